@@ -29,16 +29,26 @@ cbuffer cbPerPass : register(b0)
     float gDeltaTime;
 };
 
-cbuffer cbPerObject : register(b1)
+// Root constants, one set per instanced draw
+cbuffer cbPerBatch : register(b1)
 {
-    float4x4 pObjToWorld;
+    // Identity (0 and 1) unless positions are quantized
+    float3 pQuantOffset;
+    uint pFirstInstance;
+    float3 pQuantScale;
+    float cbPerBatchPad1;
 }
 
-VSout VS(VSin vin)
+// Object to world transforms of every instance drawn this frame
+StructuredBuffer<float4x4> gInstanceToWorld : register(t0);
+
+VSout VS(VSin vin, uint instanceID : SV_InstanceID)
 {
     VSout vout;
 
-    float4 posW = mul(float4(vin.position, 1.0f), pObjToWorld);
+    float4x4 objToWorld = gInstanceToWorld[pFirstInstance + instanceID];
+    float3 position = pQuantOffset + pQuantScale * vin.position.xyz;
+    float4 posW = mul(float4(position, 1.0f), objToWorld);
     vout.posH = mul(posW, gViewProj);
     
     return vout;
@@ -3,6 +3,15 @@ struct VSout
     float4 posH : SV_POSITION;
 };
 
+#ifdef PACKED_VERTICES
+// See Racoon::PackedVertex / PackedQuantizedVertex
+struct VSin
+{
+    float4 position : POSITION; // float3, or unorm16 to be dequantized with pQuantOffset/pQuantScale
+    float4 tangentFrame : TANGENTFRAME; // octahedral normal in xy, tangent in zw, handedness in sign(w)
+    float2 uv : UV;
+};
+#else
 struct VSin
 {
     float3 position : POSITION;
@@ -10,6 +19,25 @@ struct VSin
     float3 tangent : TANGENT;
     float2 uv : UV;
 };
+#endif
+
+float3 DecodeOctahedral(float2 e)
+{
+    float3 n = float3(e.xy, 1.0f - abs(e.x) - abs(e.y));
+    float t = saturate(-n.z);
+    n.x += n.x >= 0.0f ? -t : t;
+    n.y += n.y >= 0.0f ? -t : t;
+    return normalize(n);
+}
+
+// Unpacks a TANGENTFRAME attribute. Returns the tangent handedness
+float DecodeTangentFrame(float4 frame, out float3 normal, out float3 tangent)
+{
+    float handedness = frame.w < 0.0f ? -1.0f : 1.0f;
+    normal = DecodeOctahedral(frame.xy);
+    tangent = DecodeOctahedral(float2(frame.z, abs(frame.w) * 2.0f - 1.0f));
+    return handedness;
+}
 
 void Placeholder()
 {
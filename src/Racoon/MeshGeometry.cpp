@@ -1,6 +0,0 @@
-#include "MeshGeometry.h"
-
-namespace Racoon {
-
-
-}
\ No newline at end of file
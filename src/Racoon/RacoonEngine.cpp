@@ -5,6 +5,9 @@
 
 #include "base/ShaderCompilerHelper.h"
 #include "base/ImGuiHelper.h"
+#include "HeadlessBenchmark.h"
+
+#include <fstream>
 
 namespace Racoon {
 
@@ -21,6 +24,39 @@ void RacoonEngine::OnParseCommandLine(LPSTR lpCmdLine, uint32_t* pWidth, uint32_
     // Set some default values
     *pWidth = 1920;
     *pHeight = 1080;
+
+    // -width N -height N override the window size, -scene loads a glTF,
+    // -uploadmb N sets the geometry streamed to the GPU per frame, -terrain
+    // streams a noise terrain around the camera
+    const std::vector<std::string> Args = SplitCommandLine(lpCmdLine);
+    for (size_t i = 0; i < Args.size(); ++i)
+    {
+        if (Args[i] == "-terrain")
+        {
+            m_TerrainEnabled = true;
+            continue;
+        }
+        if (i + 1 == Args.size())
+            break;
+        if (Args[i] == "-scene")
+        {
+            m_ScenePath = Args[++i];
+            continue;
+        }
+        if (Args[i] == "-uploadmb")
+        {
+            const unsigned long Megabytes = std::strtoul(Args[++i].c_str(), nullptr, 10);
+            if (Megabytes > 0 && Megabytes <= 256)
+                m_UploadBudget = uint64_t(Megabytes) * 1024 * 1024;
+            continue;
+        }
+        uint32_t* pTarget = Args[i] == "-width" ? pWidth : Args[i] == "-height" ? pHeight : nullptr;
+        if (!pTarget)
+            continue;
+        const unsigned long Value = std::strtoul(Args[++i].c_str(), nullptr, 10);
+        if (Value > 0 && Value <= 16384)
+            *pTarget = static_cast<uint32_t>(Value);
+    }
 }
 
 void RacoonEngine::OnCreate()
@@ -29,7 +65,11 @@ void RacoonEngine::OnCreate()
     CreateShaderCache();
 
     m_Renderer.reset(new Renderer());
-    m_Renderer->OnCreate(&m_device, &m_swapChain);
+    m_Renderer->SetScenePath(m_ScenePath);
+    if (m_UploadBudget > 0)
+        m_Renderer->SetUploadBudget(m_UploadBudget);
+    m_Renderer->SetTerrainEnabled(m_TerrainEnabled);
+    m_Renderer->OnCreate(&m_device, &m_swapChain, &m_Jobs);
 
     ImGUI_Init(m_windowHwnd);
 
@@ -104,18 +144,35 @@ void RacoonEngine::UpdateCamera(Camera& cam, const ImGuiIO& io)
 
 void RacoonEngine::OnRender()
 {
+    // Before anything samples input, so the wait does not add latency
+    {
+        RACOON_PROFILE_SCOPE("FramePacer");
+        m_Pacer.SetTargetFps(m_UIState.bLimitFrameRate ? m_UIState.TargetFps : 0.f);
+        m_Pacer.WaitForNextFrame();
+    }
+
     BeginFrame();
 
-    RECT rect;
-    GetClientRect(m_windowHwnd, &rect);
-    ImGUI_UpdateIO((float)(rect.right - rect.left), (float)(rect.bottom - rect.top));
-    ImGui::NewFrame();
-    BuildUI();
+    {
+        RACOON_PROFILE_SCOPE("BuildUI");
+        RECT rect;
+        GetClientRect(m_windowHwnd, &rect);
+        ImGUI_UpdateIO((float)(rect.right - rect.left), (float)(rect.bottom - rect.top));
+        ImGui::NewFrame();
+        BuildUI();
+    }
 
-    OnUpdate();
+    {
+        RACOON_PROFILE_SCOPE("OnUpdate");
+        OnUpdate();
+    }
     m_Renderer->OnRender(&m_swapChain, m_Camera, m_Timer);
 
-    EndFrame();
+    {
+        RACOON_PROFILE_SCOPE("Present");
+        EndFrame();
+    }
+    Profiler::Get().EndFrame();
     CalculateFrameStats();
 }
 
@@ -130,6 +187,7 @@ bool RacoonEngine::OnEvent(MSG msg)
     case WM_KEYUP:
     case WM_SYSKEYUP:
         if (KeyPressed == VK_F1) m_UIState.bShowUI ^= 1;
+        if (KeyPressed == VK_F2) WriteProfilerTrace();
         break;
     }
     return true;
@@ -151,29 +209,32 @@ void RacoonEngine::OnUpdateDisplay()
 
 void RacoonEngine::CalculateFrameStats()
 {
-    static int FrameCount = 0;
-    static float TimeElapsed = 0;
+    const Profiler& Prof = Profiler::Get();
 
-    ++FrameCount;
+    // Every frame goes into the graph, so a single spike stays visible
+    m_UIState.FrameMillisec[m_UIState.CurrentFrameMsIndex++] = static_cast<float>(Prof.GetFrameMilliseconds());
+    if (m_UIState.CurrentFrameMsIndex >= m_UIState.FrameratesGraphValues)
+        m_UIState.CurrentFrameMsIndex = 0;
 
-    if (m_Timer.TotalTime() - TimeElapsed >= m_UIState.StatsUpdateFrequency)
+    // The numbers refresh slower so they stay readable
+    if (m_Timer.TotalTime() - m_UIState.LastStatsUpdate >= m_UIState.StatsUpdateFrequency)
     {
-        float FPS = (float)FrameCount / m_UIState.StatsUpdateFrequency;
-        float mspf = 1000.f / FPS;
-        
-        m_UIState.LastMeasuredFPS = FPS;
-        m_UIState.MillisecondsPerFrame = mspf;
-
-        FrameCount = 0;
-        TimeElapsed += m_UIState.StatsUpdateFrequency;
-
-        m_UIState.FrameMillisec[m_UIState.CurrentFrameMsIndex++] = mspf;
-        if (m_UIState.CurrentFrameMsIndex >= m_UIState.FrameratesGraphValues)
-            m_UIState.CurrentFrameMsIndex = 0;
+        m_UIState.FrameStats = Prof.GetFrameStats();
+        m_UIState.Pacing = m_Pacer.GetStats();
+        Prof.GetScopeStats(m_UIState.Scopes);
+        m_UIState.MillisecondsPerFrame = static_cast<float>(m_UIState.FrameStats.MeanMs);
+        m_UIState.LastMeasuredFPS = m_UIState.MillisecondsPerFrame > 0.f ? 1000.f / m_UIState.MillisecondsPerFrame : 0.f;
+        m_UIState.LastStatsUpdate = m_Timer.TotalTime();
     }
-
 }
 
+void RacoonEngine::WriteProfilerTrace()
+{
+    // Open in chrome://tracing or ui.perfetto.dev
+    std::ofstream Trace("RacoonTrace.json");
+    if (Trace)
+        Profiler::Get().WriteChromeTrace(Trace, m_UIState.TraceFrames);
+}
 }
 
 int WINAPI WinMain(HINSTANCE hInstance,
@@ -181,6 +242,17 @@ int WINAPI WinMain(HINSTANCE hInstance,
     LPSTR lpCmdLine,
     int nCmdShow)
 {
+    // --headless runs the CPU frame pipeline on a synthetic scene without
+    // creating a window or device. A GUI process has no console, so the
+    // JSON goes to a file unless --out says where.
+    std::vector<std::string> Args = Racoon::SplitCommandLine(lpCmdLine);
+    if (std::find(Args.begin(), Args.end(), "--headless") != Args.end())
+    {
+        if (std::find(Args.begin(), Args.end(), "--out") == Args.end())
+            Args.insert(Args.end(), { "--out", "RacoonHeadless.json" });
+        return Racoon::RunHeadlessBenchmarkMain(Args);
+    }
+
     LPCSTR Name = "Racoon Engine 0.0.1";
     return RunFramework(hInstance, lpCmdLine, nCmdShow, new Racoon::RacoonEngine(Name));
 }
\ No newline at end of file
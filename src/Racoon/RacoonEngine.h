@@ -5,7 +5,9 @@
 #include "base/FrameworkWindows.h"
 
 #include "Renderer.h"
+#include "FramePacer.h"
 #include "GameTimer.h"
+#include "JobSystem.h"
 #include "UI.h"
 #include "Misc/Camera.h"
 
@@ -32,12 +34,25 @@ namespace Racoon {
 		void BuildUI();
 
 		void CalculateFrameStats();
+		// Dumps the last UIState::TraceFrames frames as a Chrome trace
+		void WriteProfilerTrace();
 	private:
+		// One worker per core, the main thread is worker 0. Declared first so
+		// it outlives everything that queues jobs.
+		JobSystem m_Jobs;
 		std::unique_ptr<Renderer> m_Renderer;
 		GameTimer m_Timer;
+		// Frame rate cap, set from the UI. Waits at the top of OnRender.
+		FramePacer m_Pacer;
 		UIState m_UIState;
 
 		Camera m_Camera;
+		// From -scene on the command line
+		std::string m_ScenePath;
+		// From -uploadmb, 0 keeps the renderer's default
+		uint64_t m_UploadBudget{ 0 };
+		// From -terrain
+		bool m_TerrainEnabled{ false };
 
 		bool m_IsPaused{ false };
 
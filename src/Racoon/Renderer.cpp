@@ -7,18 +7,224 @@
 
 #include <DirectXColors.h>
 
+#include "ContentHash.h"
+#include "GltfLoader.h"
+#include "MeshOptimizer.h"
 #include "PrimitivesGenerator.h"
 
+#include <chrono>
+#include <cstring>
+
 namespace Racoon {
 
-void Renderer::OnCreate(Device* pDevice, SwapChain* pSwapChain)
+static DXGI_FORMAT ToDXGIFormat(VertexFormat Format)
+{
+    switch (Format)
+    {
+    case VertexFormat::Float2:    return DXGI_FORMAT_R32G32_FLOAT;
+    case VertexFormat::Float3:    return DXGI_FORMAT_R32G32B32_FLOAT;
+    case VertexFormat::Half2:     return DXGI_FORMAT_R16G16_FLOAT;
+    case VertexFormat::Snorm16x4: return DXGI_FORMAT_R16G16B16A16_SNORM;
+    case VertexFormat::Unorm16x4: return DXGI_FORMAT_R16G16B16A16_UNORM;
+    }
+    assert(false && "Unknown vertex format");
+    return DXGI_FORMAT_UNKNOWN;
+}
+
+static D3D_PRIMITIVE_TOPOLOGY ToD3DTopology(PrimitiveTopology Topology)
+{
+    switch (Topology)
+    {
+    case PrimitiveTopology::TriangleList:  return D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+    case PrimitiveTopology::TriangleStrip: return D3D_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP;
+    case PrimitiveTopology::LineList:      return D3D_PRIMITIVE_TOPOLOGY_LINELIST;
+    }
+    assert(false && "Unknown primitive topology");
+    return D3D_PRIMITIVE_TOPOLOGY_UNDEFINED;
+}
+
+static void GetInputLayout(const VertexLayout& Layout, std::vector<D3D12_INPUT_ELEMENT_DESC>& InputLayout)
+{
+    InputLayout.clear();
+    for (const VertexAttribute& Attribute : Layout.Attributes)
+    {
+        InputLayout.push_back({ Attribute.Semantic, 0, ToDXGIFormat(Attribute.Format), 0, Attribute.Offset,
+            D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 });
+    }
+}
+
+namespace {
+
+// Shapes of the built-in primitives. They are hashed into the cache key, so
+// bump PrimitivesRevision when the generator or OptimizeMesh change their output.
+constexpr uint32_t PrimitivesRevision = 2;
+// Cube, cylinder and sphere
+constexpr uint32_t PrimitiveCount = 3;
+struct PrimitiveParameters
+{
+    float CylinderBottomRadius{ 1.f };
+    float CylinderTopRadius{ 1.5f };
+    float CylinderHeight{ 2.f };
+    uint32_t CylinderSlices{ 8 };
+    uint32_t CylinderStacks{ 2 };
+    float SphereRadius{ 1.5f };
+    uint32_t SphereSubdivisions{ 1 };
+};
+
+// LOD chains built for every streamed mesh. Hashed into the cache key with
+// SimplifierRevision, to bump when the simplifier changes its output.
+constexpr uint32_t SimplifierRevision = 1;
+LodChainOptions GetLodOptions()
+{
+    return LodChainOptions();
+}
+
+// Objects whose mesh is not resident yet have no scene tree proxy
+constexpr uint32_t NoProxy = ~0u;
+// State of the geometry buffers outside the copies
+constexpr D3D12_RESOURCE_STATES GeometryReadState =
+    D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER | D3D12_RESOURCE_STATE_INDEX_BUFFER;
+
+// DXC through Cauldron's helper, which finds files in its shader library
+// directory. The version is the hash of the dxcompiler.dll the process
+// loaded, so updating the DLL recompiles every shader.
+class CauldronShaderCompiler final : public ShaderCompiler
+{
+public:
+    std::string GetVersion() const override
+    {
+        char Path[MAX_PATH];
+        const HMODULE Module = GetModuleHandleA("dxcompiler.dll");
+        const DWORD Length = Module ? GetModuleFileNameA(Module, Path, MAX_PATH) : 0;
+        uint64_t Hash = 0;
+        if (Length > 0 && Length < MAX_PATH && HashFile(std::string(Path, Length), Hash))
+            return "DXC " + std::to_string(Hash);
+
+        // Unknown DXC: a version no stored shader has, so this run compiles
+        // everything instead of trusting blobs from another compiler
+        OutputDebugStringA("dxcompiler.dll could not be hashed, recompiling every shader\n");
+        const auto Now = std::chrono::system_clock::now().time_since_epoch().count();
+        return "DXC unknown " + std::to_string(GetCurrentProcessId()) + " " + std::to_string(Now);
+    }
+
+    bool Compile(const std::string&, const ShaderDesc& Desc, std::vector<uint8_t>& Bytecode,
+        std::string& Error) override
+    {
+        DefineList Defines;
+        for (const auto& Define : Desc.Defines)
+            Defines[Define.first] = Define.second;
+        const std::string Params = "-T " + Desc.Profile;
+        D3D12_SHADER_BYTECODE Compiled = {};
+        if (!CompileShaderFromFile(Desc.File.c_str(), &Defines, Desc.EntryPoint.c_str(), Params.c_str(), &Compiled))
+        {
+            Error = "DXC failed, its diagnostics are in the debug output";
+            return false;
+        }
+        const uint8_t* Data = static_cast<const uint8_t*>(Compiled.pShaderBytecode);
+        Bytecode.assign(Data, Data + Compiled.BytecodeLength);
+        return true;
+    }
+};
+
+// Forwards draw recording to a D3D12 command list. Begin binds the state
+// every list of the pass shares, since lists recorded in parallel start empty.
+class D3D12DrawCommandList final : public DrawCommandList
+{
+public:
+    // One renderer pipeline state, built for each topology type it may draw
+    struct PipelineStateSet
+    {
+        ID3D12PipelineState* Triangles;
+        ID3D12PipelineState* Lines;
+    };
+
+    struct PassState
+    {
+        ID3D12DescriptorHeap* DescriptorHeap;
+        ID3D12RootSignature* RootSignature;
+        // Indexed by DrawBatch::PipelineState
+        const PipelineStateSet* PipelineStates;
+        uint32_t PipelineStateCount;
+        D3D12_CPU_DESCRIPTOR_HANDLE RenderTarget;
+        D3D12_CPU_DESCRIPTOR_HANDLE DepthStencil;
+        D3D12_VIEWPORT Viewport;
+        D3D12_RECT Scissor;
+        D3D12_GPU_VIRTUAL_ADDRESS PerFrameBuffer;
+        D3D12_GPU_VIRTUAL_ADDRESS InstanceBuffer;
+        const D3D12_VERTEX_BUFFER_VIEW* VertexBuffer;
+        const D3D12_INDEX_BUFFER_VIEW* IndexBuffer16;
+        const D3D12_INDEX_BUFFER_VIEW* IndexBuffer32;
+    };
+
+    D3D12DrawCommandList(ID3D12GraphicsCommandList2* CmdList, const PassState& State)
+        : m_CmdList(CmdList), m_State(State) {}
+
+    void Begin() override
+    {
+        m_CmdList->SetDescriptorHeaps(1, &m_State.DescriptorHeap);
+        m_CmdList->SetGraphicsRootSignature(m_State.RootSignature);
+        m_CmdList->OMSetRenderTargets(1, &m_State.RenderTarget, true, &m_State.DepthStencil);
+        m_CmdList->RSSetViewports(1, &m_State.Viewport);
+        m_CmdList->RSSetScissorRects(1, &m_State.Scissor);
+        m_CmdList->IASetVertexBuffers(0, 1, m_State.VertexBuffer);
+        m_CmdList->SetGraphicsRootConstantBufferView(0, m_State.PerFrameBuffer);
+        m_CmdList->SetGraphicsRootShaderResourceView(2, m_State.InstanceBuffer);
+    }
+
+    void SetPipelineState(uint16_t PipelineState, PrimitiveTopology Topology) override
+    {
+        assert(PipelineState < m_State.PipelineStateCount);
+        const PipelineStateSet& States = m_State.PipelineStates[PipelineState];
+        ID3D12PipelineState* Pso = Topology == PrimitiveTopology::LineList ? States.Lines : States.Triangles;
+        assert(Pso && "Pipeline state not built for this topology");
+        // A list and a strip share the pipeline state, only the topology changes
+        if (Pso != m_BoundPipelineState)
+        {
+            m_CmdList->SetPipelineState(Pso);
+            m_BoundPipelineState = Pso;
+        }
+        m_CmdList->IASetPrimitiveTopology(ToD3DTopology(Topology));
+    }
+
+    void SetBatchConstants(const BatchConstants& Constants) override
+    {
+        m_CmdList->SetGraphicsRoot32BitConstants(1, sizeof(BatchConstants) / sizeof(uint32_t), &Constants, 0);
+    }
+
+    void SetIndexBuffer(IndexFormat Width) override
+    {
+        m_CmdList->IASetIndexBuffer(Width == IndexFormat::Uint16 ? m_State.IndexBuffer16 : m_State.IndexBuffer32);
+    }
+
+    void DrawIndexedInstanced(uint32_t IndexCount, uint32_t InstanceCount, uint32_t StartIndexLocation,
+        uint32_t BaseVertexLocation) override
+    {
+        m_CmdList->DrawIndexedInstanced(IndexCount, InstanceCount, StartIndexLocation, BaseVertexLocation, 0);
+    }
+
+private:
+    ID3D12GraphicsCommandList2* m_CmdList;
+    const PassState& m_State;
+    ID3D12PipelineState* m_BoundPipelineState{ nullptr };
+};
+
+} // namespace
+
+void Renderer::OnCreate(Device* pDevice, SwapChain* pSwapChain, JobSystem* pJobs)
 {
     m_pDevice = pDevice;
     m_pSwapChain = pSwapChain;
+    m_pJobs = pJobs;
+    // At most 4 chunks per pass, a chunk holds at least 128 batches
+    m_DrawRecorder = ParallelDrawRecorder(pJobs, 4);
+    m_FrameAllocator = FrameAllocator(BACKBUFFER_COUNT, pJobs ? pJobs->GetThreadCount() : 1);
     
     m_BackbufferFormat = pSwapChain->GetFormat();
 
-    m_CommandListRing.OnCreate(pDevice, BACKBUFFER_COUNT, 4, pDevice->GetGraphicsQueue()->GetDesc());
+    // One list to clear, one for geometry copies, one per recording chunk of
+    // each pass, two for terrain copies and draws, one for UI and present
+    m_CommandListRing.OnCreate(pDevice, BACKBUFFER_COUNT, 5 + 2 * m_DrawRecorder.GetMaxChunks(),
+        pDevice->GetGraphicsQueue()->GetDesc());
     m_RtvDescriptorSize = m_pDevice->GetDevice()->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_RTV);
     m_DsvDescriptorSize = m_pDevice->GetDevice()->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_DSV);
     m_CbvDescriptorSize = m_pDevice->GetDevice()->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
@@ -33,21 +239,25 @@ void Renderer::OnCreate(Device* pDevice, SwapChain* pSwapChain)
 
     m_ResourceViewHeaps.AllocDSVDescriptor(1, &m_DepthDSV);
 
-    const uint32_t uploadHeapMemSize = 2000 * 1024 * 1024;
+    // Only ImGui's font goes through the upload heap, geometry streams through its own staging
+    const uint32_t uploadHeapMemSize = 64 * 1024 * 1024;
     const uint32_t constantBufferMemSize = 200 * 1024 * 1024;
     m_DynamicBufferRing.OnCreate(pDevice, BACKBUFFER_COUNT, constantBufferMemSize, &m_ResourceViewHeaps);
     m_UploadHeap.OnCreate(pDevice, uploadHeapMemSize);
 
     m_ImGUIHelper.OnCreate(pDevice, &m_UploadHeap, &m_ResourceViewHeaps, &m_DynamicBufferRing, pSwapChain->GetFormat());
 
-    // Create a 'static' pool for vertices, indices and constant buffers
-    const uint32_t staticGeometryMemSize = (5 * 128) * 1024 * 1024;
-    m_StaticBufferPool.OnCreate(pDevice, staticGeometryMemSize, true, "StaticGeometry");
-    
     CreateRootSignature();
 
+    // Misses compile on the job system; nothing else runs on it yet
+    m_ShaderCompiler = std::make_unique<CauldronShaderCompiler>();
+    m_ShaderCache = std::make_unique<ShaderCache>(GetShaderCompilerLibDir(), "RacoonShaderCache", *m_ShaderCompiler,
+        pJobs);
+
     std::vector<D3D12_INPUT_ELEMENT_DESC> layout;
     CreateGeometry(layout);
+    if (m_TerrainEnabled)
+        CreateTerrain();
     CreateGraphicsPipelineState(layout);
 
     m_UploadHeap.FlushAndFinish();
@@ -75,8 +285,10 @@ void Renderer::OnCreateWindowSizeDependentResources(SwapChain* pSwapChain, uint3
 
 void Renderer::OnRender(SwapChain* pSwapChain, const Camera& Cam, const GameTimer& Timer)
 {
+    RACOON_PROFILE_SCOPE("Renderer::OnRender");
     m_CommandListRing.OnBeginFrame();
     m_DynamicBufferRing.OnBeginFrame();
+    m_FrameAllocator.BeginFrame();
     
     ID3D12GraphicsCommandList2* CmdList = m_CommandListRing.GetNewCommandList();
 
@@ -84,52 +296,196 @@ void Renderer::OnRender(SwapChain* pSwapChain, const Camera& Cam, const GameTime
         D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_RENDER_TARGET));
 
     Clear(pSwapChain, CmdList);
+    ThrowIfFailed(CmdList->Close());
+    m_SubmittedLists.clear();
+    m_SubmittedLists.push_back(CmdList);
 
-    CmdList->OMSetRenderTargets(1, pSwapChain->GetCurrentBackBufferRTV(), true, &m_DepthDSV.GetCPU());
-    CmdList->RSSetViewports(1, &m_Viewport);
-    CmdList->RSSetScissorRects(1, &m_RectScissor);
+    // Adds arrived meshes and copies this frame's share of them
+    StreamGeometry();
 
-    PerFrame perFrame = FillPerFrameConstants(Cam);
+    PerFrame perFrame = FillPerFrameConstants(Cam, Timer);
     m_PerFrameBuffer = m_DynamicBufferRing.AllocConstantBuffer(sizeof(PerFrame), &perFrame);
     //std::array<float, 4> time{ Timer.TotalTime(), 0.f, 0.f, 0.f };
     //m_TimeCB = m_DynamicBufferRing.AllocConstantBuffer(sizeof(float) * 4, time.data());
-    // Set descriptor heap
-    ID3D12DescriptorHeap *descriptorHeap = m_ResourceViewHeaps.GetCBV_SRV_UAVHeap();
-    CmdList->SetDescriptorHeaps(1, &descriptorHeap);
-    CmdList->SetGraphicsRootSignature(m_RootSignature);
-    CmdList->SetGraphicsRootConstantBufferView(0, m_PerFrameBuffer);
-    CmdList->SetPipelineState(m_PipelineState);
-
-    CmdList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-
 
     // PER OBJECT
-    for (auto& Object : m_Objects)
+    // Only transforms that changed since last frame touch their bounds and
+    // proxies. Objects outside the view frustum are dropped before sorting.
+    // Items that stay inside their fat box cost one containment test; the rest
+    // are refitted together, with a full rebuild once the tree has degraded
     {
-        // Set per frame constants
-        PerObject perObject;
-        perObject.objToWorld = Object->GetObjectToWorldMatrix();
-        m_PerObjectBuffer = m_DynamicBufferRing.AllocConstantBuffer(sizeof(PerObject), &perObject);
-        CmdList->SetGraphicsRootConstantBufferView(1, m_PerObjectBuffer);
+        RACOON_PROFILE_SCOPE("UpdateScene");
+        m_Transforms.Update();
+        for (size_t i = 0; i < m_Objects.size(); ++i)
+        {
+            if (!m_Transforms.HasChanged(m_Objects[i]->GetTransform()))
+                continue;
+            m_Objects[i]->UpdateWorldBounds();
+            if (m_ObjectProxies[i] == NoProxy)
+                continue;
+            m_SceneTree.MoveProxy(m_ObjectProxies[i], Aabb::FromBounds(m_Objects[i]->GetWorldBounds()));
+        }
+        m_SceneTree.Refit();
+        m_SceneTree.RebuildIfDegraded();
+    }
+    const Frustum ViewFrustum = Frustum::FromViewProjection(Cam.GetProjection() * Cam.GetView());
+    {
+        RACOON_PROFILE_SCOPE("Cull");
+        m_VisibleObjects.clear();
+        m_SceneTree.QueryFrustum(ViewFrustum, m_VisibleObjects);
+    }
 
-        // Draw geometry
-        CmdList->IASetVertexBuffers(0, 1, &m_VertexBufferView);
-        CmdList->IASetIndexBuffer(&m_IndexBufferView);
+    // Visible items with a chain draw the coarsest level whose error stays
+    // under a pixel on screen
+    {
+        const math::Vector3 Eye = math::inverse(Cam.GetView()).getTranslation();
+        LodSelectionView View;
+        View.Eye = XMFLOAT3(Eye.getX(), Eye.getY(), Eye.getZ());
+        View.ProjectionScale = 0.5f * m_Height * Cam.GetProjection().getCol1().getY();
+        SelectLods(m_Objects, m_VisibleObjects, m_LodChains, View);
+        // The terrain selects the levels of its chunks the same way
+        if (m_Terrain)
+            UpdateTerrain(View, ViewFrustum);
+    }
 
-        CmdList->DrawIndexedInstanced(
-            static_cast<uint32_t>(Object->GetMesh()->Indices32.size()), 1,
-            Object->StartIndexLocation, Object->BaseVertexLocation, 0);
+    // Sorted by state then front to back for opaque, back to front for transparent
+    {
+        RACOON_PROFILE_SCOPE("Sort");
+        m_RenderQueue.Build(m_Objects, m_VisibleObjects, Cam.GetView());
+        m_ObjectsOpaque.clear();
+        for (uint32_t Item : m_RenderQueue.GetOpaque())
+            m_ObjectsOpaque.push_back(m_Objects[Item]);
+        m_ObjectsTransparent.clear();
+        for (uint32_t Item : m_RenderQueue.GetTransparent())
+            m_ObjectsTransparent.push_back(m_Objects[Item]);
     }
+
+    DrawObjects(pSwapChain, m_ObjectsOpaque, BatchMerging::Any, m_OpaqueBatcher);
+    if (m_Terrain)
+        DrawTerrain(pSwapChain);
+    DrawObjects(pSwapChain, m_ObjectsTransparent, BatchMerging::Adjacent, m_TransparentBatcher);
     // PER OBJECT FINISHED
     // 
     // Draw UI
+    CmdList = m_CommandListRing.GetNewCommandList();
+    ID3D12DescriptorHeap *descriptorHeap = m_ResourceViewHeaps.GetCBV_SRV_UAVHeap();
+    CmdList->SetDescriptorHeaps(1, &descriptorHeap);
+    CmdList->OMSetRenderTargets(1, pSwapChain->GetCurrentBackBufferRTV(), true, &m_DepthDSV.GetCPU());
+    CmdList->RSSetViewports(1, &m_Viewport);
+    CmdList->RSSetScissorRects(1, &m_RectScissor);
     m_ImGUIHelper.Draw(CmdList);
     // Switch backbuffer
     CmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(pSwapChain->GetCurrentBackBufferResource(),
         D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_PRESENT));
     ThrowIfFailed(CmdList->Close());
-    ID3D12CommandList* CmdListLists[] = { CmdList };
-    m_pDevice->GetGraphicsQueue()->ExecuteCommandLists(1, CmdListLists);
+    m_SubmittedLists.push_back(CmdList);
+
+    // The lists run in the order they were recorded, so chunked passes draw
+    // exactly as if they had been recorded into one list
+    m_pDevice->GetGraphicsQueue()->ExecuteCommandLists(static_cast<UINT>(m_SubmittedLists.size()),
+        m_SubmittedLists.data());
+    ++m_FrameIndex;
+}
+
+void Renderer::DrawObjects(SwapChain* pSwapChain,
+    const std::vector<std::shared_ptr<RenderItem>>& Objects, BatchMerging Merging, DrawBatcher& Batcher)
+{
+    RACOON_PROFILE_SCOPE("DrawObjects");
+    // Items sharing a mesh and pipeline state become one instanced draw.
+    // Their transforms go to a single per-frame buffer the shader indexes
+    // with FirstInstance + SV_InstanceID
+    Batcher.Build(Objects, Merging);
+    const std::vector<DrawBatch>& Batches = Batcher.GetBatches();
+    if (Batches.empty())
+        return;
+
+    // Everything that allocates from the rings happens here, on the calling
+    // thread; the workers only write into their own command lists
+    const auto& Transforms = Batcher.GetInstanceTransforms();
+    D3D12DrawCommandList::PassState State;
+    State.DescriptorHeap = m_ResourceViewHeaps.GetCBV_SRV_UAVHeap();
+    State.RootSignature = m_RootSignature;
+    // The scene has a single pipeline state, see RenderItem::PipelineState
+    const D3D12DrawCommandList::PipelineStateSet SceneStates[] = { { m_PipelineState, m_LinePipelineState } };
+    State.PipelineStates = SceneStates;
+    State.PipelineStateCount = 1;
+    State.RenderTarget = *pSwapChain->GetCurrentBackBufferRTV();
+    State.DepthStencil = m_DepthDSV.GetCPU();
+    State.Viewport = m_Viewport;
+    State.Scissor = m_RectScissor;
+    State.PerFrameBuffer = m_PerFrameBuffer;
+    State.InstanceBuffer = m_DynamicBufferRing.AllocConstantBuffer(
+        static_cast<uint32_t>(Transforms.size() * sizeof(math::Matrix4)),
+        const_cast<math::Matrix4*>(Transforms.data()));
+    State.VertexBuffer = &m_VertexBufferView;
+    State.IndexBuffer16 = &m_IndexBufferView16;
+    State.IndexBuffer32 = &m_IndexBufferView32;
+
+    const uint32_t ChunkCount = m_DrawRecorder.GetChunkCount(Batches.size());
+    // Scratch for this pass only, from the frame arena instead of the heap
+    std::pmr::vector<D3D12DrawCommandList> Lists(&m_FrameAllocator.GetArena());
+    std::pmr::vector<DrawCommandList*> ListPointers(&m_FrameAllocator.GetArena());
+    Lists.reserve(ChunkCount);
+    ListPointers.reserve(ChunkCount);
+    const size_t FirstSubmitted = m_SubmittedLists.size();
+    for (uint32_t Chunk = 0; Chunk < ChunkCount; ++Chunk)
+    {
+        ID3D12GraphicsCommandList2* CmdList = m_CommandListRing.GetNewCommandList();
+        m_SubmittedLists.push_back(CmdList);
+        Lists.emplace_back(CmdList, State);
+        ListPointers.push_back(&Lists.back());
+    }
+
+    m_DrawRecorder.Record(Batches, ListPointers.data());
+
+    for (size_t i = FirstSubmitted; i < m_SubmittedLists.size(); ++i)
+        ThrowIfFailed(static_cast<ID3D12GraphicsCommandList2*>(m_SubmittedLists[i])->Close());
+}
+
+void Renderer::DrawTerrain(SwapChain* pSwapChain)
+{
+    RACOON_PROFILE_SCOPE("DrawTerrain");
+    if (m_VisibleTerrain.empty())
+        return;
+
+    // Positions are in world space: one identity instance, no quantization
+    math::Matrix4 Identity = math::Matrix4::identity();
+    D3D12DrawCommandList::PassState State;
+    State.DescriptorHeap = m_ResourceViewHeaps.GetCBV_SRV_UAVHeap();
+    State.RootSignature = m_RootSignature;
+    const D3D12DrawCommandList::PipelineStateSet TerrainStates = { m_TerrainPipelineState, nullptr };
+    State.PipelineStates = &TerrainStates;
+    State.PipelineStateCount = 1;
+    State.RenderTarget = *pSwapChain->GetCurrentBackBufferRTV();
+    State.DepthStencil = m_DepthDSV.GetCPU();
+    State.Viewport = m_Viewport;
+    State.Scissor = m_RectScissor;
+    State.PerFrameBuffer = m_PerFrameBuffer;
+    State.InstanceBuffer = m_DynamicBufferRing.AllocConstantBuffer(sizeof(Identity), &Identity);
+    State.VertexBuffer = &m_TerrainVertexBufferView;
+    State.IndexBuffer16 = &m_TerrainIndexBufferView;
+    State.IndexBuffer32 = &m_TerrainIndexBufferView;
+
+    ID3D12GraphicsCommandList2* CmdList = m_CommandListRing.GetNewCommandList();
+    D3D12DrawCommandList List(CmdList, State);
+    List.Begin();
+    List.SetPipelineState(0, PrimitiveTopology::TriangleList);
+    const VertexQuantization None;
+    BatchConstants Constants;
+    Constants.QuantOffset = None.Offset;
+    Constants.FirstInstance = 0;
+    Constants.QuantScale = None.Scale;
+    Constants.Pad = 0.f;
+    List.SetBatchConstants(Constants);
+    List.SetIndexBuffer(IndexFormat::Uint16);
+    const std::vector<TerrainDraw>& Draws = m_Terrain->GetDraws();
+    for (uint32_t Visible : m_VisibleTerrain)
+    {
+        const TerrainDraw& Draw = Draws[Visible];
+        List.DrawIndexedInstanced(Draw.IndexCount, 1, Draw.StartIndex, Draw.BaseVertex);
+    }
+    ThrowIfFailed(CmdList->Close());
+    m_SubmittedLists.push_back(CmdList);
 }
 
 void Renderer::Clear(SwapChain* pSwapChain, ID3D12GraphicsCommandList2* CmdList)
@@ -140,80 +496,609 @@ void Renderer::Clear(SwapChain* pSwapChain, ID3D12GraphicsCommandList2* CmdList)
 
 void Renderer::CreateGeometry(std::vector<D3D12_INPUT_ELEMENT_DESC>& layout)
 {
+    // The layout follows the vertex encoding. glTF meshes come with every
+    // Vertex attribute filled in, derived where the file lacks it, so they
+    // share the layout with the primitives.
+    const VertexLayout VertexLayoutDesc = GetVertexLayout(m_VertexEncoding);
+    GetInputLayout(VertexLayoutDesc, layout);
+
+    // Fixed GPU arenas the registry's arenas are copied into, as the static pool was
+    const uint64_t MB = 1024 * 1024;
+    const uint64_t Capacities[GeometryArenaCount] = { 384 * MB, 64 * MB, 192 * MB };
+    const wchar_t* Names[GeometryArenaCount] = { L"StreamedVertices", L"StreamedIndices16", L"StreamedIndices32" };
+    ID3D12Device* pDevice = m_pDevice->GetDevice();
+    for (uint32_t i = 0; i < GeometryArenaCount; ++i)
+    {
+        ThrowIfFailed(pDevice->CreateCommittedResource(&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
+            D3D12_HEAP_FLAG_NONE, &CD3DX12_RESOURCE_DESC::Buffer(Capacities[i]), D3D12_RESOURCE_STATE_COPY_DEST,
+            nullptr, IID_PPV_ARGS(&m_GeometryBuffers[i])));
+        m_GeometryBuffers[i]->SetName(Names[i]);
+    }
+    m_GeometryBuffersReadable = false;
+    m_Residency = ArenaResidency(VertexLayoutDesc.Stride, Capacities);
+
+    m_VertexBufferView.BufferLocation = m_GeometryBuffers[0]->GetGPUVirtualAddress();
+    m_VertexBufferView.SizeInBytes = static_cast<UINT>(Capacities[0]);
+    m_VertexBufferView.StrideInBytes = VertexLayoutDesc.Stride;
+    m_IndexBufferView16 = { m_GeometryBuffers[1]->GetGPUVirtualAddress(), static_cast<UINT>(Capacities[1]),
+        DXGI_FORMAT_R16_UINT };
+    m_IndexBufferView32 = { m_GeometryBuffers[2]->GetGPUVirtualAddress(), static_cast<UINT>(Capacities[2]),
+        DXGI_FORMAT_R32_UINT };
+
+    // One budget's worth of staging per frame in flight, reused once that
+    // frame has retired like the dynamic buffer ring
+    ThrowIfFailed(pDevice->CreateCommittedResource(&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
+        D3D12_HEAP_FLAG_NONE, &CD3DX12_RESOURCE_DESC::Buffer(m_UploadBudget * BACKBUFFER_COUNT),
+        D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, IID_PPV_ARGS(&m_GeometryStaging)));
+    m_GeometryStaging->SetName(L"GeometryStaging");
+    CD3DX12_RANGE NoReads(0, 0);
+    ThrowIfFailed(m_GeometryStaging->Map(0, &NoReads, reinterpret_cast<void**>(&m_GeometryStagingData)));
+
+    // Opening the scene and hashing it for the cache key take time in
+    // proportion to its size, so they happen off the render thread too;
+    // frames render empty until the first meshes arrive
+    m_GeometrySetup = std::async(std::launch::async, FindGeometrySource, m_ScenePath, m_VertexEncoding);
+}
+
+void Renderer::CreateTerrain()
+{
+    // PackedQuantized would quantize each chunk to its own bounds, so the
+    // terrain keeps the float positions of Packed then
+    TerrainOptions Options;
+    Options.Encoding = m_VertexEncoding == VertexEncoding::Full ? VertexEncoding::Full : VertexEncoding::Packed;
+    m_TerrainHeights = std::make_unique<NoiseHeightSource>();
+    m_Terrain = std::make_unique<Terrain>(*m_TerrainHeights, Options, m_pJobs);
+
+    const uint64_t VertexBytes = m_Terrain->GetVertexData().size();
+    const uint64_t IndexBytes = m_Terrain->GetIndices().size() * sizeof(uint16_t);
+    ID3D12Device* pDevice = m_pDevice->GetDevice();
+    ThrowIfFailed(pDevice->CreateCommittedResource(&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
+        D3D12_HEAP_FLAG_NONE, &CD3DX12_RESOURCE_DESC::Buffer(VertexBytes), D3D12_RESOURCE_STATE_COPY_DEST,
+        nullptr, IID_PPV_ARGS(&m_TerrainVertices)));
+    m_TerrainVertices->SetName(L"TerrainVertices");
+    ThrowIfFailed(pDevice->CreateCommittedResource(&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
+        D3D12_HEAP_FLAG_NONE, &CD3DX12_RESOURCE_DESC::Buffer(IndexBytes), D3D12_RESOURCE_STATE_COPY_DEST,
+        nullptr, IID_PPV_ARGS(&m_TerrainIndices)));
+    m_TerrainIndices->SetName(L"TerrainIndices");
+    m_TerrainBuffersReadable = false;
+
+    m_TerrainVertexBufferView.BufferLocation = m_TerrainVertices->GetGPUVirtualAddress();
+    m_TerrainVertexBufferView.SizeInBytes = static_cast<UINT>(VertexBytes);
+    m_TerrainVertexBufferView.StrideInBytes = m_Terrain->GetVertexStride();
+    m_TerrainIndexBufferView = { m_TerrainIndices->GetGPUVirtualAddress(), static_cast<UINT>(IndexBytes),
+        DXGI_FORMAT_R16_UINT };
+
+    // An update builds MaxBuildsPerUpdate chunks at most, and they are all
+    // copied that frame, so the slot never runs out
+    const uint64_t ChunkBytes = uint64_t(m_Terrain->GetVerticesPerChunk()) * m_Terrain->GetVertexStride();
+    m_TerrainStagingSlot = IndexBytes + Options.MaxBuildsPerUpdate * ChunkBytes;
+    ThrowIfFailed(pDevice->CreateCommittedResource(&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
+        D3D12_HEAP_FLAG_NONE, &CD3DX12_RESOURCE_DESC::Buffer(m_TerrainStagingSlot * BACKBUFFER_COUNT),
+        D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, IID_PPV_ARGS(&m_TerrainStaging)));
+    m_TerrainStaging->SetName(L"TerrainStaging");
+    CD3DX12_RANGE NoReads(0, 0);
+    ThrowIfFailed(m_TerrainStaging->Map(0, &NoReads, reinterpret_cast<void**>(&m_TerrainStagingData)));
+}
+
+void Renderer::UpdateTerrain(const LodSelectionView& View, const Frustum& ViewFrustum)
+{
+    RACOON_PROFILE_SCOPE("UpdateTerrain");
+    m_Terrain->Update(View);
+
+    // Only the slots built by this update are copied; the indices never
+    // change and go with the first copies
+    m_Terrain->TakeWrittenSlots(m_TerrainWrittenSlots);
+    if (!m_TerrainWrittenSlots.empty() || !m_TerrainBuffersReadable)
+    {
+        ID3D12GraphicsCommandList2* CmdList = m_CommandListRing.GetNewCommandList();
+        if (m_TerrainBuffersReadable)
+        {
+            CmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(m_TerrainVertices,
+                D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER, D3D12_RESOURCE_STATE_COPY_DEST));
+        }
+
+        const uint64_t SlotOffset = (m_FrameIndex % BACKBUFFER_COUNT) * m_TerrainStagingSlot;
+        uint64_t Staged = 0;
+        if (!m_TerrainBuffersReadable)
+        {
+            const std::vector<uint16_t>& Indices = m_Terrain->GetIndices();
+            Staged = Indices.size() * sizeof(uint16_t);
+            std::memcpy(m_TerrainStagingData + SlotOffset, Indices.data(), Staged);
+            CmdList->CopyBufferRegion(m_TerrainIndices, 0, m_TerrainStaging, SlotOffset, Staged);
+        }
+        const uint64_t ChunkBytes = uint64_t(m_Terrain->GetVerticesPerChunk()) * m_Terrain->GetVertexStride();
+        const uint8_t* Vertices = m_Terrain->GetVertexData().data();
+        for (uint32_t Slot : m_TerrainWrittenSlots)
+        {
+            assert(Staged + ChunkBytes <= m_TerrainStagingSlot);
+            std::memcpy(m_TerrainStagingData + SlotOffset + Staged, Vertices + Slot * ChunkBytes, ChunkBytes);
+            CmdList->CopyBufferRegion(m_TerrainVertices, Slot * ChunkBytes, m_TerrainStaging, SlotOffset + Staged,
+                ChunkBytes);
+            Staged += ChunkBytes;
+        }
+
+        CD3DX12_RESOURCE_BARRIER ToRead[2] = {
+            CD3DX12_RESOURCE_BARRIER::Transition(m_TerrainVertices, D3D12_RESOURCE_STATE_COPY_DEST,
+                D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER),
+            CD3DX12_RESOURCE_BARRIER::Transition(m_TerrainIndices, D3D12_RESOURCE_STATE_COPY_DEST,
+                D3D12_RESOURCE_STATE_INDEX_BUFFER),
+        };
+        CmdList->ResourceBarrier(m_TerrainBuffersReadable ? 1 : 2, ToRead);
+        m_TerrainBuffersReadable = true;
+        ThrowIfFailed(CmdList->Close());
+        m_SubmittedLists.push_back(CmdList);
+    }
+
+    {
+        RACOON_PROFILE_SCOPE("CullTerrain");
+        const std::vector<TerrainDraw>& Draws = m_Terrain->GetDraws();
+        m_TerrainCuller.Resize(static_cast<uint32_t>(Draws.size()));
+        for (uint32_t i = 0; i < Draws.size(); ++i)
+            m_TerrainCuller.SetBounds(i, Draws[i].WorldBounds);
+        m_TerrainCuller.Cull(ViewFrustum, m_VisibleTerrain);
+    }
+}
+
+Renderer::GeometrySource Renderer::FindGeometrySource(std::string ScenePath, VertexEncoding Encoding)
+{
+    // The cache key covers the source and everything that shapes the cooked
+    // bytes, so a file left over from other inputs is never used
+    GeometrySource Source;
+    ContentHasher Key;
+    Key.AddValue(MeshCacheFormat::Version).AddValue(Encoding);
+    const LodChainOptions Lods = GetLodOptions();
+    Key.AddValue(SimplifierRevision).Add(Lods.TriangleRatios.data(), Lods.TriangleRatios.size() * sizeof(float));
+    Key.AddValue(Lods.MinReduction).AddValue(Lods.Simplify.MaxError).AddValue(Lods.Simplify.LockBorders);
+    Key.AddValue(Lods.Simplify.NormalWeight).AddValue(Lods.Simplify.UVWeight);
+    std::string Error;
+    if (!ScenePath.empty())
+    {
+        Source.Scene = std::make_unique<GltfDocument>();
+        if (!Source.Scene->Open(ScenePath, Error) || Source.Scene->GetPrimitiveCount() == 0)
+        {
+            OutputDebugStringA((ScenePath + ": " + (Error.empty() ? std::string("no triangle meshes") : Error) +
+                ", using the built-in primitives\n").c_str());
+            Source.Scene.reset();
+        }
+    }
+    if (Source.Scene)
+        Key = ContentHasher(Source.Scene->HashContents(Key.Get()));
+    else
+        Key.AddValue(PrimitivesRevision).AddValue(PrimitiveParameters());
+    Source.Key = Key.Get();
+    Source.CachePath = Source.Scene ? ScenePath + ".rmesh" : std::string("RacoonPrimitives.rmesh");
+
+    if (!Source.Cache.Open(Source.CachePath, Error) || Source.Cache.GetContentHash() != Source.Key ||
+        Source.Cache.GetEncoding() != Encoding)
+    {
+        Source.Cache.Close();
+    }
+    return Source;
+}
+
+void Renderer::BeginStreaming(GeometrySource&& Source)
+{
+    m_Geometry = std::move(Source);
+    m_SceneLayout = m_Geometry.Scene != nullptr;
+
+    if (m_Geometry.Cache.IsOpen())
+    {
+        // Cooked: every item is placed at once from the bounds and becomes
+        // drawable as the mapped arenas are copied. Each mesh's levels
+        // follow it in the file.
+        const uint32_t EntryCount = m_Geometry.Cache.GetMeshCount();
+        uint32_t MeshIndex = 0;
+        for (uint32_t i = 0; i < EntryCount;)
+        {
+            const CookedMesh& Cooked = m_Geometry.Cache.GetMesh(i);
+            uint32_t LevelCount = 1;
+            while (i + LevelCount < EntryCount && m_Geometry.Cache.GetMesh(i + LevelCount).LodLevel == LevelCount)
+                ++LevelCount;
+            uint32_t Chain = NoLodChain;
+            if (LevelCount > 1)
+            {
+                MeshLodChain Lods;
+                Lods.LevelCount = LevelCount;
+                Lods.LocalRadius = Cooked.LocalBounds.Radius;
+                for (uint32_t Level = 0; Level < LevelCount; ++Level)
+                {
+                    const CookedMesh& Entry = m_Geometry.Cache.GetMesh(i + Level);
+                    Lods.Levels[Level] = { Entry.Range, i + Level, Entry.LodError };
+                }
+                Chain = static_cast<uint32_t>(m_LodChains.size());
+                m_LodChains.push_back(Lods);
+            }
+
+            auto Mesh = std::make_shared<MeshData>();
+            Mesh->LocalBounds = Cooked.LocalBounds;
+            const size_t FirstObject = m_Objects.size();
+            PlaceMesh(MeshIndex++, Mesh);
+            for (size_t Object = FirstObject; Object < m_Objects.size(); ++Object)
+            {
+                ApplyCookedMesh(Cooked, i, *m_Objects[Object]);
+                m_Objects[Object]->LodChain = Chain;
+                m_WaitingObjects.push_back({ static_cast<uint32_t>(Object), Cooked.Range });
+            }
+            i += LevelCount;
+        }
+        m_Geometry.Scene.reset();
+        return;
+    }
+
+    // Rebuilt from the source, one request per mesh
+    m_MeshRegistry = MeshRegistry(m_VertexEncoding);
+    GeometryStreamerOptions Options;
+    Options.Encoding = m_VertexEncoding;
+    Options.BuildLods = true;
+    Options.Lods = GetLodOptions();
+    m_Streamer = std::make_unique<GeometryStreamer>(Options);
+    const uint32_t MeshCount = m_Geometry.Scene ? m_Geometry.Scene->GetPrimitiveCount() : PrimitiveCount;
+    m_StreamedMeshes.assign(MeshCount, nullptr);
+    m_StreamedLods.assign(MeshCount, {});
+    m_StreamedArrived.assign(MeshCount, 0);
+    if (m_Geometry.Scene)
+    {
+        // Sized from the accessors, up to what the GPU arenas hold, so the
+        // arenas are never copied to grow in the middle of a frame. The LOD
+        // levels add at most their ratios' share on top.
+        uint64_t Elements[GeometryArenaCount] = {};
+        for (uint32_t i = 0; i < MeshCount; ++i)
+        {
+            uint32_t Vertices, Indices;
+            m_Geometry.Scene->GetPrimitiveSize(i, Vertices, Indices);
+            Elements[0] += Vertices;
+            Elements[Vertices <= 0x10000u ? 1 : 2] += Indices;
+        }
+        float LodShare = 1.f;
+        for (float Ratio : Options.Lods.TriangleRatios)
+            LodShare += Ratio;
+        for (uint64_t& Count : Elements)
+            Count = static_cast<uint64_t>(Count * LodShare);
+        const uint64_t ElementSizes[GeometryArenaCount] = { m_MeshRegistry.GetVertexStride(), 2, 4 };
+        uint32_t Reserved[GeometryArenaCount];
+        for (uint32_t i = 0; i < GeometryArenaCount; ++i)
+        {
+            const uint64_t Fitting = m_Residency.GetCapacity(static_cast<GeometryArena>(i)) / ElementSizes[i];
+            Reserved[i] = static_cast<uint32_t>(std::min(Elements[i], Fitting));
+        }
+        m_MeshRegistry.Reserve(Reserved[0], Reserved[1], Reserved[2]);
+    }
+    for (uint32_t i = 0; i < MeshCount; ++i)
+    {
+        if (m_Geometry.Scene)
+        {
+            // Exporters already order for the vertex cache, unlike the generator
+            const GltfDocument* Scene = m_Geometry.Scene.get();
+            m_Streamer->Request(i, [Scene, i](MeshData& Mesh, std::string& Error) {
+                GltfMesh Loaded;
+                if (!Scene->LoadPrimitive(i, Loaded, Error))
+                    return false;
+                Mesh = std::move(Loaded.Mesh);
+                return true;
+            });
+        }
+        else
+        {
+            m_Streamer->Request(i, [i](MeshData& Mesh, std::string&) {
+                Mesh = CreatePrimitive(i);
+                return true;
+            });
+        }
+    }
+}
+
+void Renderer::StreamGeometry()
+{
+    RACOON_PROFILE_SCOPE("StreamGeometry");
+    if (m_GeometrySetup.valid())
+    {
+        if (m_GeometrySetup.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+            return;
+        BeginStreaming(m_GeometrySetup.get());
+    }
+
+    // Meshes are only taken while less than two budgets wait for the GPU, so
+    // the rest stay in the streamer's bounded queue and hold the loaders back
+    uint64_t Sizes[GeometryArenaCount];
+    if (m_Streamer)
+    {
+        StreamedMesh Streamed;
+        for (;;)
+        {
+            GetArenaSizes(Sizes);
+            if (m_Residency.GetBacklog(Sizes) >= 2 * m_UploadBudget || !m_Streamer->TryPop(Streamed))
+                break;
+            AddStreamedMesh(std::move(Streamed));
+        }
+        if (m_Streamer->GetPendingCount() == 0)
+            FinishStreaming();
+    }
+
+    GetArenaSizes(Sizes);
+    if (m_Residency.GetBacklog(Sizes) > 0)
+    {
+        ID3D12GraphicsCommandList2* CmdList = m_CommandListRing.GetNewCommandList();
+        if (m_GeometryBuffersReadable)
+        {
+            CD3DX12_RESOURCE_BARRIER ToCopy[GeometryArenaCount];
+            for (uint32_t i = 0; i < GeometryArenaCount; ++i)
+            {
+                ToCopy[i] = CD3DX12_RESOURCE_BARRIER::Transition(m_GeometryBuffers[i], GeometryReadState,
+                    D3D12_RESOURCE_STATE_COPY_DEST);
+            }
+            CmdList->ResourceBarrier(GeometryArenaCount, ToCopy);
+        }
+
+        // Copies of this frame go to its own staging slot
+        const uint64_t SlotOffset = (m_FrameIndex % BACKBUFFER_COUNT) * m_UploadBudget;
+        uint64_t Staged = 0;
+        m_Residency.Advance(Sizes, m_UploadBudget, [&](GeometryArena Arena, uint64_t Offset, uint64_t Size) {
+            std::memcpy(m_GeometryStagingData + SlotOffset + Staged, GetArenaData(Arena) + Offset, Size);
+            CmdList->CopyBufferRegion(m_GeometryBuffers[static_cast<uint32_t>(Arena)], Offset,
+                m_GeometryStaging, SlotOffset + Staged, Size);
+            Staged += Size;
+        });
+
+        CD3DX12_RESOURCE_BARRIER ToRead[GeometryArenaCount];
+        for (uint32_t i = 0; i < GeometryArenaCount; ++i)
+        {
+            ToRead[i] = CD3DX12_RESOURCE_BARRIER::Transition(m_GeometryBuffers[i], D3D12_RESOURCE_STATE_COPY_DEST,
+                GeometryReadState);
+        }
+        CmdList->ResourceBarrier(GeometryArenaCount, ToRead);
+        m_GeometryBuffersReadable = true;
+        ThrowIfFailed(CmdList->Close());
+        m_SubmittedLists.push_back(CmdList);
+
+        // A fully copied cache is not needed anymore
+        if (m_Geometry.Cache.IsOpen() && m_Residency.GetBacklog(Sizes) == 0)
+            m_Geometry.Cache.Close();
+    }
+    if (m_CacheWritePending && m_Residency.GetBacklog(Sizes) == 0)
+        WriteGeometryCache();
+
+    // Objects join the scene tree, and so culling and drawing, once their
+    // mesh and all its levels are resident. The copies above run before
+    // this frame's draws.
+    for (size_t i = 0; i < m_WaitingObjects.size();)
+    {
+        const WaitingObject& Waiting = m_WaitingObjects[i];
+        bool Resident = m_Residency.IsResident(Waiting.Range);
+        const uint32_t Chain = m_Objects[Waiting.Object]->LodChain;
+        for (uint32_t Level = 1; Resident && Chain != NoLodChain && Level < m_LodChains[Chain].LevelCount; ++Level)
+            Resident = m_Residency.IsResident(m_LodChains[Chain].Levels[Level].Range);
+        if (!Resident)
+        {
+            ++i;
+            continue;
+        }
+        m_ObjectProxies[Waiting.Object] = m_SceneTree.CreateProxy(
+            Aabb::FromBounds(m_Objects[Waiting.Object]->GetWorldBounds()), Waiting.Object);
+        m_WaitingObjects[i] = m_WaitingObjects.back();
+        m_WaitingObjects.pop_back();
+        m_SceneTreeGrew = true;
+    }
+    if (m_SceneTreeGrew && m_WaitingObjects.empty())
+    {
+        // Incremental inserts leave a worse tree than a build over everything
+        m_SceneTree.Rebuild();
+        m_SceneTreeGrew = false;
+    }
+}
+
+void Renderer::AddStreamedMesh(StreamedMesh&& Streamed)
+{
+    const uint32_t Id = Streamed.Id;
+    m_StreamedArrived[Id] = 1;
+    if (!Streamed.Mesh)
+    {
+        OutputDebugStringA(("Mesh " + std::to_string(Id) + ": " + Streamed.Error + "\n").c_str());
+        m_StreamFailed = true;
+    }
+    else
+    {
+        // Meshes that would overflow the GPU arenas with their levels are dropped
+        uint64_t Sizes[GeometryArenaCount];
+        GetArenaSizes(Sizes);
+        auto AddSizes = [&Sizes](const MeshData& Mesh, const PackedVertexStream& Vertices) {
+            const bool Narrow = Mesh.FitsIndices16();
+            Sizes[0] += Vertices.Data.size();
+            Sizes[Narrow ? 1 : 2] += Mesh.Indices32.size() * (Narrow ? sizeof(uint16_t) : sizeof(uint32_t));
+        };
+        AddSizes(*Streamed.Mesh, Streamed.Vertices);
+        for (size_t Level = 0; Level < Streamed.Lods.size(); ++Level)
+            AddSizes(*Streamed.Lods[Level].Mesh, Streamed.LodVertices[Level]);
+        bool Fits = true;
+        for (uint32_t i = 0; i < GeometryArenaCount; ++i)
+            Fits = Fits && Sizes[i] <= m_Residency.GetCapacity(static_cast<GeometryArena>(i));
+        if (Fits)
+        {
+            m_MeshRegistry.Register(Streamed.Mesh, Streamed.Vertices);
+            for (size_t Level = 0; Level < Streamed.Lods.size(); ++Level)
+                m_MeshRegistry.Register(Streamed.Lods[Level].Mesh, Streamed.LodVertices[Level]);
+            m_StreamedMeshes[Id] = std::move(Streamed.Mesh);
+            m_StreamedLods[Id] = std::move(Streamed.Lods);
+        }
+        else
+        {
+            OutputDebugStringA(("Mesh " + std::to_string(Id) + " does not fit the geometry buffers\n").c_str());
+            m_StreamFailed = true;
+        }
+    }
+
+    // Meshes are placed in request order, so the scene row comes out the same
+    // whichever loader finished first
+    while (m_PlacedMeshes < m_StreamedArrived.size() && m_StreamedArrived[m_PlacedMeshes])
+    {
+        const std::shared_ptr<MeshData>& Mesh = m_StreamedMeshes[m_PlacedMeshes];
+        if (Mesh)
+        {
+            const MeshHandle Handle = m_MeshRegistry.Find(Mesh.get());
+            const std::vector<LodLevel>& Simplified = m_StreamedLods[m_PlacedMeshes];
+            uint32_t Chain = NoLodChain;
+            if (!Simplified.empty())
+            {
+                MeshLodChain Lods;
+                Lods.LevelCount = static_cast<uint32_t>(std::min<size_t>(Simplified.size() + 1, MeshLodChain::MaxLevels));
+                Lods.LocalRadius = Mesh->LocalBounds.Radius;
+                Lods.Levels[0] = { m_MeshRegistry.GetRange(Handle), Handle.Index, 0.f };
+                for (uint32_t Level = 1; Level < Lods.LevelCount; ++Level)
+                {
+                    const MeshHandle LevelHandle = m_MeshRegistry.Find(Simplified[Level - 1].Mesh.get());
+                    Lods.Levels[Level] = { m_MeshRegistry.GetRange(LevelHandle), LevelHandle.Index,
+                        Simplified[Level - 1].Error };
+                }
+                Chain = static_cast<uint32_t>(m_LodChains.size());
+                m_LodChains.push_back(Lods);
+            }
+            const size_t FirstObject = m_Objects.size();
+            PlaceMesh(m_PlacedMeshes, Mesh);
+            for (size_t Object = FirstObject; Object < m_Objects.size(); ++Object)
+            {
+                m_MeshRegistry.ApplyRange(Handle, *m_Objects[Object]);
+                m_Objects[Object]->LodChain = Chain;
+                m_WaitingObjects.push_back({ static_cast<uint32_t>(Object), m_MeshRegistry.GetRange(Handle) });
+            }
+        }
+        ++m_PlacedMeshes;
+    }
+}
+
+void Renderer::FinishStreaming()
+{
+    m_Streamer.reset();
+    m_Geometry.Scene.reset();
+    m_CacheWritePending = !m_StreamFailed;
+}
+
+void Renderer::WriteGeometryCache()
+{
+    m_CacheWritePending = false;
+
+    // Off the job system, so a frame's Wait never picks up a write of many
+    // megabytes. Everything is resident by now, so the render thread does
+    // not read the CPU arenas anymore: the writer takes them over, without
+    // a copy on this frame, and frees them when done.
+    m_CacheWrite = std::async(std::launch::async,
+        [Registry = std::move(m_MeshRegistry), Meshes = std::move(m_StreamedMeshes),
+            Lods = std::move(m_StreamedLods), CachePath = m_Geometry.CachePath, Hash = m_Geometry.Key]() {
+            std::string WriteError;
+            if (!WriteMeshCache(CachePath, Hash, Registry, Meshes, Lods, WriteError))
+                OutputDebugStringA((WriteError + "\n").c_str());
+        });
+    m_MeshRegistry = MeshRegistry(m_VertexEncoding);
+    m_StreamedMeshes.clear();
+    m_StreamedLods.clear();
+}
+
+void Renderer::PlaceMesh(uint32_t Index, const std::shared_ptr<MeshData>& Mesh)
+{
+    auto Place = [this, &Mesh](XMFLOAT3 Position) {
+        m_Objects.push_back(std::make_shared<RenderItem>(Mesh, m_Transforms,
+            m_Transforms.Create(Trs::FromTranslation(Position))));
+        m_ObjectProxies.push_back(NoProxy);
+    };
+
+    if (m_SceneLayout)
+    {
+        // Node transforms are not loaded yet, so the meshes are laid out in a
+        // row along X, each next to the previous one
+        const Bounds& Local = Mesh->LocalBounds;
+        const float X = m_PlacementCursor + Local.Extents.x - Local.Center.x;
+        m_PlacementCursor += 2.f * Local.Extents.x + 1.f;
+        Place(XMFLOAT3(X, 0.f, 0.f));
+        return;
+    }
+
+    switch (Index)
+    {
+    case 0:
+        // Cube a bit to the right
+        Place(XMFLOAT3(2.f, 0.f, 0.f));
+        // Add one more cube, it shares the first cube's range
+        Place(XMFLOAT3(-2.f, 0.f, -3.f));
+        break;
+    case 1:
+        // Cylinder a bit to the left
+        Place(XMFLOAT3(-2.f, 0.f, 0.f));
+        break;
+    case 2:
+        // Sphere a bit back
+        Place(XMFLOAT3(0.f, 0.f, 2.f));
+        break;
+    default:
+        assert(false && "Unknown primitive");
+    }
+}
+
+MeshData Renderer::CreatePrimitive(uint32_t Index)
+{
+    // Runs on a loader thread, so the generator does not split work across
+    // the job system
     PrimitivesGenerator Generator;
-    
+    const PrimitiveParameters Params;
+
     //auto Mesh = Generator.CreateCylinder(1.f, 1.f, 2.f, 8, 2);
     //auto Mesh = Generator.CreateGeosphere(2.f, 1);
 
-    // Hardcode for now. Later CreateGeometry should read geometry input
-    // from glTF and modify layout automatically
-    layout = {
-        { "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0,
-            D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
-        { "NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 12,
-            D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
-        { "TANGENT", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 24,
-            D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},
-        { "UV", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 36,
-            D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0}
-    };
+    MeshData Mesh;
+    switch (Index)
+    {
+    case 0:
+        Mesh = Generator.CreateCube();
+        break;
+    case 1:
+        Mesh = Generator.CreateCylinder(Params.CylinderBottomRadius, Params.CylinderTopRadius, Params.CylinderHeight,
+            Params.CylinderSlices, Params.CylinderStacks);
+        break;
+    default:
+        Mesh = Generator.CreateGeosphere(Params.SphereRadius, Params.SphereSubdivisions);
+        break;
+    }
+    OptimizeMesh(Mesh);
+    return Mesh;
+}
 
-    // Cube a bit to the right
-    auto CubeMesh = std::make_shared<MeshData>(Generator.CreateCube());
-    m_Objects.push_back(std::make_unique<RenderItem>(CubeMesh, 
-        math::transpose(math::Matrix4::translation({ 2,0,0 }))));
-    
-    auto AllVertices = CubeMesh->Vertices;
-    auto AllIndices =  CubeMesh->Indices32;
-    
-    // Cylinder a bit to the left
-    auto CylinderMesh = std::make_shared<MeshData>(Generator.CreateCylinder(1.f, 1.5f, 2.f, 8, 2));
-    m_Objects.push_back(std::make_unique<RenderItem>(CylinderMesh,
-        math::transpose(math::Matrix4::translation({ -2,0,0 }))));
-    m_Objects.back()->BaseVertexLocation = CubeMesh->Vertices.size();
-    m_Objects.back()->StartIndexLocation = CubeMesh->Indices32.size();
-
-    AllVertices.insert(AllVertices.end(), CylinderMesh->Vertices.begin(), CylinderMesh->Vertices.end());
-    AllIndices.insert( AllIndices.end(),  CylinderMesh->Indices32.begin(), CylinderMesh->Indices32.end());
-
-    // Sphere a bit back
-    auto SphereMesh = std::make_shared<MeshData>(Generator.CreateGeosphere(1.5f, 1));
-    m_Objects.push_back(std::make_unique<RenderItem>(SphereMesh,
-        math::transpose(math::Matrix4::translation({ 0,0,2 }))));
-    m_Objects.back()->BaseVertexLocation = m_Objects[1]->BaseVertexLocation + CylinderMesh->Vertices.size();
-    m_Objects.back()->StartIndexLocation = m_Objects[1]->StartIndexLocation + CylinderMesh->Indices32.size();
-
-    AllVertices.insert(AllVertices.end(), SphereMesh->Vertices.begin(), SphereMesh->Vertices.end());
-    AllIndices.insert(AllIndices.end(), SphereMesh->Indices32.begin(), SphereMesh->Indices32.end());
-
-    // Add one more cube
-    AllVertices.insert(AllVertices.end(), CubeMesh->Vertices.begin(), CubeMesh->Vertices.end());
-    AllIndices.insert(AllIndices.end(), CubeMesh->Indices32.begin(), CubeMesh->Indices32.end());
-
-    m_Objects.push_back(std::make_unique<RenderItem>(CubeMesh,
-        math::transpose(math::Matrix4::translation({ -2, 0, -3}))));
-    const auto PrevObject = m_Objects[m_Objects.size() - 2];
-    m_Objects.back()->BaseVertexLocation = PrevObject->BaseVertexLocation + PrevObject->GetMesh()->Vertices.size();
-    m_Objects.back()->StartIndexLocation = PrevObject->StartIndexLocation + PrevObject->GetMesh()->Indices32.size();
-
-    m_StaticBufferPool.AllocVertexBuffer(static_cast<uint32_t>(AllVertices.size()),
-        sizeof(Vertex), AllVertices.data(), &m_VertexBufferView);
-
-    m_StaticBufferPool.AllocIndexBuffer(static_cast<uint32_t>(AllIndices.size()),
-        sizeof(uint32_t), AllIndices.data(), &m_IndexBufferView);
-
-    // Make sure we've finished uploading
-    m_StaticBufferPool.UploadData(m_UploadHeap.GetCommandList());
+void Renderer::GetArenaSizes(uint64_t (&Sizes)[GeometryArenaCount]) const
+{
+    if (m_Geometry.Cache.IsOpen())
+    {
+        Sizes[0] = uint64_t(m_Geometry.Cache.GetVertexCount()) * m_Geometry.Cache.GetVertexStride();
+        Sizes[1] = uint64_t(m_Geometry.Cache.GetIndex16Count()) * sizeof(uint16_t);
+        Sizes[2] = uint64_t(m_Geometry.Cache.GetIndex32Count()) * sizeof(uint32_t);
+        return;
+    }
+    Sizes[0] = m_MeshRegistry.GetVertexData().size();
+    Sizes[1] = m_MeshRegistry.GetIndices16().size() * sizeof(uint16_t);
+    Sizes[2] = m_MeshRegistry.GetIndices32().size() * sizeof(uint32_t);
+}
+
+const uint8_t* Renderer::GetArenaData(GeometryArena Arena) const
+{
+    const bool Cached = m_Geometry.Cache.IsOpen();
+    switch (Arena)
+    {
+    case GeometryArena::Vertices:
+        return Cached ? m_Geometry.Cache.GetVertexData() : m_MeshRegistry.GetVertexData().data();
+    case GeometryArena::Indices16:
+        return reinterpret_cast<const uint8_t*>(
+            Cached ? m_Geometry.Cache.GetIndices16() : m_MeshRegistry.GetIndices16().data());
+    case GeometryArena::Indices32:
+        return reinterpret_cast<const uint8_t*>(
+            Cached ? m_Geometry.Cache.GetIndices32() : m_MeshRegistry.GetIndices32().data());
+    }
+    return nullptr;
 }
 
 void Renderer::CreateRootSignature()
 {
-    CD3DX12_ROOT_PARAMETER rootParam[2];
+    CD3DX12_ROOT_PARAMETER rootParam[3];
     rootParam[0].InitAsConstantBufferView(0, 0, D3D12_SHADER_VISIBILITY_VERTEX);
-    rootParam[1].InitAsConstantBufferView(1, 0, D3D12_SHADER_VISIBILITY_VERTEX);
+    rootParam[1].InitAsConstants(sizeof(BatchConstants) / sizeof(uint32_t), 1, 0, D3D12_SHADER_VISIBILITY_VERTEX);
+    rootParam[2].InitAsShaderResourceView(0, 0, D3D12_SHADER_VISIBILITY_VERTEX);
 
     // A root signature is an array of root parameters
-    CD3DX12_ROOT_SIGNATURE_DESC rootSignDesc(2, rootParam, 0, nullptr,
+    CD3DX12_ROOT_SIGNATURE_DESC rootSignDesc(3, rootParam, 0, nullptr,
         D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT);
     
     ID3DBlob* pSerializedRootSignBlob, * pErrorBlob = nullptr;
@@ -233,11 +1118,26 @@ void Renderer::CreateRootSignature()
 
 void Renderer::CreateGraphicsPipelineState(const std::vector<D3D12_INPUT_ELEMENT_DESC>& layout)
 {
-    D3D12_SHADER_BYTECODE shaderVert, shaderPixel, shaderSemantics;
+    // Packed encodings read a different VSin, see shaders_semantics.hlsl
+    ShaderDefines Defines;
+    if (m_VertexEncoding != VertexEncoding::Full)
+        Defines["PACKED_VERTICES"] = "1";
 
-    CompileShaderFromFile("shaders_semantics.hlsl", nullptr, "Placeholder", "-T vs_6_0", &shaderSemantics);
-    CompileShaderFromFile("default_vertex.hlsl", nullptr, "VS", "-T vs_6_0", &shaderVert);
-    CompileShaderFromFile("default_pixel.hlsl", nullptr, "PS", "-T ps_6_0", &shaderPixel);
+    // shaders_semantics.hlsl is only ever included; the cache follows the
+    // includes, so it needs no compile of its own
+    const std::vector<ShaderDesc> Shaders = {
+        { "default_vertex.hlsl", "VS", "vs_6_0", Defines },
+        { "default_pixel.hlsl", "PS", "ps_6_0", Defines },
+    };
+    std::vector<ShaderBlob> Blobs;
+    std::string Error;
+    if (!m_ShaderCache->Build(Shaders, Blobs, Error))
+    {
+        OutputDebugStringA(Error.c_str());
+        ThrowIfFailed(E_FAIL);
+    }
+    const D3D12_SHADER_BYTECODE shaderVert = { Blobs[0]->data(), Blobs[0]->size() };
+    const D3D12_SHADER_BYTECODE shaderPixel = { Blobs[1]->data(), Blobs[1]->size() };
 
     // Create a PSO description
     D3D12_GRAPHICS_PIPELINE_STATE_DESC descPso = {};
@@ -264,6 +1164,24 @@ void Renderer::CreateGraphicsPipelineState(const std::vector<D3D12_INPUT_ELEMENT
     ThrowIfFailed(
         m_pDevice->GetDevice()->CreateGraphicsPipelineState(&descPso, IID_PPV_ARGS(&m_PipelineState))
     );
+
+    // Line lists need a pipeline state of the line topology type
+    descPso.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_LINE;
+    ThrowIfFailed(
+        m_pDevice->GetDevice()->CreateGraphicsPipelineState(&descPso, IID_PPV_ARGS(&m_LinePipelineState))
+    );
+    descPso.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
+
+    // The shaders read both packed encodings, only the input layout differs
+    if (m_Terrain)
+    {
+        std::vector<D3D12_INPUT_ELEMENT_DESC> TerrainLayout;
+        GetInputLayout(GetVertexLayout(m_Terrain->GetEncoding()), TerrainLayout);
+        descPso.InputLayout = { TerrainLayout.data(), (UINT)TerrainLayout.size() };
+        ThrowIfFailed(
+            m_pDevice->GetDevice()->CreateGraphicsPipelineState(&descPso, IID_PPV_ARGS(&m_TerrainPipelineState))
+        );
+    }
 }
 
 math::Matrix4 Renderer::GetViewProjMatrix(const Camera& Cam)
@@ -272,12 +1190,14 @@ math::Matrix4 Renderer::GetViewProjMatrix(const Camera& Cam)
     return math::transpose(viewProj);
 }
 
-Renderer::PerFrame Renderer::FillPerFrameConstants(const Camera& Cam)
+Renderer::PerFrame Renderer::FillPerFrameConstants(const Camera& Cam, const GameTimer& Timer)
 {
     PerFrame perFrame;
     perFrame.gViewProj = GetViewProjMatrix(Cam);
     perFrame.gObjToWorld = math::Matrix4::identity();
-    perFrame.gDeltaTime = 0.7f;
+    perFrame.gTotalTime = Timer.TotalTime();
+    // Smoothed, so a single hitch does not make shader animation jump
+    perFrame.gDeltaTime = Timer.SmoothedDeltaTime();
     return perFrame;
 }
 
@@ -306,13 +1226,41 @@ void Renderer::OnDestroyWindowSizeDependentResources()
 
 void Renderer::OnDestroy()
 {
+    // Loaders read the scene, so they stop first. The cache writer only
+    // reads its own copies, let it finish the file.
+    if (m_GeometrySetup.valid())
+        m_GeometrySetup.wait();
+    m_Streamer.reset();
+    m_Geometry = GeometrySource();
+    if (m_CacheWrite.valid())
+        m_CacheWrite.wait();
+
     m_ImGUIHelper.OnDestroy();
 
     m_RootSignature->Release();
     m_PipelineState->Release();
+    m_LinePipelineState->Release();
+    if (m_Terrain)
+    {
+        m_TerrainPipelineState->Release();
+        m_TerrainVertices->Release();
+        m_TerrainIndices->Release();
+        m_TerrainStaging->Unmap(0, nullptr);
+        m_TerrainStaging->Release();
+        m_Terrain.reset();
+    }
+    m_ShaderCache.reset();
+    m_ShaderCompiler.reset();
 
     m_UploadHeap.OnDestroy();
-    m_StaticBufferPool.OnDestroy();
+    for (ID3D12Resource*& Buffer : m_GeometryBuffers)
+    {
+        Buffer->Release();
+        Buffer = nullptr;
+    }
+    m_GeometryStaging->Unmap(0, nullptr);
+    m_GeometryStaging->Release();
+    m_GeometryStaging = nullptr;
     m_DynamicBufferRing.OnDestroy();
     m_ResourceViewHeaps.OnDestroy();
     
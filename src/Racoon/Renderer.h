@@ -8,13 +8,30 @@
 #include "base/Imgui.h"
 #include "base/Buffer.h"
 #include "base/StaticConstantBufferPool.h"
-#include "base/StaticBufferPool.h"
 #include "base/CommandListRing.h"
 
 #include "Misc/Camera.h"
 
+#include "AabbTree.h"
+#include "DrawBatcher.h"
+#include "DrawRecorder.h"
+#include "FrameAllocator.h"
 #include "GameTimer.h"
+#include "GeometryStreamer.h"
+#include "GltfLoader.h"
+#include "JobSystem.h"
+#include "MeshCache.h"
+#include "MeshLod.h"
+#include "MeshRegistry.h"
+#include "Profiler.h"
+#include "RenderQueue.h"
 #include "RenderItem.h"
+#include "ShaderCache.h"
+#include "Terrain.h"
+#include "TransformSystem.h"
+#include "VertexPacking.h"
+
+#include <future>
 
 using namespace CAULDRON_DX12;
 
@@ -26,11 +43,6 @@ using namespace Microsoft::WRL;
 	class Renderer
 	{
 	public:
-		struct PerObject
-		{
-			math::Matrix4 objToWorld;
-		};
-
 		struct PerFrame
 		{
 			math::Matrix4 gView;
@@ -50,7 +62,22 @@ using namespace Microsoft::WRL;
 			float gDeltaTime;
 		};
 
-		void OnCreate(Device* pDevice, SwapChain* pSwapChain);
+		// Must be called before OnCreate. Full by default, the packed
+		// encodings roughly halve vertex memory and bandwidth.
+		void SetVertexEncoding(VertexEncoding Encoding) { m_VertexEncoding = Encoding; }
+		// Must be called before OnCreate. A .gltf or .glb whose meshes replace
+		// the built-in primitives; empty keeps the primitives.
+		void SetScenePath(const std::string& Path) { m_ScenePath = Path; }
+		// Must be called before OnCreate. Bytes of geometry copied to the GPU
+		// per frame at most; larger scenes take more frames to appear, not
+		// longer frames.
+		void SetUploadBudget(uint64_t Bytes) { m_UploadBudget = Bytes; }
+		// Must be called before OnCreate. Streams a noise terrain around the
+		// camera, drawn after the opaque objects.
+		void SetTerrainEnabled(bool Enabled) { m_TerrainEnabled = Enabled; }
+
+		// Jobs runs geometry generation and draw recording, it must outlive the renderer
+		void OnCreate(Device* pDevice, SwapChain* pSwapChain, JobSystem* pJobs);
 		void OnCreateWindowSizeDependentResources(SwapChain* pSwapChain, uint32_t Width, uint32_t Height);
 		
 		void OnRender(SwapChain* pSwapChain, const Camera& Cam, const GameTimer& Timer);
@@ -58,9 +85,63 @@ using namespace Microsoft::WRL;
 		void OnDestroyWindowSizeDependentResources();
 		void OnDestroy();
 
+		// Objects tested and culled since the last reset
+		const CullingStats& GetCullingStats() const { return m_SceneTree.GetStats(); }
+		void ResetCullingStats() { m_SceneTree.ResetStats(); }
+
 	private:
 		void Clear(SwapChain*, ID3D12GraphicsCommandList2*);
+		// One instanced draw per batch, all transforms in one upload. The
+		// batches are recorded in chunks on worker threads, one new command
+		// list per chunk, appended to m_SubmittedLists in draw order.
+		void DrawObjects(SwapChain* pSwapChain,
+			const std::vector<std::shared_ptr<RenderItem>>& Objects, BatchMerging Merging, DrawBatcher& Batcher);
+		// Where the geometry comes from: a matching cache, the scene or the
+		// built-in primitives. Scene and Cache stay open while streaming.
+		struct GeometrySource
+		{
+			std::unique_ptr<GltfDocument> Scene;
+			MeshCacheFile Cache;
+			uint64_t Key{ 0 };
+			std::string CachePath;
+		};
+		struct WaitingObject
+		{
+			uint32_t Object;
+			MeshRange Range;
+		};
+
+		// Creates the GPU arenas and starts looking for the geometry source.
+		// Nothing is loaded here; meshes stream in over the first frames.
 		void CreateGeometry(std::vector<D3D12_INPUT_ELEMENT_DESC>& layout);
+		// Opens the scene and a matching cache, off the render thread
+		static GeometrySource FindGeometrySource(std::string ScenePath, VertexEncoding Encoding);
+		// Places a cached scene at once, or requests every mesh from the streamer
+		void BeginStreaming(GeometrySource&& Source);
+		// Once per frame: registers arrived meshes, records this frame's copies
+		// into a list of its own and lets resident objects into the scene tree
+		void StreamGeometry();
+		void AddStreamedMesh(StreamedMesh&& Streamed);
+		// Drops the streamer once every mesh has arrived
+		void FinishStreaming();
+		// Cooks the registry in the background once it is all resident
+		void WriteGeometryCache();
+		// Adds the items of mesh Index: the primitives at fixed spots, scene
+		// meshes in a row
+		void PlaceMesh(uint32_t Index, const std::shared_ptr<MeshData>& Mesh);
+		// Cube, cylinder or sphere, optimized for the vertex cache
+		static MeshData CreatePrimitive(uint32_t Index);
+		// The arenas being copied: the mapped cache, or the registry while streaming
+		void GetArenaSizes(uint64_t (&Sizes)[GeometryArenaCount]) const;
+		const uint8_t* GetArenaData(GeometryArena Arena) const;
+		// Creates the terrain and its GPU buffers. The vertex buffer mirrors
+		// the terrain's slot pool and is only written where chunks were built.
+		void CreateTerrain();
+		// Once per frame: streams chunks around the eye, records the copies of
+		// the slots it wrote into a list of its own and culls the chunks
+		void UpdateTerrain(const LodSelectionView& View, const Frustum& ViewFrustum);
+		// The visible chunks, one draw each, into a list of their own
+		void DrawTerrain(SwapChain* pSwapChain);
 		void CreateRootSignature();
 		void CreateGraphicsPipelineState(const std::vector<D3D12_INPUT_ELEMENT_DESC>& layout);
 
@@ -71,33 +152,47 @@ using namespace Microsoft::WRL;
 		DXGI_FORMAT m_BackbufferFormat;
 
 		math::Matrix4 GetViewProjMatrix(const Camera& Cam);
-		PerFrame FillPerFrameConstants(const Camera& Cam);
+		PerFrame FillPerFrameConstants(const Camera& Cam, const GameTimer& Timer);
 		
 		ImGUI m_ImGUIHelper;
 
 		uint32_t CheckForMSAAQualitySupport();
 
 		Device* m_pDevice;
+		JobSystem* m_pJobs{ nullptr };
 		SwapChain* m_pSwapChain;
 		CommandListRing m_CommandListRing;
 		ResourceViewHeaps m_ResourceViewHeaps;
 		UploadHeap m_UploadHeap;
 		DynamicBufferRing m_DynamicBufferRing;
-		StaticBufferPool m_StaticBufferPool; // for vertex buffer
+		// GPU copies of the registry arenas, indexed by GeometryArena, filled
+		// a budget at a time through one staging slot per frame in flight
+		ID3D12Resource* m_GeometryBuffers[GeometryArenaCount]{};
+		bool m_GeometryBuffersReadable{ false };
+		ID3D12Resource* m_GeometryStaging{ nullptr };
+		uint8_t* m_GeometryStagingData{ nullptr };
+		uint64_t m_UploadBudget{ 8 * 1024 * 1024 };
+		uint64_t m_FrameIndex{ 0 };
 
 		DSV m_DepthDSV;
 		Texture m_Depth;
 
 		D3D12_VERTEX_BUFFER_VIEW m_VertexBufferView;
 
-		D3D12_INDEX_BUFFER_VIEW m_IndexBufferView;
+		// Meshes whose indices fit in 16 bits share the 16-bit buffer, the rest the 32-bit one
+		D3D12_INDEX_BUFFER_VIEW m_IndexBufferView16{};
+		D3D12_INDEX_BUFFER_VIEW m_IndexBufferView32{};
 		D3D12_GPU_VIRTUAL_ADDRESS m_ConstantBuffer;
 		D3D12_GPU_VIRTUAL_ADDRESS m_PerFrameBuffer;
-		D3D12_GPU_VIRTUAL_ADDRESS m_PerObjectBuffer;
 		D3D12_GPU_VIRTUAL_ADDRESS m_TimeCB;
 
 		ID3D12RootSignature* m_RootSignature{ nullptr };
 		ID3D12PipelineState* m_PipelineState{ nullptr };
+		// The same state for items drawn as line lists
+		ID3D12PipelineState* m_LinePipelineState{ nullptr };
+		// Declared before the cache, which keeps a reference to it
+		std::unique_ptr<ShaderCompiler> m_ShaderCompiler;
+		std::unique_ptr<ShaderCache> m_ShaderCache;
 
 		uint32_t m_RtvDescriptorSize,
 			m_DsvDescriptorSize,
@@ -106,6 +201,72 @@ using namespace Microsoft::WRL;
 
 		uint32_t m_4xMsaasQuality;
 
+		VertexEncoding m_VertexEncoding{ VertexEncoding::Full };
+		std::string m_ScenePath;
+		MeshRegistry m_MeshRegistry;
+		// Cooks the geometry to a .rmesh file after a cache miss
+		std::future<void> m_CacheWrite;
+		std::future<GeometrySource> m_GeometrySetup;
+		GeometrySource m_Geometry;
+		// Declared after m_Geometry, so its loaders stop before the scene closes
+		std::unique_ptr<GeometryStreamer> m_Streamer;
+		ArenaResidency m_Residency;
+		// Streamed meshes by request id; null until arrived, or when failed
+		std::vector<std::shared_ptr<MeshData>> m_StreamedMeshes;
+		// Their coarser levels, for the cache
+		std::vector<std::vector<LodLevel>> m_StreamedLods;
+		std::vector<uint8_t> m_StreamedArrived;
+		// Meshes placed so far, always a prefix of the requests
+		uint32_t m_PlacedMeshes{ 0 };
+		float m_PlacementCursor{ 0.f };
+		bool m_SceneLayout{ false };
+		// Set when a mesh could not be loaded, so no partial cache is written
+		bool m_StreamFailed{ false };
+		// Every mesh arrived; the cache is written once the uploads catch up
+		bool m_CacheWritePending{ false };
+		// LOD levels of the placed meshes that have them, see RenderItem::LodChain
+		std::vector<MeshLodChain> m_LodChains;
+		// Placed objects whose mesh is not resident yet, not in m_SceneTree
+		std::vector<WaitingObject> m_WaitingObjects;
+		bool m_SceneTreeGrew{ false };
+		bool m_TerrainEnabled{ false };
+		// Declared before the terrain, which keeps a reference to it
+		std::unique_ptr<NoiseHeightSource> m_TerrainHeights;
+		std::unique_ptr<Terrain> m_Terrain;
+		ID3D12Resource* m_TerrainVertices{ nullptr };
+		ID3D12Resource* m_TerrainIndices{ nullptr };
+		bool m_TerrainBuffersReadable{ false };
+		// One update's worth of chunks per frame in flight, after the indices
+		// the first frame copies. Every chunk is copied the frame it is built,
+		// so all the draws of a frame are resident.
+		ID3D12Resource* m_TerrainStaging{ nullptr };
+		uint8_t* m_TerrainStagingData{ nullptr };
+		uint64_t m_TerrainStagingSlot{ 0 };
+		D3D12_VERTEX_BUFFER_VIEW m_TerrainVertexBufferView{};
+		D3D12_INDEX_BUFFER_VIEW m_TerrainIndexBufferView{};
+		// Same shaders, with the input layout of the terrain's encoding
+		ID3D12PipelineState* m_TerrainPipelineState{ nullptr };
+		std::vector<uint32_t> m_TerrainWrittenSlots;
+		FrustumCuller m_TerrainCuller;
+		// Indices into Terrain::GetDraws() that passed culling this frame
+		std::vector<uint32_t> m_VisibleTerrain;
+		// One batcher per pass so both passes' batches stay alive while recording
+		DrawBatcher m_OpaqueBatcher;
+		DrawBatcher m_TransparentBatcher;
+		ParallelDrawRecorder m_DrawRecorder;
+		// Transient CPU memory of the frames in flight, one arena per worker
+		FrameAllocator m_FrameAllocator;
+		// Closed command lists of this frame, in execution order
+		std::vector<ID3D12CommandList*> m_SubmittedLists;
+		RenderQueue m_RenderQueue;
+		// Spatial index over m_Objects, one proxy per resident object
+		AabbTree m_SceneTree;
+		std::vector<uint32_t> m_ObjectProxies;
+		// Indices into m_Objects that passed culling this frame
+		std::vector<uint32_t> m_VisibleObjects;
+
+		// Owns every object's transform; declared first so it outlives them
+		TransformSystem m_Transforms;
 		std::vector<std::shared_ptr<RenderItem>> m_Objects;
 		std::vector<std::shared_ptr<RenderItem>> m_ObjectsOpaque;
 		std::vector<std::shared_ptr<RenderItem>> m_ObjectsTransparent;
@@ -25,9 +25,19 @@ void RacoonEngine::BuildUI()
             {
                 ImGui::Text("Last FPS: %.3f", m_UIState.LastMeasuredFPS);
                 ImGui::Text("MS per frame: %.3f", m_UIState.MillisecondsPerFrame);
+                const ScopeStats& Frame = m_UIState.FrameStats;
+                ImGui::Text("Frame p50 %.2f  p95 %.2f  p99 %.2f  max %.2f ms",
+                    Frame.P50Ms, Frame.P95Ms, Frame.P99Ms, Frame.MaxMs);
                 ImGui::Spacing();
                 ImGui::Text("Delta time: %.3f", m_Timer.DeltaTime());
                 ImGui::Text("Total time:: %.3f", m_Timer.TotalTime());
+                ImGui::Spacing();
+                ImGui::Checkbox("Limit frame rate", &m_UIState.bLimitFrameRate);
+                ImGui::SliderFloat("Target FPS", &m_UIState.TargetFps, 30.f, 360.f, "%.0f");
+                ImGui::Text("Frame interval: %.3f ms, jitter %.3f ms, worst %.3f ms",
+                    m_UIState.Pacing.MeanIntervalMs, m_UIState.Pacing.JitterMs, m_UIState.Pacing.MaxDeviationMs);
+                ImGui::Text("Limiter wake error: %.3f ms, %u missed of %u",
+                    m_UIState.Pacing.MeanWakeErrorMs, m_UIState.Pacing.MissedFrames, m_UIState.Pacing.Frames);
             }
         }
         ImGui::Spacing();
@@ -41,24 +51,40 @@ void RacoonEngine::BuildUI()
             }
         }
 
-        // FPS graph
-        //{
-        //    ImGui::Begin("MS per frame, less is better");
-        //    ImGui::PlotLines("##Line", m_UIState.FrameMillisec.data(), 
-        //        m_UIState.FrameMillisec.size(), 0, 0, 0, 10, ImVec2(0, 320));
-        //    // Draw the vertical line
-        //        // Get the graph bounds
-        //    ImVec2 graphBoundsMin = ImGui::GetItemRectMin();
-        //    ImVec2 graphBoundsMax = ImGui::GetItemRectMax();
-        //
-        //    float x = static_cast<float>(m_UIState.CurrentFrameMsIndex) / m_UIState.FrameMillisec.size();
-        //    ImGui::GetWindowDrawList()->AddLine(
-        //        ImVec2(graphBoundsMin.x + x * (graphBoundsMax.x - graphBoundsMin.x), graphBoundsMin.y),
-        //        ImVec2(graphBoundsMin.x + x * (graphBoundsMax.x - graphBoundsMin.x), graphBoundsMax.y),
-        //        ImGui::GetColorU32(ImGuiCol_PlotLines),
-        //        1.0f);
-        //    ImGui::End();
-        //}
+        if (ImGui::CollapsingHeader("Profiler", ImGuiTreeNodeFlags_DefaultOpen))
+        {
+            // MS per frame, less is better. The line marks the newest frame.
+            ImGui::PlotLines("##FrameMs", m_UIState.FrameMillisec.data(),
+                static_cast<int>(m_UIState.FrameMillisec.size()), 0, nullptr, 0.f, 33.f, ImVec2(0, 120));
+            const ImVec2 GraphMin = ImGui::GetItemRectMin();
+            const ImVec2 GraphMax = ImGui::GetItemRectMax();
+            const float x = static_cast<float>(m_UIState.CurrentFrameMsIndex) / m_UIState.FrameMillisec.size();
+            ImGui::GetWindowDrawList()->AddLine(
+                ImVec2(GraphMin.x + x * (GraphMax.x - GraphMin.x), GraphMin.y),
+                ImVec2(GraphMin.x + x * (GraphMax.x - GraphMin.x), GraphMax.y),
+                ImGui::GetColorU32(ImGuiCol_PlotLines),
+                1.0f);
+
+            // Per-frame time of every scope, ms
+            ImGui::Columns(5, "Scopes");
+            ImGui::Text("Scope"); ImGui::NextColumn();
+            ImGui::Text("p50"); ImGui::NextColumn();
+            ImGui::Text("p95"); ImGui::NextColumn();
+            ImGui::Text("p99"); ImGui::NextColumn();
+            ImGui::Text("max"); ImGui::NextColumn();
+            for (const ScopeStats& Scope : m_UIState.Scopes)
+            {
+                ImGui::Text("%s", Scope.Name); ImGui::NextColumn();
+                ImGui::Text("%.3f", Scope.P50Ms); ImGui::NextColumn();
+                ImGui::Text("%.3f", Scope.P95Ms); ImGui::NextColumn();
+                ImGui::Text("%.3f", Scope.P99Ms); ImGui::NextColumn();
+                ImGui::Text("%.3f", Scope.MaxMs); ImGui::NextColumn();
+            }
+            ImGui::Columns(1);
+
+            if (ImGui::Button("Write trace (F2)"))
+                WriteProfilerTrace();
+        }
 
         ImGui::End();
     }
@@ -1,6 +1,8 @@
 #pragma once
 
 #include "../imgui/imgui.h"
+#include "FramePacer.h"
+#include "Profiler.h"
 #include <array>
 namespace Racoon {
 
@@ -14,11 +16,23 @@ struct UIState
     float LastMeasuredFPS{ 0 };
     float MillisecondsPerFrame{ 0 };
 
+    bool bLimitFrameRate{ false };
+    float TargetFps{ 60.f };
+    FramePacingStats Pacing;
+
     float StatsUpdateFrequency{ 0.1f };
+    float LastStatsUpdate{ 0 };
 
+    // Length of every frame, a ring
     static constexpr uint16_t FrameratesGraphValues = 512;
     std::array<float, FrameratesGraphValues> FrameMillisec;
     uint16_t CurrentFrameMsIndex{ 0 };
+
+    // Over the profiler's history, refreshed with the numbers above
+    ScopeStats FrameStats;
+    std::vector<ScopeStats> Scopes;
+    // Frames F2 writes to RacoonTrace.json
+    uint32_t TraceFrames{ 120 };
 };
 
 }
\ No newline at end of file
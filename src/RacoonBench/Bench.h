@@ -0,0 +1,89 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+namespace Racoon {
+namespace Bench {
+
+// Heap traffic since the last ResetAllocCounters(). Counted by the global
+// operator new/delete replacements in Main.cpp.
+struct AllocCounters
+{
+    uint64_t Bytes{ 0 };
+    uint64_t Allocations{ 0 };
+};
+
+void ResetAllocCounters();
+AllocCounters GetAllocCounters();
+
+struct Result
+{
+    std::string Name;
+    uint32_t Iterations{ 0 };
+    double MillisecondsPerIteration{ 0 };
+    // "Item" is whatever the benchmark counts: vertices, objects...
+    double ItemsPerSecond{ 0 };
+    uint64_t BytesPerIteration{ 0 };
+    uint64_t AllocationsPerIteration{ 0 };
+};
+
+// Keeps the optimizer from discarding work whose result is otherwise unused
+extern const void* volatile g_Sink;
+template<typename T>
+inline void DoNotOptimize(const T& Value) { g_Sink = &Value; }
+
+// Runs Body once to warm up, then Iterations times while timing it and
+// counting allocations.
+template<typename Fn>
+Result Measure(const std::string& Name, uint32_t Iterations, uint64_t ItemsPerIteration, Fn&& Body)
+{
+    using Clock = std::chrono::steady_clock;
+
+    Body();
+
+    ResetAllocCounters();
+    const auto Start = Clock::now();
+    for (uint32_t i = 0; i < Iterations; ++i)
+    {
+        Body();
+    }
+    const auto End = Clock::now();
+    const AllocCounters Allocs = GetAllocCounters();
+
+    const double Seconds = std::chrono::duration<double>(End - Start).count();
+
+    Result R;
+    R.Name = Name;
+    R.Iterations = Iterations;
+    R.MillisecondsPerIteration = Seconds * 1000.0 / Iterations;
+    R.ItemsPerSecond = Seconds > 0.0 ? double(ItemsPerIteration) * Iterations / Seconds : 0.0;
+    R.BytesPerIteration = Allocs.Bytes / Iterations;
+    R.AllocationsPerIteration = Allocs.Allocations / Iterations;
+    return R;
+}
+
+void Report(const Result& R, const char* ItemName);
+
+// Suites, one per area of RacoonCore
+void RunGeometryBenchmarks();
+void RunSceneBenchmarks();
+void RunPackingBenchmarks();
+void RunOptimizeBenchmarks();
+void RunCullingBenchmarks();
+void RunRecordingBenchmarks();
+void RunJobsBenchmarks();
+void RunTransformBenchmarks();
+void RunFrameBenchmarks();
+void RunProfilerBenchmarks();
+void RunTimingBenchmarks();
+void RunGltfBenchmarks();
+void RunCacheBenchmarks();
+void RunStreamingBenchmarks();
+void RunShaderBenchmarks();
+void RunLodBenchmarks();
+void RunTerrainBenchmarks();
+
+} // namespace Bench
+} // namespace Racoon
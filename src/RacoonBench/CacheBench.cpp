@@ -0,0 +1,142 @@
+#include "Bench.h"
+
+#include "ContentHash.h"
+#include "MeshCache.h"
+#include "MeshOptimizer.h"
+#include "MeshRegistry.h"
+#include "PrimitivesGenerator.h"
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+namespace Racoon {
+namespace Bench {
+
+namespace {
+
+// What the renderer does on a cache miss: generate, optimize and encode
+MeshRegistry BuildRegistry(std::vector<std::shared_ptr<MeshData>>& Meshes, VertexEncoding Encoding)
+{
+    PrimitivesGenerator Generator;
+    Meshes.clear();
+    for (uint32_t i = 0; i < 32; ++i)
+    {
+        Meshes.push_back(std::make_shared<MeshData>(i % 4 == 2 ? Generator.CreateCylinder(1.f, 0.5f, 2.f, 256, 64)
+                                                               : Generator.CreateGeosphere(1.f + i * 0.01f, 5)));
+        OptimizeMesh(*Meshes.back());
+    }
+    MeshRegistry Registry(Encoding);
+    for (const auto& Mesh : Meshes)
+        Registry.Register(Mesh);
+    return Registry;
+}
+
+bool SameBytes(const void* A, const void* B, size_t Size)
+{
+    return Size == 0 || std::memcmp(A, B, Size) == 0;
+}
+
+// The cache must hand back exactly what the registry uploads
+bool MatchesRegistry(const MeshCacheFile& Cache, const MeshRegistry& Registry,
+    const std::vector<std::shared_ptr<MeshData>>& Meshes)
+{
+    const auto& Indices16 = Registry.GetIndices16();
+    const auto& Indices32 = Registry.GetIndices32();
+    bool Match = Cache.GetEncoding() == Registry.GetEncoding() &&
+        Cache.GetVertexCount() == Registry.GetVertexCount() &&
+        Cache.GetIndex16Count() == Indices16.size() && Cache.GetIndex32Count() == Indices32.size() &&
+        Cache.GetMeshCount() == Meshes.size() &&
+        SameBytes(Cache.GetVertexData(), Registry.GetVertexData().data(), Registry.GetVertexData().size()) &&
+        SameBytes(Cache.GetIndices16(), Indices16.data(), Indices16.size() * sizeof(uint16_t)) &&
+        SameBytes(Cache.GetIndices32(), Indices32.data(), Indices32.size() * sizeof(uint32_t));
+    for (uint32_t i = 0; Match && i < Cache.GetMeshCount(); ++i)
+    {
+        const CookedMesh& Cooked = Cache.GetMesh(i);
+        const MeshRange& Range = Registry.GetRange(Registry.Find(Meshes[i].get()));
+        const Bounds& Local = Meshes[i]->LocalBounds;
+        Match = Cooked.Range.BaseVertex == Range.BaseVertex && Cooked.Range.VertexCount == Range.VertexCount &&
+            Cooked.Range.StartIndex == Range.StartIndex && Cooked.Range.IndexCount == Range.IndexCount &&
+            Cooked.Range.IndexWidth == Range.IndexWidth &&
+            SameBytes(&Cooked.Range.Quantization, &Range.Quantization, sizeof(VertexQuantization)) &&
+            Cooked.LocalBounds.Radius == Local.Radius &&
+            SameBytes(&Cooked.LocalBounds.Center, &Local.Center, sizeof(XMFLOAT3)) &&
+            SameBytes(&Cooked.LocalBounds.Extents, &Local.Extents, sizeof(XMFLOAT3));
+    }
+    return Match;
+}
+
+} // namespace
+
+void RunCacheBenchmarks()
+{
+    const std::string CachePath = (std::filesystem::temp_directory_path() / "RacoonBench.rmesh").string();
+    std::string Error;
+
+    std::vector<std::shared_ptr<MeshData>> Meshes;
+    MeshRegistry Registry = BuildRegistry(Meshes, VertexEncoding::PackedQuantized);
+    const uint64_t Key = ContentHasher().AddValue(uint32_t(1)).AddValue(Registry.GetEncoding()).Get();
+    if (!WriteMeshCache(CachePath, Key, Registry, Meshes, Error))
+    {
+        std::printf("%-44s write failed: %s\n", "", Error.c_str());
+        return;
+    }
+    const size_t FileBytes = std::filesystem::file_size(CachePath);
+
+    MeshCacheFile Cache;
+    const bool Opened = Cache.Open(CachePath, Error);
+    std::printf("%-44s %u meshes, %.1f MB, matches the registry: %s, key kept: %s\n", "", Registry.GetMeshCount(),
+        FileBytes / 1e6, Opened && MatchesRegistry(Cache, Registry, Meshes) ? "yes" : "NO",
+        Opened && Cache.GetContentHash() == Key ? "yes" : "NO");
+    Cache.Close();
+
+    // A cut off file must be refused, not read past its end
+    {
+        const std::string TruncatedPath = CachePath + ".truncated";
+        std::filesystem::copy_file(CachePath, TruncatedPath, std::filesystem::copy_options::overwrite_existing);
+        std::filesystem::resize_file(TruncatedPath, FileBytes / 2);
+        MeshCacheFile Truncated;
+        std::printf("%-44s truncated file refused: %s\n", "", Truncated.Open(TruncatedPath, Error) ? "NO" : "yes");
+        std::filesystem::remove(TruncatedPath);
+    }
+
+    const std::vector<uint8_t>& VertexData = Registry.GetVertexData();
+    Report(Measure("cache/hash arenas (XXH64)", 20, VertexData.size(), [&]
+        {
+            const uint64_t Hash = HashBytes(VertexData.data(), VertexData.size());
+            DoNotOptimize(Hash);
+        }), "B");
+    Report(Measure("cache/write", 5, FileBytes, [&]
+        {
+            WriteMeshCache(CachePath, Key, Registry, Meshes, Error);
+        }), "B");
+
+    // A miss rebuilds everything; a hit maps the file and the upload copies
+    // the arenas out of it, which this copy stands in for
+    Report(Measure("cache/miss: generate + optimize + encode", 3, FileBytes, [&]
+        {
+            std::vector<std::shared_ptr<MeshData>> Rebuilt;
+            MeshRegistry Built = BuildRegistry(Rebuilt, VertexEncoding::PackedQuantized);
+            DoNotOptimize(Built);
+        }), "B");
+    std::vector<uint8_t> Staging(FileBytes);
+    Report(Measure("cache/hit: open + copy arenas", 20, FileBytes, [&]
+        {
+            MeshCacheFile Hit;
+            Hit.Open(CachePath, Error);
+            const size_t VertexBytes = size_t(Hit.GetVertexCount()) * Hit.GetVertexStride();
+            uint8_t* Out = Staging.data();
+            std::memcpy(Out, Hit.GetVertexData(), VertexBytes);
+            Out += VertexBytes;
+            std::memcpy(Out, Hit.GetIndices16(), Hit.GetIndex16Count() * sizeof(uint16_t));
+            Out += Hit.GetIndex16Count() * sizeof(uint16_t);
+            std::memcpy(Out, Hit.GetIndices32(), Hit.GetIndex32Count() * sizeof(uint32_t));
+            DoNotOptimize(Staging);
+        }), "B");
+
+    std::filesystem::remove(CachePath);
+}
+
+} // namespace Bench
+} // namespace Racoon
@@ -0,0 +1,202 @@
+#include "Bench.h"
+
+#include "AabbTree.h"
+#include "FrustumCuller.h"
+#include "PrimitivesGenerator.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <random>
+
+namespace Racoon {
+namespace Bench {
+
+namespace {
+
+// Objects scattered in a 2 km cube around a camera at the origin looking
+// down -Z, so roughly a tenth of them are in view
+std::vector<std::shared_ptr<RenderItem>> ScatterItems(uint32_t Count, TransformSystem& Transforms)
+{
+    PrimitivesGenerator Generator;
+    const auto Mesh = std::make_shared<MeshData>(Generator.CreateCube());
+
+    std::mt19937 Rng(11);
+    std::uniform_real_distribution<float> Coordinate(-1000.f, 1000.f);
+    std::vector<std::shared_ptr<RenderItem>> Items;
+    Items.reserve(Count);
+    for (uint32_t i = 0; i < Count; ++i)
+    {
+        const XMFLOAT3 Position{ Coordinate(Rng), Coordinate(Rng), Coordinate(Rng) };
+        Items.push_back(std::make_shared<RenderItem>(Mesh, Transforms, Transforms.Create(Trs::FromTranslation(Position))));
+    }
+    return Items;
+}
+
+// Reference answer, one box and one plane at a time
+uint32_t CountVisibleScalar(const std::vector<std::shared_ptr<RenderItem>>& Items, const Frustum& View)
+{
+    uint32_t Visible = 0;
+    for (const auto& Item : Items)
+    {
+        const Bounds& B = Item->GetWorldBounds();
+        bool Inside = true;
+        for (const XMFLOAT4& P : View.Planes)
+        {
+            const float Distance = P.x * B.Center.x + P.y * B.Center.y + P.z * B.Center.z + P.w +
+                std::fabs(P.x) * B.Extents.x + std::fabs(P.y) * B.Extents.y + std::fabs(P.z) * B.Extents.z;
+            Inside &= Distance >= 0.f;
+        }
+        Visible += Inside;
+    }
+    return Visible;
+}
+
+} // namespace
+
+void RunCullingBenchmarks()
+{
+    TransformSystem Transforms;
+    const auto Items = ScatterItems(100000, Transforms);
+    const math::Matrix4 Projection = math::Matrix4::perspective(3.14159265f / 3.f, 16.f / 9.f, 0.1f, 1000.f);
+    const Frustum View = Frustum::FromViewProjection(Projection * math::Matrix4::identity());
+
+    FrustumCuller Culler;
+    Result R = Measure("FrustumCuller::SetBounds 100000 items", 50, Items.size(), [&]() {
+        Culler.SetBounds(Items);
+    });
+    Report(R, "items");
+
+    std::vector<uint32_t> Visible;
+    Culler.ResetStats();
+    R = Measure("FrustumCuller::Cull 100000 items", 200, Items.size(), [&]() {
+        Culler.Cull(View, Visible);
+        DoNotOptimize(Visible);
+    });
+    Report(R, "items");
+
+    const CullingStats& Stats = Culler.GetStats();
+    const uint32_t Expected = CountVisibleScalar(Items, View);
+    std::printf("%-44s %zu visible (scalar reference %u), %.1f%% of %llu tests culled\n", "",
+        Visible.size(), Expected, 100.0 * Stats.Culled / Stats.Tested,
+        static_cast<unsigned long long>(Stats.Tested));
+
+    // Same scene in the dynamic tree
+    AabbTree Tree(0.5f);
+    std::vector<uint32_t> Proxies(Items.size());
+    R = Measure("AabbTree insert 100000 items", 1, Items.size(), [&]() {
+        Tree = AabbTree(0.5f);
+        for (uint32_t i = 0; i < Items.size(); ++i)
+            Proxies[i] = Tree.CreateProxy(Aabb::FromBounds(Items[i]->GetWorldBounds()), i);
+    });
+    Report(R, "items");
+    std::printf("%-44s height %u, SAH cost %.1f\n", "", Tree.GetHeight(), Tree.GetCost());
+
+    R = Measure("AabbTree::Rebuild 100000 items", 5, Items.size(), [&]() { Tree.Rebuild(); });
+    Report(R, "items");
+    std::printf("%-44s height %u, SAH cost %.1f\n", "", Tree.GetHeight(), Tree.GetCost());
+
+    std::vector<uint32_t> TreeVisible;
+    R = Measure("AabbTree::QueryFrustum 100000 items", 200, Items.size(), [&]() {
+        TreeVisible.clear();
+        Tree.QueryFrustum(View, TreeVisible);
+        DoNotOptimize(TreeVisible);
+    });
+    Report(R, "items");
+
+    // Leaves are fattened, so the tree may return a few extra objects but
+    // never miss one the exact test keeps
+    std::sort(TreeVisible.begin(), TreeVisible.end());
+    const bool Superset = std::includes(TreeVisible.begin(), TreeVisible.end(), Visible.begin(), Visible.end());
+    std::printf("%-44s %zu visible, contains every exact hit: %s\n", "",
+        TreeVisible.size(), Superset ? "yes" : "NO");
+
+    // A frame of motion: 1% of objects jitter inside their margin, 1% move far
+    std::mt19937 Rng(5);
+    std::uniform_int_distribution<uint32_t> Pick(0, static_cast<uint32_t>(Items.size() - 1));
+    std::uniform_real_distribution<float> Jump(-1000.f, 1000.f);
+    uint32_t Updated = 0;
+    R = Measure("AabbTree move 2000 items + Refit", 20, 2000, [&]() {
+        for (uint32_t k = 0; k < 1000; ++k)
+        {
+            // Shrink the fat box back to the object, then nudge it
+            const uint32_t i = Pick(Rng);
+            Aabb Box = Tree.GetFatAabb(Proxies[i]);
+            Box.Min = XMFLOAT3(Box.Min.x + 0.5f + 0.1f, Box.Min.y + 0.5f, Box.Min.z + 0.5f);
+            Box.Max = XMFLOAT3(Box.Max.x - 0.5f + 0.1f, Box.Max.y - 0.5f, Box.Max.z - 0.5f);
+            Updated += Tree.MoveProxy(Proxies[i], Box);
+        }
+        for (uint32_t k = 0; k < 1000; ++k)
+        {
+            const uint32_t i = Pick(Rng);
+            Bounds Moved = Items[i]->GetWorldBounds();
+            Moved.Center = XMFLOAT3(Jump(Rng), Jump(Rng), Jump(Rng));
+            Updated += Tree.MoveProxy(Proxies[i], Aabb::FromBounds(Moved));
+        }
+        Tree.Refit();
+    });
+    Report(R, "moves");
+    // Checked every frame, so it must not walk the tree
+    float DegradedCost = 0.f;
+    R = Measure("AabbTree::GetCost", 1000, 1, [&]() {
+        DegradedCost = Tree.GetCost();
+        DoNotOptimize(DegradedCost);
+    });
+    Report(R, "calls");
+    const bool Rebuilt = Tree.RebuildIfDegraded();
+    std::printf("%-44s %u tree updates, SAH cost %.1f -> %.1f (%s)\n", "", Updated, DegradedCost,
+        Tree.GetCost(), Rebuilt ? "rebuilt" : "kept");
+
+    // Box and ray queries against brute force over the fat boxes
+    const Aabb Region{ XMFLOAT3(-100.f, -100.f, -100.f), XMFLOAT3(100.f, 100.f, 100.f) };
+    std::vector<uint32_t> Overlapping;
+    R = Measure("AabbTree::QueryAabb 200 m box", 200, 1, [&]() {
+        Overlapping.clear();
+        Tree.QueryAabb(Region, Overlapping);
+    });
+    Report(R, "queries");
+    size_t BruteOverlapping = 0;
+    for (uint32_t Proxy : Proxies)
+        BruteOverlapping += Tree.GetFatAabb(Proxy).Overlaps(Region);
+
+    // Aimed at one proxy so there is at least one hit; the move pass above
+    // may have taken it away from its render item
+    const Aabb& Target = Tree.GetFatAabb(Proxies[0]);
+    const XMVECTOR TargetCenter = XMVectorScale(XMVectorAdd(XMLoadFloat3(&Target.Min), XMLoadFloat3(&Target.Max)), 0.5f);
+    const XMFLOAT3 Origin(-1000.f, 0.f, 0.f);
+    const XMVECTOR ToTarget = XMVectorSubtract(TargetCenter, XMLoadFloat3(&Origin));
+    const float MaxDistance = XMVectorGetX(XMVector3Length(ToTarget)) + 10.f;
+    XMFLOAT3 Direction;
+    XMStoreFloat3(&Direction, XMVector3Normalize(ToTarget));
+    std::vector<uint32_t> RayHits;
+    R = Measure("AabbTree::QueryRay", 200, 1, [&]() {
+        RayHits.clear();
+        Tree.QueryRay(Origin, Direction, MaxDistance, RayHits);
+    });
+    Report(R, "queries");
+    size_t BruteRayHits = 0;
+    for (uint32_t Proxy : Proxies)
+    {
+        const Aabb& Box = Tree.GetFatAabb(Proxy);
+        float tNear = 0.f, tFar = MaxDistance;
+        const float o[3] = { Origin.x, Origin.y, Origin.z }, d[3] = { Direction.x, Direction.y, Direction.z };
+        const float lo[3] = { Box.Min.x, Box.Min.y, Box.Min.z }, hi[3] = { Box.Max.x, Box.Max.y, Box.Max.z };
+        for (int a = 0; a < 3; ++a)
+        {
+            if (d[a] == 0.f)
+            {
+                if (o[a] < lo[a] || o[a] > hi[a])
+                    tNear = tFar + 1.f;
+                continue;
+            }
+            const float t1 = (lo[a] - o[a]) / d[a], t2 = (hi[a] - o[a]) / d[a];
+            tNear = std::max(tNear, std::min(t1, t2));
+            tFar = std::min(tFar, std::max(t1, t2));
+        }
+        BruteRayHits += tNear <= tFar;
+    }
+    std::printf("%-44s box %zu hits (brute force %zu), ray %zu hits (brute force %zu)\n", "",
+        Overlapping.size(), BruteOverlapping, RayHits.size(), BruteRayHits);
+}
+
+} // namespace Bench
+} // namespace Racoon
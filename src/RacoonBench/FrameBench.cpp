@@ -0,0 +1,131 @@
+#include "Bench.h"
+
+#include "FrameAllocator.h"
+#include "JobSystem.h"
+
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <random>
+
+namespace Racoon {
+namespace Bench {
+
+namespace {
+
+// The transient containers a frame builds: visible indices, sort keys and
+// instance matrices, sized like a busy scene. Returns a checksum.
+template<typename Allocator>
+uint64_t SimulateFrame(uint32_t Frame, const Allocator& Alloc)
+{
+    using IndexVector = std::vector<uint32_t, typename std::allocator_traits<Allocator>::template rebind_alloc<uint32_t>>;
+    using KeyVector = std::vector<uint64_t, typename std::allocator_traits<Allocator>::template rebind_alloc<uint64_t>>;
+    using MatrixVector = std::vector<XMFLOAT4X4, typename std::allocator_traits<Allocator>::template rebind_alloc<XMFLOAT4X4>>;
+
+    // Grown with push_back like the real stages, not reserved up front
+    IndexVector Visible(Alloc);
+    for (uint32_t i = 0; i < 20000; i += 1 + (i + Frame) % 3)
+        Visible.push_back(i);
+    KeyVector Keys(Alloc);
+    for (uint32_t Item : Visible)
+        Keys.push_back((static_cast<uint64_t>(Item * 2654435761u) << 32) | Item);
+    MatrixVector Instances(Alloc);
+    for (size_t i = 0; i < Visible.size() / 4; ++i)
+    {
+        XMFLOAT4X4 World;
+        XMStoreFloat4x4(&World, XMMatrixTranslation(static_cast<float>(i), 0.f, 0.f));
+        Instances.push_back(World);
+    }
+    return Visible.size() + Keys.back() + static_cast<uint64_t>(Instances.back().m[3][0]);
+}
+
+void PrintStats(const char* Label, const ArenaStats& Stats)
+{
+    std::printf("%-44s %s: high-water %zu KiB, capacity %zu KiB, %llu heap blocks\n", "", Label,
+        Stats.HighWaterMark / 1024, Stats.Capacity / 1024, static_cast<unsigned long long>(Stats.HeapAllocations));
+}
+
+} // namespace
+
+void RunFrameBenchmarks()
+{
+    uint32_t Frame = 0;
+    uint64_t Checksum = 0;
+    Result R = Measure("Frame containers, std::allocator", 200, 1, [&]() {
+        Checksum += SimulateFrame(++Frame, std::allocator<char>());
+        DoNotOptimize(Checksum);
+    });
+    Report(R, "frames");
+
+    // Starts with small blocks to show the chain collapsing into one block
+    const uint32_t FramesInFlight = 3;
+    FrameAllocator Frames(FramesInFlight, 1, 16 * 1024);
+    Frames.SetPoisonFreedMemory(false);
+    for (uint32_t i = 0; i < FramesInFlight * 2; ++i)
+    {
+        Frames.BeginFrame();
+        SimulateFrame(++Frame, std::pmr::polymorphic_allocator<char>(&Frames.GetArena()));
+    }
+    PrintStats("after warm-up", Frames.GetStats());
+    const uint64_t WarmBlocks = Frames.GetStats().HeapAllocations;
+
+    R = Measure("Frame containers, FrameAllocator", 200, 1, [&]() {
+        Frames.BeginFrame();
+        Checksum += SimulateFrame(++Frame, std::pmr::polymorphic_allocator<char>(&Frames.GetArena()));
+        DoNotOptimize(Checksum);
+    });
+    Report(R, "frames");
+    std::printf("%-44s heap blocks added in steady state: %llu\n", "",
+        static_cast<unsigned long long>(Frames.GetStats().HeapAllocations - WarmBlocks));
+
+    Frames.SetPoisonFreedMemory(true);
+    R = Measure("Frame containers, FrameAllocator + poison", 200, 1, [&]() {
+        Frames.BeginFrame();
+        Checksum += SimulateFrame(++Frame, std::pmr::polymorphic_allocator<char>(&Frames.GetArena()));
+        DoNotOptimize(Checksum);
+    });
+    Report(R, "frames");
+
+    // Freed memory must read back as poison, and only once its frame comes around again
+    LinearArena Arena(1024);
+    uint32_t* Stale = Arena.AllocateArray<uint32_t>(64);
+    for (uint32_t i = 0; i < 64; ++i)
+        Stale[i] = i;
+    Arena.SetPoisonFreedMemory(true);
+    Arena.Reset();
+    bool Poisoned = true;
+    for (uint32_t i = 0; i < 64 * sizeof(uint32_t); ++i)
+        Poisoned &= reinterpret_cast<unsigned char*>(Stale)[i] == LinearArena::PoisonByte;
+    std::printf("%-44s freed memory poisoned: %s\n", "", Poisoned ? "yes" : "NO");
+
+    // Every worker allocates from its own arena, no locks involved
+    JobSystem Jobs;
+    FrameAllocator Threaded(FramesInFlight, Jobs.GetThreadCount());
+    Threaded.SetPoisonFreedMemory(false);
+    const uint32_t Count = 1 << 16;
+    std::atomic<uintptr_t> ScratchSum{ 0 };
+    auto ThreadedFrame = [&]() {
+        Threaded.BeginFrame();
+        Jobs.ParallelFor(Count, 256, [&](uint32_t First, uint32_t Last) {
+            LinearArena& Local = Threaded.GetThreadArena(Jobs);
+            uintptr_t Sum = 0;
+            for (uint32_t i = First; i < Last; ++i)
+            {
+                float* Scratch = Local.AllocateArray<float>(16);
+                Scratch[0] = static_cast<float>(i);
+                Sum += reinterpret_cast<uintptr_t>(Scratch);
+            }
+            ScratchSum.fetch_add(Sum, std::memory_order_relaxed);
+        });
+    };
+    // Each arena grows on its first use and settles into one block at its next Reset
+    for (uint32_t i = 0; i < FramesInFlight * 2; ++i)
+        ThreadedFrame();
+    R = Measure("ParallelFor 64k arena allocations", 50, Count, ThreadedFrame);
+    Report(R, "allocs");
+    PrintStats(("summed over " + std::to_string(Jobs.GetThreadCount()) + " threads x " +
+        std::to_string(FramesInFlight) + " frames").c_str(), Threaded.GetStats());
+}
+
+} // namespace Bench
+} // namespace Racoon
@@ -0,0 +1,111 @@
+#include "Bench.h"
+
+#include "PrimitivesGenerator.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+namespace Racoon {
+namespace Bench {
+
+namespace {
+
+template<typename Fn>
+void MeasureMesh(const std::string& Name, uint32_t Iterations, Fn&& Create)
+{
+    const MeshData Probe = Create();
+    const uint64_t VertexCount = Probe.Vertices.size();
+
+    Result R = Measure(Name, Iterations, VertexCount, [&]() {
+        MeshData Mesh = Create();
+        DoNotOptimize(Mesh);
+    });
+    Report(R, "verts");
+
+    const uint64_t Resident = Probe.Vertices.capacity() * sizeof(Vertex) +
+        Probe.Indices32.capacity() * sizeof(uint32_t);
+    std::printf("%-44s %10llu verts %10llu indices %12llu B resident\n", "",
+        static_cast<unsigned long long>(VertexCount),
+        static_cast<unsigned long long>(Probe.Indices32.size()),
+        static_cast<unsigned long long>(Resident));
+}
+
+// Largest per-component difference between two meshes of the same topology,
+// or -1 when the topology differs
+float MaxVertexDifference(const MeshData& A, const MeshData& B)
+{
+    if (A.Vertices.size() != B.Vertices.size() || A.Indices32 != B.Indices32)
+        return -1.f;
+
+    float MaxDiff = 0.f;
+    for (size_t i = 0; i < A.Vertices.size(); ++i)
+    {
+        const float* a = &A.Vertices[i].Position.x;
+        const float* b = &B.Vertices[i].Position.x;
+        for (size_t k = 0; k < sizeof(Vertex) / sizeof(float); ++k)
+            MaxDiff = std::max(MaxDiff, std::fabs(a[k] - b[k]));
+    }
+    return MaxDiff;
+}
+
+void CompareCylinderModes(uint32_t Slices, uint32_t Stacks, uint32_t Iterations)
+{
+    const std::string Size = std::to_string(Slices) + "x" + std::to_string(Stacks);
+
+    JobSystem Jobs;
+    GeneratorOptions Options;
+    Options.Jobs = &Jobs;
+    Options.Mode = GenerationMode::Scalar;
+    PrimitivesGenerator Scalar(Options);
+    Options.Mode = GenerationMode::Bulk;
+    Options.MaxThreads = 1;
+    PrimitivesGenerator BulkSingle(Options);
+    Options.MaxThreads = 0;
+    PrimitivesGenerator Bulk(Options);
+
+    MeasureMesh("CreateCylinder scalar " + Size, Iterations,
+        [&]() { return Scalar.CreateCylinder(1.f, 1.5f, 2.f, Slices, Stacks); });
+    MeasureMesh("CreateCylinder bulk 1 thread " + Size, Iterations,
+        [&]() { return BulkSingle.CreateCylinder(1.f, 1.5f, 2.f, Slices, Stacks); });
+    MeasureMesh("CreateCylinder bulk " + Size, Iterations,
+        [&]() { return Bulk.CreateCylinder(1.f, 1.5f, 2.f, Slices, Stacks); });
+
+    const MeshData Reference = Scalar.CreateCylinder(1.f, 1.5f, 2.f, Slices, Stacks);
+    const MeshData Result = Bulk.CreateCylinder(1.f, 1.5f, 2.f, Slices, Stacks);
+    const bool Identical = Reference.Vertices.size() == Result.Vertices.size() &&
+        std::memcmp(Reference.Vertices.data(), Result.Vertices.data(), Reference.Vertices.size() * sizeof(Vertex)) == 0;
+    std::printf("%-44s bulk vs scalar: %s, max diff %g\n", "",
+        Identical ? "bit-identical" : "differs", MaxVertexDifference(Reference, Result));
+}
+
+} // namespace
+
+void RunGeometryBenchmarks()
+{
+    PrimitivesGenerator Generator;
+
+    MeasureMesh("CreateCube", 20000, [&]() { return Generator.CreateCube(); });
+
+    MeasureMesh("CreateCylinder 8x2", 20000,
+        [&]() { return Generator.CreateCylinder(1.f, 1.5f, 2.f, 8, 2); });
+    MeasureMesh("CreateCylinder 64x32", 2000,
+        [&]() { return Generator.CreateCylinder(1.f, 1.5f, 2.f, 64, 32); });
+    CompareCylinderModes(512, 512, 20);
+    CompareCylinderModes(2048, 1024, 3);
+
+    // One row per level. "unshared" is what emitting three vertices per
+    // triangle would cost without the edge midpoint cache.
+    for (uint32_t Subdivisions = 0; Subdivisions <= 8; ++Subdivisions)
+    {
+        const uint32_t Iterations = Subdivisions <= 4 ? 2000 : (Subdivisions <= 6 ? 100 : 10);
+        MeasureMesh("CreateGeosphere subdiv " + std::to_string(Subdivisions), Iterations,
+            [&]() { return Generator.CreateGeosphere(1.5f, Subdivisions); });
+
+        const uint32_t Triangles = PrimitivesGenerator::GeosphereTriangleCount(Subdivisions);
+        std::printf("%-44s %10u tris %10u unshared verts\n", "", Triangles, Triangles * 3);
+    }
+}
+
+} // namespace Bench
+} // namespace Racoon
@@ -0,0 +1,282 @@
+#include "Bench.h"
+
+#include "GltfLoader.h"
+#include "JobSystem.h"
+#include "MeshOptimizer.h"
+#include "PrimitivesGenerator.h"
+
+#include "json/json.h"
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+
+namespace Racoon {
+namespace Bench {
+
+namespace {
+
+using json = nlohmann::json;
+
+// Appends a buffer view and returns its index
+uint32_t AddView(json& Document, std::vector<uint8_t>& Binary, const void* Data, size_t Size, uint32_t Stride)
+{
+    while (Binary.size() % 4)
+        Binary.push_back(0);
+    json View = { { "buffer", 0 }, { "byteOffset", Binary.size() }, { "byteLength", Size } };
+    if (Stride)
+        View["byteStride"] = Stride;
+    const uint8_t* Bytes = static_cast<const uint8_t*>(Data);
+    Binary.insert(Binary.end(), Bytes, Bytes + Size);
+    Document["bufferViews"].push_back(View);
+    return static_cast<uint32_t>(Document["bufferViews"].size() - 1);
+}
+
+uint32_t AddAccessor(json& Document, uint32_t View, size_t Offset, uint32_t ComponentType, size_t Count,
+    const char* Type, bool Normalized = false)
+{
+    json Accessor = { { "bufferView", View }, { "byteOffset", Offset }, { "componentType", ComponentType },
+        { "count", Count }, { "type", Type } };
+    if (Normalized)
+        Accessor["normalized"] = true;
+    Document["accessors"].push_back(Accessor);
+    return static_cast<uint32_t>(Document["accessors"].size() - 1);
+}
+
+// Even meshes are exported the way DCC tools usually do: one interleaved
+// float view with every attribute. Odd ones carry only positions and
+// unorm16 UVs in separate views, so the loader must derive the rest.
+json BuildDocument(const std::vector<MeshData>& Meshes, std::vector<uint8_t>& Binary)
+{
+    json Document = { { "asset", { { "version", "2.0" } } }, { "bufferViews", json::array() },
+        { "accessors", json::array() }, { "meshes", json::array() } };
+    for (size_t m = 0; m < Meshes.size(); ++m)
+    {
+        const MeshData& Mesh = Meshes[m];
+        const size_t Count = Mesh.Vertices.size();
+        json Attributes;
+        if (m % 2 == 0)
+        {
+            struct Interleaved
+            {
+                XMFLOAT3 Position;
+                XMFLOAT3 Normal;
+                XMFLOAT4 Tangent;
+                XMFLOAT2 UV;
+            };
+            std::vector<Interleaved> Vertices(Count);
+            for (size_t i = 0; i < Count; ++i)
+            {
+                const Vertex& V = Mesh.Vertices[i];
+                Vertices[i] = { V.Position, V.Normal, XMFLOAT4(V.Tangent.x, V.Tangent.y, V.Tangent.z, 1.f), V.UV };
+            }
+            const uint32_t View = AddView(Document, Binary, Vertices.data(), Count * sizeof(Interleaved),
+                sizeof(Interleaved));
+            Attributes["POSITION"] = AddAccessor(Document, View, offsetof(Interleaved, Position), 5126, Count, "VEC3");
+            Attributes["NORMAL"] = AddAccessor(Document, View, offsetof(Interleaved, Normal), 5126, Count, "VEC3");
+            Attributes["TANGENT"] = AddAccessor(Document, View, offsetof(Interleaved, Tangent), 5126, Count, "VEC4");
+            Attributes["TEXCOORD_0"] = AddAccessor(Document, View, offsetof(Interleaved, UV), 5126, Count, "VEC2");
+        }
+        else
+        {
+            std::vector<XMFLOAT3> Positions(Count);
+            std::vector<uint16_t> UVs(Count * 2);
+            for (size_t i = 0; i < Count; ++i)
+            {
+                Positions[i] = Mesh.Vertices[i].Position;
+                UVs[2 * i] = static_cast<uint16_t>(std::lround(Mesh.Vertices[i].UV.x * 65535.f));
+                UVs[2 * i + 1] = static_cast<uint16_t>(std::lround(Mesh.Vertices[i].UV.y * 65535.f));
+            }
+            const uint32_t PositionView = AddView(Document, Binary, Positions.data(), Count * sizeof(XMFLOAT3), 0);
+            const uint32_t UVView = AddView(Document, Binary, UVs.data(), UVs.size() * sizeof(uint16_t), 0);
+            Attributes["POSITION"] = AddAccessor(Document, PositionView, 0, 5126, Count, "VEC3");
+            Attributes["TEXCOORD_0"] = AddAccessor(Document, UVView, 0, 5123, Count, "VEC2", true);
+        }
+
+        json Primitive = { { "attributes", Attributes } };
+        if (Count <= 0xFFFF)
+        {
+            std::vector<uint16_t> Indices(Mesh.Indices32.begin(), Mesh.Indices32.end());
+            const uint32_t View = AddView(Document, Binary, Indices.data(), Indices.size() * sizeof(uint16_t), 0);
+            Primitive["indices"] = AddAccessor(Document, View, 0, 5123, Indices.size(), "SCALAR");
+        }
+        else
+        {
+            const uint32_t View = AddView(Document, Binary, Mesh.Indices32.data(),
+                Mesh.Indices32.size() * sizeof(uint32_t), 0);
+            Primitive["indices"] = AddAccessor(Document, View, 0, 5125, Mesh.Indices32.size(), "SCALAR");
+        }
+        Document["meshes"].push_back({ { "name", "mesh" + std::to_string(m) }, { "primitives", { Primitive } } });
+    }
+    while (Binary.size() % 4)
+        Binary.push_back(0);
+    Document["buffers"] = { { { "byteLength", Binary.size() } } };
+    return Document;
+}
+
+void WriteGlb(const std::string& Path, const json& Document, const std::vector<uint8_t>& Binary)
+{
+    std::string Text = Document.dump();
+    while (Text.size() % 4)
+        Text += ' ';
+    const uint32_t Header[3] = { 0x46546C67, 2, static_cast<uint32_t>(12 + 8 + Text.size() + 8 + Binary.size()) };
+    const uint32_t JsonChunk[2] = { static_cast<uint32_t>(Text.size()), 0x4E4F534A };
+    const uint32_t BinaryChunk[2] = { static_cast<uint32_t>(Binary.size()), 0x004E4942 };
+    std::ofstream File(Path, std::ios::binary);
+    File.write(reinterpret_cast<const char*>(Header), sizeof(Header));
+    File.write(reinterpret_cast<const char*>(JsonChunk), sizeof(JsonChunk));
+    File.write(Text.data(), Text.size());
+    File.write(reinterpret_cast<const char*>(BinaryChunk), sizeof(BinaryChunk));
+    File.write(reinterpret_cast<const char*>(Binary.data()), Binary.size());
+}
+
+std::string EncodeBase64(const std::vector<uint8_t>& Data)
+{
+    static const char Alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::string Text;
+    for (size_t i = 0; i < Data.size(); i += 3)
+    {
+        const uint32_t Bits = (Data[i] << 16) | ((i + 1 < Data.size() ? Data[i + 1] : 0) << 8)
+            | (i + 2 < Data.size() ? Data[i + 2] : 0);
+        Text += Alphabet[(Bits >> 18) & 63];
+        Text += Alphabet[(Bits >> 12) & 63];
+        Text += i + 1 < Data.size() ? Alphabet[(Bits >> 6) & 63] : '=';
+        Text += i + 2 < Data.size() ? Alphabet[Bits & 63] : '=';
+    }
+    return Text;
+}
+
+struct Comparison
+{
+    bool Exact{ true };
+    float MinNormalDot{ 1.f };
+    float MaxUVError{ 0.f };
+};
+
+void Compare(const MeshData& Source, const GltfMesh& Loaded, Comparison& Result)
+{
+    const bool Full = Loaded.Attributes == VertexAttributeBits::All;
+    if (Loaded.Mesh.Vertices.size() != Source.Vertices.size() || Loaded.Mesh.Indices32 != Source.Indices32)
+    {
+        Result.Exact = false;
+        return;
+    }
+    for (size_t i = 0; i < Source.Vertices.size(); ++i)
+    {
+        const Vertex& A = Source.Vertices[i];
+        const Vertex& B = Loaded.Mesh.Vertices[i];
+        Result.Exact &= std::memcmp(&A.Position, &B.Position, sizeof(XMFLOAT3)) == 0;
+        if (Full)
+        {
+            Result.Exact &= std::memcmp(&A.Normal, &B.Normal, sizeof(XMFLOAT3)) == 0
+                && std::memcmp(&A.Tangent, &B.Tangent, sizeof(XMFLOAT3)) == 0
+                && std::memcmp(&A.UV, &B.UV, sizeof(XMFLOAT2)) == 0;
+            continue;
+        }
+        Result.MinNormalDot = std::min(Result.MinNormalDot,
+            XMVectorGetX(XMVector3Dot(XMLoadFloat3(&A.Normal), XMLoadFloat3(&B.Normal))));
+        Result.MaxUVError = std::max({ Result.MaxUVError, std::abs(A.UV.x - B.UV.x), std::abs(A.UV.y - B.UV.y) });
+    }
+}
+
+} // namespace
+
+void RunGltfBenchmarks()
+{
+    // Welded geospheres and cylinders, about 30 MB of vertex and index data.
+    // The generator's cylinders are not wound counter-clockwise as glTF
+    // expects, so they only go where normals are exported.
+    PrimitivesGenerator Generator;
+    std::vector<MeshData> Meshes;
+    for (uint32_t i = 0; i < 64; ++i)
+    {
+        Meshes.push_back(i % 4 == 2 ? Generator.CreateCylinder(1.f, 0.5f, 2.f, 256, 64)
+                                    : Generator.CreateGeosphere(1.f + i * 0.01f, 5));
+        OptimizeMesh(Meshes.back());
+    }
+
+    const std::filesystem::path Directory = std::filesystem::temp_directory_path();
+    const std::string GlbPath = (Directory / "RacoonBench.glb").string();
+    std::vector<uint8_t> Binary;
+    const json Document = BuildDocument(Meshes, Binary);
+    WriteGlb(GlbPath, Document, Binary);
+    const size_t FileBytes = std::filesystem::file_size(GlbPath);
+
+    std::string Error;
+    GltfDocument Asset;
+    std::vector<GltfMesh> Loaded;
+    if (!Asset.Open(GlbPath, Error) || !Asset.LoadMeshes(Loaded, Error))
+    {
+        std::printf("%-44s load failed: %s\n", "", Error.c_str());
+        return;
+    }
+    Comparison Check;
+    for (size_t i = 0; i < Meshes.size(); ++i)
+        Compare(Meshes[i], Loaded[i], Check);
+    std::printf("%-44s %u primitives, %.1f MB, matches the source: %s\n", "", Asset.GetPrimitiveCount(),
+        FileBytes / 1e6, Check.Exact ? "yes" : "NO");
+    std::printf("%-44s derived normals min dot %.4f, unorm16 UV max error %.2g\n", "", Check.MinNormalDot,
+        Check.MaxUVError);
+
+    // The same first mesh as a .gltf with its buffer in a data: URI
+    {
+        std::vector<uint8_t> SmallBinary;
+        json Small = BuildDocument({ Meshes[0] }, SmallBinary);
+        Small["buffers"][0]["uri"] = "data:application/octet-stream;base64," + EncodeBase64(SmallBinary);
+        const std::string GltfPath = (Directory / "RacoonBench.gltf").string();
+        std::ofstream(GltfPath) << Small.dump();
+
+        GltfDocument SmallAsset;
+        std::vector<GltfMesh> SmallLoaded;
+        Comparison SmallCheck;
+        const bool Opened = SmallAsset.Open(GltfPath, Error) && SmallAsset.LoadMeshes(SmallLoaded, Error);
+        if (Opened)
+            Compare(Meshes[0], SmallLoaded[0], SmallCheck);
+        std::printf("%-44s .gltf with a data URI matches: %s\n", "", Opened && SmallCheck.Exact ? "yes" : "NO");
+        std::filesystem::remove(GltfPath);
+    }
+
+    // What the loader avoids: reading the whole file into memory before
+    // anything is parsed
+    Report(Measure("gltf/ifstream read, for reference", 10, FileBytes, [&]
+        {
+            std::ifstream File(GlbPath, std::ios::binary);
+            std::vector<char> Bytes(FileBytes);
+            File.read(Bytes.data(), Bytes.size());
+            DoNotOptimize(Bytes);
+        }), "B");
+    Report(Measure("gltf/open (map + JSON)", 10, FileBytes, [&]
+        {
+            GltfDocument Document;
+            Document.Open(GlbPath, Error);
+            DoNotOptimize(Document);
+        }), "B");
+    Report(Measure("gltf/open + load, serial", 10, FileBytes, [&]
+        {
+            GltfDocument Document;
+            std::vector<GltfMesh> Out;
+            Document.Open(GlbPath, Error);
+            Document.LoadMeshes(Out, Error);
+            DoNotOptimize(Out);
+        }), "B");
+
+    // At least 4 threads so the split is exercised on small machines too
+    JobSystem Jobs(std::max(4u, std::thread::hardware_concurrency()));
+    char Name[64];
+    std::snprintf(Name, sizeof(Name), "gltf/open + load, %u threads", Jobs.GetThreadCount());
+    Report(Measure(Name, 10, FileBytes, [&]
+        {
+            GltfDocument Document;
+            std::vector<GltfMesh> Out;
+            Document.Open(GlbPath, Error);
+            Document.LoadMeshes(Out, Error, &Jobs);
+            DoNotOptimize(Out);
+        }), "B");
+
+    std::filesystem::remove(GlbPath);
+}
+
+} // namespace Bench
+} // namespace Racoon
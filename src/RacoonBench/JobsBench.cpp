@@ -0,0 +1,127 @@
+#include "Bench.h"
+
+#include "JobSystem.h"
+#include "PrimitivesGenerator.h"
+
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+
+namespace Racoon {
+namespace Bench {
+
+namespace {
+
+// A few hundred nanoseconds of float math per element
+float Work(uint32_t i)
+{
+    float x = static_cast<float>(i);
+    for (int k = 0; k < 32; ++k)
+        x = std::sqrt(x * 1.0001f + 1.f);
+    return x;
+}
+
+std::vector<uint32_t> ThreadCounts()
+{
+    const uint32_t Hardware = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<uint32_t> Counts;
+    for (uint32_t Threads = 1; Threads < Hardware; Threads *= 2)
+        Counts.push_back(Threads);
+    Counts.push_back(Hardware);
+    return Counts;
+}
+
+// Every job of every round must run exactly once: lost jobs leave a 0 and
+// duplicated ones a 2. Mixes ParallelFor, nested Run and overflowing a deque.
+bool StressTest(JobSystem& Jobs, uint32_t Rounds)
+{
+    const uint32_t Count = 100000;
+    std::vector<std::atomic<uint32_t>> Hits(Count);
+    bool Ok = true;
+    for (uint32_t Round = 0; Round < Rounds && Ok; ++Round)
+    {
+        for (auto& Hit : Hits)
+            Hit.store(0, std::memory_order_relaxed);
+
+        // Grain 1 makes every element its own job
+        Jobs.ParallelFor(Count / 2, Round % 2 ? 1 : 0, [&](uint32_t First, uint32_t Last) {
+            for (uint32_t i = First; i < Last; ++i)
+                Hits[i].fetch_add(1, std::memory_order_relaxed);
+        });
+
+        // More jobs than a deque holds, each queuing a child from inside a job
+        JobCounter Counter;
+        for (uint32_t i = Count / 2; i < Count; i += 2)
+        {
+            Jobs.Run(Counter, [&Jobs, &Hits, &Counter, i]() {
+                Hits[i].fetch_add(1, std::memory_order_relaxed);
+                Jobs.Run(Counter, [&Hits, i]() { Hits[i + 1].fetch_add(1, std::memory_order_relaxed); });
+            });
+        }
+        Jobs.Wait(Counter);
+
+        for (const auto& Hit : Hits)
+            Ok &= Hit.load(std::memory_order_relaxed) == 1;
+    }
+    return Ok;
+}
+
+} // namespace
+
+void RunJobsBenchmarks()
+{
+    const uint32_t Count = 1 << 20;
+    std::vector<float> Out(Count);
+
+    Result R = Measure("Serial loop 1M elements", 5, Count, [&]() {
+        for (uint32_t i = 0; i < Count; ++i)
+            Out[i] = Work(i);
+        DoNotOptimize(Out);
+    });
+    Report(R, "elements");
+    const double SerialMs = R.MillisecondsPerIteration;
+
+    for (uint32_t Threads : ThreadCounts())
+    {
+        JobSystem Jobs(Threads);
+        R = Measure("ParallelFor 1M elements, " + std::to_string(Threads) + " threads", 5, Count, [&]() {
+            Jobs.ParallelFor(Count, 0, [&](uint32_t First, uint32_t Last) {
+                for (uint32_t i = First; i < Last; ++i)
+                    Out[i] = Work(i);
+            });
+            DoNotOptimize(Out);
+        });
+        Report(R, "elements");
+        std::printf("%-44s %.2fx serial, %llu jobs stolen\n", "", SerialMs / R.MillisecondsPerIteration,
+            static_cast<unsigned long long>(Jobs.GetStolenJobCount()));
+
+        // Tiny jobs, where queueing overhead dominates
+        R = Measure("Run + Wait 10000 empty jobs, " + std::to_string(Threads) + " threads", 20, 10000, [&]() {
+            JobCounter Counter;
+            for (uint32_t i = 0; i < 10000; ++i)
+                Jobs.Run(Counter, []() {});
+            Jobs.Wait(Counter);
+        });
+        Report(R, "jobs");
+
+        GeneratorOptions Options;
+        Options.Jobs = &Jobs;
+        Options.MinVerticesPerThread = 16 * 1024;
+        PrimitivesGenerator Generator(Options);
+        R = Measure("CreateCylinder 2048x1024, " + std::to_string(Threads) + " threads", 3, 2049 * 1025, [&]() {
+            MeshData Mesh = Generator.CreateCylinder(1.f, 1.5f, 2.f, 2048, 1024);
+            DoNotOptimize(Mesh);
+        });
+        Report(R, "verts");
+    }
+
+    // Oversubscribed on purpose so workers get preempted mid-steal
+    const uint32_t StressThreads = std::max(4u, std::thread::hardware_concurrency() * 2);
+    JobSystem Jobs(StressThreads);
+    const bool Ok = StressTest(Jobs, 20);
+    std::printf("%-44s 20 rounds x 100000 jobs on %u threads, every job ran once: %s (%llu stolen)\n",
+        "Stress", StressThreads, Ok ? "yes" : "NO", static_cast<unsigned long long>(Jobs.GetStolenJobCount()));
+}
+
+} // namespace Bench
+} // namespace Racoon
@@ -0,0 +1,201 @@
+#include "Bench.h"
+
+#include "JobSystem.h"
+#include "MeshCache.h"
+#include "MeshLod.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "PrimitivesGenerator.h"
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace Racoon {
+namespace Bench {
+
+namespace {
+
+// Edges with a triangle on one side only, with vertices matched by position,
+// so seams count as closed. Simplifying must not add any: that would be a
+// crack along a seam.
+uint32_t CountOpenEdges(const MeshData& Mesh)
+{
+    std::unordered_map<uint64_t, uint32_t> Positions;
+    std::vector<uint32_t> Remap(Mesh.Vertices.size());
+    for (size_t v = 0; v < Mesh.Vertices.size(); ++v)
+    {
+        uint32_t Bits[3];
+        std::memcpy(Bits, &Mesh.Vertices[v].Position, sizeof(Bits));
+        const uint64_t Key = (uint64_t(Bits[0]) * 73856093u) ^ (uint64_t(Bits[1]) << 21) ^
+            (uint64_t(Bits[2]) << 42) ^ Bits[2];
+        Remap[v] = Positions.emplace(Key, static_cast<uint32_t>(v)).first->second;
+    }
+
+    std::unordered_set<uint64_t> Edges;
+    for (size_t t = 0; t < Mesh.Indices32.size(); t += 3)
+    {
+        for (uint32_t k = 0; k < 3; ++k)
+        {
+            const uint32_t A = Remap[Mesh.Indices32[t + k]];
+            const uint32_t B = Remap[Mesh.Indices32[t + (k + 1) % 3]];
+            Edges.insert(uint64_t(A) << 32 | B);
+        }
+    }
+    uint32_t Open = 0;
+    for (uint64_t Edge : Edges)
+        Open += Edges.count(Edge << 32 | Edge >> 32) == 0;
+    return Open;
+}
+
+// The generator's cylinder puts the last slice at sinf(2 pi), a hair off
+// the first slice at 0, so its UV seam would not close by position
+MeshData CreateClosedCylinder()
+{
+    MeshData Cylinder = PrimitivesGenerator().CreateCylinder(1.f, 0.5f, 2.f, 256, 64);
+    for (Vertex& V : Cylinder.Vertices)
+    {
+        if (std::fabs(V.Position.z) < 1e-5f)
+            V.Position.z = 0.f;
+    }
+    return Cylinder;
+}
+
+void PrintChain(const char* Name, const std::vector<LodLevel>& Chain)
+{
+    for (size_t i = 0; i < Chain.size(); ++i)
+    {
+        const MeshData& Level = *Chain[i].Mesh;
+        std::printf("%-44s %s lod %zu: %8zu tris %8zu verts, error %.5f, open edges %u\n", "", Name,
+            i, Level.Indices32.size() / 3, Level.Vertices.size(), Chain[i].Error, CountOpenEdges(Level));
+    }
+}
+
+// Walks the camera away from an item and back, and then shakes it around
+// each switch distance, counting level changes
+void CheckHysteresis(const std::vector<LodLevel>& Lods)
+{
+    MeshLodChain Chain;
+    Chain.LevelCount = static_cast<uint32_t>(std::min<size_t>(Lods.size(), MeshLodChain::MaxLevels));
+    Chain.LocalRadius = Lods[0].Mesh->LocalBounds.Radius;
+    for (uint32_t i = 0; i < Chain.LevelCount; ++i)
+        Chain.Levels[i].Error = Lods[i].Error;
+
+    LodSelectionView View;
+    // 1080 pixels high at 60 degrees
+    View.ProjectionScale = 540.f / std::tan(XM_PI / 6.f);
+
+    uint32_t Level = 0;
+    uint32_t Switches = 0;
+    std::vector<float> SwitchDistances;
+    for (float Distance = 0.01f; Distance < 100.f; Distance *= 1.01f)
+    {
+        const uint32_t Next = SelectLod(Chain, 1.f, Distance, View, Level);
+        if (Next != Level)
+            SwitchDistances.push_back(Distance);
+        Switches += Next != Level;
+        Level = Next;
+    }
+    const uint32_t Coarsest = Level;
+    for (float Distance = 100.f; Distance > 0.01f; Distance /= 1.01f)
+    {
+        const uint32_t Next = SelectLod(Chain, 1.f, Distance, View, Level);
+        Switches += Next != Level;
+        Level = Next;
+    }
+
+    uint32_t Flicker = 0;
+    for (float Switch : SwitchDistances)
+    {
+        uint32_t Shaken = SelectLod(Chain, 1.f, Switch, View, 0);
+        for (uint32_t Frame = 0; Frame < 100; ++Frame)
+        {
+            const float Distance = Switch * (Frame % 2 ? 1.05f : 0.95f);
+            const uint32_t Next = SelectLod(Chain, 1.f, Distance, View, Shaken);
+            Flicker += Next != Shaken;
+            Shaken = Next;
+        }
+    }
+    std::printf("%-44s selection: out to lod %u and back to lod %u with %u switches, %u switches in %zu x 100 "
+        "frames of 5%% camera shake at the switch distances\n", "", Coarsest, Level, Switches, Flicker,
+        SwitchDistances.size());
+}
+
+} // namespace
+
+void RunLodBenchmarks()
+{
+    PrimitivesGenerator Generator;
+    // 1.3M triangles, no seams
+    auto Sphere = std::make_shared<MeshData>(Generator.CreateGeosphere(1.f, 8));
+    OptimizeMesh(*Sphere);
+    // UV seam down the side and hard edges around the caps
+    auto Cylinder = std::make_shared<MeshData>(CreateClosedCylinder());
+    OptimizeMesh(*Cylinder);
+    const uint64_t SphereTriangles = Sphere->Indices32.size() / 3;
+
+    JobSystem Jobs(std::max(4u, std::thread::hardware_concurrency()));
+    std::vector<LodLevel> Chain;
+    Report(Measure("lod/chain of 4, serial", 1, SphereTriangles, [&]
+        {
+            Chain = BuildLodChain(Sphere);
+        }), "tris");
+    char Name[64];
+    std::snprintf(Name, sizeof(Name), "lod/chain of 4, %u threads", Jobs.GetThreadCount());
+    Report(Measure(Name, 1, SphereTriangles, [&]
+        {
+            Chain = BuildLodChain(Sphere, LodChainOptions(), &Jobs);
+        }), "tris");
+    PrintChain("sphere", Chain);
+    CheckHysteresis(Chain);
+
+    std::vector<LodLevel> CylinderChain;
+    Report(Measure("lod/chain of 4, cylinder with seams", 5, Cylinder->Indices32.size() / 3, [&]
+        {
+            CylinderChain = BuildLodChain(Cylinder, LodChainOptions(), &Jobs);
+        }), "tris");
+    PrintChain("cylinder", CylinderChain);
+
+    // Levels are cooked right after their mesh and come back as a chain
+    {
+        MeshRegistry Registry(VertexEncoding::PackedQuantized);
+        for (const LodLevel& Level : CylinderChain)
+            Registry.Register(Level.Mesh);
+        const std::vector<std::vector<LodLevel>> Lods{ { CylinderChain.begin() + 1, CylinderChain.end() } };
+        const std::string CachePath = (std::filesystem::temp_directory_path() / "RacoonBenchLod.rmesh").string();
+        std::string Error;
+        MeshCacheFile Cache;
+        bool Match = WriteMeshCache(CachePath, 1, Registry, { Cylinder }, Lods, Error) && Cache.Open(CachePath, Error) &&
+            Cache.GetMeshCount() == CylinderChain.size();
+        for (uint32_t i = 0; Match && i < Cache.GetMeshCount(); ++i)
+        {
+            const CookedMesh& Cooked = Cache.GetMesh(i);
+            Match = Cooked.LodLevel == i && Cooked.LodError == CylinderChain[i].Error &&
+                Cooked.Range.IndexCount == CylinderChain[i].Mesh->Indices32.size();
+        }
+        std::printf("%-44s cooked chain reads back: %s\n", "", Match ? "yes" : ("NO " + Error).c_str());
+        Cache.Close();
+        std::filesystem::remove(CachePath);
+    }
+
+    // An open tube, the cylinder's side without its caps: its two rims are
+    // borders, which stay where they are when locked
+    auto Tube = std::make_shared<MeshData>(CreateClosedCylinder());
+    Tube->Indices32.resize(256 * 64 * 6);
+    Tube->UpdateBounds();
+    MeshData Free, Locked;
+    SimplifyOptions LockOptions;
+    LockOptions.LockBorders = true;
+    const SimplifyResult FreeResult = SimplifyMesh(*Tube, 200, Free);
+    const SimplifyResult LockedResult = SimplifyMesh(*Tube, 200, Locked, LockOptions);
+    std::printf("%-44s tube to 200 tris, %u open edges: borders free %u tris %u open edges error %.5f, "
+        "locked %u tris %u open edges error %.5f\n", "", CountOpenEdges(*Tube), FreeResult.TriangleCount,
+        CountOpenEdges(Free), FreeResult.Error, LockedResult.TriangleCount, CountOpenEdges(Locked),
+        LockedResult.Error);
+}
+
+} // namespace Bench
+} // namespace Racoon
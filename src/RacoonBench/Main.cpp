@@ -0,0 +1,109 @@
+#include "Bench.h"
+
+#include "HeadlessBenchmark.h"
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+namespace {
+std::atomic<uint64_t> g_AllocBytes{ 0 };
+std::atomic<uint64_t> g_AllocCount{ 0 };
+}
+
+void* operator new(std::size_t Size)
+{
+    g_AllocBytes.fetch_add(Size, std::memory_order_relaxed);
+    g_AllocCount.fetch_add(1, std::memory_order_relaxed);
+    if (void* Ptr = std::malloc(Size ? Size : 1))
+        return Ptr;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* Ptr) noexcept
+{
+    std::free(Ptr);
+}
+
+void operator delete(void* Ptr, std::size_t) noexcept
+{
+    std::free(Ptr);
+}
+
+namespace Racoon {
+namespace Bench {
+
+const void* volatile g_Sink = nullptr;
+
+void ResetAllocCounters()
+{
+    g_AllocBytes = 0;
+    g_AllocCount = 0;
+}
+
+AllocCounters GetAllocCounters()
+{
+    return { g_AllocBytes.load(), g_AllocCount.load() };
+}
+
+void Report(const Result& R, const char* ItemName)
+{
+    std::printf("%-44s %10.4f ms %14.0f %s/s %12llu B/iter %8llu allocs/iter\n",
+        R.Name.c_str(), R.MillisecondsPerIteration, R.ItemsPerSecond, ItemName,
+        static_cast<unsigned long long>(R.BytesPerIteration),
+        static_cast<unsigned long long>(R.AllocationsPerIteration));
+}
+
+} // namespace Bench
+} // namespace Racoon
+
+struct Suite
+{
+    const char* Name;
+    void (*Run)();
+};
+
+static const Suite g_Suites[] = {
+    { "geometry", Racoon::Bench::RunGeometryBenchmarks },
+    { "scene", Racoon::Bench::RunSceneBenchmarks },
+    { "packing", Racoon::Bench::RunPackingBenchmarks },
+    { "optimize", Racoon::Bench::RunOptimizeBenchmarks },
+    { "culling", Racoon::Bench::RunCullingBenchmarks },
+    { "recording", Racoon::Bench::RunRecordingBenchmarks },
+    { "jobs", Racoon::Bench::RunJobsBenchmarks },
+    { "transforms", Racoon::Bench::RunTransformBenchmarks },
+    { "frame", Racoon::Bench::RunFrameBenchmarks },
+    { "profiler", Racoon::Bench::RunProfilerBenchmarks },
+    { "timing", Racoon::Bench::RunTimingBenchmarks },
+    { "gltf", Racoon::Bench::RunGltfBenchmarks },
+    { "cache", Racoon::Bench::RunCacheBenchmarks },
+    { "streaming", Racoon::Bench::RunStreamingBenchmarks },
+    { "shaders", Racoon::Bench::RunShaderBenchmarks },
+    { "lod", Racoon::Bench::RunLodBenchmarks },
+    { "terrain", Racoon::Bench::RunTerrainBenchmarks },
+};
+
+// Usage: RacoonBench [suite...]. Runs every suite when none is given.
+//        RacoonBench --headless [options], see Racoon::HeadlessUsage.
+int main(int argc, char** argv)
+{
+    if (argc > 1 && std::strcmp(argv[1], "--headless") == 0)
+        return Racoon::RunHeadlessBenchmarkMain(std::vector<std::string>(argv + 2, argv + argc));
+
+    for (const Suite& S : g_Suites)
+    {
+        bool Selected = argc < 2;
+        for (int i = 1; i < argc && !Selected; ++i)
+        {
+            Selected = std::strcmp(argv[i], S.Name) == 0;
+        }
+        if (!Selected)
+            continue;
+
+        std::printf("== %s\n", S.Name);
+        S.Run();
+    }
+    return 0;
+}
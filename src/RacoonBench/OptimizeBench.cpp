@@ -0,0 +1,124 @@
+#include "Bench.h"
+
+#include "MeshOptimizer.h"
+#include "PrimitivesGenerator.h"
+
+#include <cstdio>
+#include <numeric>
+#include <random>
+
+namespace Racoon {
+namespace Bench {
+
+namespace {
+
+// Imported meshes rarely come in a cache friendly order. Shuffling triangles
+// and vertices gives a repeatable worst-ish case.
+MeshData Shuffled(MeshData Mesh, uint32_t Seed)
+{
+    std::mt19937 Rng(Seed);
+
+    const size_t TriangleCount = Mesh.Indices32.size() / 3;
+    std::vector<uint32_t> Order(TriangleCount);
+    std::iota(Order.begin(), Order.end(), 0u);
+    std::shuffle(Order.begin(), Order.end(), Rng);
+
+    std::vector<uint32_t> VertexOrder(Mesh.Vertices.size());
+    std::iota(VertexOrder.begin(), VertexOrder.end(), 0u);
+    std::shuffle(VertexOrder.begin(), VertexOrder.end(), Rng);
+
+    std::vector<Vertex> Vertices(Mesh.Vertices.size());
+    for (size_t v = 0; v < Vertices.size(); ++v)
+        Vertices[VertexOrder[v]] = Mesh.Vertices[v];
+
+    std::vector<uint32_t> Indices(Mesh.Indices32.size());
+    for (size_t t = 0; t < TriangleCount; ++t)
+    {
+        for (size_t k = 0; k < 3; ++k)
+            Indices[t * 3 + k] = VertexOrder[Mesh.Indices32[Order[t] * 3 + k]];
+    }
+
+    Mesh.Vertices.swap(Vertices);
+    Mesh.Indices32.swap(Indices);
+    return Mesh;
+}
+
+void MeasureOptimize(const std::string& Name, const MeshData& Source, const MeshOptimizationOptions& Options)
+{
+    const uint64_t TriangleCount = Source.Indices32.size() / 3;
+
+    MeshOptimizationReport Last;
+    Result R = Measure("OptimizeMesh " + Name, 5, TriangleCount, [&]() {
+        MeshData Mesh = Source;
+        Last = OptimizeMesh(Mesh, Options);
+        DoNotOptimize(Mesh);
+    });
+    Report(R, "tris");
+    std::printf("%-44s ACMR %.3f -> %.3f   ATVR %.3f -> %.3f\n", "",
+        Last.Before.ACMR, Last.After.ACMR, Last.Before.ATVR, Last.After.ATVR);
+}
+
+// Unindexed triangle soup, the way many exporters write meshes: every corner
+// gets its own vertex.
+MeshData Unindexed(const MeshData& Mesh)
+{
+    MeshData Soup;
+    Soup.Vertices.reserve(Mesh.Indices32.size());
+    Soup.Indices32.reserve(Mesh.Indices32.size());
+    for (uint32_t Index : Mesh.Indices32)
+    {
+        Soup.Indices32.push_back(static_cast<uint32_t>(Soup.Vertices.size()));
+        Soup.Vertices.push_back(Mesh.Vertices[Index]);
+    }
+    return Soup;
+}
+
+void MeasureWeld(const std::string& Name, const MeshData& Source, const WeldOptions& Options)
+{
+    size_t Removed = 0;
+    size_t Remaining = 0;
+    Result R = Measure("WeldVertices " + Name, 5, Source.Vertices.size(), [&]() {
+        MeshData Mesh = Source;
+        Removed = WeldVertices(Mesh, Options);
+        Remaining = Mesh.Vertices.size();
+        DoNotOptimize(Mesh);
+    });
+    Report(R, "verts");
+    std::printf("%-44s %zu -> %zu vertices (%zu removed)\n", "",
+        Source.Vertices.size(), Remaining, Removed);
+}
+
+} // namespace
+
+void RunOptimizeBenchmarks()
+{
+    PrimitivesGenerator Generator;
+    const MeshData Sphere = Generator.CreateGeosphere(1.5f, 7);
+    const MeshData Cylinder = Generator.CreateCylinder(1.f, 1.5f, 2.f, 512, 256);
+
+    MeshOptimizationOptions Options;
+    MeasureOptimize("geosphere 7", Sphere, Options);
+    MeasureOptimize("geosphere 7 shuffled", Shuffled(Sphere, 1), Options);
+    MeasureOptimize("cylinder 512x256", Cylinder, Options);
+    MeasureOptimize("cylinder 512x256 shuffled", Shuffled(Cylinder, 2), Options);
+
+    Options.Overdraw = true;
+    MeasureOptimize("geosphere 7 shuffled +overdraw", Shuffled(Sphere, 1), Options);
+
+    // Exact welding recovers the indexed mesh from a soup; the seam and cap
+    // rims of the cylinder only merge once UVs and normals are ignored
+    WeldOptions Exact;
+    MeasureWeld("geosphere 7 soup", Unindexed(Sphere), Exact);
+    MeasureWeld("geosphere 8 soup", Unindexed(Generator.CreateGeosphere(1.5f, 8)), Exact);
+    MeasureWeld("cylinder 512x256", Cylinder, Exact);
+
+    WeldOptions PositionOnly;
+    PositionOnly.PositionEpsilon = 1e-5f;
+    PositionOnly.NormalEpsilon = INFINITY;
+    PositionOnly.TangentEpsilon = INFINITY;
+    PositionOnly.UVEpsilon = INFINITY;
+    MeasureWeld("cylinder 512x256 position only", Cylinder, PositionOnly);
+}
+
+} // namespace Bench
+} // namespace Racoon
@@ -0,0 +1,123 @@
+#include "Bench.h"
+
+#include "PrimitivesGenerator.h"
+#include "VertexPacking.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+namespace Racoon {
+namespace Bench {
+
+namespace {
+
+const char* EncodingName(VertexEncoding Encoding)
+{
+    switch (Encoding)
+    {
+    case VertexEncoding::Full: return "full";
+    case VertexEncoding::Packed: return "packed";
+    case VertexEncoding::PackedQuantized: return "packed+quantized";
+    }
+    return "?";
+}
+
+float AngleDegrees(const XMFLOAT3& a, const XMFLOAT3& b)
+{
+    // atan2 of |a x b| and a.b stays accurate for tiny angles, where acos of the
+    // dot product alone would report ~0.03 degrees for identical vectors
+    const double cx = double(a.y) * b.z - double(a.z) * b.y;
+    const double cy = double(a.z) * b.x - double(a.x) * b.z;
+    const double cz = double(a.x) * b.y - double(a.y) * b.x;
+    const double Dot = double(a.x) * b.x + double(a.y) * b.y + double(a.z) * b.z;
+    return static_cast<float>(std::atan2(std::sqrt(cx * cx + cy * cy + cz * cz), Dot) * 180.0 / 3.14159265358979);
+}
+
+void ReportRoundTripError(const MeshData& Mesh, const PackedVertexStream& Stream)
+{
+    std::vector<Vertex> Decoded(Stream.VertexCount);
+    UnpackVertices(Stream, Decoded.data());
+
+    float MaxPosition = 0.f, MaxNormal = 0.f, MaxTangent = 0.f, MaxUV = 0.f;
+    for (size_t i = 0; i < Decoded.size(); ++i)
+    {
+        const Vertex& a = Mesh.Vertices[i];
+        const Vertex& b = Decoded[i];
+        MaxPosition = std::max({ MaxPosition, std::fabs(a.Position.x - b.Position.x),
+            std::fabs(a.Position.y - b.Position.y), std::fabs(a.Position.z - b.Position.z) });
+        MaxNormal = std::max(MaxNormal, AngleDegrees(a.Normal, b.Normal));
+        MaxTangent = std::max(MaxTangent, AngleDegrees(a.Tangent, b.Tangent));
+        MaxUV = std::max({ MaxUV, std::fabs(a.UV.x - b.UV.x), std::fabs(a.UV.y - b.UV.y) });
+    }
+    std::printf("%-44s %2u B/vertex, max error: pos %.2e, normal %.4f deg, tangent %.4f deg, uv %.2e\n", "",
+        Stream.Stride, MaxPosition, MaxNormal, MaxTangent, MaxUV);
+}
+
+} // namespace
+
+void RunPackingBenchmarks()
+{
+    PrimitivesGenerator Generator;
+    const MeshData Mesh = Generator.CreateGeosphere(1.5f, 7);
+    const uint64_t VertexCount = Mesh.Vertices.size();
+
+    for (VertexEncoding Encoding : { VertexEncoding::Full, VertexEncoding::Packed, VertexEncoding::PackedQuantized })
+    {
+        const std::string Name = EncodingName(Encoding);
+
+        Result Encode = Measure("PackVertices " + Name, 20, VertexCount, [&]() {
+            PackedVertexStream Stream = PackVertices(Mesh, Encoding);
+            DoNotOptimize(Stream);
+        });
+        Report(Encode, "verts");
+
+        const PackedVertexStream Stream = PackVertices(Mesh, Encoding);
+        std::vector<Vertex> Decoded(VertexCount);
+        Result Decode = Measure("UnpackVertices " + Name, 20, VertexCount, [&]() {
+            UnpackVertices(Stream, Decoded.data());
+            DoNotOptimize(Decoded);
+        });
+        Report(Decode, "verts");
+
+        ReportRoundTripError(Mesh, Stream);
+    }
+
+    // Index narrowing. A level 6 sphere has 40962 vertices, so it fits in 16 bits
+    MeshData Sphere = Generator.CreateGeosphere(1.5f, 6);
+    const uint64_t IndexCount = Sphere.Indices32.size();
+    std::vector<uint16_t> Narrowed(IndexCount);
+
+    Result Fits = Measure("FitsIndices16", 200, IndexCount, [&]() {
+        const bool Result = Sphere.FitsIndices16();
+        DoNotOptimize(Result);
+    });
+    Report(Fits, "indices");
+
+    Result Scalar = Measure("Narrow indices scalar", 200, IndexCount, [&]() {
+        for (size_t i = 0; i < IndexCount; ++i)
+            Narrowed[i] = static_cast<uint16_t>(Sphere.Indices32[i]);
+        DoNotOptimize(Narrowed);
+    });
+    Report(Scalar, "indices");
+
+    Result Simd = Measure("NarrowIndices16", 200, IndexCount, [&]() {
+        NarrowIndices16(Sphere.Indices32.data(), IndexCount, Narrowed.data());
+        DoNotOptimize(Narrowed);
+    });
+    Report(Simd, "indices");
+
+    Result Cached = Measure("GetIndices16 (cached)", 200, IndexCount, [&]() {
+        const auto& Indices16 = Sphere.GetIndices16();
+        DoNotOptimize(Indices16);
+    });
+    Report(Cached, "indices");
+
+    std::printf("%-44s index memory %llu B -> %llu B, narrowed copy %s\n", "",
+        static_cast<unsigned long long>(IndexCount * sizeof(uint32_t)),
+        static_cast<unsigned long long>(IndexCount * sizeof(uint16_t)),
+        std::equal(Narrowed.begin(), Narrowed.end(), Sphere.Indices32.begin()) ? "matches" : "MISMATCH");
+}
+
+} // namespace Bench
+} // namespace Racoon
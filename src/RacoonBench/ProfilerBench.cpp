@@ -0,0 +1,143 @@
+#include "Bench.h"
+
+#include "JobSystem.h"
+#include "Profiler.h"
+
+#include <atomic>
+#include <cstdio>
+#include <sstream>
+
+namespace Racoon {
+namespace Bench {
+
+namespace {
+
+// Spins for roughly Nanoseconds on the profiler's clock
+void BusyWait(const Profiler& Prof, uint64_t Nanoseconds)
+{
+    const uint64_t End = Prof.Now() + Nanoseconds;
+    while (Prof.Now() < End)
+    {
+    }
+}
+
+void PrintScope(const ScopeStats& Stats)
+{
+    std::printf("%-44s %-12s p50 %.3f p95 %.3f p99 %.3f max %.3f ms over %u frames, %.1f calls/frame\n", "",
+        Stats.Name, Stats.P50Ms, Stats.P95Ms, Stats.P99Ms, Stats.MaxMs, Stats.Frames, Stats.CallsPerFrame);
+}
+
+} // namespace
+
+void RunProfilerBenchmarks()
+{
+    const uint32_t Scopes = 100000;
+    {
+        // Big enough rings that nothing is dropped between EndFrames. One
+        // frame of history, so the frame's event array is warm after one iteration.
+        Profiler Prof(1, 128 * 1024);
+        // Includes draining the ring, which EndFrame does for every event
+        Result R = Measure("ProfileScope enabled + EndFrame", 20, Scopes, [&]() {
+            for (uint32_t i = 0; i < Scopes; ++i)
+                ProfileScope Scope("Empty", Prof);
+            Prof.EndFrame();
+        });
+        Report(R, "scopes");
+
+        Prof.SetEnabled(false);
+        R = Measure("ProfileScope disabled + EndFrame", 20, Scopes, [&]() {
+            for (uint32_t i = 0; i < Scopes; ++i)
+                ProfileScope Scope("Empty", Prof);
+            Prof.EndFrame();
+        });
+        Report(R, "scopes");
+    }
+
+    // 199 frames of 0.2 ms work with one 5 ms spike: the average barely
+    // moves, the max and p99 must show it
+    {
+        Profiler Prof(200);
+        for (uint32_t Frame = 0; Frame < 200; ++Frame)
+        {
+            {
+                ProfileScope Update("Update", Prof);
+                ProfileScope Inner("Simulate", Prof);
+                BusyWait(Prof, Frame == 150 ? 5000000 : 200000);
+            }
+            Prof.EndFrame();
+        }
+        std::vector<ScopeStats> Stats;
+        Prof.GetScopeStats(Stats);
+        std::printf("%-44s 200 frames, one 5 ms spike\n", "Spike frame");
+        for (const ScopeStats& Scope : Stats)
+            PrintScope(Scope);
+        std::printf("%-44s mean %.3f ms, spike visible in max: %s\n", "", Stats.back().MeanMs,
+            Stats.back().MaxMs > 4.0 && Stats.back().P50Ms < 1.0 ? "yes" : "NO");
+    }
+
+    // Every worker records into its own ring while EndFrame drains them. At
+    // least four threads, so the rings see concurrent use even on small machines.
+    {
+        Profiler Prof(64, 64 * 1024);
+        JobSystem Jobs(std::max(4u, std::thread::hardware_concurrency()));
+        const uint32_t Count = 4096;
+        std::atomic<uint32_t> Checksum{ 0 };
+        for (uint32_t Frame = 0; Frame < 64; ++Frame)
+        {
+            {
+                ProfileScope FrameScope("Frame work", Prof);
+                Jobs.ParallelFor(Count, 64, [&](uint32_t First, uint32_t Last) {
+                    ProfileScope Chunk("Chunk", Prof);
+                    uint32_t Sum = 0;
+                    for (uint32_t i = First; i < Last; ++i)
+                    {
+                        ProfileScope Item("Item", Prof);
+                        Sum += i;
+                    }
+                    Checksum.fetch_add(Sum, std::memory_order_relaxed);
+                });
+            }
+            Prof.EndFrame();
+        }
+
+        std::vector<ScopeStats> Stats;
+        Prof.GetScopeStats(Stats);
+        uint64_t Items = 0;
+        for (const ScopeStats& Scope : Stats)
+        {
+            PrintScope(Scope);
+            if (std::string(Scope.Name) == "Item")
+                Items = static_cast<uint64_t>(Scope.CallsPerFrame * Scope.Frames + 0.5);
+        }
+        std::printf("%-44s %llu of %u item scopes recorded, %llu dropped\n", "",
+            static_cast<unsigned long long>(Items), 64 * Count,
+            static_cast<unsigned long long>(Prof.GetDroppedEventCount()));
+
+        std::ostringstream Trace;
+        Result R = Measure("WriteChromeTrace 8 frames", 5, 8, [&]() {
+            Trace.str("");
+            Prof.WriteChromeTrace(Trace, 8);
+        });
+        Report(R, "frames");
+        const std::string Json = Trace.str();
+        size_t Events = 0;
+        for (size_t At = Json.find("\"ph\":\"X\""); At != std::string::npos; At = Json.find("\"ph\":\"X\"", At + 1))
+            ++Events;
+        std::printf("%-44s %zu KiB, %zu complete events\n", "", Json.size() / 1024, Events);
+    }
+
+    // A ring that fills up drops the newest events instead of blocking
+    {
+        Profiler Prof(4, 1024);
+        for (uint32_t i = 0; i < 1500; ++i)
+            ProfileScope Scope("Overflow", Prof);
+        Prof.EndFrame();
+        std::vector<ScopeStats> Stats;
+        Prof.GetScopeStats(Stats);
+        std::printf("%-44s 1500 scopes into a 1024 ring: %.0f kept, %llu dropped\n", "Overflow",
+            Stats.empty() ? 0.0 : Stats[0].CallsPerFrame, static_cast<unsigned long long>(Prof.GetDroppedEventCount()));
+    }
+}
+
+} // namespace Bench
+} // namespace Racoon
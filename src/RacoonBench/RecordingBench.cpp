@@ -0,0 +1,158 @@
+#include "Bench.h"
+
+#include "DrawRecorder.h"
+
+#include <cstdio>
+#include <cstring>
+#include <random>
+
+namespace Racoon {
+namespace Bench {
+
+namespace {
+
+// What the GPU would see for one draw: the pipeline state, constants and
+// index buffer bound at that point, and the draw arguments
+struct LoggedDraw
+{
+    uint16_t PipelineState;
+    PrimitiveTopology Topology;
+    BatchConstants Constants;
+    IndexFormat IndexWidth;
+    uint32_t IndexCount;
+    uint32_t InstanceCount;
+    uint32_t StartIndexLocation;
+    uint32_t BaseVertexLocation;
+};
+
+// Logs the effective state of every draw instead of talking to a GPU
+class MockCommandList final : public DrawCommandList
+{
+public:
+    void Begin() override
+    {
+        m_Draws.clear();
+        m_Commands = 0;
+    }
+
+    void SetPipelineState(uint16_t PipelineState, PrimitiveTopology Topology) override
+    {
+        m_PipelineState = PipelineState;
+        m_Topology = Topology;
+        ++m_Commands;
+    }
+
+    void SetBatchConstants(const BatchConstants& Constants) override
+    {
+        m_Constants = Constants;
+        ++m_Commands;
+    }
+
+    void SetIndexBuffer(IndexFormat Width) override
+    {
+        m_IndexWidth = Width;
+        ++m_Commands;
+    }
+
+    void DrawIndexedInstanced(uint32_t IndexCount, uint32_t InstanceCount, uint32_t StartIndexLocation,
+        uint32_t BaseVertexLocation) override
+    {
+        m_Draws.push_back({ m_PipelineState, m_Topology, m_Constants, m_IndexWidth, IndexCount, InstanceCount, StartIndexLocation, BaseVertexLocation });
+        ++m_Commands;
+    }
+
+    const std::vector<LoggedDraw>& GetDraws() const { return m_Draws; }
+    uint32_t GetCommandCount() const { return m_Commands; }
+
+private:
+    uint16_t m_PipelineState{ 0 };
+    PrimitiveTopology m_Topology{ PrimitiveTopology::TriangleList };
+    BatchConstants m_Constants{};
+    IndexFormat m_IndexWidth{ IndexFormat::Uint16 };
+    std::vector<LoggedDraw> m_Draws;
+    uint32_t m_Commands{ 0 };
+};
+
+std::vector<DrawBatch> MakeBatches(uint32_t Count)
+{
+    std::mt19937 Rng(13);
+    std::uniform_int_distribution<uint32_t> Small(1, 64);
+    std::uniform_real_distribution<float> Unit(0.f, 1.f);
+
+    std::vector<DrawBatch> Batches(Count);
+    uint32_t FirstInstance = 0;
+    for (uint32_t i = 0; i < Count; ++i)
+    {
+        DrawBatch& Batch = Batches[i];
+        // Runs of equal state and width, like a sorted queue
+        Batch.PipelineState = static_cast<uint16_t>(i / 5000);
+        Batch.PrimitiveType = (i / 1000) % 4 == 3 ? PrimitiveTopology::LineList : PrimitiveTopology::TriangleList;
+        Batch.IndexWidth = (i / 100) % 3 == 2 ? IndexFormat::Uint32 : IndexFormat::Uint16;
+        Batch.IndexCount = Small(Rng) * 3;
+        Batch.StartIndexLocation = i * 192;
+        Batch.BaseVertexLocation = i * 64;
+        Batch.Quantization.Offset = XMFLOAT3(Unit(Rng), Unit(Rng), Unit(Rng));
+        Batch.Quantization.Scale = XMFLOAT3(Unit(Rng), Unit(Rng), Unit(Rng));
+        Batch.FirstInstance = FirstInstance;
+        Batch.InstanceCount = Small(Rng);
+        FirstInstance += Batch.InstanceCount;
+    }
+    return Batches;
+}
+
+bool SameDraw(const LoggedDraw& a, const LoggedDraw& b)
+{
+    return a.PipelineState == b.PipelineState && a.Topology == b.Topology &&
+        std::memcmp(&a.Constants, &b.Constants, sizeof(BatchConstants)) == 0 &&
+        a.IndexWidth == b.IndexWidth && a.IndexCount == b.IndexCount && a.InstanceCount == b.InstanceCount &&
+        a.StartIndexLocation == b.StartIndexLocation && a.BaseVertexLocation == b.BaseVertexLocation;
+}
+
+} // namespace
+
+void RunRecordingBenchmarks()
+{
+    const uint32_t Count = 20000;
+    const std::vector<DrawBatch> Batches = MakeBatches(Count);
+
+    MockCommandList Reference;
+    Result R = Measure("RecordBatches 20000 batches, 1 list", 50, Count, [&]() {
+        RecordBatches(Batches.data(), Batches.size(), Reference);
+    });
+    Report(R, "batches");
+
+    JobSystem Jobs;
+    for (uint32_t MaxChunks : { 2u, 4u })
+    {
+        const ParallelDrawRecorder Recorder(&Jobs, MaxChunks);
+        const uint32_t ChunkCount = Recorder.GetChunkCount(Batches.size());
+        std::vector<MockCommandList> Lists(ChunkCount);
+        std::vector<DrawCommandList*> ListPointers;
+        for (MockCommandList& List : Lists)
+            ListPointers.push_back(&List);
+
+        char Name[64];
+        std::snprintf(Name, sizeof(Name), "ParallelDrawRecorder %u lists", ChunkCount);
+        R = Measure(Name, 50, Count, [&]() { Recorder.Record(Batches, ListPointers.data()); });
+        Report(R, "batches");
+
+        // Executed in order, the lists must draw exactly what the single list
+        // does. Each list rebinds its pipeline state and index buffer, so only
+        // compare per-draw state.
+        std::vector<LoggedDraw> Merged;
+        uint32_t Commands = 0;
+        for (const MockCommandList& List : Lists)
+        {
+            Merged.insert(Merged.end(), List.GetDraws().begin(), List.GetDraws().end());
+            Commands += List.GetCommandCount();
+        }
+        bool Same = Merged.size() == Reference.GetDraws().size();
+        for (size_t i = 0; Same && i < Merged.size(); ++i)
+            Same = SameDraw(Merged[i], Reference.GetDraws()[i]);
+        std::printf("%-44s %zu draws, %u commands (single list %u), matches single list: %s\n", "",
+            Merged.size(), Commands, Reference.GetCommandCount(), Same ? "yes" : "NO");
+    }
+}
+
+} // namespace Bench
+} // namespace Racoon
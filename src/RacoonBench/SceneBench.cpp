@@ -0,0 +1,214 @@
+#include "Bench.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <random>
+
+#include "DrawBatcher.h"
+#include "MeshRegistry.h"
+#include "PrimitivesGenerator.h"
+#include "RenderQueue.h"
+#include "RenderItem.h"
+
+namespace Racoon {
+namespace Bench {
+
+namespace {
+
+struct SceneGeometry
+{
+    std::vector<std::shared_ptr<RenderItem>> Objects;
+    std::vector<Vertex> AllVertices;
+    std::vector<uint32_t> AllIndices;
+};
+
+// Same steps Renderer::CreateGeometry takes per object: create the item,
+// place it, and append its mesh to the shared vertex/index arrays.
+SceneGeometry AssembleScene(const std::vector<std::shared_ptr<MeshData>>& Meshes, uint32_t ObjectCount,
+    TransformSystem& Transforms)
+{
+    SceneGeometry Scene;
+    Scene.Objects.reserve(ObjectCount);
+
+    for (uint32_t i = 0; i < ObjectCount; ++i)
+    {
+        const auto& Mesh = Meshes[i % Meshes.size()];
+        const float x = static_cast<float>(i % 100) * 3.f;
+        const float z = static_cast<float>(i / 100) * 3.f;
+
+        auto Object = std::make_shared<RenderItem>(Mesh, Transforms,
+            Transforms.Create(Trs::FromTranslation(XMFLOAT3(x, 0.f, z))));
+        Object->Index = i;
+        Object->IndexCount = Mesh->Indices32.size();
+        Object->BaseVertexLocation = static_cast<uint32_t>(Scene.AllVertices.size());
+        Object->StartIndexLocation = Scene.AllIndices.size();
+
+        Scene.AllVertices.insert(Scene.AllVertices.end(), Mesh->Vertices.begin(), Mesh->Vertices.end());
+        Scene.AllIndices.insert(Scene.AllIndices.end(), Mesh->Indices32.begin(), Mesh->Indices32.end());
+        Scene.Objects.push_back(std::move(Object));
+    }
+    return Scene;
+}
+
+// Same scene through MeshRegistry: each distinct mesh is stored once
+std::vector<std::shared_ptr<RenderItem>> RegisterScene(const std::vector<std::shared_ptr<MeshData>>& Meshes,
+    uint32_t ObjectCount, MeshRegistry& Registry, TransformSystem& Transforms)
+{
+    std::vector<std::shared_ptr<RenderItem>> Objects;
+    Objects.reserve(ObjectCount);
+
+    for (uint32_t i = 0; i < ObjectCount; ++i)
+    {
+        const float x = static_cast<float>(i % 100) * 3.f;
+        const float z = static_cast<float>(i / 100) * 3.f;
+
+        auto Object = std::make_shared<RenderItem>(Meshes[i % Meshes.size()], Transforms,
+            Transforms.Create(Trs::FromTranslation(XMFLOAT3(x, 0.f, z))));
+        Object->Index = i;
+        Registry.Register(*Object);
+        Objects.push_back(std::move(Object));
+    }
+    return Objects;
+}
+
+} // namespace
+
+void RunSceneBenchmarks()
+{
+    PrimitivesGenerator Generator;
+    const std::vector<std::shared_ptr<MeshData>> Meshes = {
+        std::make_shared<MeshData>(Generator.CreateCube()),
+        std::make_shared<MeshData>(Generator.CreateCylinder(1.f, 1.5f, 2.f, 8, 2)),
+        std::make_shared<MeshData>(Generator.CreateGeosphere(1.5f, 1))
+    };
+
+    for (uint32_t ObjectCount : { 1000u, 10000u, 100000u })
+    {
+        const uint32_t Iterations = ObjectCount >= 100000u ? 5 : 50;
+        Result R = Measure("AssembleScene " + std::to_string(ObjectCount) + " items", Iterations, ObjectCount,
+            [&]() {
+                TransformSystem Transforms;
+                SceneGeometry Scene = AssembleScene(Meshes, ObjectCount, Transforms);
+                DoNotOptimize(Scene);
+            });
+        Report(R, "items");
+    }
+
+    // 10k objects over 50 distinct meshes should store 50 meshes
+    std::vector<std::shared_ptr<MeshData>> Distinct;
+    for (uint32_t i = 0; i < 50; ++i)
+        Distinct.push_back(std::make_shared<MeshData>(Generator.CreateCylinder(1.f, 1.5f, 2.f, 8 + i, 2)));
+
+    MeshRegistry Registry;
+    Result R = Measure("RegisterScene 10000 items, 50 meshes", 50, 10000, [&]() {
+        Registry = MeshRegistry();
+        TransformSystem Transforms;
+        auto Objects = RegisterScene(Distinct, 10000, Registry, Transforms);
+        DoNotOptimize(Objects);
+    });
+    Report(R, "items");
+
+    const uint64_t RegistryBytes = Registry.GetVertexData().size() +
+        Registry.GetIndices16().size() * sizeof(uint16_t) + Registry.GetIndices32().size() * sizeof(uint32_t);
+    TransformSystem Transforms;
+    const SceneGeometry Naive = AssembleScene(Distinct, 10000, Transforms);
+    const uint64_t NaiveBytes = Naive.AllVertices.size() * sizeof(Vertex) + Naive.AllIndices.size() * sizeof(uint32_t);
+    std::printf("%-44s %u meshes stored, %llu KiB arena (copy per item: %llu KiB)\n", "",
+        Registry.GetMeshCount(), static_cast<unsigned long long>(RegistryBytes / 1024),
+        static_cast<unsigned long long>(NaiveBytes / 1024));
+
+    // Per-frame batching of the same scene: one draw per distinct mesh
+    const auto Objects = RegisterScene(Distinct, 10000, Registry, Transforms);
+    DrawBatcher Batcher;
+    R = Measure("DrawBatcher::Build 10000 items", 200, Objects.size(), [&]() {
+        Batcher.Build(Objects);
+        DoNotOptimize(Batcher);
+    });
+    Report(R, "items");
+    std::printf("%-44s %zu items -> %zu instanced draws\n", "",
+        Objects.size(), Batcher.GetBatches().size());
+
+    // Sorting a frame's items: radix sort on 64-bit keys vs std::sort on the shared_ptrs
+    {
+        std::mt19937 Rng(7);
+        std::uniform_real_distribution<float> Coordinate(-500.f, 500.f);
+        std::vector<std::shared_ptr<RenderItem>> Items;
+        for (uint32_t i = 0; i < 100000; ++i)
+        {
+            // Braces keep the draws in order
+            const XMFLOAT3 Position{ Coordinate(Rng), Coordinate(Rng), Coordinate(Rng) };
+            auto Item = std::make_shared<RenderItem>(Distinct[i % Distinct.size()], Transforms,
+                Transforms.Create(Trs::FromTranslation(Position)));
+            Item->MeshIndex = i % 50;
+            Item->PipelineState = static_cast<uint16_t>(i % 7);
+            Item->Pass = i % 10 == 0 ? RenderPass::Transparent : RenderPass::Opaque;
+            Items.push_back(std::move(Item));
+        }
+        const math::Matrix4 View = math::Matrix4::identity();
+
+        RenderQueue Queue;
+        R = Measure("RenderQueue::Build 100000 items", 50, Items.size(), [&]() {
+            Queue.Build(Items, View);
+            DoNotOptimize(Queue);
+        });
+        Report(R, "items");
+
+        std::vector<SortEntry> Entries(Items.size()), Scratch;
+        std::mt19937_64 KeyRng(3);
+        for (uint32_t i = 0; i < Entries.size(); ++i)
+            Entries[i] = MakeSortEntry(KeyRng() >> (64 - SortKeyBits), i);
+        R = Measure("RadixSort 100000 random keys", 50, Entries.size(), [&]() {
+            std::vector<SortEntry> Sorted = Entries;
+            RadixSort(Sorted, Scratch);
+            DoNotOptimize(Sorted);
+        });
+        Report(R, "keys");
+
+        R = Measure("std::sort 100000 shared_ptr items", 10, Items.size(), [&]() {
+            auto Sorted = Items;
+            std::sort(Sorted.begin(), Sorted.end(), [](const auto& a, const auto& b) {
+                if (a->PipelineState != b->PipelineState)
+                    return a->PipelineState < b->PipelineState;
+                return a->GetWorldPosition().getZ() > b->GetWorldPosition().getZ();
+            });
+            DoNotOptimize(Sorted);
+        });
+        Report(R, "items");
+
+        // Check the order: opaque by state then nearest first, transparent farthest first
+        auto Depth = [&](uint32_t Item) { return -Items[Item]->GetWorldPosition().getZ(); };
+        bool Ordered = true;
+        const auto& Opaque = Queue.GetOpaque();
+        for (size_t i = 1; i < Opaque.size(); ++i)
+        {
+            const RenderItem& a = *Items[Opaque[i - 1]];
+            const RenderItem& b = *Items[Opaque[i]];
+            // Depth is quantized to about 1%, so near-equal depths may swap
+            if (a.PipelineState == b.PipelineState && a.MeshIndex == b.MeshIndex)
+                Ordered &= Depth(Opaque[i - 1]) <= std::max(Depth(Opaque[i]), 0.f) * 1.01f;
+            else
+                Ordered &= a.PipelineState < b.PipelineState ||
+                    (a.PipelineState == b.PipelineState && a.MeshIndex < b.MeshIndex);
+        }
+        const auto& Transparent = Queue.GetTransparent();
+        for (size_t i = 1; i < Transparent.size(); ++i)
+            Ordered &= std::max(Depth(Transparent[i - 1]), 0.f) * 1.01f >= Depth(Transparent[i]);
+        std::printf("%-44s %zu opaque, %zu transparent, order %s\n", "",
+            Opaque.size(), Transparent.size(), Ordered ? "ok" : "WRONG");
+    }
+
+    // Dropping every other mesh leaves holes until Compact
+    for (uint32_t i = 0; i < Distinct.size(); i += 2)
+    {
+        const MeshHandle Handle = Registry.Find(Distinct[i].get());
+        while (Registry.Find(Distinct[i].get()).IsValid())
+            Registry.Release(Handle);
+    }
+    const uint32_t Wasted = Registry.GetWastedVertices();
+    Registry.Compact();
+    std::printf("%-44s %u meshes after release, %u vertices reclaimed, %u vertices live\n", "Compact",
+        Registry.GetMeshCount(), Wasted, Registry.GetVertexCount());
+}
+
+} // namespace Bench
+} // namespace Racoon
@@ -0,0 +1,180 @@
+#include "Bench.h"
+
+#include "ContentHash.h"
+#include "JobSystem.h"
+#include "MappedFile.h"
+#include "ShaderCache.h"
+
+#include <atomic>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+
+namespace Racoon {
+namespace Bench {
+
+namespace {
+
+constexpr uint32_t SourceCount = 24;
+
+// Stands in for DXC: reads the source, burns CPU for about as long as a
+// small shader takes to compile and returns bytes derived from what it was
+// given. Fails like a compiler when the entry point is not in the file.
+class StubCompiler : public ShaderCompiler
+{
+public:
+    std::string GetVersion() const override { return "stub 1"; }
+
+    bool Compile(const std::string& SourceDir, const ShaderDesc& Desc, std::vector<uint8_t>& Bytecode,
+        std::string& Error) override
+    {
+        m_Calls.fetch_add(1, std::memory_order_relaxed);
+        MappedFile Source;
+        if (!Source.Open((std::filesystem::path(SourceDir) / Desc.File).string(), Error))
+            return false;
+        const std::string Text(reinterpret_cast<const char*>(Source.GetData()), Source.GetSize());
+        if (Text.find(Desc.EntryPoint + "(") == std::string::npos)
+        {
+            Error = "entry point " + Desc.EntryPoint + " not found";
+            return false;
+        }
+
+        ContentHasher Hasher;
+        Hasher.Add(Text).Add(Desc.EntryPoint).Add(Desc.Profile);
+        for (const auto& Define : Desc.Defines)
+            Hasher.Add(Define.first).Add(Define.second);
+        uint64_t Hash = Hasher.Get();
+        for (uint32_t i = 0; i < 200000; ++i)
+            Hash = HashBytes(Text.data(), Text.size(), Hash);
+        Bytecode.resize(256);
+        for (size_t i = 0; i < Bytecode.size(); ++i)
+            Bytecode[i] = static_cast<uint8_t>(Hash >> (i % 8 * 8));
+        return true;
+    }
+
+    uint32_t GetCalls() const { return m_Calls.load(); }
+
+private:
+    std::atomic<uint32_t> m_Calls{ 0 };
+};
+
+void WriteText(const std::filesystem::path& Path, const std::string& Text)
+{
+    std::ofstream(Path, std::ios::binary | std::ios::trunc) << Text;
+}
+
+// A shared header like shaders_semantics.hlsl, a second header built on it,
+// and shaders that include one, the other or nothing. The include in the
+// comment must not count.
+void WriteSources(const std::filesystem::path& Directory)
+{
+    std::filesystem::create_directories(Directory);
+    WriteText(Directory / "semantics.hlsl", "struct VSout\n{\n    float4 posH : SV_POSITION;\n};\n");
+    WriteText(Directory / "lighting.hlsl",
+        "#include \"semantics.hlsl\"\nfloat3 Light(float3 n) { return saturate(n.y); }\n");
+    for (uint32_t i = 0; i < SourceCount; ++i)
+    {
+        const char* Include = i % 3 == 0 ? "#include \"semantics.hlsl\"\n"
+            : i % 3 == 1 ? "  #  include <lighting.hlsl> // lit\n"
+                         : "/*\n#include \"semantics.hlsl\"\n*/\n";
+        WriteText(Directory / ("shader" + std::to_string(i) + ".hlsl"),
+            std::string(Include) + "float4 Main(float4 p : POSITION) : SV_POSITION { return p * " +
+                std::to_string(i) + "; }\n");
+    }
+}
+
+std::vector<ShaderDesc> MakeDescs()
+{
+    std::vector<ShaderDesc> Shaders;
+    for (uint32_t i = 0; i < SourceCount; ++i)
+    {
+        ShaderDesc Desc{ "shader" + std::to_string(i) + ".hlsl", "Main", "vs_6_0", {} };
+        Shaders.push_back(Desc);
+        Desc.Defines["PACKED_VERTICES"] = "1";
+        Shaders.push_back(Desc);
+    }
+    return Shaders;
+}
+
+} // namespace
+
+void RunShaderBenchmarks()
+{
+    const std::filesystem::path Root = std::filesystem::temp_directory_path() / "RacoonBenchShaders";
+    const std::string SourceDir = (Root / "src").string();
+    const std::string CacheDir = (Root / "cache").string();
+    std::filesystem::remove_all(Root);
+    WriteSources(SourceDir);
+    const std::vector<ShaderDesc> Shaders = MakeDescs();
+    const uint32_t Count = static_cast<uint32_t>(Shaders.size());
+
+    StubCompiler Compiler;
+    JobSystem Jobs(std::max(4u, std::thread::hardware_concurrency()));
+    std::vector<ShaderBlob> Blobs;
+    std::string Error;
+
+    Report(Measure("shaders/cold build, serial", 3, Count, [&]
+        {
+            std::filesystem::remove_all(CacheDir);
+            ShaderCache Cache(SourceDir, CacheDir, Compiler);
+            Cache.Build(Shaders, Blobs, Error);
+        }), "shaders");
+    char Name[64];
+    std::snprintf(Name, sizeof(Name), "shaders/cold build, %u threads", Jobs.GetThreadCount());
+    Report(Measure(Name, 3, Count, [&]
+        {
+            std::filesystem::remove_all(CacheDir);
+            ShaderCache Cache(SourceDir, CacheDir, Compiler, &Jobs);
+            Cache.Build(Shaders, Blobs, Error);
+        }), "shaders");
+    // A new session: keys are hashed from the sources, bytecode read from disk
+    Report(Measure("shaders/warm start from disk", 20, Count, [&]
+        {
+            ShaderCache Cache(SourceDir, CacheDir, Compiler, &Jobs);
+            Cache.Build(Shaders, Blobs, Error);
+        }), "shaders");
+
+    ShaderCache Cache(SourceDir, CacheDir, Compiler, &Jobs);
+    Cache.Build(Shaders, Blobs, Error);
+    std::vector<ShaderBlob> Before = Blobs;
+    Report(Measure("shaders/rebuild in session", 100, Count, [&]
+        {
+            Cache.Build(Shaders, Blobs, Error);
+        }), "shaders");
+
+    // Editing a header recompiles exactly the shaders that include it,
+    // directly or through the other header: two thirds of the sources
+    auto Edit = [&](const std::string& File, uint32_t Expected) {
+        std::ofstream(std::filesystem::path(SourceDir) / File, std::ios::app) << "// edited\n";
+        const size_t Affected = Cache.OnFileChanged(File).size();
+        const uint32_t CallsBefore = Compiler.GetCalls();
+        const bool Built = Cache.Build(Shaders, Blobs, Error);
+        uint32_t Changed = 0;
+        for (uint32_t i = 0; i < Count; ++i)
+            Changed += Blobs[i] != Before[i];
+        std::printf("%-44s edit %s: %zu files affected, recompiled %u of %u (expected %u), %u new blobs, "
+            "%s\n", "", File.c_str(), Affected, Compiler.GetCalls() - CallsBefore, Count, Expected, Changed,
+            Built ? "ok" : Error.c_str());
+        Before = Blobs;
+    };
+    const uint32_t Including = 2 * (SourceCount - SourceCount / 3);
+    Edit("semantics.hlsl", Including);
+    Edit("shader2.hlsl", 2);
+
+    // A broken shader fails on its own; the rest still build
+    ShaderDesc Broken{ "shader0.hlsl", "Missing", "ps_6_0", {} };
+    std::vector<ShaderDesc> WithBroken = Shaders;
+    WithBroken.push_back(Broken);
+    const bool Built = Cache.Build(WithBroken, Blobs, Error);
+    uint32_t Missing = 0;
+    for (const ShaderBlob& Blob : Blobs)
+        Missing += !Blob;
+    std::printf("%-44s broken entry point refused: %s, other shaders built: %s\n", "", Built ? "NO" : "yes",
+        Missing == 1 ? "yes" : "NO");
+
+    std::filesystem::remove_all(Root);
+}
+
+} // namespace Bench
+} // namespace Racoon
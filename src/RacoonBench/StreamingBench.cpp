@@ -0,0 +1,181 @@
+#include "Bench.h"
+
+#include "GeometryStreamer.h"
+#include "MeshOptimizer.h"
+#include "MeshRegistry.h"
+#include "PrimitivesGenerator.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+namespace Racoon {
+namespace Bench {
+
+namespace {
+
+constexpr uint32_t MeshCount = 48;
+
+MeshData CreateBenchMesh(uint32_t Index)
+{
+    PrimitivesGenerator Generator;
+    MeshData Mesh = Index % 4 == 2 ? Generator.CreateCylinder(1.f, 0.5f, 2.f, 256, 64)
+                                   : Generator.CreateGeosphere(1.f + Index * 0.01f, 5);
+    OptimizeMesh(Mesh);
+    return Mesh;
+}
+
+struct StreamRun
+{
+    double FirstFrameMs{ 0 };
+    double CompleteMs{ 0 };
+    double MaxFrameMs{ 0 };
+    double MedianFrameMs{ 0 };
+    uint32_t Frames{ 0 };
+    bool Matches{ false };
+};
+
+// The renderer's per frame streaming step against CPU stand-ins for the GPU
+// buffers. A short sleep per frame stands in for waiting on the swap chain.
+StreamRun RunStreaming(uint64_t Budget)
+{
+    using Clock = std::chrono::steady_clock;
+
+    // Allocated up front like the renderer's buffers
+    const uint64_t MB = 1024 * 1024;
+    const uint64_t Capacities[GeometryArenaCount] = { 256 * MB, 32 * MB, 64 * MB };
+    std::vector<uint8_t> Gpu[GeometryArenaCount];
+    for (uint32_t i = 0; i < GeometryArenaCount; ++i)
+        Gpu[i].resize(Capacities[i]);
+
+    // The renderer reserves the arenas from the glTF accessors; here one
+    // mesh of each shape gives the sizes
+    uint64_t Elements[GeometryArenaCount] = {};
+    {
+        const MeshData Sphere = CreateBenchMesh(0);
+        const MeshData Cylinder = CreateBenchMesh(2);
+        for (uint32_t i = 0; i < MeshCount; ++i)
+        {
+            const MeshData& Mesh = i % 4 == 2 ? Cylinder : Sphere;
+            Elements[0] += Mesh.Vertices.size();
+            Elements[Mesh.Vertices.size() <= 0x10000u ? 1 : 2] += Mesh.Indices32.size();
+        }
+    }
+
+    const auto Start = Clock::now();
+
+    GeometryStreamerOptions Options;
+    Options.Encoding = VertexEncoding::Packed;
+    GeometryStreamer Streamer(Options);
+    for (uint32_t i = 0; i < MeshCount; ++i)
+    {
+        Streamer.Request(i, [i](MeshData& Mesh, std::string&) {
+            Mesh = CreateBenchMesh(i);
+            return true;
+        });
+    }
+
+    MeshRegistry Registry(Options.Encoding);
+    Registry.Reserve(static_cast<uint32_t>(Elements[0]), static_cast<uint32_t>(Elements[1]),
+        static_cast<uint32_t>(Elements[2]));
+    ArenaResidency Residency(Registry.GetVertexStride(), Capacities);
+    std::vector<MeshRange> Waiting;
+    uint32_t Resident = 0;
+
+    auto Sizes = [&](uint64_t (&Out)[GeometryArenaCount]) {
+        Out[0] = Registry.GetVertexData().size();
+        Out[1] = Registry.GetIndices16().size() * sizeof(uint16_t);
+        Out[2] = Registry.GetIndices32().size() * sizeof(uint32_t);
+    };
+    auto Data = [&](GeometryArena Arena) -> const uint8_t* {
+        switch (Arena)
+        {
+        case GeometryArena::Vertices: return Registry.GetVertexData().data();
+        case GeometryArena::Indices16: return reinterpret_cast<const uint8_t*>(Registry.GetIndices16().data());
+        default: return reinterpret_cast<const uint8_t*>(Registry.GetIndices32().data());
+        }
+    };
+
+    StreamRun Run;
+    std::vector<double> FrameMs;
+    while (Resident < MeshCount)
+    {
+        const auto FrameStart = Clock::now();
+        uint64_t ArenaSizes[GeometryArenaCount];
+        StreamedMesh Streamed;
+        for (;;)
+        {
+            Sizes(ArenaSizes);
+            if (Residency.GetBacklog(ArenaSizes) >= 2 * Budget || !Streamer.TryPop(Streamed))
+                break;
+            const MeshHandle Handle = Registry.Register(Streamed.Mesh, Streamed.Vertices);
+            Waiting.push_back(Registry.GetRange(Handle));
+        }
+        Sizes(ArenaSizes);
+        Residency.Advance(ArenaSizes, Budget, [&](GeometryArena Arena, uint64_t Offset, uint64_t Size) {
+            std::memcpy(Gpu[static_cast<uint32_t>(Arena)].data() + Offset, Data(Arena) + Offset, Size);
+        });
+        for (size_t i = 0; i < Waiting.size();)
+        {
+            if (!Residency.IsResident(Waiting[i]))
+            {
+                ++i;
+                continue;
+            }
+            Waiting[i] = Waiting.back();
+            Waiting.pop_back();
+            ++Resident;
+        }
+        const auto FrameEnd = Clock::now();
+        FrameMs.push_back(std::chrono::duration<double, std::milli>(FrameEnd - FrameStart).count());
+        if (FrameMs.size() == 1)
+            Run.FirstFrameMs = std::chrono::duration<double, std::milli>(FrameEnd - Start).count();
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+    Run.CompleteMs = std::chrono::duration<double, std::milli>(Clock::now() - Start).count();
+
+    Run.Frames = static_cast<uint32_t>(FrameMs.size());
+    Run.MaxFrameMs = *std::max_element(FrameMs.begin(), FrameMs.end());
+    std::nth_element(FrameMs.begin(), FrameMs.begin() + FrameMs.size() / 2, FrameMs.end());
+    Run.MedianFrameMs = FrameMs[FrameMs.size() / 2];
+
+    // What reached the GPU is exactly what the registry holds
+    uint64_t ArenaSizes[GeometryArenaCount];
+    Sizes(ArenaSizes);
+    Run.Matches = true;
+    for (uint32_t i = 0; i < GeometryArenaCount; ++i)
+    {
+        const GeometryArena Arena = static_cast<GeometryArena>(i);
+        Run.Matches = Run.Matches && Residency.GetResidentBytes(Arena) == ArenaSizes[i] &&
+            (ArenaSizes[i] == 0 || std::memcmp(Gpu[i].data(), Data(Arena), ArenaSizes[i]) == 0);
+    }
+    return Run;
+}
+
+} // namespace
+
+void RunStreamingBenchmarks()
+{
+    // Everything before the first frame, as OnCreate used to do it
+    Report(Measure("streaming/synchronous build + copy", 3, MeshCount, [&]
+        {
+            MeshRegistry Registry(VertexEncoding::Packed);
+            for (uint32_t i = 0; i < MeshCount; ++i)
+                Registry.Register(std::make_shared<MeshData>(CreateBenchMesh(i)));
+            std::vector<uint8_t> Gpu(Registry.GetVertexData());
+            DoNotOptimize(Gpu);
+        }), "meshes");
+
+    for (uint64_t BudgetMB : { 1u, 4u, 16u })
+    {
+        const StreamRun Run = RunStreaming(BudgetMB * 1024 * 1024);
+        std::printf("%-44s budget %2u MB: first frame %.2f ms, all resident after %u frames / %.0f ms\n", "",
+            static_cast<uint32_t>(BudgetMB), Run.FirstFrameMs, Run.Frames, Run.CompleteMs);
+        std::printf("%-44s   render thread per frame: median %.3f ms, max %.3f ms, GPU copy matches: %s\n", "",
+            Run.MedianFrameMs, Run.MaxFrameMs, Run.Matches ? "yes" : "NO");
+    }
+}
+
+} // namespace Bench
+} // namespace Racoon
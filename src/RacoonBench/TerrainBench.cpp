@@ -0,0 +1,391 @@
+#include "Bench.h"
+
+#include "JobSystem.h"
+#include "Terrain.h"
+#include "TerrainHeights.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace Racoon {
+namespace Bench {
+
+namespace {
+
+// Sample points on a grid, SoA in batches of four
+struct SamplePoints
+{
+    std::vector<XMFLOAT4A> X;
+    std::vector<XMFLOAT4A> Z;
+};
+
+SamplePoints MakeSamplePoints(uint32_t Side, float Spacing)
+{
+    SamplePoints Points;
+    for (uint32_t Row = 0; Row < Side; ++Row)
+    {
+        for (uint32_t Column = 0; Column < Side; Column += 4)
+        {
+            Points.X.emplace_back(Column * Spacing, (Column + 1) * Spacing, (Column + 2) * Spacing,
+                (Column + 3) * Spacing);
+            Points.Z.emplace_back(Row * Spacing, Row * Spacing, Row * Spacing, Row * Spacing);
+        }
+    }
+    return Points;
+}
+
+// Largest difference between the two paths of a source, 0 when they agree bit for bit
+float CompareSamplePaths(const TerrainHeightSource& Source, const SamplePoints& Points)
+{
+    float Largest = 0.f;
+    for (size_t b = 0; b < Points.X.size(); ++b)
+    {
+        XMFLOAT4A Heights;
+        XMStoreFloat4A(&Heights, Source.SampleHeights4(XMLoadFloat4A(&Points.X[b]), XMLoadFloat4A(&Points.Z[b])));
+        for (uint32_t Lane = 0; Lane < 4; ++Lane)
+        {
+            const float Scalar = Source.SampleHeight((&Points.X[b].x)[Lane], (&Points.Z[b].x)[Lane]);
+            Largest = std::max(Largest, std::fabs(Scalar - (&Heights.x)[Lane]));
+        }
+    }
+    return Largest;
+}
+
+// Every variant of every level must cover the whole chunk with triangles
+// wound the same way, whatever its stitched sides
+void CheckVariants(const Terrain& Ground, const TerrainOptions& Options)
+{
+    const uint32_t Side = Options.ChunkQuads + 1;
+    const std::vector<uint16_t>& Indices = Ground.GetIndices();
+    uint32_t Covering = 0;
+    uint32_t Flipped = 0;
+    uint64_t Triangles = 0;
+    for (uint32_t Lod = 0; Lod < Options.LodCount; ++Lod)
+    {
+        for (uint32_t Mask = 0; Mask < 16; ++Mask)
+        {
+            const TerrainIndexRange& Range = Ground.GetIndexRange(Lod, Mask);
+            double Area = 0.0;
+            for (uint32_t i = Range.StartIndex; i < Range.StartIndex + Range.IndexCount; i += 3)
+            {
+                const int32_t Ax = Indices[i] % Side, Az = Indices[i] / Side;
+                const int32_t Bx = Indices[i + 1] % Side, Bz = Indices[i + 1] / Side;
+                const int32_t Cx = Indices[i + 2] % Side, Cz = Indices[i + 2] / Side;
+                const int32_t Twice = (Bx - Ax) * (Cz - Az) - (Bz - Az) * (Cx - Ax);
+                Flipped += Twice <= 0;
+                Area += 0.5 * Twice;
+            }
+            Covering += Area == double(Options.ChunkQuads) * Options.ChunkQuads;
+            Triangles += Range.IndexCount / 3;
+        }
+    }
+    std::printf("%-44s %u index variants, %zu indices shared by every chunk: %u cover the chunk, %u triangles "
+        "flipped of %llu\n", "", Options.LodCount * 16, Indices.size(), Covering, Flipped,
+        static_cast<unsigned long long>(Triangles));
+}
+
+uint64_t PositionKey(const XMFLOAT3& Position)
+{
+    uint32_t Bits[3];
+    std::memcpy(Bits, &Position, sizeof(Bits));
+    return (uint64_t(Bits[0]) * 73856093u) ^ (uint64_t(Bits[1]) << 21) ^ (uint64_t(Bits[2]) << 42) ^ Bits[2];
+}
+
+// Welds the drawn triangles of every resident chunk by position and looks
+// for open edges. Only sides without a resident neighbour may be open;
+// anything else is a crack. Shared vertices must also agree on normals.
+void CheckSeams(const Terrain& Ground, const TerrainOptions& Options)
+{
+    const std::vector<TerrainDraw>& Draws = Ground.GetDraws();
+    std::unordered_map<uint64_t, uint32_t> LodOfChunk;
+    for (const TerrainDraw& Draw : Draws)
+        LodOfChunk[uint64_t(uint32_t(Draw.ChunkX)) << 32 | uint32_t(Draw.ChunkZ)] = Draw.Lod;
+    auto FindLod = [&](int32_t X, int32_t Z) {
+        const auto Found = LodOfChunk.find(uint64_t(uint32_t(X)) << 32 | uint32_t(Z));
+        return Found == LodOfChunk.end() ? -1 : int32_t(Found->second);
+    };
+
+    const uint32_t Quads = Options.ChunkQuads;
+    std::unordered_map<uint64_t, uint32_t> Welded;
+    std::unordered_map<uint64_t, uint32_t> NormalBits;
+    std::unordered_map<uint64_t, uint32_t> EdgeDraw;
+    std::vector<Vertex> Vertices(Ground.GetVerticesPerChunk());
+    uint32_t NormalMismatches = 0;
+    uint32_t LevelJumps = 0;
+    uint32_t Stitched = 0;
+    uint32_t Histogram[Terrain::MaxLods] = {};
+    for (uint32_t d = 0; d < Draws.size(); ++d)
+    {
+        const TerrainDraw& Draw = Draws[d];
+        ++Histogram[Draw.Lod];
+        Stitched += Draw.StitchMask != 0;
+        for (uint32_t Edge = 0; Edge < 4; ++Edge)
+        {
+            const int32_t Neighbour = FindLod(Draw.ChunkX + (Edge == 1) - (Edge == 0),
+                Draw.ChunkZ + (Edge == 3) - (Edge == 2));
+            LevelJumps += Neighbour >= 0 && std::abs(Neighbour - int32_t(Draw.Lod)) > 1;
+        }
+
+        PackedVertexStream Stream;
+        Stream.Encoding = Options.Encoding;
+        Stream.Stride = Ground.GetVertexStride();
+        Stream.VertexCount = Ground.GetVerticesPerChunk();
+        const uint8_t* Data = Ground.GetVertexData().data() + size_t(Draw.BaseVertex) * Stream.Stride;
+        Stream.Data.assign(Data, Data + size_t(Stream.VertexCount) * Stream.Stride);
+        UnpackVertices(Stream, Vertices.data());
+
+        std::vector<uint32_t> Ids(Vertices.size());
+        for (size_t v = 0; v < Vertices.size(); ++v)
+        {
+            const uint64_t Key = PositionKey(Vertices[v].Position);
+            Ids[v] = Welded.emplace(Key, static_cast<uint32_t>(Welded.size())).first->second;
+            uint32_t Normal[3];
+            std::memcpy(Normal, &Vertices[v].Normal, sizeof(Normal));
+            const uint32_t Bits = Normal[0] * 31u ^ Normal[1] * 131u ^ Normal[2];
+            NormalMismatches += NormalBits.emplace(Key, Bits).first->second != Bits;
+        }
+
+        const uint16_t* Indices = Ground.GetIndices().data() + Draw.StartIndex;
+        for (uint32_t i = 0; i < Draw.IndexCount; i += 3)
+        {
+            for (uint32_t k = 0; k < 3; ++k)
+            {
+                const uint32_t A = Ids[Indices[i + k]];
+                const uint32_t B = Ids[Indices[i + (k + 1) % 3]];
+                EdgeDraw.emplace(uint64_t(A) << 32 | B, d);
+            }
+        }
+    }
+
+    // Grid coordinates of the welded vertices, to tell borders from cracks
+    std::vector<XMFLOAT3> Positions(Welded.size());
+    for (const TerrainDraw& Draw : Draws)
+    {
+        PackedVertexStream Stream;
+        Stream.Encoding = Options.Encoding;
+        Stream.Stride = Ground.GetVertexStride();
+        Stream.VertexCount = Ground.GetVerticesPerChunk();
+        const uint8_t* Data = Ground.GetVertexData().data() + size_t(Draw.BaseVertex) * Stream.Stride;
+        Stream.Data.assign(Data, Data + size_t(Stream.VertexCount) * Stream.Stride);
+        UnpackVertices(Stream, Vertices.data());
+        for (const Vertex& V : Vertices)
+            Positions[Welded[PositionKey(V.Position)]] = V.Position;
+    }
+
+    uint32_t Border = 0;
+    uint32_t Cracks = 0;
+    for (const auto& Entry : EdgeDraw)
+    {
+        const uint64_t Edge = Entry.first;
+        if (EdgeDraw.count(Edge << 32 | Edge >> 32))
+            continue;
+        const TerrainDraw& Draw = Draws[Entry.second];
+        const XMFLOAT3& A = Positions[Edge >> 32];
+        const XMFLOAT3& B = Positions[uint32_t(Edge)];
+        auto Local = [&](float World, int32_t Chunk) {
+            return int32_t(std::lround(World / Options.SampleSpacing)) - Chunk * int32_t(Quads);
+        };
+        const int32_t Ac = Local(A.x, Draw.ChunkX), Ar = Local(A.z, Draw.ChunkZ);
+        const int32_t Bc = Local(B.x, Draw.ChunkX), Br = Local(B.z, Draw.ChunkZ);
+        const bool Open = (Ac == 0 && Bc == 0 && FindLod(Draw.ChunkX - 1, Draw.ChunkZ) < 0) ||
+            (Ac == int32_t(Quads) && Bc == int32_t(Quads) && FindLod(Draw.ChunkX + 1, Draw.ChunkZ) < 0) ||
+            (Ar == 0 && Br == 0 && FindLod(Draw.ChunkX, Draw.ChunkZ - 1) < 0) ||
+            (Ar == int32_t(Quads) && Br == int32_t(Quads) && FindLod(Draw.ChunkX, Draw.ChunkZ + 1) < 0);
+        Border += Open;
+        Cracks += !Open;
+    }
+
+    std::printf("%-44s %zu chunks, levels", "", Draws.size());
+    for (uint32_t Lod = 0; Lod < Options.LodCount; ++Lod)
+        std::printf(" %u", Histogram[Lod]);
+    std::printf(", %u stitched: %u open edges on the outer border, %u cracks, %u neighbours more than one "
+        "level apart, %u shared vertices with different normals\n", Stitched, Border, Cracks, LevelJumps,
+        NormalMismatches);
+}
+
+// Flies the camera in a straight line and reports what streaming cost
+void Fly(Terrain& Ground, LodSelectionView View, float Distance, float Step)
+{
+    using Clock = std::chrono::steady_clock;
+    const float DirectionX = 0.6f;
+    const float DirectionZ = 0.8f;
+    const uint32_t Frames = static_cast<uint32_t>(Distance / Step);
+    uint64_t Built = 0;
+    uint64_t Evicted = 0;
+    uint32_t MaxResident = 0;
+    uint32_t MaxPending = 0;
+    double TotalMs = 0.0;
+    double MaxMs = 0.0;
+    std::vector<uint32_t> Written;
+    size_t WrittenSlots = 0;
+    for (uint32_t Frame = 0; Frame < Frames; ++Frame)
+    {
+        View.Eye.x += DirectionX * Step;
+        View.Eye.z += DirectionZ * Step;
+        const auto Start = Clock::now();
+        Ground.Update(View);
+        const double Ms = std::chrono::duration<double, std::milli>(Clock::now() - Start).count();
+        TotalMs += Ms;
+        MaxMs = std::max(MaxMs, Ms);
+        Ground.TakeWrittenSlots(Written);
+        WrittenSlots += Written.size();
+
+        const TerrainUpdateStats& Stats = Ground.GetLastUpdateStats();
+        Built += Stats.Built;
+        Evicted += Stats.Evicted;
+        MaxResident = std::max(MaxResident, Ground.GetResidentChunkCount());
+        MaxPending = std::max(MaxPending, Stats.Pending);
+    }
+    std::printf("%-44s %.0f km in %u frames: %llu chunks built, %llu evicted, %zu slots uploaded, at most %u "
+        "resident and %u pending, update %.3f ms mean %.3f ms max\n", "", Distance / 1000.f, Frames,
+        static_cast<unsigned long long>(Built), static_cast<unsigned long long>(Evicted), WrittenSlots,
+        MaxResident, MaxPending, TotalMs / Frames, MaxMs);
+}
+
+} // namespace
+
+void RunTerrainBenchmarks()
+{
+    JobSystem Jobs(std::max(4u, std::thread::hardware_concurrency()));
+    NoiseHeightSource Noise;
+
+    // Four heights per call against one, same values either way
+    const SamplePoints Points = MakeSamplePoints(512, 1.37f);
+    const uint64_t SampleCount = Points.X.size() * 4;
+    Report(Measure("terrain/noise heights, scalar", 5, SampleCount, [&]
+        {
+            float Sum = 0.f;
+            for (size_t b = 0; b < Points.X.size(); ++b)
+            {
+                for (uint32_t Lane = 0; Lane < 4; ++Lane)
+                    Sum += Noise.SampleHeight((&Points.X[b].x)[Lane], (&Points.Z[b].x)[Lane]);
+            }
+            DoNotOptimize(Sum);
+        }), "samples");
+    Report(Measure("terrain/noise heights, SIMD x4", 5, SampleCount, [&]
+        {
+            XMVECTOR Sum = XMVectorZero();
+            for (size_t b = 0; b < Points.X.size(); ++b)
+                Sum = XMVectorAdd(Sum, Noise.SampleHeights4(XMLoadFloat4A(&Points.X[b]), XMLoadFloat4A(&Points.Z[b])));
+            XMFLOAT4A Result;
+            XMStoreFloat4A(&Result, Sum);
+            DoNotOptimize(Result);
+        }), "samples");
+    std::printf("%-44s noise, largest scalar to SIMD difference: %g\n", "", CompareSamplePaths(Noise, Points));
+
+    // A heightfield baked from the noise, through an .r16 file and back
+    {
+        const uint32_t Side = 257;
+        const float HeightScale = 256.f;
+        std::vector<uint16_t> Raw(Side * Side);
+        for (uint32_t i = 0; i < Raw.size(); ++i)
+        {
+            const float Height = Noise.SampleHeight(float(i % Side) * 4.f, float(i / Side) * 4.f) + 128.f;
+            Raw[i] = static_cast<uint16_t>(std::lround(std::min(std::max(Height / HeightScale, 0.f), 1.f) * 65535.f));
+        }
+        const std::string Path = (std::filesystem::temp_directory_path() / "RacoonBenchTerrain.r16").string();
+        std::ofstream(Path, std::ios::binary | std::ios::trunc)
+            .write(reinterpret_cast<const char*>(Raw.data()), Raw.size() * sizeof(uint16_t));
+        HeightfieldSource Field(4.f);
+        std::string Error;
+        const bool Loaded = Field.LoadR16(Path, Side, Side, HeightScale, Error);
+        HeightfieldSource Short(4.f);
+        const bool Refused = !Short.LoadR16(Path, Side + 1, Side, HeightScale, Error);
+        std::filesystem::remove(Path);
+        const float Difference = Loaded ? CompareSamplePaths(Field, MakeSamplePoints(256, 3.9f)) : -1.f;
+        std::printf("%-44s heightfield %ux%u from .r16: %s, wrong size refused: %s, largest scalar to SIMD "
+            "difference: %g\n", "", Side, Side, Loaded ? "loaded" : Error.c_str(), Refused ? "yes" : "NO",
+            Difference);
+    }
+
+    TerrainOptions Options;
+    // 128 m chunks of 64 x 64 quads
+    LodSelectionView View;
+    View.Eye = XMFLOAT3(0.f, 80.f, 0.f);
+    View.ProjectionScale = 540.f / std::tan(XM_PI / 6.f);
+
+    {
+        Terrain Ground(Noise, Options);
+        const uint32_t ChunkCount = 64;
+        const uint64_t VertexCount = uint64_t(ChunkCount) * Ground.GetVerticesPerChunk();
+        std::vector<Vertex> Vertices(VertexCount);
+        std::vector<float> Errors(ChunkCount * Terrain::MaxLods);
+        auto BuildRange = [&](uint32_t First, uint32_t Last) {
+            for (uint32_t i = First; i < Last; ++i)
+                Ground.BuildChunk(int32_t(i % 8), int32_t(i / 8), &Vertices[size_t(i) * Ground.GetVerticesPerChunk()],
+                    &Errors[i * Terrain::MaxLods]);
+        };
+        Report(Measure("terrain/64 chunk builds, serial", 3, VertexCount, [&]
+            {
+                BuildRange(0, ChunkCount);
+            }), "verts");
+        char Name[64];
+        std::snprintf(Name, sizeof(Name), "terrain/64 chunk builds, %u threads", Jobs.GetThreadCount());
+        Report(Measure(Name, 3, VertexCount, [&]
+            {
+                Jobs.ParallelFor(ChunkCount, 1, BuildRange);
+            }), "verts");
+    }
+
+    // Everything within the radius in one update, then the chunks are drawn
+    // as they would be: welded, they must not show a single crack
+    TerrainOptions FullLoad = Options;
+    FullLoad.MaxBuildsPerUpdate = ~0u;
+    {
+        uint32_t Built = 0;
+        Report(Measure("terrain/initial load, serial", 1, 1, [&]
+            {
+                Terrain Ground(Noise, FullLoad);
+                Ground.Update(View);
+                Built = Ground.GetLastUpdateStats().Built;
+            }), "loads");
+        char Name[64];
+        std::snprintf(Name, sizeof(Name), "terrain/initial load, %u threads", Jobs.GetThreadCount());
+        Report(Measure(Name, 1, 1, [&]
+            {
+                Terrain Ground(Noise, FullLoad, &Jobs);
+                Ground.Update(View);
+            }), "loads");
+        std::printf("%-44s %u chunks within %.0f m\n", "", Built, FullLoad.LoadRadius);
+    }
+
+    Terrain Ground(Noise, FullLoad, &Jobs);
+    Ground.Update(View);
+    CheckVariants(Ground, FullLoad);
+    CheckSeams(Ground, FullLoad);
+    // Stricter pixels coarsen faster and put more levels side by side
+    LodSelectionView Coarse = View;
+    Coarse.PixelThreshold = 8.f;
+    Ground.Update(Coarse);
+    CheckSeams(Ground, FullLoad);
+    const float Steady = [&] {
+        using Clock = std::chrono::steady_clock;
+        const auto Start = Clock::now();
+        for (uint32_t i = 0; i < 100; ++i)
+            Ground.Update(Coarse);
+        return float(std::chrono::duration<double, std::milli>(Clock::now() - Start).count() / 100.0);
+    }();
+    std::printf("%-44s steady camera: update %.3f ms, nothing built: %s\n", "", Steady,
+        Ground.GetLastUpdateStats().Built == 0 ? "yes" : "NO");
+
+    // Twenty kilometres at 20 m per frame, builds capped per frame. The
+    // pool is sized by the radius once; the flight only recycles slots.
+    Terrain Flying(Noise, Options, &Jobs);
+    Flying.Update(View);
+    const size_t PoolBytes = Flying.GetVertexData().capacity();
+    ResetAllocCounters();
+    Fly(Flying, View, 20000.f, 20.f);
+    const AllocCounters Allocs = GetAllocCounters();
+    std::printf("%-44s vertex pool %u slots, %.1f MB before and %.1f MB after the flight; %.1f MB allocated "
+        "in total while flying, none of it kept\n", "", Flying.GetSlotCount(), PoolBytes / 1048576.0,
+        Flying.GetVertexData().capacity() / 1048576.0, Allocs.Bytes / 1048576.0);
+}
+
+} // namespace Bench
+} // namespace Racoon
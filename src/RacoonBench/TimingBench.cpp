@@ -0,0 +1,124 @@
+#include "Bench.h"
+
+#include "FramePacer.h"
+#include "GameTimer.h"
+
+#include <cstdio>
+#include <random>
+#include <thread>
+
+namespace Racoon {
+namespace Bench {
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+void PrintPacing(const char* Label, const FramePacingStats& Stats)
+{
+    std::printf("%-44s target %.3f ms, interval %.3f ms, jitter %.3f ms, max deviation %.3f ms, "
+        "wake error mean %.3f max %.3f ms, %u/%u missed\n", Label, Stats.TargetMs, Stats.MeanIntervalMs,
+        Stats.JitterMs, Stats.MaxDeviationMs, Stats.MeanWakeErrorMs, Stats.MaxWakeErrorMs,
+        Stats.MissedFrames, Stats.Frames);
+}
+
+// Stand-in for a frame's CPU work, varying like a real one
+void FakeWork(std::mt19937& Rng)
+{
+    std::uniform_int_distribution<int> Microseconds(500, 1500);
+    const Clock::time_point End = Clock::now() + std::chrono::microseconds(Microseconds(Rng));
+    while (Clock::now() < End)
+    {
+    }
+}
+
+} // namespace
+
+void RunTimingBenchmarks()
+{
+    // The usual limiter: sleep_for the rest of the frame and hope
+    {
+        const double TargetFps = 240.0;
+        const auto Period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / TargetFps));
+        std::mt19937 Rng(3);
+        double WakeSum = 0.0;
+        double WakeMax = 0.0;
+        Clock::time_point Deadline = Clock::now() + Period;
+        const uint32_t Frames = 240;
+        for (uint32_t i = 0; i < Frames; ++i)
+        {
+            FakeWork(Rng);
+            std::this_thread::sleep_until(Deadline);
+            const double Late = std::chrono::duration<double, std::milli>(Clock::now() - Deadline).count();
+            WakeSum += Late;
+            WakeMax = std::max(WakeMax, Late);
+            Deadline = std::max(Deadline + Period, Clock::now());
+        }
+        std::printf("%-44s wake error mean %.3f max %.3f ms\n", "sleep_until limiter, 240 FPS", WakeSum / Frames, WakeMax);
+    }
+
+    {
+        FramePacer Pacer(240.0);
+        std::mt19937 Rng(3);
+        for (uint32_t i = 0; i < 240; ++i)
+        {
+            Pacer.WaitForNextFrame();
+            FakeWork(Rng);
+        }
+        PrintPacing("FramePacer, 240 FPS", Pacer.GetStats());
+    }
+
+    {
+        // Uncapped still measures, here the work's own spread
+        FramePacer Pacer;
+        std::mt19937 Rng(3);
+        for (uint32_t i = 0; i < 128; ++i)
+        {
+            Pacer.WaitForNextFrame();
+            FakeWork(Rng);
+        }
+        PrintPacing("FramePacer, uncapped", Pacer.GetStats());
+    }
+
+    // Simulated time must add up: steps run + time dropped by the cap +
+    // what is left in the accumulator equals the time fed in
+    {
+        FixedTimestep Step(1.0 / 60.0, 4);
+        std::mt19937 Rng(5);
+        std::uniform_real_distribution<double> Delta(0.002, 0.040);
+        double Fed = 0.0;
+        uint64_t Steps = 0;
+        bool AlphaInRange = true;
+        for (uint32_t i = 0; i < 10000; ++i)
+        {
+            // Now and then a long hitch that hits the step cap
+            const double Frame = i % 1000 == 999 ? 0.5 : Delta(Rng);
+            Fed += Frame;
+            Steps += Step.Advance(Frame);
+            AlphaInRange &= Step.GetAlpha() >= 0.0 && Step.GetAlpha() < 1.0;
+        }
+        const double Accounted = Steps * Step.GetStep() + Step.GetDroppedTime() + Step.GetAlpha() * Step.GetStep();
+        std::printf("%-44s %llu steps, %.3f s dropped, time accounted to %.2e s, alpha in [0, 1): %s\n",
+            "FixedTimestep 60 Hz, 10000 frames", static_cast<unsigned long long>(Steps), Step.GetDroppedTime(),
+            std::abs(Accounted - Fed), AlphaInRange ? "yes" : "NO");
+    }
+
+    // Stopped time is excluded from TotalTime and gives a zero delta
+    {
+        GameTimer Timer;
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        Timer.Tick();
+        Timer.Stop();
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        Timer.Tick();
+        const float StoppedDelta = Timer.DeltaTime();
+        Timer.Start();
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        Timer.Tick();
+        std::printf("%-44s total %.3f s after 40 ms running and 50 ms stopped, delta while stopped %.3f, smoothed delta %.4f s\n",
+            "GameTimer", Timer.TotalTime(), StoppedDelta, Timer.SmoothedDeltaTime());
+    }
+}
+
+} // namespace Bench
+} // namespace Racoon
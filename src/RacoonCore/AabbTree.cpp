@@ -0,0 +1,571 @@
+#include "CoreStdafx.h"
+
+#include "AabbTree.h"
+
+#include <cfloat>
+#include <cstring>
+
+namespace Racoon {
+
+namespace {
+
+// Parent of nodes on the free list, tells them apart from live nodes
+constexpr uint32_t FreeParent = AabbTree::NullNode - 1;
+
+constexpr uint32_t SahBinCount = 12;
+
+// Traversal stack that lives on the call stack for any sane tree depth and
+// only touches the heap past that
+class NodeStack
+{
+public:
+    void Push(uint32_t Node)
+    {
+        if (m_Size < InlineCapacity)
+            m_Inline[m_Size] = Node;
+        else
+            m_Overflow.push_back(Node);
+        ++m_Size;
+    }
+    uint32_t Pop()
+    {
+        --m_Size;
+        if (m_Size < InlineCapacity)
+            return m_Inline[m_Size];
+        const uint32_t Node = m_Overflow.back();
+        m_Overflow.pop_back();
+        return Node;
+    }
+    bool Empty() const { return m_Size == 0; }
+
+private:
+    static constexpr uint32_t InlineCapacity = 64;
+    uint32_t m_Inline[InlineCapacity];
+    std::vector<uint32_t> m_Overflow;
+    uint32_t m_Size{ 0 };
+};
+
+XMFLOAT3 Centroid(const Aabb& Box)
+{
+    return XMFLOAT3((Box.Min.x + Box.Max.x) * 0.5f, (Box.Min.y + Box.Max.y) * 0.5f, (Box.Min.z + Box.Max.z) * 0.5f);
+}
+
+float Component(const XMFLOAT3& v, uint32_t Axis)
+{
+    return Axis == 0 ? v.x : (Axis == 1 ? v.y : v.z);
+}
+
+enum class FrustumOverlap
+{
+    Outside,
+    Intersecting,
+    Inside
+};
+
+FrustumOverlap TestFrustum(const Frustum& View, const Aabb& Box)
+{
+    const XMFLOAT3 Center = Centroid(Box);
+    const XMFLOAT3 Extents((Box.Max.x - Box.Min.x) * 0.5f, (Box.Max.y - Box.Min.y) * 0.5f,
+        (Box.Max.z - Box.Min.z) * 0.5f);
+
+    FrustumOverlap Result = FrustumOverlap::Inside;
+    for (const XMFLOAT4& Plane : View.Planes)
+    {
+        const float Distance = Plane.x * Center.x + Plane.y * Center.y + Plane.z * Center.z + Plane.w;
+        const float Radius = std::fabs(Plane.x) * Extents.x + std::fabs(Plane.y) * Extents.y +
+            std::fabs(Plane.z) * Extents.z;
+        if (Distance + Radius < 0.f)
+            return FrustumOverlap::Outside;
+        if (Distance - Radius < 0.f)
+            Result = FrustumOverlap::Intersecting;
+    }
+    return Result;
+}
+
+} // namespace
+
+Aabb Aabb::FromBounds(const Bounds& B)
+{
+    Aabb Box;
+    Box.Min = XMFLOAT3(B.Center.x - B.Extents.x, B.Center.y - B.Extents.y, B.Center.z - B.Extents.z);
+    Box.Max = XMFLOAT3(B.Center.x + B.Extents.x, B.Center.y + B.Extents.y, B.Center.z + B.Extents.z);
+    return Box;
+}
+
+float Aabb::SurfaceArea() const
+{
+    const float dx = Max.x - Min.x;
+    const float dy = Max.y - Min.y;
+    const float dz = Max.z - Min.z;
+    return 2.f * (dx * dy + dy * dz + dz * dx);
+}
+
+bool Aabb::Contains(const Aabb& Other) const
+{
+    return Min.x <= Other.Min.x && Min.y <= Other.Min.y && Min.z <= Other.Min.z &&
+        Max.x >= Other.Max.x && Max.y >= Other.Max.y && Max.z >= Other.Max.z;
+}
+
+bool Aabb::Overlaps(const Aabb& Other) const
+{
+    return Min.x <= Other.Max.x && Min.y <= Other.Max.y && Min.z <= Other.Max.z &&
+        Max.x >= Other.Min.x && Max.y >= Other.Min.y && Max.z >= Other.Min.z;
+}
+
+Aabb Union(const Aabb& a, const Aabb& b)
+{
+    Aabb Box;
+    Box.Min = XMFLOAT3(std::min(a.Min.x, b.Min.x), std::min(a.Min.y, b.Min.y), std::min(a.Min.z, b.Min.z));
+    Box.Max = XMFLOAT3(std::max(a.Max.x, b.Max.x), std::max(a.Max.y, b.Max.y), std::max(a.Max.z, b.Max.z));
+    return Box;
+}
+
+Aabb AabbTree::Fatten(const Aabb& Box) const
+{
+    Aabb Fat;
+    Fat.Min = XMFLOAT3(Box.Min.x - m_FatMargin, Box.Min.y - m_FatMargin, Box.Min.z - m_FatMargin);
+    Fat.Max = XMFLOAT3(Box.Max.x + m_FatMargin, Box.Max.y + m_FatMargin, Box.Max.z + m_FatMargin);
+    return Fat;
+}
+
+uint32_t AabbTree::AllocateNode()
+{
+    if (m_FreeList == NullNode)
+    {
+        m_Nodes.emplace_back();
+        return static_cast<uint32_t>(m_Nodes.size() - 1);
+    }
+    const uint32_t Index = m_FreeList;
+    m_FreeList = m_Nodes[Index].Child1;
+    m_Nodes[Index] = Node();
+    return Index;
+}
+
+void AabbTree::FreeNode(uint32_t Index)
+{
+    Node& Freed = m_Nodes[Index];
+    Freed.Parent = FreeParent;
+    Freed.Child1 = m_FreeList;
+    Freed.Child2 = NullNode;
+    Freed.Moved = false;
+    m_FreeList = Index;
+}
+
+void AabbTree::SetInternalBox(uint32_t Index, const Aabb& Box)
+{
+    Node& Internal = m_Nodes[Index];
+    m_InternalArea += double(Box.SurfaceArea()) - Internal.Box.SurfaceArea();
+    Internal.Box = Box;
+}
+
+uint32_t AabbTree::CreateProxy(const Aabb& Box, uint32_t UserData)
+{
+    const uint32_t Leaf = AllocateNode();
+    m_Nodes[Leaf].Box = Fatten(Box);
+    m_Nodes[Leaf].UserData = UserData;
+    InsertLeaf(Leaf);
+    ++m_ProxyCount;
+    return Leaf;
+}
+
+void AabbTree::DestroyProxy(uint32_t Proxy)
+{
+    assert(Proxy < m_Nodes.size() && m_Nodes[Proxy].IsLeaf() && m_Nodes[Proxy].Parent != FreeParent);
+    if (m_Nodes[Proxy].Moved)
+        m_MovedLeaves.erase(std::find(m_MovedLeaves.begin(), m_MovedLeaves.end(), Proxy));
+    RemoveLeaf(Proxy);
+    FreeNode(Proxy);
+    --m_ProxyCount;
+}
+
+bool AabbTree::MoveProxy(uint32_t Proxy, const Aabb& Box)
+{
+    Node& Leaf = m_Nodes[Proxy];
+    assert(Leaf.IsLeaf() && Leaf.Parent != FreeParent);
+    if (Leaf.Box.Contains(Box))
+        return false;
+
+    Leaf.Box = Fatten(Box);
+    if (!Leaf.Moved)
+    {
+        Leaf.Moved = true;
+        m_MovedLeaves.push_back(Proxy);
+    }
+    return true;
+}
+
+void AabbTree::InsertLeaf(uint32_t Leaf)
+{
+    if (m_Root == NullNode)
+    {
+        m_Root = Leaf;
+        m_Nodes[Leaf].Parent = NullNode;
+        return;
+    }
+
+    // Descend towards the sibling with the lowest SAH cost. Creating a parent
+    // at a node costs the new parent's area plus the growth of every ancestor.
+    const Aabb LeafBox = m_Nodes[Leaf].Box;
+    uint32_t Index = m_Root;
+    while (!m_Nodes[Index].IsLeaf())
+    {
+        const Node& Current = m_Nodes[Index];
+        const float Area = Current.Box.SurfaceArea();
+        const float CombinedArea = Union(Current.Box, LeafBox).SurfaceArea();
+
+        const float Cost = 2.f * CombinedArea;
+        const float InheritanceCost = 2.f * (CombinedArea - Area);
+
+        auto DescendCost = [&](uint32_t Child) {
+            const Aabb& ChildBox = m_Nodes[Child].Box;
+            const float Grown = Union(ChildBox, LeafBox).SurfaceArea();
+            return (m_Nodes[Child].IsLeaf() ? Grown : Grown - ChildBox.SurfaceArea()) + InheritanceCost;
+        };
+        const float Cost1 = DescendCost(Current.Child1);
+        const float Cost2 = DescendCost(Current.Child2);
+
+        if (Cost < Cost1 && Cost < Cost2)
+            break;
+        Index = Cost1 < Cost2 ? Current.Child1 : Current.Child2;
+    }
+
+    const uint32_t Sibling = Index;
+    const uint32_t OldParent = m_Nodes[Sibling].Parent;
+    const uint32_t NewParent = AllocateNode();
+    Node& Parent = m_Nodes[NewParent];
+    Parent.Parent = OldParent;
+    Parent.Box = Union(LeafBox, m_Nodes[Sibling].Box);
+    m_InternalArea += Parent.Box.SurfaceArea();
+    Parent.Child1 = Sibling;
+    Parent.Child2 = Leaf;
+    m_Nodes[Sibling].Parent = NewParent;
+    m_Nodes[Leaf].Parent = NewParent;
+
+    if (OldParent == NullNode)
+    {
+        m_Root = NewParent;
+        return;
+    }
+    if (m_Nodes[OldParent].Child1 == Sibling)
+        m_Nodes[OldParent].Child1 = NewParent;
+    else
+        m_Nodes[OldParent].Child2 = NewParent;
+
+    for (uint32_t Ancestor = OldParent; Ancestor != NullNode; Ancestor = m_Nodes[Ancestor].Parent)
+    {
+        const Node& Current = m_Nodes[Ancestor];
+        SetInternalBox(Ancestor, Union(m_Nodes[Current.Child1].Box, m_Nodes[Current.Child2].Box));
+    }
+}
+
+void AabbTree::RemoveLeaf(uint32_t Leaf)
+{
+    if (Leaf == m_Root)
+    {
+        m_Root = NullNode;
+        return;
+    }
+
+    const uint32_t Parent = m_Nodes[Leaf].Parent;
+    const uint32_t GrandParent = m_Nodes[Parent].Parent;
+    const uint32_t Sibling = m_Nodes[Parent].Child1 == Leaf ? m_Nodes[Parent].Child2 : m_Nodes[Parent].Child1;
+
+    // The sibling takes the parent's place
+    m_Nodes[Sibling].Parent = GrandParent;
+    m_InternalArea -= m_Nodes[Parent].Box.SurfaceArea();
+    FreeNode(Parent);
+    if (GrandParent == NullNode)
+    {
+        m_Root = Sibling;
+        return;
+    }
+    if (m_Nodes[GrandParent].Child1 == Parent)
+        m_Nodes[GrandParent].Child1 = Sibling;
+    else
+        m_Nodes[GrandParent].Child2 = Sibling;
+
+    for (uint32_t Ancestor = GrandParent; Ancestor != NullNode; Ancestor = m_Nodes[Ancestor].Parent)
+    {
+        const Node& Current = m_Nodes[Ancestor];
+        SetInternalBox(Ancestor, Union(m_Nodes[Current.Child1].Box, m_Nodes[Current.Child2].Box));
+    }
+}
+
+void AabbTree::Refit()
+{
+    for (uint32_t Leaf : m_MovedLeaves)
+    {
+        m_Nodes[Leaf].Moved = false;
+        for (uint32_t Ancestor = m_Nodes[Leaf].Parent; Ancestor != NullNode; Ancestor = m_Nodes[Ancestor].Parent)
+        {
+            const Node& Current = m_Nodes[Ancestor];
+            const Aabb Box = Union(m_Nodes[Current.Child1].Box, m_Nodes[Current.Child2].Box);
+            // Everything above is unaffected once a box stops changing
+            if (std::memcmp(&Box, &Current.Box, sizeof(Aabb)) == 0)
+                break;
+            SetInternalBox(Ancestor, Box);
+        }
+    }
+    m_MovedLeaves.clear();
+}
+
+void AabbTree::CollectLeaves(uint32_t Root, std::vector<uint32_t>& Out) const
+{
+    if (Root == NullNode)
+        return;
+    NodeStack Stack;
+    Stack.Push(Root);
+    while (!Stack.Empty())
+    {
+        const Node& Current = m_Nodes[Stack.Pop()];
+        if (Current.IsLeaf())
+        {
+            Out.push_back(Current.UserData);
+            continue;
+        }
+        Stack.Push(Current.Child1);
+        Stack.Push(Current.Child2);
+    }
+}
+
+uint32_t AabbTree::BuildRange(BuildLeaf* Leaves, uint32_t Count, uint32_t Parent)
+{
+    if (Count == 1)
+    {
+        m_Nodes[Leaves[0].Leaf].Parent = Parent;
+        return Leaves[0].Leaf;
+    }
+
+    Aabb CentroidBox{ Leaves[0].Centroid, Leaves[0].Centroid };
+    for (uint32_t i = 1; i < Count; ++i)
+        CentroidBox = Union(CentroidBox, Aabb{ Leaves[i].Centroid, Leaves[i].Centroid });
+    const XMFLOAT3 Size(CentroidBox.Max.x - CentroidBox.Min.x, CentroidBox.Max.y - CentroidBox.Min.y,
+        CentroidBox.Max.z - CentroidBox.Min.z);
+    const uint32_t Axis = Size.x > Size.y ? (Size.x > Size.z ? 0 : 2) : (Size.y > Size.z ? 1 : 2);
+    const float AxisMin = Component(CentroidBox.Min, Axis);
+    const float AxisSize = Component(Size, Axis);
+
+    uint32_t Mid = Count / 2;
+    if (AxisSize > 0.f)
+    {
+        // Bin the centroids, then sweep for the split with the lowest
+        // left area * left count + right area * right count
+        const float BinScale = SahBinCount / AxisSize;
+        auto BinOf = [&](const BuildLeaf& Leaf) {
+            const float c = Component(Leaf.Centroid, Axis);
+            return std::min(SahBinCount - 1, static_cast<uint32_t>((c - AxisMin) * BinScale));
+        };
+
+        uint32_t BinCounts[SahBinCount] = {};
+        Aabb BinBoxes[SahBinCount];
+        for (uint32_t i = 0; i < Count; ++i)
+        {
+            const uint32_t Bin = BinOf(Leaves[i]);
+            BinBoxes[Bin] = BinCounts[Bin] ? Union(BinBoxes[Bin], Leaves[i].Box) : Leaves[i].Box;
+            ++BinCounts[Bin];
+        }
+
+        float RightCosts[SahBinCount];
+        Aabb Accumulated;
+        uint32_t AccumulatedCount = 0;
+        for (uint32_t Bin = SahBinCount - 1; Bin > 0; --Bin)
+        {
+            if (BinCounts[Bin])
+                Accumulated = AccumulatedCount ? Union(Accumulated, BinBoxes[Bin]) : BinBoxes[Bin];
+            AccumulatedCount += BinCounts[Bin];
+            RightCosts[Bin] = AccumulatedCount ? Accumulated.SurfaceArea() * AccumulatedCount : 0.f;
+        }
+
+        float BestCost = FLT_MAX;
+        uint32_t BestSplit = 0;
+        AccumulatedCount = 0;
+        for (uint32_t Split = 1; Split < SahBinCount; ++Split)
+        {
+            const uint32_t Bin = Split - 1;
+            if (BinCounts[Bin])
+                Accumulated = AccumulatedCount ? Union(Accumulated, BinBoxes[Bin]) : BinBoxes[Bin];
+            AccumulatedCount += BinCounts[Bin];
+            if (AccumulatedCount == 0 || AccumulatedCount == Count)
+                continue;
+            const float Cost = Accumulated.SurfaceArea() * AccumulatedCount + RightCosts[Split];
+            if (Cost < BestCost)
+            {
+                BestCost = Cost;
+                BestSplit = Split;
+            }
+        }
+
+        if (BestSplit != 0)
+        {
+            BuildLeaf* SplitPoint = std::partition(Leaves, Leaves + Count,
+                [&](const BuildLeaf& Leaf) { return BinOf(Leaf) < BestSplit; });
+            Mid = static_cast<uint32_t>(SplitPoint - Leaves);
+        }
+    }
+
+    const uint32_t Index = AllocateNode();
+    m_Nodes[Index].Parent = Parent;
+    const uint32_t Child1 = BuildRange(Leaves, Mid, Index);
+    const uint32_t Child2 = BuildRange(Leaves + Mid, Count - Mid, Index);
+
+    Node& Internal = m_Nodes[Index];
+    Internal.Child1 = Child1;
+    Internal.Child2 = Child2;
+    Internal.Box = Union(m_Nodes[Child1].Box, m_Nodes[Child2].Box);
+    m_InternalArea += Internal.Box.SurfaceArea();
+    return Index;
+}
+
+void AabbTree::Rebuild()
+{
+    Refit();
+
+    // Leaves keep their indices, internal nodes go back to the free list
+    std::vector<BuildLeaf> Leaves;
+    Leaves.reserve(m_ProxyCount);
+    for (uint32_t i = 0; i < m_Nodes.size(); ++i)
+    {
+        if (m_Nodes[i].Parent == FreeParent)
+            continue;
+        if (m_Nodes[i].IsLeaf())
+            Leaves.push_back({ m_Nodes[i].Box, Centroid(m_Nodes[i].Box), i });
+        else
+            FreeNode(i);
+    }
+
+    // Summed afresh, which also drops the rounding the updates accumulated
+    m_InternalArea = 0.0;
+    m_Root = Leaves.empty() ? NullNode : BuildRange(Leaves.data(), static_cast<uint32_t>(Leaves.size()), NullNode);
+    m_RebuiltCost = GetCost();
+}
+
+bool AabbTree::RebuildIfDegraded(float Ratio)
+{
+    if (m_RebuiltCost > 0.f && GetCost() <= m_RebuiltCost * Ratio)
+        return false;
+    Rebuild();
+    return true;
+}
+
+float AabbTree::GetCost() const
+{
+    if (m_Root == NullNode || m_Nodes[m_Root].IsLeaf())
+        return 0.f;
+
+    const float RootArea = m_Nodes[m_Root].Box.SurfaceArea();
+    return RootArea > 0.f ? static_cast<float>(std::max(m_InternalArea, 0.0) / RootArea) : 0.f;
+}
+
+uint32_t AabbTree::GetHeight() const
+{
+    if (m_Root == NullNode)
+        return 0;
+
+    // Depth of a node is stored next to it on the stack
+    uint32_t Height = 0;
+    std::vector<std::pair<uint32_t, uint32_t>> Stack{ { m_Root, 1u } };
+    while (!Stack.empty())
+    {
+        const auto Entry = Stack.back();
+        Stack.pop_back();
+        Height = std::max(Height, Entry.second);
+        const Node& Current = m_Nodes[Entry.first];
+        if (!Current.IsLeaf())
+        {
+            Stack.push_back({ Current.Child1, Entry.second + 1 });
+            Stack.push_back({ Current.Child2, Entry.second + 1 });
+        }
+    }
+    return Height;
+}
+
+void AabbTree::QueryFrustum(const Frustum& View, std::vector<uint32_t>& Out) const
+{
+    const size_t FirstOut = Out.size();
+    if (m_Root != NullNode)
+    {
+        NodeStack Stack;
+        Stack.Push(m_Root);
+        while (!Stack.Empty())
+        {
+            const uint32_t Index = Stack.Pop();
+            const Node& Current = m_Nodes[Index];
+            const FrustumOverlap Overlap = TestFrustum(View, Current.Box);
+            if (Overlap == FrustumOverlap::Outside)
+                continue;
+            // Whole subtree is visible, no more plane tests below here
+            if (Overlap == FrustumOverlap::Inside || Current.IsLeaf())
+            {
+                CollectLeaves(Index, Out);
+                continue;
+            }
+            Stack.Push(Current.Child1);
+            Stack.Push(Current.Child2);
+        }
+    }
+
+    const uint64_t Visible = Out.size() - FirstOut;
+    m_Stats.Tested += m_ProxyCount;
+    m_Stats.Culled += m_ProxyCount - Visible;
+}
+
+void AabbTree::QueryAabb(const Aabb& Box, std::vector<uint32_t>& Out) const
+{
+    if (m_Root == NullNode)
+        return;
+
+    NodeStack Stack;
+    Stack.Push(m_Root);
+    while (!Stack.Empty())
+    {
+        const Node& Current = m_Nodes[Stack.Pop()];
+        if (!Current.Box.Overlaps(Box))
+            continue;
+        if (Current.IsLeaf())
+        {
+            Out.push_back(Current.UserData);
+            continue;
+        }
+        Stack.Push(Current.Child1);
+        Stack.Push(Current.Child2);
+    }
+}
+
+void AabbTree::QueryRay(const XMFLOAT3& Origin, const XMFLOAT3& Direction, float MaxDistance,
+    std::vector<uint32_t>& Out) const
+{
+    if (m_Root == NullNode)
+        return;
+
+    // Division by a zero component gives +-inf, which the slab test handles
+    const float InvX = 1.f / Direction.x;
+    const float InvY = 1.f / Direction.y;
+    const float InvZ = 1.f / Direction.z;
+
+    auto Hit = [&](const Aabb& Box) {
+        const float tx1 = (Box.Min.x - Origin.x) * InvX, tx2 = (Box.Max.x - Origin.x) * InvX;
+        const float ty1 = (Box.Min.y - Origin.y) * InvY, ty2 = (Box.Max.y - Origin.y) * InvY;
+        const float tz1 = (Box.Min.z - Origin.z) * InvZ, tz2 = (Box.Max.z - Origin.z) * InvZ;
+        const float tNear = std::max(std::max(std::min(tx1, tx2), std::min(ty1, ty2)), std::max(std::min(tz1, tz2), 0.f));
+        const float tFar = std::min(std::min(std::max(tx1, tx2), std::max(ty1, ty2)), std::min(std::max(tz1, tz2), MaxDistance));
+        return tNear <= tFar;
+    };
+
+    NodeStack Stack;
+    Stack.Push(m_Root);
+    while (!Stack.Empty())
+    {
+        const Node& Current = m_Nodes[Stack.Pop()];
+        if (!Hit(Current.Box))
+            continue;
+        if (Current.IsLeaf())
+        {
+            Out.push_back(Current.UserData);
+            continue;
+        }
+        Stack.Push(Current.Child1);
+        Stack.Push(Current.Child2);
+    }
+}
+
+} // namespace Racoon
@@ -0,0 +1,117 @@
+#pragma once
+
+#include "CoreStdafx.h"
+#include "FrustumCuller.h"
+#include "MeshGeometry.h"
+
+namespace Racoon {
+
+struct Aabb
+{
+    XMFLOAT3 Min{ 0.f, 0.f, 0.f };
+    XMFLOAT3 Max{ 0.f, 0.f, 0.f };
+
+    static Aabb FromBounds(const Bounds& B);
+    float SurfaceArea() const;
+    bool Contains(const Aabb& Other) const;
+    bool Overlaps(const Aabb& Other) const;
+};
+
+Aabb Union(const Aabb& a, const Aabb& b);
+
+// Dynamic bounding volume tree over proxies, one per scene object. Leaves
+// store a fattened box so small motions leave the tree untouched. Moves that
+// do escape only update the leaf; Refit then fixes the affected ancestors,
+// and Rebuild (or RebuildIfDegraded) restores SAH quality. Proxy ids stay
+// valid across refits and rebuilds.
+class AabbTree
+{
+public:
+    static constexpr uint32_t NullNode = ~0u;
+
+    // Margin added on every side of a leaf box
+    explicit AabbTree(float FatMargin = 0.1f) : m_FatMargin(FatMargin) {}
+
+    uint32_t CreateProxy(const Aabb& Box, uint32_t UserData);
+    void DestroyProxy(uint32_t Proxy);
+    // Returns false when the box is still inside the proxy's fat box and
+    // nothing changed. Otherwise the leaf is refattened and queued for Refit.
+    bool MoveProxy(uint32_t Proxy, const Aabb& Box);
+
+    // Recomputes the boxes of the ancestors of moved leaves, bottom up,
+    // stopping early where a parent box does not change
+    void Refit();
+    // Top-down binned SAH build over the current leaves
+    void Rebuild();
+    // Rebuilds when GetCost() exceeds Ratio times the cost after the last rebuild
+    bool RebuildIfDegraded(float Ratio = 1.5f);
+    // Summed surface area of internal nodes relative to the root: the
+    // expected number of nodes a random ray visits. Lower is better. The sum
+    // is kept up to date as boxes change, so this is cheap every frame.
+    float GetCost() const;
+
+    uint32_t GetUserData(uint32_t Proxy) const { return m_Nodes[Proxy].UserData; }
+    const Aabb& GetFatAabb(uint32_t Proxy) const { return m_Nodes[Proxy].Box; }
+    uint32_t GetProxyCount() const { return m_ProxyCount; }
+    uint32_t GetHeight() const;
+
+    // Queries append the user data of the matching leaves to Out. Refit must
+    // have run since the last MoveProxy for the results to be complete.
+    void QueryFrustum(const Frustum& View, std::vector<uint32_t>& Out) const;
+    void QueryAabb(const Aabb& Box, std::vector<uint32_t>& Out) const;
+    // Leaves whose fat box the segment Origin + t * Direction, t in [0, MaxDistance], touches
+    void QueryRay(const XMFLOAT3& Origin, const XMFLOAT3& Direction, float MaxDistance,
+        std::vector<uint32_t>& Out) const;
+
+    // Frustum query counters: proxies considered and rejected
+    const CullingStats& GetStats() const { return m_Stats; }
+    void ResetStats() { m_Stats = CullingStats(); }
+
+private:
+    struct Node
+    {
+        Aabb Box;
+        uint32_t Parent{ NullNode };
+        // Both NullNode for leaves. Free nodes chain through Child1.
+        uint32_t Child1{ NullNode };
+        uint32_t Child2{ NullNode };
+        uint32_t UserData{ 0 };
+        // Leaf waiting for Refit
+        bool Moved{ false };
+
+        bool IsLeaf() const { return Child1 == NullNode; }
+    };
+
+    uint32_t AllocateNode();
+    void FreeNode(uint32_t Index);
+    void InsertLeaf(uint32_t Leaf);
+    void RemoveLeaf(uint32_t Leaf);
+    // Leaf data copied out for Rebuild so partitioning stays in one array
+    struct BuildLeaf
+    {
+        Aabb Box;
+        XMFLOAT3 Centroid;
+        uint32_t Leaf;
+    };
+    uint32_t BuildRange(BuildLeaf* Leaves, uint32_t Count, uint32_t Parent);
+    void CollectLeaves(uint32_t Root, std::vector<uint32_t>& Out) const;
+    Aabb Fatten(const Aabb& Box) const;
+    // Assigns the box of an internal node, keeping m_InternalArea in step
+    void SetInternalBox(uint32_t Index, const Aabb& Box);
+
+    std::vector<Node> m_Nodes;
+    uint32_t m_Root{ NullNode };
+    uint32_t m_FreeList{ NullNode };
+    uint32_t m_ProxyCount{ 0 };
+    float m_FatMargin;
+
+    std::vector<uint32_t> m_MovedLeaves;
+    float m_RebuiltCost{ 0.f };
+    // Surface areas of the internal nodes, summed. Double, so the many small
+    // updates between rebuilds do not drift.
+    double m_InternalArea{ 0.0 };
+
+    mutable CullingStats m_Stats;
+};
+
+} // namespace Racoon
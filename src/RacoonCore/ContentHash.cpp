@@ -0,0 +1,115 @@
+#include "CoreStdafx.h"
+
+#include "ContentHash.h"
+
+#include "MappedFile.h"
+
+#include <cstring>
+
+namespace Racoon {
+
+namespace {
+
+constexpr uint64_t Prime1 = 0x9E3779B185EBCA87ull;
+constexpr uint64_t Prime2 = 0xC2B2AE3D27D4EB4Full;
+constexpr uint64_t Prime3 = 0x165667B19E3779F9ull;
+constexpr uint64_t Prime4 = 0x85EBCA77C2B2AE63ull;
+constexpr uint64_t Prime5 = 0x27D4EB2F165667C5ull;
+
+uint64_t Rotate(uint64_t Value, int Bits)
+{
+    return (Value << Bits) | (Value >> (64 - Bits));
+}
+
+uint64_t Read64(const uint8_t* Data)
+{
+    uint64_t Value;
+    std::memcpy(&Value, Data, sizeof(Value));
+    return Value;
+}
+
+uint32_t Read32(const uint8_t* Data)
+{
+    uint32_t Value;
+    std::memcpy(&Value, Data, sizeof(Value));
+    return Value;
+}
+
+uint64_t Round(uint64_t Accumulator, uint64_t Input)
+{
+    Accumulator += Input * Prime2;
+    return Rotate(Accumulator, 31) * Prime1;
+}
+
+uint64_t MergeRound(uint64_t Hash, uint64_t Lane)
+{
+    Hash ^= Round(0, Lane);
+    return Hash * Prime1 + Prime4;
+}
+
+} // namespace
+
+uint64_t HashBytes(const void* Data, size_t Size, uint64_t Seed)
+{
+    const uint8_t* Bytes = static_cast<const uint8_t*>(Data);
+    const uint8_t* const End = Bytes + Size;
+    uint64_t Hash;
+
+    if (Size >= 32)
+    {
+        // Four independent lanes keep the multipliers busy
+        uint64_t Lanes[4] = { Seed + Prime1 + Prime2, Seed + Prime2, Seed, Seed - Prime1 };
+        for (; Bytes + 32 <= End; Bytes += 32)
+        {
+            Lanes[0] = Round(Lanes[0], Read64(Bytes));
+            Lanes[1] = Round(Lanes[1], Read64(Bytes + 8));
+            Lanes[2] = Round(Lanes[2], Read64(Bytes + 16));
+            Lanes[3] = Round(Lanes[3], Read64(Bytes + 24));
+        }
+        Hash = Rotate(Lanes[0], 1) + Rotate(Lanes[1], 7) + Rotate(Lanes[2], 12) + Rotate(Lanes[3], 18);
+        for (uint64_t Lane : Lanes)
+            Hash = MergeRound(Hash, Lane);
+    }
+    else
+    {
+        Hash = Seed + Prime5;
+    }
+    Hash += Size;
+
+    for (; Bytes + 8 <= End; Bytes += 8)
+        Hash = Rotate(Hash ^ Round(0, Read64(Bytes)), 27) * Prime1 + Prime4;
+    if (Bytes + 4 <= End)
+    {
+        Hash = Rotate(Hash ^ (Read32(Bytes) * Prime1), 23) * Prime2 + Prime3;
+        Bytes += 4;
+    }
+    for (; Bytes < End; ++Bytes)
+        Hash = Rotate(Hash ^ (*Bytes * Prime5), 11) * Prime1;
+
+    Hash ^= Hash >> 33;
+    Hash *= Prime2;
+    Hash ^= Hash >> 29;
+    Hash *= Prime3;
+    Hash ^= Hash >> 32;
+    return Hash;
+}
+
+ContentHasher& ContentHasher::Add(const void* Data, size_t Size)
+{
+    // Chained through the seed; the length is part of XXH64 already
+    m_Hash = HashBytes(Data, Size, m_Hash);
+    return *this;
+}
+
+bool HashFile(const std::string& Path, uint64_t& Hash, uint64_t Seed)
+{
+    MappedFile File;
+    std::string Error;
+    if (!File.Open(Path, Error))
+        return false;
+    File.PrefetchAll();
+    Hash = HashBytes(File.GetData(), File.GetSize(), Seed);
+    return true;
+}
+
+} // namespace Racoon
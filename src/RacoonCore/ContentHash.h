@@ -0,0 +1,40 @@
+#pragma once
+
+#include "CoreStdafx.h"
+
+#include <string>
+
+namespace Racoon {
+
+// 64-bit XXH64 of Size bytes, about as fast as memory can deliver them.
+// For cache keys, not for security.
+uint64_t HashBytes(const void* Data, size_t Size, uint64_t Seed = 0);
+
+// Hashes a sequence of inputs into one cache key. Each input's length is
+// mixed in too, so "ab" + "c" and "a" + "bc" differ.
+class ContentHasher
+{
+public:
+    explicit ContentHasher(uint64_t Seed = 0) : m_Hash(Seed) {}
+
+    ContentHasher& Add(const void* Data, size_t Size);
+    ContentHasher& Add(const std::string& Text) { return Add(Text.data(), Text.size()); }
+    // Plain values only: padding bytes would make the key unstable
+    template<typename T>
+    ContentHasher& AddValue(const T& Value)
+    {
+        static_assert(std::is_trivially_copyable_v<T>, "hash the members of non-trivial types");
+        return Add(&Value, sizeof(T));
+    }
+
+    uint64_t Get() const { return m_Hash; }
+
+private:
+    uint64_t m_Hash;
+};
+
+// Hashes the contents of the file at Path through a memory mapping. False
+// when it cannot be read.
+bool HashFile(const std::string& Path, uint64_t& Hash, uint64_t Seed = 0);
+
+} // namespace Racoon
@@ -0,0 +1,17 @@
+#pragma once
+
+// Common includes for RacoonCore. Unlike the engine's stdafx.h this header
+// must not pull in Windows or D3D12, so the library builds on any platform.
+
+#include <DirectXMath.h>
+
+#include "vectormath/vectormath.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+using namespace DirectX;
@@ -0,0 +1,119 @@
+#include "CoreStdafx.h"
+
+#include "DrawBatcher.h"
+
+namespace Racoon {
+
+namespace {
+
+constexpr uint32_t EmptySlot = ~0u;
+
+bool SameBatch(const DrawBatch& Batch, const RenderItem& Item)
+{
+    return Batch.PipelineState == Item.PipelineState &&
+        Batch.StartIndexLocation == Item.StartIndexLocation &&
+        Batch.BaseVertexLocation == Item.BaseVertexLocation &&
+        Batch.IndexCount == Item.IndexCount &&
+        Batch.IndexWidth == Item.IndexWidth &&
+        Batch.PrimitiveType == Item.PrimitiveType;
+}
+
+DrawBatch MakeBatch(const RenderItem& Item)
+{
+    DrawBatch Batch;
+    Batch.PipelineState = Item.PipelineState;
+    Batch.IndexWidth = Item.IndexWidth;
+    Batch.PrimitiveType = Item.PrimitiveType;
+    Batch.IndexCount = static_cast<uint32_t>(Item.IndexCount);
+    Batch.StartIndexLocation = static_cast<uint32_t>(Item.StartIndexLocation);
+    Batch.BaseVertexLocation = Item.BaseVertexLocation;
+    Batch.Quantization = Item.Quantization;
+    return Batch;
+}
+
+uint64_t HashItem(const RenderItem& Item)
+{
+    uint64_t Hash = (uint64_t(Item.StartIndexLocation) << 32) ^ Item.BaseVertexLocation;
+    Hash ^= (uint64_t(Item.PipelineState) << 48) ^ (uint64_t(Item.IndexWidth) << 40) ^
+        (uint64_t(Item.PrimitiveType) << 36) ^ (uint64_t(Item.IndexCount) << 7);
+    Hash *= 0x9E3779B97F4A7C15ull;
+    return Hash ^ (Hash >> 31);
+}
+
+} // namespace
+
+uint32_t DrawBatcher::FindOrAddBatch(const RenderItem& Item)
+{
+    const size_t Mask = m_Slots.size() - 1;
+    size_t Slot = static_cast<size_t>(HashItem(Item)) & Mask;
+    while (m_Slots[Slot] != EmptySlot)
+    {
+        if (SameBatch(m_Batches[m_Slots[Slot]], Item))
+            return m_Slots[Slot];
+        Slot = (Slot + 1) & Mask;
+    }
+
+    const uint32_t BatchIndex = static_cast<uint32_t>(m_Batches.size());
+    m_Slots[Slot] = BatchIndex;
+
+    m_Batches.push_back(MakeBatch(Item));
+    return BatchIndex;
+}
+
+void DrawBatcher::Build(const std::vector<std::shared_ptr<RenderItem>>& Items, BatchMerging Merging)
+{
+    m_Batches.clear();
+
+    if (Merging == BatchMerging::Adjacent)
+    {
+        // Batches are already in item order, no table or scatter needed
+        m_Transforms.resize(Items.size());
+        for (size_t i = 0; i < Items.size(); ++i)
+        {
+            const RenderItem& Item = *Items[i];
+            if (m_Batches.empty() || !SameBatch(m_Batches.back(), Item))
+            {
+                m_Batches.push_back(MakeBatch(Item));
+                m_Batches.back().FirstInstance = static_cast<uint32_t>(i);
+            }
+            ++m_Batches.back().InstanceCount;
+            m_Transforms[i] = Item.GetObjectToWorldMatrix();
+        }
+        return;
+    }
+
+    // Worst case every item is its own batch
+    size_t TableSize = 64;
+    while (TableSize < Items.size() * 2)
+        TableSize <<= 1;
+    if (m_Slots.size() < TableSize)
+        m_Slots.resize(TableSize);
+    std::fill(m_Slots.begin(), m_Slots.end(), EmptySlot);
+
+    // Counting pass, then a prefix sum gives every batch its instance range
+    m_ItemBatches.resize(Items.size());
+    for (size_t i = 0; i < Items.size(); ++i)
+    {
+        const uint32_t BatchIndex = FindOrAddBatch(*Items[i]);
+        m_ItemBatches[i] = BatchIndex;
+        ++m_Batches[BatchIndex].InstanceCount;
+    }
+
+    uint32_t FirstInstance = 0;
+    for (DrawBatch& Batch : m_Batches)
+    {
+        Batch.FirstInstance = FirstInstance;
+        FirstInstance += Batch.InstanceCount;
+        // Used as the write cursor below, which counts it back up
+        Batch.InstanceCount = 0;
+    }
+
+    m_Transforms.resize(Items.size());
+    for (size_t i = 0; i < Items.size(); ++i)
+    {
+        DrawBatch& Batch = m_Batches[m_ItemBatches[i]];
+        m_Transforms[Batch.FirstInstance + Batch.InstanceCount++] = Items[i]->GetObjectToWorldMatrix();
+    }
+}
+
+} // namespace Racoon
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "CoreStdafx.h"
+#include "RenderItem.h"
+
+namespace Racoon {
+
+// One instanced draw: every item that shares a pipeline state and a mesh range
+struct DrawBatch
+{
+    uint16_t PipelineState{ 0 };
+    IndexFormat IndexWidth{ IndexFormat::Uint32 };
+    PrimitiveTopology PrimitiveType{ PrimitiveTopology::TriangleList };
+    uint32_t IndexCount{ 0 };
+    uint32_t StartIndexLocation{ 0 };
+    uint32_t BaseVertexLocation{ 0 };
+    VertexQuantization Quantization;
+    // Range of the batch's transforms in GetInstanceTransforms()
+    uint32_t FirstInstance{ 0 };
+    uint32_t InstanceCount{ 0 };
+};
+
+enum class BatchMerging : uint8_t
+{
+    // Any two matching items share a batch. Keeps the first-appearance order
+    // of batches, which matches the item order when the items are sorted by state.
+    Any,
+    // Only consecutive matching items share a batch, so the draw order is
+    // exactly the item order. For back-to-front transparent lists.
+    Adjacent
+};
+
+// Groups render items into instanced draws and packs their object-to-world
+// matrices into one array, contiguous per batch. Batches come out in the order
+// their first item appears, instances in item order. Build is meant to run
+// every frame; once the buffers have grown it does not allocate.
+class DrawBatcher
+{
+public:
+    void Build(const std::vector<std::shared_ptr<RenderItem>>& Items, BatchMerging Merging = BatchMerging::Any);
+
+    const std::vector<DrawBatch>& GetBatches() const { return m_Batches; }
+    const std::vector<math::Matrix4>& GetInstanceTransforms() const { return m_Transforms; }
+
+private:
+    uint32_t FindOrAddBatch(const RenderItem& Item);
+
+    std::vector<DrawBatch> m_Batches;
+    std::vector<math::Matrix4> m_Transforms;
+    // Batch of every item, from the counting pass
+    std::vector<uint32_t> m_ItemBatches;
+    // Open-addressing table of batch indices, at most half full
+    std::vector<uint32_t> m_Slots;
+};
+
+} // namespace Racoon
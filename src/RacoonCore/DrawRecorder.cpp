@@ -0,0 +1,86 @@
+#include "CoreStdafx.h"
+
+#include "DrawRecorder.h"
+#include "Profiler.h"
+
+namespace Racoon {
+
+void RecordBatches(const DrawBatch* Batches, size_t Count, DrawCommandList& List)
+{
+    List.Begin();
+
+    // Every list starts with no pipeline state or index buffer, so the first
+    // batch always binds both
+    bool StateBound = false;
+    uint16_t BoundState = 0;
+    PrimitiveTopology BoundTopology = PrimitiveTopology::TriangleList;
+    bool IndexBufferBound = false;
+    IndexFormat BoundWidth = IndexFormat::Uint16;
+    for (size_t i = 0; i < Count; ++i)
+    {
+        const DrawBatch& Batch = Batches[i];
+
+        if (!StateBound || Batch.PipelineState != BoundState || Batch.PrimitiveType != BoundTopology)
+        {
+            List.SetPipelineState(Batch.PipelineState, Batch.PrimitiveType);
+            BoundState = Batch.PipelineState;
+            BoundTopology = Batch.PrimitiveType;
+            StateBound = true;
+        }
+
+        BatchConstants Constants;
+        Constants.QuantOffset = Batch.Quantization.Offset;
+        Constants.FirstInstance = Batch.FirstInstance;
+        Constants.QuantScale = Batch.Quantization.Scale;
+        Constants.Pad = 0.f;
+        List.SetBatchConstants(Constants);
+
+        if (!IndexBufferBound || Batch.IndexWidth != BoundWidth)
+        {
+            List.SetIndexBuffer(Batch.IndexWidth);
+            BoundWidth = Batch.IndexWidth;
+            IndexBufferBound = true;
+        }
+
+        // SV_InstanceID ignores StartInstanceLocation, the offset comes from the constants
+        List.DrawIndexedInstanced(Batch.IndexCount, Batch.InstanceCount, Batch.StartIndexLocation,
+            Batch.BaseVertexLocation);
+    }
+}
+
+ParallelDrawRecorder::ParallelDrawRecorder(JobSystem* Jobs, uint32_t MaxChunks, uint32_t MinBatchesPerChunk)
+    : m_Jobs(Jobs)
+    , m_MaxChunks(!Jobs ? 1 : (MaxChunks ? MaxChunks : Jobs->GetThreadCount()))
+    , m_MinBatchesPerChunk(std::max(1u, MinBatchesPerChunk))
+{
+}
+
+uint32_t ParallelDrawRecorder::GetChunkCount(size_t BatchCount) const
+{
+    const size_t Chunks = BatchCount / m_MinBatchesPerChunk;
+    return static_cast<uint32_t>(std::max<size_t>(1, std::min<size_t>(Chunks, m_MaxChunks)));
+}
+
+void ParallelDrawRecorder::Record(const std::vector<DrawBatch>& Batches, DrawCommandList* const* Lists) const
+{
+    const uint32_t ChunkCount = GetChunkCount(Batches.size());
+    const size_t BatchesPerChunk = (Batches.size() + ChunkCount - 1) / ChunkCount;
+    auto RecordChunk = [&](uint32_t Chunk) {
+        RACOON_PROFILE_SCOPE("RecordChunk");
+        const size_t First = std::min(Batches.size(), Chunk * BatchesPerChunk);
+        const size_t Last = std::min(Batches.size(), First + BatchesPerChunk);
+        RecordBatches(Batches.data() + First, Last - First, *Lists[Chunk]);
+    };
+
+    if (ChunkCount == 1)
+    {
+        RecordChunk(0);
+        return;
+    }
+    m_Jobs->ParallelFor(ChunkCount, 1, [&](uint32_t First, uint32_t Last) {
+        for (uint32_t Chunk = First; Chunk < Last; ++Chunk)
+            RecordChunk(Chunk);
+    });
+}
+
+} // namespace Racoon
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "CoreStdafx.h"
+#include "DrawBatcher.h"
+#include "JobSystem.h"
+
+namespace Racoon {
+
+// Root constants of one instanced draw, matches cbPerBatch in default_vertex.hlsl
+struct BatchConstants
+{
+    XMFLOAT3 QuantOffset;
+    uint32_t FirstInstance;
+    XMFLOAT3 QuantScale;
+    float Pad;
+};
+
+// The commands draw recording emits. The renderer forwards them to an
+// ID3D12GraphicsCommandList, headless code can log or count them.
+class DrawCommandList
+{
+public:
+    virtual ~DrawCommandList() = default;
+
+    // Called once before the first draw of a chunk. A list starts without
+    // state, so this binds whatever the chunk's draws share.
+    virtual void Begin() = 0;
+    // PipelineState indexes the renderer's pipeline states. Both arrive
+    // together since a D3D12 pipeline state fixes the topology type.
+    virtual void SetPipelineState(uint16_t PipelineState, PrimitiveTopology Topology) = 0;
+    virtual void SetBatchConstants(const BatchConstants& Constants) = 0;
+    virtual void SetIndexBuffer(IndexFormat Width) = 0;
+    virtual void DrawIndexedInstanced(uint32_t IndexCount, uint32_t InstanceCount, uint32_t StartIndexLocation,
+        uint32_t BaseVertexLocation) = 0;
+};
+
+// Records Count batches into List: Begin, then per batch the pipeline state
+// when it or the topology changes, its constants, the index buffer when the
+// width changes, and the draw.
+void RecordBatches(const DrawBatch* Batches, size_t Count, DrawCommandList& List);
+
+// Splits the batches into contiguous chunks and records chunk i into list i,
+// each as a job. Executing the lists in order draws exactly what
+// RecordBatches into a single list would. Lists must be safe to record
+// concurrently, which separate D3D12 command lists are.
+class ParallelDrawRecorder
+{
+public:
+    // MaxChunks caps the lists used, 0 picks Jobs->GetThreadCount(). A chunk
+    // gets at least MinBatchesPerChunk batches since small ones are not worth
+    // a job. Without Jobs there is always a single chunk.
+    explicit ParallelDrawRecorder(JobSystem* Jobs = nullptr, uint32_t MaxChunks = 0,
+        uint32_t MinBatchesPerChunk = 128);
+
+    uint32_t GetMaxChunks() const { return m_MaxChunks; }
+    uint32_t GetChunkCount(size_t BatchCount) const;
+
+    // Lists holds GetChunkCount(Batches.size()) lists. The calling thread
+    // records chunks too and returns once every chunk is recorded.
+    void Record(const std::vector<DrawBatch>& Batches, DrawCommandList* const* Lists) const;
+
+private:
+    JobSystem* m_Jobs;
+    uint32_t m_MaxChunks;
+    uint32_t m_MinBatchesPerChunk;
+};
+
+} // namespace Racoon
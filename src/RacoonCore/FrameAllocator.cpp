@@ -0,0 +1,129 @@
+#include "CoreStdafx.h"
+
+#include "FrameAllocator.h"
+#include "JobSystem.h"
+
+#include <cstring>
+
+namespace Racoon {
+
+namespace {
+
+unsigned char* AlignUp(unsigned char* Pointer, size_t Alignment)
+{
+    const uintptr_t Address = reinterpret_cast<uintptr_t>(Pointer);
+    return Pointer + ((Alignment - Address % Alignment) % Alignment);
+}
+
+} // namespace
+
+LinearArena::LinearArena(size_t BlockSize)
+    : m_BlockSize(BlockSize)
+{
+}
+
+void* LinearArena::Allocate(size_t Size, size_t Alignment)
+{
+    assert(Alignment && (Alignment & (Alignment - 1)) == 0 && "Alignment must be a power of two");
+
+    unsigned char* Result = m_Cursor ? AlignUp(m_Cursor, Alignment) : nullptr;
+    if (!Result || Size > static_cast<size_t>(m_End - Result))
+    {
+        AddBlock(Size, Alignment);
+        Result = AlignUp(m_Cursor, Alignment);
+    }
+
+    m_Cursor = Result + Size;
+    m_Stats.BytesUsed = m_FullBlocksUsed + static_cast<size_t>(m_Cursor - m_Blocks.back().Memory.get());
+    m_Stats.HighWaterMark = std::max(m_Stats.HighWaterMark, m_Stats.BytesUsed);
+    return Result;
+}
+
+void LinearArena::AddBlock(size_t Size, size_t Alignment)
+{
+    // The rest of the current block is skipped, counting it keeps the
+    // high-water mark an honest size for the single block Reset makes
+    if (!m_Blocks.empty())
+        m_FullBlocksUsed += m_Blocks.back().Size;
+
+    Block NewBlock;
+    NewBlock.Size = std::max(m_BlockSize, Size + Alignment);
+    NewBlock.Memory.reset(new unsigned char[NewBlock.Size]);
+    m_Cursor = NewBlock.Memory.get();
+    m_End = m_Cursor + NewBlock.Size;
+    m_Stats.Capacity += NewBlock.Size;
+    ++m_Stats.HeapAllocations;
+    m_Blocks.push_back(std::move(NewBlock));
+}
+
+void LinearArena::Reset()
+{
+    if (m_Blocks.empty())
+        return;
+
+    // Outgrew one block: trade the chain for a block the size of the peak
+    if (m_Blocks.size() > 1)
+    {
+        m_BlockSize = std::max(m_BlockSize, m_Stats.HighWaterMark);
+        m_Blocks.clear();
+        m_Stats.Capacity = 0;
+        m_FullBlocksUsed = 0;
+        AddBlock(0, 1);
+        if (m_Poison)
+            std::memset(m_Blocks.front().Memory.get(), PoisonByte, m_Blocks.front().Size);
+    }
+    else if (m_Poison)
+    {
+        std::memset(m_Blocks.front().Memory.get(), PoisonByte, m_Cursor - m_Blocks.front().Memory.get());
+    }
+
+    m_Cursor = m_Blocks.front().Memory.get();
+    m_End = m_Cursor + m_Blocks.front().Size;
+    m_Stats.BytesUsed = 0;
+}
+
+FrameAllocator::FrameAllocator(uint32_t FramesInFlight, uint32_t ThreadCount, size_t BlockSize)
+    : m_FramesInFlight(FramesInFlight)
+    , m_ThreadCount(ThreadCount)
+{
+    assert(FramesInFlight > 0 && ThreadCount > 0);
+    m_Arenas.reserve(FramesInFlight * ThreadCount);
+    for (uint32_t i = 0; i < FramesInFlight * ThreadCount; ++i)
+        m_Arenas.push_back(std::make_unique<LinearArena>(BlockSize));
+}
+
+void FrameAllocator::BeginFrame()
+{
+    m_Frame = (m_Frame + 1) % m_FramesInFlight;
+    for (uint32_t Thread = 0; Thread < m_ThreadCount; ++Thread)
+        GetArena(Thread).Reset();
+}
+
+LinearArena& FrameAllocator::GetThreadArena(const JobSystem& Jobs)
+{
+    const uint32_t Worker = Jobs.GetWorkerIndex();
+    assert(Worker < m_ThreadCount && "Calling thread has no arena");
+    return GetArena(Worker);
+}
+
+void FrameAllocator::SetPoisonFreedMemory(bool Poison)
+{
+    for (auto& Arena : m_Arenas)
+        Arena->SetPoisonFreedMemory(Poison);
+}
+
+ArenaStats FrameAllocator::GetStats() const
+{
+    ArenaStats Total;
+    for (const auto& Arena : m_Arenas)
+    {
+        const ArenaStats& Stats = Arena->GetStats();
+        Total.BytesUsed += Stats.BytesUsed;
+        Total.HighWaterMark += Stats.HighWaterMark;
+        Total.Capacity += Stats.Capacity;
+        Total.HeapAllocations += Stats.HeapAllocations;
+    }
+    return Total;
+}
+
+} // namespace Racoon
@@ -0,0 +1,120 @@
+#pragma once
+
+#include "CoreStdafx.h"
+
+#include <cstddef>
+#include <memory_resource>
+
+namespace Racoon {
+
+class JobSystem;
+
+struct ArenaStats
+{
+    // Allocated since the last Reset
+    size_t BytesUsed{ 0 };
+    // Most bytes allocated between two Resets
+    size_t HighWaterMark{ 0 };
+    // Bytes held in blocks
+    size_t Capacity{ 0 };
+    // Blocks taken from the heap since construction. Stops growing once the
+    // arena has reached its steady-state size.
+    uint64_t HeapAllocations{ 0 };
+};
+
+// Bump allocator for data that dies together. Allocation moves a cursor,
+// deallocation does nothing and Reset frees everything at once. When a block
+// runs out another is chained on; the next Reset replaces the chain with a
+// single block big enough for all of it, so a workload of stable size stops
+// touching the heap after its first frames.
+//
+// Usable as a std::pmr::memory_resource, e.g. std::pmr::vector<T> V(&Arena).
+// Not thread safe: give every thread its own arena.
+class alignas(64) LinearArena final : public std::pmr::memory_resource
+{
+public:
+    explicit LinearArena(size_t BlockSize = 64 * 1024);
+
+    LinearArena(const LinearArena&) = delete;
+    LinearArena& operator=(const LinearArena&) = delete;
+
+    void* Allocate(size_t Size, size_t Alignment = alignof(std::max_align_t));
+    // Uninitialized storage for Count objects of T
+    template<typename T>
+    T* AllocateArray(size_t Count) { return static_cast<T*>(Allocate(Count * sizeof(T), alignof(T))); }
+
+    // Frees everything allocated so far. Destructors are not run.
+    void Reset();
+
+    // Fills freed memory with PoisonByte on Reset, so reads through stale
+    // pointers show up as garbage instead of last frame's data. On by
+    // default in debug builds.
+    static constexpr unsigned char PoisonByte = 0xDD;
+    void SetPoisonFreedMemory(bool Poison) { m_Poison = Poison; }
+
+    const ArenaStats& GetStats() const { return m_Stats; }
+
+protected:
+    void* do_allocate(size_t Bytes, size_t Alignment) override { return Allocate(Bytes, Alignment); }
+    void do_deallocate(void*, size_t, size_t) override {}
+    bool do_is_equal(const std::pmr::memory_resource& Other) const noexcept override { return this == &Other; }
+
+private:
+    struct Block
+    {
+        std::unique_ptr<unsigned char[]> Memory;
+        size_t Size;
+    };
+
+    // Chains a block that fits Size bytes at Alignment
+    void AddBlock(size_t Size, size_t Alignment);
+
+    size_t m_BlockSize;
+    std::vector<Block> m_Blocks;
+    unsigned char* m_Cursor{ nullptr };
+    unsigned char* m_End{ nullptr };
+    // Bytes of the blocks before the current one, used or skipped
+    size_t m_FullBlocksUsed{ 0 };
+#ifdef NDEBUG
+    bool m_Poison{ false };
+#else
+    bool m_Poison{ true };
+#endif
+    ArenaStats m_Stats;
+};
+
+// Transient CPU memory for per-frame work: one set of arenas per frame in
+// flight, one arena per thread in each set. BeginFrame frees the set the
+// frame about to start last used, FramesInFlight frames ago, so data handed
+// to the GPU or to a later frame stays valid until the GPU is done with it.
+// Threads only touch their own arena and never contend.
+class FrameAllocator
+{
+public:
+    explicit FrameAllocator(uint32_t FramesInFlight = 1, uint32_t ThreadCount = 1, size_t BlockSize = 256 * 1024);
+
+    void BeginFrame();
+
+    // Arena of thread Thread in the current frame
+    LinearArena& GetArena(uint32_t Thread = 0) { return *m_Arenas[m_Frame * m_ThreadCount + Thread]; }
+    // Arena of the calling thread, which must be one of Jobs' workers.
+    // ThreadCount must be at least Jobs.GetThreadCount().
+    LinearArena& GetThreadArena(const JobSystem& Jobs);
+
+    void SetPoisonFreedMemory(bool Poison);
+
+    uint32_t GetFramesInFlight() const { return m_FramesInFlight; }
+    uint32_t GetThreadCount() const { return m_ThreadCount; }
+    // Summed over every arena of every frame. HighWaterMark is the sum of the
+    // arenas' marks, an upper bound on what one frame ever needed.
+    ArenaStats GetStats() const;
+
+private:
+    uint32_t m_FramesInFlight;
+    uint32_t m_ThreadCount;
+    uint32_t m_Frame{ 0 };
+    // Frame-major: frame f, thread t is m_Arenas[f * m_ThreadCount + t]
+    std::vector<std::unique_ptr<LinearArena>> m_Arenas;
+};
+
+} // namespace Racoon
@@ -0,0 +1,167 @@
+#include "CoreStdafx.h"
+
+#include "FramePacer.h"
+
+#include <thread>
+
+namespace Racoon {
+
+namespace {
+
+using namespace std::chrono_literals;
+
+// Never spin less than this, sleep_for is rarely more precise
+constexpr FramePacer::Clock::duration MinSpinMargin = 200us;
+// A Windows timer tick at the default resolution
+constexpr FramePacer::Clock::duration InitialSpinMargin = 2ms;
+// A hitch, a debugger pause or a wake from sleep can oversleep by seconds;
+// beyond this the margin would keep every later wait from sleeping at all
+constexpr FramePacer::Clock::duration MaxSpinMargin = 2ms;
+
+double ToMilliseconds(FramePacer::Clock::duration Duration)
+{
+    return std::chrono::duration<double, std::milli>(Duration).count();
+}
+
+} // namespace
+
+FramePacer::FramePacer(double TargetFps)
+    : m_SpinMargin(InitialSpinMargin)
+{
+    SetTargetFps(TargetFps);
+}
+
+void FramePacer::SetTargetFps(double TargetFps)
+{
+    // Cheap to call every frame, only a change resets the schedule
+    TargetFps = std::max(0.0, TargetFps);
+    if (TargetFps == m_TargetFps && m_Started)
+        return;
+    m_TargetFps = TargetFps;
+    m_Period = m_TargetFps > 0.0
+        ? std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / m_TargetFps))
+        : Clock::duration::zero();
+    // The old schedule may be far off with the new period
+    m_NextDeadline = m_LastFrameStart + m_Period;
+}
+
+void FramePacer::SleepUntil(Clock::time_point Deadline)
+{
+    // Never more than half a period, so a short period still sleeps
+    const Clock::duration Cap = std::max(MinSpinMargin, std::min(MaxSpinMargin, m_Period / 2));
+    m_SpinMargin = std::min(m_SpinMargin, Cap);
+    bool Slept = false;
+    for (;;)
+    {
+        const Clock::time_point Now = Clock::now();
+        const Clock::duration Remaining = Deadline - Now;
+        if (Remaining <= m_SpinMargin)
+        {
+            // A wait that only spins decays the margin too, or a large one would never shrink
+            if (!Slept)
+                m_SpinMargin = std::max(MinSpinMargin, m_SpinMargin - (m_SpinMargin - MinSpinMargin) / 16);
+            break;
+        }
+
+        // Sleep all but the margin, then learn from how late the OS woke us
+        const Clock::duration Request = Remaining - m_SpinMargin;
+        std::this_thread::sleep_for(Request);
+        const Clock::duration Oversleep = Clock::now() - Now - Request;
+        // Grows at once, shrinks slowly, so one lucky wake does not make the next one late
+        if (Oversleep > m_SpinMargin)
+            m_SpinMargin = std::min(Oversleep, Cap);
+        else
+            m_SpinMargin = std::max(MinSpinMargin, m_SpinMargin - (m_SpinMargin - Oversleep) / 16);
+        Slept = true;
+    }
+
+    while (Clock::now() < Deadline)
+        std::this_thread::yield();
+}
+
+void FramePacer::WaitForNextFrame()
+{
+    bool Missed = false;
+    if (m_Started && m_Period > Clock::duration::zero())
+    {
+        Missed = Clock::now() > m_NextDeadline;
+        if (!Missed)
+            SleepUntil(m_NextDeadline);
+    }
+
+    const Clock::time_point Now = Clock::now();
+    if (m_Started)
+    {
+        m_Intervals[m_HistoryNext] = ToMilliseconds(Now - m_LastFrameStart);
+        m_WakeErrors[m_HistoryNext] = m_Period > Clock::duration::zero() && !Missed
+            ? ToMilliseconds(Now - m_NextDeadline) : 0.0;
+        m_Missed[m_HistoryNext] = Missed;
+        m_HistoryNext = (m_HistoryNext + 1) % HistoryFrames;
+        m_HistoryCount = std::min(m_HistoryCount + 1, HistoryFrames);
+    }
+
+    // On time, keep the phase so small wake errors do not accumulate. Late,
+    // restart the schedule from now.
+    m_NextDeadline = Missed || !m_Started ? Now + m_Period : m_NextDeadline + m_Period;
+    m_LastFrameStart = Now;
+    m_Started = true;
+}
+
+FramePacingStats FramePacer::GetStats() const
+{
+    FramePacingStats Stats;
+    Stats.TargetMs = ToMilliseconds(m_Period);
+    Stats.Frames = m_HistoryCount;
+    if (!m_HistoryCount)
+        return Stats;
+
+    double IntervalSum = 0.0;
+    double WakeSum = 0.0;
+    for (uint32_t i = 0; i < m_HistoryCount; ++i)
+    {
+        IntervalSum += m_Intervals[i];
+        WakeSum += m_WakeErrors[i];
+        Stats.MaxWakeErrorMs = std::max(Stats.MaxWakeErrorMs, m_WakeErrors[i]);
+        Stats.MissedFrames += m_Missed[i] ? 1 : 0;
+    }
+    Stats.MeanIntervalMs = IntervalSum / m_HistoryCount;
+    Stats.MeanWakeErrorMs = WakeSum / m_HistoryCount;
+
+    double Variance = 0.0;
+    for (uint32_t i = 0; i < m_HistoryCount; ++i)
+    {
+        const double Deviation = m_Intervals[i] - Stats.MeanIntervalMs;
+        Variance += Deviation * Deviation;
+        Stats.MaxDeviationMs = std::max(Stats.MaxDeviationMs, std::abs(Deviation));
+    }
+    Stats.JitterMs = std::sqrt(Variance / m_HistoryCount);
+    return Stats;
+}
+
+void FramePacer::ResetStats()
+{
+    m_HistoryCount = 0;
+    m_HistoryNext = 0;
+}
+
+FixedTimestep::FixedTimestep(double StepSeconds, uint32_t MaxStepsPerFrame)
+    : m_Step(StepSeconds)
+    , m_MaxSteps(std::max(1u, MaxStepsPerFrame))
+{
+    assert(StepSeconds > 0.0);
+}
+
+uint32_t FixedTimestep::Advance(double DeltaSeconds)
+{
+    m_Accumulator += std::max(0.0, DeltaSeconds);
+    const double Due = std::floor(m_Accumulator / m_Step);
+    m_Accumulator = std::max(0.0, m_Accumulator - Due * m_Step);
+
+    // Beyond the cap whole steps are dropped; the fraction stays, so alpha
+    // keeps moving smoothly
+    const uint32_t Steps = static_cast<uint32_t>(std::min<double>(Due, m_MaxSteps));
+    m_Dropped += (Due - Steps) * m_Step;
+    return Steps;
+}
+
+} // namespace Racoon
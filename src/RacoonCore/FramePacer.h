@@ -0,0 +1,104 @@
+#pragma once
+
+#include "CoreStdafx.h"
+
+#include <chrono>
+
+namespace Racoon {
+
+// How evenly frames start, over the pacer's recent frames
+struct FramePacingStats
+{
+    double TargetMs{ 0 };
+    // Start-to-start interval between frames
+    double MeanIntervalMs{ 0 };
+    // Standard deviation of the interval: the stutter a player feels
+    double JitterMs{ 0 };
+    // Worst deviation of an interval from the mean
+    double MaxDeviationMs{ 0 };
+    // How late WaitForNextFrame returned past its deadline
+    double MeanWakeErrorMs{ 0 };
+    double MaxWakeErrorMs{ 0 };
+    // Frames that were already past their deadline when they finished
+    uint32_t MissedFrames{ 0 };
+    uint32_t Frames{ 0 };
+};
+
+// Caps the frame rate and measures how evenly frames start. Call
+// WaitForNextFrame at the top of the frame, before input is read, so the
+// waiting happens before the frame's inputs are sampled rather than
+// between input and present.
+//
+// Waiting sleeps while the deadline is further away than the OS timer's
+// observed oversleep, then spins the rest, which lands within a few
+// microseconds of the deadline. A frame that overran starts immediately
+// and the schedule restarts from it instead of rushing to catch up.
+class FramePacer
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // 0 leaves the frame rate uncapped, but still measures jitter
+    explicit FramePacer(double TargetFps = 0.0);
+
+    void SetTargetFps(double TargetFps);
+    double GetTargetFps() const { return m_TargetFps; }
+
+    // Blocks until the next frame is due and starts it
+    void WaitForNextFrame();
+
+    // Over the last HistoryFrames frames
+    FramePacingStats GetStats() const;
+    void ResetStats();
+
+    static constexpr uint32_t HistoryFrames = 128;
+
+private:
+    void SleepUntil(Clock::time_point Deadline);
+
+    double m_TargetFps{ 0.0 };
+    Clock::duration m_Period{ 0 };
+    Clock::time_point m_NextDeadline;
+    Clock::time_point m_LastFrameStart;
+    bool m_Started{ false };
+
+    // Largest recent oversleep of sleep_for, spun instead of slept. Starts
+    // at a Windows timer tick and adapts to what the OS actually delivers,
+    // up to a tick or half a period.
+    Clock::duration m_SpinMargin;
+
+    // Rings of the latest frames
+    double m_Intervals[HistoryFrames]{};
+    double m_WakeErrors[HistoryFrames]{};
+    bool m_Missed[HistoryFrames]{};
+    uint32_t m_HistoryCount{ 0 };
+    uint32_t m_HistoryNext{ 0 };
+};
+
+// Runs simulation at a fixed rate independent of the frame rate. Each
+// frame, Advance returns how many steps to simulate; rendering blends the
+// last two simulated states by GetAlpha. Steps per frame are capped so a
+// long stall cannot make the simulation fall further and further behind.
+class FixedTimestep
+{
+public:
+    explicit FixedTimestep(double StepSeconds = 1.0 / 60.0, uint32_t MaxStepsPerFrame = 8);
+
+    // Adds a frame's delta and returns the steps due
+    uint32_t Advance(double DeltaSeconds);
+
+    double GetStep() const { return m_Step; }
+    // Fraction of a step left over, in [0, 1): how far between the previous
+    // and the current simulated state the rendered frame is
+    double GetAlpha() const { return m_Accumulator / m_Step; }
+    // Simulated time discarded because of the step cap
+    double GetDroppedTime() const { return m_Dropped; }
+
+private:
+    double m_Step;
+    uint32_t m_MaxSteps;
+    double m_Accumulator{ 0.0 };
+    double m_Dropped{ 0.0 };
+};
+
+} // namespace Racoon
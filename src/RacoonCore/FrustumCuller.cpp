@@ -0,0 +1,199 @@
+#include "CoreStdafx.h"
+
+#include "FrustumCuller.h"
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define RACOON_AVX 1
+#elif defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define RACOON_SSE2 1
+#endif
+
+namespace Racoon {
+
+namespace {
+
+// Arrays are padded to this many boxes so every batch is a full load
+constexpr uint32_t CullBatchWidth = 8;
+
+XMFLOAT4 NormalizePlane(const math::Vector4& Plane)
+{
+    const float Length = std::sqrt(Plane.getX() * Plane.getX() + Plane.getY() * Plane.getY() +
+        Plane.getZ() * Plane.getZ());
+    const float InvLength = Length > 0.f ? 1.f / Length : 0.f;
+    return XMFLOAT4(Plane.getX() * InvLength, Plane.getY() * InvLength, Plane.getZ() * InvLength,
+        Plane.getW() * InvLength);
+}
+
+math::Vector4 Add(const math::Vector4& a, const math::Vector4& b)
+{
+    return math::Vector4(a.getX() + b.getX(), a.getY() + b.getY(), a.getZ() + b.getZ(), a.getW() + b.getW());
+}
+
+math::Vector4 Subtract(const math::Vector4& a, const math::Vector4& b)
+{
+    return math::Vector4(a.getX() - b.getX(), a.getY() - b.getY(), a.getZ() - b.getZ(), a.getW() - b.getW());
+}
+
+// Plane coefficients splatted for the SIMD loop. Abs* are |normal|, which
+// project the box extents onto the normal.
+struct PlaneSoA
+{
+    float X[6], Y[6], Z[6], W[6];
+    float AbsX[6], AbsY[6], AbsZ[6];
+};
+
+PlaneSoA SplitPlanes(const Frustum& View)
+{
+    PlaneSoA Planes;
+    for (int p = 0; p < 6; ++p)
+    {
+        const XMFLOAT4& Plane = View.Planes[p];
+        Planes.X[p] = Plane.x;
+        Planes.Y[p] = Plane.y;
+        Planes.Z[p] = Plane.z;
+        Planes.W[p] = Plane.w;
+        Planes.AbsX[p] = std::fabs(Plane.x);
+        Planes.AbsY[p] = std::fabs(Plane.y);
+        Planes.AbsZ[p] = std::fabs(Plane.z);
+    }
+    return Planes;
+}
+
+} // namespace
+
+Frustum Frustum::FromViewProjection(const math::Matrix4& ViewProj)
+{
+    const math::Vector4 Row0 = ViewProj.getRow(0);
+    const math::Vector4 Row1 = ViewProj.getRow(1);
+    const math::Vector4 Row2 = ViewProj.getRow(2);
+    const math::Vector4 Row3 = ViewProj.getRow(3);
+
+    Frustum Result;
+    Result.Planes[0] = NormalizePlane(Add(Row3, Row0));
+    Result.Planes[1] = NormalizePlane(Subtract(Row3, Row0));
+    Result.Planes[2] = NormalizePlane(Add(Row3, Row1));
+    Result.Planes[3] = NormalizePlane(Subtract(Row3, Row1));
+    Result.Planes[4] = NormalizePlane(Add(Row3, Row2));
+    Result.Planes[5] = NormalizePlane(Subtract(Row3, Row2));
+    return Result;
+}
+
+void FrustumCuller::Resize(uint32_t Count)
+{
+    m_Count = Count;
+    const size_t Padded = (static_cast<size_t>(Count) + CullBatchWidth - 1) / CullBatchWidth * CullBatchWidth;
+    for (std::vector<float>* Array : { &m_CenterX, &m_CenterY, &m_CenterZ, &m_ExtentX, &m_ExtentY, &m_ExtentZ })
+        Array->resize(Padded, 0.f);
+}
+
+void FrustumCuller::SetBounds(uint32_t Index, const Bounds& WorldBounds)
+{
+    assert(Index < m_Count);
+    m_CenterX[Index] = WorldBounds.Center.x;
+    m_CenterY[Index] = WorldBounds.Center.y;
+    m_CenterZ[Index] = WorldBounds.Center.z;
+    m_ExtentX[Index] = WorldBounds.Extents.x;
+    m_ExtentY[Index] = WorldBounds.Extents.y;
+    m_ExtentZ[Index] = WorldBounds.Extents.z;
+}
+
+void FrustumCuller::SetBounds(const std::vector<std::shared_ptr<RenderItem>>& Items)
+{
+    Resize(static_cast<uint32_t>(Items.size()));
+    for (uint32_t i = 0; i < m_Count; ++i)
+        SetBounds(i, Items[i]->GetWorldBounds());
+}
+
+void FrustumCuller::Cull(const Frustum& View, std::vector<uint32_t>& Visible)
+{
+    const PlaneSoA Planes = SplitPlanes(View);
+
+    // Every lane writes its index and the cursor only advances for visible
+    // ones, so there is no branch per box
+    Visible.resize(static_cast<size_t>(m_Count) + CullBatchWidth);
+    uint32_t* Out = Visible.data();
+
+    for (uint32_t Base = 0; Base < m_Count; Base += CullBatchWidth)
+    {
+        uint32_t InsideMask = 0;
+#if defined(RACOON_AVX)
+        const __m256 Cx = _mm256_loadu_ps(&m_CenterX[Base]);
+        const __m256 Cy = _mm256_loadu_ps(&m_CenterY[Base]);
+        const __m256 Cz = _mm256_loadu_ps(&m_CenterZ[Base]);
+        const __m256 Ex = _mm256_loadu_ps(&m_ExtentX[Base]);
+        const __m256 Ey = _mm256_loadu_ps(&m_ExtentY[Base]);
+        const __m256 Ez = _mm256_loadu_ps(&m_ExtentZ[Base]);
+
+        // A box is outside when center distance + projected extent < 0 for any plane
+        __m256 Outside = _mm256_setzero_ps();
+        for (int p = 0; p < 6; ++p)
+        {
+            __m256 Distance = _mm256_add_ps(_mm256_mul_ps(Cx, _mm256_set1_ps(Planes.X[p])), _mm256_set1_ps(Planes.W[p]));
+            Distance = _mm256_add_ps(Distance, _mm256_mul_ps(Cy, _mm256_set1_ps(Planes.Y[p])));
+            Distance = _mm256_add_ps(Distance, _mm256_mul_ps(Cz, _mm256_set1_ps(Planes.Z[p])));
+            Distance = _mm256_add_ps(Distance, _mm256_mul_ps(Ex, _mm256_set1_ps(Planes.AbsX[p])));
+            Distance = _mm256_add_ps(Distance, _mm256_mul_ps(Ey, _mm256_set1_ps(Planes.AbsY[p])));
+            Distance = _mm256_add_ps(Distance, _mm256_mul_ps(Ez, _mm256_set1_ps(Planes.AbsZ[p])));
+            Outside = _mm256_or_ps(Outside, _mm256_cmp_ps(Distance, _mm256_setzero_ps(), _CMP_LT_OQ));
+        }
+        InsideMask = ~static_cast<uint32_t>(_mm256_movemask_ps(Outside)) & 0xFFu;
+#elif defined(RACOON_SSE2)
+        for (uint32_t Half = 0; Half < CullBatchWidth; Half += 4)
+        {
+            const uint32_t i = Base + Half;
+            const __m128 Cx = _mm_loadu_ps(&m_CenterX[i]);
+            const __m128 Cy = _mm_loadu_ps(&m_CenterY[i]);
+            const __m128 Cz = _mm_loadu_ps(&m_CenterZ[i]);
+            const __m128 Ex = _mm_loadu_ps(&m_ExtentX[i]);
+            const __m128 Ey = _mm_loadu_ps(&m_ExtentY[i]);
+            const __m128 Ez = _mm_loadu_ps(&m_ExtentZ[i]);
+
+            __m128 Outside = _mm_setzero_ps();
+            for (int p = 0; p < 6; ++p)
+            {
+                __m128 Distance = _mm_add_ps(_mm_mul_ps(Cx, _mm_set1_ps(Planes.X[p])), _mm_set1_ps(Planes.W[p]));
+                Distance = _mm_add_ps(Distance, _mm_mul_ps(Cy, _mm_set1_ps(Planes.Y[p])));
+                Distance = _mm_add_ps(Distance, _mm_mul_ps(Cz, _mm_set1_ps(Planes.Z[p])));
+                Distance = _mm_add_ps(Distance, _mm_mul_ps(Ex, _mm_set1_ps(Planes.AbsX[p])));
+                Distance = _mm_add_ps(Distance, _mm_mul_ps(Ey, _mm_set1_ps(Planes.AbsY[p])));
+                Distance = _mm_add_ps(Distance, _mm_mul_ps(Ez, _mm_set1_ps(Planes.AbsZ[p])));
+                Outside = _mm_or_ps(Outside, _mm_cmplt_ps(Distance, _mm_setzero_ps()));
+            }
+            InsideMask |= (~static_cast<uint32_t>(_mm_movemask_ps(Outside)) & 0xFu) << Half;
+        }
+#else
+        for (uint32_t Lane = 0; Lane < CullBatchWidth; ++Lane)
+        {
+            const uint32_t i = Base + Lane;
+            bool Inside = true;
+            for (int p = 0; p < 6; ++p)
+            {
+                const float Distance = m_CenterX[i] * Planes.X[p] + m_CenterY[i] * Planes.Y[p] +
+                    m_CenterZ[i] * Planes.Z[p] + Planes.W[p] + m_ExtentX[i] * Planes.AbsX[p] +
+                    m_ExtentY[i] * Planes.AbsY[p] + m_ExtentZ[i] * Planes.AbsZ[p];
+                Inside &= Distance >= 0.f;
+            }
+            InsideMask |= static_cast<uint32_t>(Inside) << Lane;
+        }
+#endif
+        // Drop the padding lanes of the last batch
+        const uint32_t Lanes = std::min(CullBatchWidth, m_Count - Base);
+        InsideMask &= (1u << Lanes) - 1;
+
+        for (uint32_t Lane = 0; Lane < CullBatchWidth; ++Lane)
+        {
+            *Out = Base + Lane;
+            Out += (InsideMask >> Lane) & 1;
+        }
+    }
+
+    const uint32_t VisibleCount = static_cast<uint32_t>(Out - Visible.data());
+    Visible.resize(VisibleCount);
+
+    m_Stats.Tested += m_Count;
+    m_Stats.Culled += m_Count - VisibleCount;
+}
+
+} // namespace Racoon
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "CoreStdafx.h"
+#include "RenderItem.h"
+
+namespace Racoon {
+
+// Six planes (xyz normal pointing inside, w distance) in the order left,
+// right, bottom, top, near, far. A point p is inside when dot(n, p) + w >= 0.
+struct Frustum
+{
+    XMFLOAT4 Planes[6];
+
+    // Extracts the planes from a column-vector view-projection matrix
+    // (clip = ViewProj * p), as built from Camera::GetProjection() * GetView().
+    // The near plane is taken as -w <= z, which holds for both the D3D and GL
+    // depth ranges and so never culls anything visible.
+    static Frustum FromViewProjection(const math::Matrix4& ViewProj);
+};
+
+// Objects considered and rejected by culling, summed over queries
+struct CullingStats
+{
+    uint64_t Tested{ 0 };
+    uint64_t Culled{ 0 };
+};
+
+// Tests world-space AABBs against a frustum, 8 boxes per instruction with AVX
+// and 4 with SSE. Bounds are kept in SoA arrays owned by the culler; copy them
+// in with SetBounds whenever the items or their transforms change.
+class FrustumCuller
+{
+public:
+    // Takes the world bounds of every item, index i is Items[i]
+    void SetBounds(const std::vector<std::shared_ptr<RenderItem>>& Items);
+    void Resize(uint32_t Count);
+    void SetBounds(uint32_t Index, const Bounds& WorldBounds);
+    uint32_t GetCount() const { return m_Count; }
+
+    // Fills Visible with the indices of the boxes intersecting the frustum,
+    // in increasing order, and adds to the counters
+    void Cull(const Frustum& View, std::vector<uint32_t>& Visible);
+
+    // Totals since the last ResetStats
+    const CullingStats& GetStats() const { return m_Stats; }
+    void ResetStats() { m_Stats = CullingStats(); }
+
+private:
+    uint32_t m_Count{ 0 };
+    // Padded to a multiple of the SIMD width; padding lanes are ignored
+    std::vector<float> m_CenterX, m_CenterY, m_CenterZ;
+    std::vector<float> m_ExtentX, m_ExtentY, m_ExtentZ;
+    CullingStats m_Stats;
+};
+
+} // namespace Racoon
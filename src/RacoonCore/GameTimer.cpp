@@ -0,0 +1,111 @@
+#include "CoreStdafx.h"
+
+#include "GameTimer.h"
+
+namespace Racoon {
+
+namespace {
+
+double ToSeconds(GameTimer::Clock::duration Duration)
+{
+    return std::chrono::duration<double>(Duration).count();
+}
+
+} // namespace
+
+GameTimer::GameTimer()
+{
+    // Every time point starts out valid, TotalTime is 0 until the first Tick
+    Reset();
+}
+
+float GameTimer::DeltaTime() const
+{
+    return static_cast<float>(m_DeltaTime);
+}
+
+float GameTimer::TotalTime() const
+{
+    if (m_IsStopped)
+    {
+        return static_cast<float>(ToSeconds(m_StopTime - m_PausedTime - m_BaseTime));
+    }
+    else
+    {
+        return static_cast<float>(ToSeconds(m_CurrentTime - m_PausedTime - m_BaseTime));
+    }
+}
+
+float GameTimer::SmoothedDeltaTime() const
+{
+    // Summed on demand, a running sum would drift over a long session
+    double Sum = 0.0;
+    for (uint32_t i = 0; i < m_RecentCount; ++i)
+        Sum += m_RecentDeltas[i];
+    return m_RecentCount ? static_cast<float>(Sum / m_RecentCount) : 0.f;
+}
+
+void GameTimer::Reset()
+{
+    const Clock::time_point currTime = Clock::now();
+
+    m_BaseTime = currTime;
+    m_PrevTime = currTime;
+    m_CurrentTime = currTime;
+    m_StopTime = currTime;
+    m_PausedTime = Clock::duration::zero();
+    m_DeltaTime = 0.0;
+    m_IsStopped = false;
+
+    m_RecentCount = 0;
+    m_RecentNext = 0;
+}
+
+void GameTimer::Start()
+{
+    // If we are resuming the timer
+    if (m_IsStopped)
+    {
+        const Clock::time_point startTime = Clock::now();
+        m_PausedTime += startTime - m_StopTime;
+        // as we are starting the timer back up,
+        // the current m_PrevTime occurred while paused.
+        // So it's not valid
+        m_PrevTime = startTime;
+        m_CurrentTime = startTime;
+
+        m_IsStopped = false;
+    }
+}
+
+void GameTimer::Stop()
+{
+    if (!m_IsStopped)
+    {
+        m_StopTime = Clock::now();
+        m_IsStopped = true;
+    }
+}
+
+void GameTimer::Tick()
+{
+    if (m_IsStopped)
+    {
+        m_DeltaTime = 0.0;
+        return;
+    }
+
+    // Get the time this frame
+    m_CurrentTime = Clock::now();
+
+    // Time diff between this and prev. steady_clock never goes backwards.
+    m_DeltaTime = ToSeconds(m_CurrentTime - m_PrevTime);
+    // Prepare for the next frame
+    m_PrevTime = m_CurrentTime;
+
+    m_RecentDeltas[m_RecentNext] = std::min(m_DeltaTime, MaxDeltaTime);
+    m_RecentCount = std::min(m_RecentCount + 1, SmoothingFrames);
+    m_RecentNext = (m_RecentNext + 1) % SmoothingFrames;
+}
+
+}
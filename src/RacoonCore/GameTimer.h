@@ -0,0 +1,54 @@
+#pragma once
+
+#include "CoreStdafx.h"
+
+#include <chrono>
+
+namespace Racoon {
+
+// Frame clock on std::chrono::steady_clock, which is QueryPerformanceCounter
+// on Windows and clock_gettime(CLOCK_MONOTONIC) on Linux. Time spent stopped
+// does not count towards TotalTime.
+class GameTimer
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    GameTimer();
+
+    float DeltaTime() const; // seconds
+    float TotalTime() const; // total time elapsed since timer reset, minus stopped time
+    // Mean of the last SmoothingFrames deltas, each clamped to MaxDeltaTime.
+    // Steadier than DeltaTime for animation; a hitch nudges it instead of
+    // teleporting everything by a whole stall.
+    float SmoothedDeltaTime() const;
+
+    void Reset();
+    void Start();
+    void Stop();
+    void Tick();
+
+    bool IsStopped() const { return m_IsStopped; }
+
+    static constexpr uint32_t SmoothingFrames = 16;
+    // Longer deltas are taken for a stall, e.g. a breakpoint or window drag
+    static constexpr double MaxDeltaTime = 0.25;
+
+private:
+    double m_DeltaTime{ 0.0 };
+
+    Clock::time_point m_BaseTime; // supposed to be message loop start time
+    Clock::duration m_PausedTime{ 0 }; // accumulated paused time
+    Clock::time_point m_StopTime;
+    Clock::time_point m_PrevTime;
+    Clock::time_point m_CurrentTime;
+
+    bool m_IsStopped{ false };
+
+    // Ring of the latest clamped deltas
+    double m_RecentDeltas[SmoothingFrames]{};
+    uint32_t m_RecentCount{ 0 };
+    uint32_t m_RecentNext{ 0 };
+};
+
+}
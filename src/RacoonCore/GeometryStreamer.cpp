@@ -0,0 +1,156 @@
+#include "CoreStdafx.h"
+
+#include "GeometryStreamer.h"
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#elif defined(__linux__)
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace Racoon {
+
+namespace {
+
+// Loading is throughput work; on machines with few cores it must not take
+// time slices from the render thread
+void LowerThreadPriority()
+{
+#ifdef _WIN32
+    SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_BELOW_NORMAL);
+#elif defined(__linux__)
+    // Linux applies nice values per thread
+    setpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)), 10);
+#endif
+}
+
+} // namespace
+
+GeometryStreamer::GeometryStreamer(const GeometryStreamerOptions& Options) : m_Options(Options)
+{
+    assert(m_Options.LoaderThreads > 0 && m_Options.QueueCapacity > 0);
+    for (uint32_t i = 0; i < m_Options.LoaderThreads; ++i)
+        m_Loaders.emplace_back([this]() { LoaderMain(); });
+}
+
+GeometryStreamer::~GeometryStreamer()
+{
+    {
+        std::lock_guard<std::mutex> Lock(m_Mutex);
+        m_Stopping = true;
+    }
+    m_RequestQueued.notify_all();
+    m_SlotFreed.notify_all();
+    for (std::thread& Loader : m_Loaders)
+        Loader.join();
+}
+
+void GeometryStreamer::Request(uint32_t Id, LoadFunction Load)
+{
+    m_Pending.fetch_add(1, std::memory_order_relaxed);
+    {
+        std::lock_guard<std::mutex> Lock(m_Mutex);
+        m_Requests.push_back({ Id, std::move(Load) });
+    }
+    m_RequestQueued.notify_one();
+}
+
+bool GeometryStreamer::TryPop(StreamedMesh& Out)
+{
+    {
+        std::lock_guard<std::mutex> Lock(m_Mutex);
+        if (m_Finished.empty())
+            return false;
+        Out = std::move(m_Finished.front());
+        m_Finished.pop_front();
+    }
+    m_SlotFreed.notify_one();
+    m_Pending.fetch_sub(1, std::memory_order_release);
+    return true;
+}
+
+void GeometryStreamer::LoaderMain()
+{
+    LowerThreadPriority();
+    for (;;)
+    {
+        Job Current;
+        {
+            std::unique_lock<std::mutex> Lock(m_Mutex);
+            m_RequestQueued.wait(Lock, [this]() { return m_Stopping || !m_Requests.empty(); });
+            if (m_Stopping)
+                return;
+            Current = std::move(m_Requests.front());
+            m_Requests.pop_front();
+        }
+
+        // Everything the render thread would otherwise do per element
+        // happens here: building, encoding and narrowing the indices
+        StreamedMesh Finished;
+        Finished.Id = Current.Id;
+        auto Mesh = std::make_shared<MeshData>();
+        if (Current.Load(*Mesh, Finished.Error))
+        {
+            Finished.Vertices = PackVertices(*Mesh, m_Options.Encoding);
+            if (Mesh->FitsIndices16())
+                Mesh->GetIndices16();
+            if (m_Options.BuildLods)
+            {
+                // Serially: the other loaders keep the cores busy
+                std::vector<LodLevel> Chain = BuildLodChain(Mesh, m_Options.Lods);
+                for (size_t Level = 1; Level < Chain.size(); ++Level)
+                {
+                    MeshData& Lod = *Chain[Level].Mesh;
+                    Finished.LodVertices.push_back(PackVertices(Lod, m_Options.Encoding));
+                    if (Lod.FitsIndices16())
+                        Lod.GetIndices16();
+                    Finished.Lods.push_back(std::move(Chain[Level]));
+                }
+            }
+            Finished.Mesh = std::move(Mesh);
+        }
+
+        std::unique_lock<std::mutex> Lock(m_Mutex);
+        m_SlotFreed.wait(Lock, [this]() { return m_Stopping || m_Finished.size() < m_Options.QueueCapacity; });
+        if (m_Stopping)
+            return;
+        m_Finished.push_back(std::move(Finished));
+    }
+}
+
+ArenaResidency::ArenaResidency(uint32_t VertexStride, const uint64_t (&Capacities)[GeometryArenaCount])
+    : m_VertexStride(VertexStride)
+{
+    for (uint32_t i = 0; i < GeometryArenaCount; ++i)
+        m_Capacity[i] = Capacities[i];
+}
+
+uint64_t ArenaResidency::GetBacklog(const uint64_t (&Sizes)[GeometryArenaCount]) const
+{
+    uint64_t Backlog = 0;
+    for (uint32_t i = 0; i < GeometryArenaCount; ++i)
+    {
+        const uint64_t Copyable = std::min(Sizes[i], m_Capacity[i]);
+        Backlog += Copyable > m_Resident[i] ? Copyable - m_Resident[i] : 0;
+    }
+    return Backlog;
+}
+
+bool ArenaResidency::IsResident(const MeshRange& Range) const
+{
+    const bool Narrow = Range.IndexWidth == IndexFormat::Uint16;
+    const uint64_t IndexEnd = (uint64_t(Range.StartIndex) + Range.IndexCount) * (Narrow ? 2 : 4);
+    const uint64_t VertexEnd = (uint64_t(Range.BaseVertex) + Range.VertexCount) * m_VertexStride;
+    return VertexEnd <= m_Resident[static_cast<uint32_t>(GeometryArena::Vertices)] &&
+        IndexEnd <= m_Resident[static_cast<uint32_t>(Narrow ? GeometryArena::Indices16 : GeometryArena::Indices32)];
+}
+
+} // namespace Racoon
@@ -0,0 +1,180 @@
+#pragma once
+
+#include "CoreStdafx.h"
+#include "MeshGeometry.h"
+#include "MeshRegistry.h"
+#include "MeshSimplifier.h"
+#include "VertexPacking.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace Racoon {
+
+struct GeometryStreamerOptions
+{
+    // Threads that load and encode meshes
+    uint32_t LoaderThreads{ 2 };
+    // Finished meshes waiting for the render thread. Loaders block once it
+    // is full, so a slow consumer holds back loading instead of memory growing.
+    uint32_t QueueCapacity{ 8 };
+    VertexEncoding Encoding{ VertexEncoding::Full };
+    // Simplifies each loaded mesh into an LOD chain on the loader thread
+    bool BuildLods{ false };
+    LodChainOptions Lods;
+};
+
+// A mesh as it leaves a loader thread: built and already encoded, so the
+// render thread only copies it. Mesh is null when the load failed.
+struct StreamedMesh
+{
+    uint32_t Id{ 0 };
+    std::shared_ptr<MeshData> Mesh;
+    PackedVertexStream Vertices;
+    // Coarser levels of Mesh, finest first, each encoded like Mesh. Empty
+    // unless the streamer builds LODs.
+    std::vector<LodLevel> Lods;
+    std::vector<PackedVertexStream> LodVertices;
+    std::string Error;
+};
+
+// First two stages of geometry streaming. Requests run on dedicated loader
+// threads at below normal priority, not on the JobSystem, so a frame waiting
+// on its own jobs never ends up running a load. Finished meshes are encoded
+// there too and wait in a bounded queue for the render thread, which pops
+// them between frames.
+class GeometryStreamer
+{
+public:
+    // Fills Mesh, false with Error when the mesh cannot be produced. Runs on
+    // a loader thread, so it must not touch render thread state.
+    using LoadFunction = std::function<bool(MeshData& Mesh, std::string& Error)>;
+
+    explicit GeometryStreamer(const GeometryStreamerOptions& Options = GeometryStreamerOptions());
+    // Drops requests that have not started and waits for the running ones
+    ~GeometryStreamer();
+
+    GeometryStreamer(const GeometryStreamer&) = delete;
+    GeometryStreamer& operator=(const GeometryStreamer&) = delete;
+
+    // Queues Load; the mesh comes back from TryPop with Id. Requests start in
+    // the order they were made but may finish in any order.
+    void Request(uint32_t Id, LoadFunction Load);
+
+    // Takes one finished mesh without waiting, false when none is ready
+    bool TryPop(StreamedMesh& Out);
+
+    // Requests whose mesh has not been popped yet
+    uint32_t GetPendingCount() const { return m_Pending.load(std::memory_order_acquire); }
+    VertexEncoding GetEncoding() const { return m_Options.Encoding; }
+
+private:
+    struct Job
+    {
+        uint32_t Id;
+        LoadFunction Load;
+    };
+
+    void LoaderMain();
+
+    GeometryStreamerOptions m_Options;
+    std::vector<std::thread> m_Loaders;
+
+    std::mutex m_Mutex;
+    // Loaders wait for requests, and for room in m_Finished
+    std::condition_variable m_RequestQueued;
+    std::condition_variable m_SlotFreed;
+    std::deque<Job> m_Requests;
+    std::deque<StreamedMesh> m_Finished;
+    bool m_Stopping{ false };
+
+    std::atomic<uint32_t> m_Pending{ 0 };
+};
+
+// The GPU copies of the MeshRegistry arenas, in registry order
+enum class GeometryArena : uint8_t
+{
+    Vertices,
+    Indices16,
+    Indices32
+};
+constexpr uint32_t GeometryArenaCount = 3;
+
+// Third stage: which prefix of each arena has been copied to the GPU. The
+// arenas only grow while streaming, so copies advance front to back and a
+// mesh is resident once the prefixes cover its ranges. Each frame Advance
+// hands out at most a budget of bytes, so upload cost per frame stays flat
+// however much is waiting.
+class ArenaResidency
+{
+public:
+    ArenaResidency() = default;
+    // Capacities of the GPU buffers in bytes; nothing past them is copied
+    ArenaResidency(uint32_t VertexStride, const uint64_t (&Capacities)[GeometryArenaCount]);
+
+    // Calls Copy(Arena, Offset, Size) for the next bytes past the resident
+    // prefixes, Budget bytes in total, and counts them resident. Sizes are
+    // the arenas' current sizes in bytes. The budget is split by what each
+    // arena has waiting, so vertices and indices of a mesh arrive together.
+    // Returns the bytes handed out.
+    template<typename Fn>
+    uint64_t Advance(const uint64_t (&Sizes)[GeometryArenaCount], uint64_t Budget, Fn&& Copy);
+
+    // Bytes of the arenas, as clamped to the capacities, not yet resident
+    uint64_t GetBacklog(const uint64_t (&Sizes)[GeometryArenaCount]) const;
+    uint64_t GetResidentBytes(GeometryArena Arena) const { return m_Resident[static_cast<uint32_t>(Arena)]; }
+    uint64_t GetCapacity(GeometryArena Arena) const { return m_Capacity[static_cast<uint32_t>(Arena)]; }
+    bool IsResident(const MeshRange& Range) const;
+
+private:
+    uint32_t m_VertexStride{ 0 };
+    uint64_t m_Capacity[GeometryArenaCount]{};
+    uint64_t m_Resident[GeometryArenaCount]{};
+};
+
+template<typename Fn>
+uint64_t ArenaResidency::Advance(const uint64_t (&Sizes)[GeometryArenaCount], uint64_t Budget, Fn&& Copy)
+{
+    uint64_t Waiting[GeometryArenaCount];
+    uint64_t TotalWaiting = 0;
+    for (uint32_t i = 0; i < GeometryArenaCount; ++i)
+    {
+        const uint64_t Copyable = std::min(Sizes[i], m_Capacity[i]);
+        Waiting[i] = Copyable > m_Resident[i] ? Copyable - m_Resident[i] : 0;
+        TotalWaiting += Waiting[i];
+    }
+    const uint64_t Total = std::min(Budget, TotalWaiting);
+    if (Total == 0)
+        return 0;
+
+    uint64_t Share[GeometryArenaCount];
+    uint64_t Assigned = 0;
+    for (uint32_t i = 0; i < GeometryArenaCount; ++i)
+    {
+        Share[i] = std::min(Waiting[i], static_cast<uint64_t>(double(Total) * Waiting[i] / TotalWaiting));
+        Assigned += Share[i];
+    }
+    // Rounding leftovers go to the first arenas with bytes to spare
+    for (uint32_t i = 0; i < GeometryArenaCount && Assigned < Total; ++i)
+    {
+        const uint64_t Extra = std::min(Waiting[i] - Share[i], Total - Assigned);
+        Share[i] += Extra;
+        Assigned += Extra;
+    }
+
+    for (uint32_t i = 0; i < GeometryArenaCount; ++i)
+    {
+        if (Share[i] == 0)
+            continue;
+        Copy(static_cast<GeometryArena>(i), m_Resident[i], Share[i]);
+        m_Resident[i] += Share[i];
+    }
+    return Total;
+}
+
+} // namespace Racoon
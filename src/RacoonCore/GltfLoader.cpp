@@ -0,0 +1,638 @@
+#include "CoreStdafx.h"
+
+#include "GltfLoader.h"
+
+#include "ContentHash.h"
+#include "JobSystem.h"
+#include "Profiler.h"
+
+// nlohmann::json, vendored by Cauldron next to vectormath
+#include "json/json.h"
+
+#include <cctype>
+#include <cfloat>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+
+namespace Racoon {
+
+namespace {
+
+using json = nlohmann::json;
+
+constexpr uint32_t GlbMagic = 0x46546C67; // "glTF"
+constexpr uint32_t GlbChunkJson = 0x4E4F534A; // "JSON"
+constexpr uint32_t GlbChunkBinary = 0x004E4942; // "BIN\0"
+
+constexpr uint32_t ComponentByte = 5120;
+constexpr uint32_t ComponentUnsignedByte = 5121;
+constexpr uint32_t ComponentShort = 5122;
+constexpr uint32_t ComponentUnsignedShort = 5123;
+constexpr uint32_t ComponentUnsignedInt = 5125;
+constexpr uint32_t ComponentFloat = 5126;
+
+constexpr uint32_t ModeTriangles = 4;
+
+uint32_t ReadUint32(const uint8_t* Data)
+{
+    uint32_t Value;
+    std::memcpy(&Value, Data, sizeof(Value));
+    return Value;
+}
+
+uint32_t ComponentSize(uint32_t ComponentType)
+{
+    switch (ComponentType)
+    {
+    case ComponentByte:
+    case ComponentUnsignedByte:
+        return 1;
+    case ComponentShort:
+    case ComponentUnsignedShort:
+        return 2;
+    case ComponentUnsignedInt:
+    case ComponentFloat:
+        return 4;
+    default:
+        return 0;
+    }
+}
+
+// Matrices are not vertex data, so only the vector types count
+uint32_t ComponentCount(const std::string& Type)
+{
+    if (Type == "SCALAR")
+        return 1;
+    if (Type == "VEC2")
+        return 2;
+    if (Type == "VEC3")
+        return 3;
+    if (Type == "VEC4")
+        return 4;
+    return 0;
+}
+
+bool DecodeBase64(const char* Text, size_t Length, std::vector<uint8_t>& Out)
+{
+    static const auto Decode = [](char c) -> int
+    {
+        if (c >= 'A' && c <= 'Z') return c - 'A';
+        if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+        if (c >= '0' && c <= '9') return c - '0' + 52;
+        if (c == '+' || c == '-') return 62;
+        if (c == '/' || c == '_') return 63;
+        return -1;
+    };
+
+    Out.clear();
+    Out.reserve(Length / 4 * 3);
+    uint32_t Bits = 0;
+    int BitCount = 0;
+    for (size_t i = 0; i < Length && Text[i] != '='; ++i)
+    {
+        const int Value = Decode(Text[i]);
+        if (Value < 0)
+            return false;
+        Bits = (Bits << 6) | static_cast<uint32_t>(Value);
+        BitCount += 6;
+        if (BitCount >= 8)
+        {
+            BitCount -= 8;
+            Out.push_back(static_cast<uint8_t>(Bits >> BitCount));
+        }
+    }
+    return true;
+}
+
+// URIs in glTF are percent-encoded, e.g. spaces in file names
+std::string DecodeUri(const std::string& Uri)
+{
+    std::string Decoded;
+    for (size_t i = 0; i < Uri.size(); ++i)
+    {
+        if (Uri[i] == '%' && i + 2 < Uri.size() && std::isxdigit(static_cast<unsigned char>(Uri[i + 1]))
+            && std::isxdigit(static_cast<unsigned char>(Uri[i + 2])))
+        {
+            Decoded += static_cast<char>(std::stoi(Uri.substr(i + 1, 2), nullptr, 16));
+            i += 2;
+        }
+        else
+        {
+            Decoded += Uri[i];
+        }
+    }
+    return Decoded;
+}
+
+XMVECTOR LoadFloats(const uint8_t* Source, uint32_t Components)
+{
+    switch (Components)
+    {
+    case 2:
+        return XMLoadFloat2(reinterpret_cast<const XMFLOAT2*>(Source));
+    case 3:
+        return XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(Source));
+    default:
+        return XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(Source));
+    }
+}
+
+// Calls Store(i, Element) for every element, converted to floats. The
+// component type is dispatched once per accessor rather than per element.
+template<typename Component, typename StoreFn>
+void ConvertElements(const uint8_t* Source, uint32_t Count, uint32_t Stride, uint32_t Components, bool Normalized,
+    StoreFn&& Store)
+{
+    if constexpr (std::is_same_v<Component, float>)
+    {
+        for (uint32_t i = 0; i < Count; ++i, Source += Stride)
+            Store(i, LoadFloats(Source, Components));
+    }
+    else
+    {
+        // Normalized integers map to [0, 1] or [-1, 1], the most negative
+        // signed value clamping to -1 as the spec asks
+        const XMVECTOR Scale = XMVectorReplicate(
+            Normalized ? 1.f / static_cast<float>(std::numeric_limits<Component>::max()) : 1.f);
+        const XMVECTOR Min = XMVectorReplicate(Normalized && std::is_signed_v<Component> ? -1.f : -FLT_MAX);
+        for (uint32_t i = 0; i < Count; ++i, Source += Stride)
+        {
+            Component Values[4]{};
+            std::memcpy(Values, Source, sizeof(Component) * Components);
+            const XMVECTOR Integers = XMVectorSetInt(static_cast<uint32_t>(Values[0]), static_cast<uint32_t>(Values[1]),
+                static_cast<uint32_t>(Values[2]), static_cast<uint32_t>(Values[3]));
+            Store(i, XMVectorMax(XMVectorMultiply(XMConvertVectorIntToFloat(Integers, 0), Scale), Min));
+        }
+    }
+}
+
+template<typename StoreFn>
+void ReadAccessor(const uint8_t* Source, uint32_t Count, uint32_t Stride, uint32_t ComponentType,
+    uint32_t Components, bool Normalized, StoreFn&& Store)
+{
+    switch (ComponentType)
+    {
+    case ComponentByte:
+        ConvertElements<int8_t>(Source, Count, Stride, Components, Normalized, Store);
+        break;
+    case ComponentUnsignedByte:
+        ConvertElements<uint8_t>(Source, Count, Stride, Components, Normalized, Store);
+        break;
+    case ComponentShort:
+        ConvertElements<int16_t>(Source, Count, Stride, Components, Normalized, Store);
+        break;
+    case ComponentUnsignedShort:
+        ConvertElements<uint16_t>(Source, Count, Stride, Components, Normalized, Store);
+        break;
+    case ComponentUnsignedInt:
+        ConvertElements<uint32_t>(Source, Count, Stride, Components, Normalized, Store);
+        break;
+    default:
+        ConvertElements<float>(Source, Count, Stride, Components, Normalized, Store);
+        break;
+    }
+}
+
+template<typename Index>
+bool ReadIndices(const uint8_t* Source, uint32_t Count, uint32_t Stride, uint32_t VertexCount, uint32_t* Out)
+{
+    // Validated together at the end, which keeps the loop branch-free
+    uint32_t Largest = 0;
+    for (uint32_t i = 0; i < Count; ++i, Source += Stride)
+    {
+        Index Value;
+        std::memcpy(&Value, Source, sizeof(Index));
+        Out[i] = Value;
+        Largest = std::max<uint32_t>(Largest, Value);
+    }
+    return Count == 0 || Largest < VertexCount;
+}
+
+XMVECTOR AnyPerpendicular(XMVECTOR Normal)
+{
+    const XMVECTOR Axis = std::abs(XMVectorGetY(Normal)) < 0.99f ? XMVectorSet(0.f, 1.f, 0.f, 0.f)
+                                                                   : XMVectorSet(1.f, 0.f, 0.f, 0.f);
+    return XMVector3Normalize(XMVector3Cross(Axis, Normal));
+}
+
+} // namespace
+
+bool GltfDocument::Open(const std::string& Path, std::string& Error)
+{
+    RACOON_PROFILE_SCOPE("GltfDocument::Open");
+    *this = GltfDocument();
+    if (!m_File.Open(Path, Error))
+        return false;
+
+    const size_t Slash = Path.find_last_of("/\\");
+    const std::string Directory = Slash == std::string::npos ? std::string() : Path.substr(0, Slash + 1);
+    const uint8_t* Data = m_File.GetData();
+    const size_t Size = m_File.GetSize();
+
+    // A .gltf is the JSON itself; a .glb a header and JSON and BIN chunks
+    if (Size < 12 || ReadUint32(Data) != GlbMagic)
+        return ParseJson(Data, Size, Directory, BufferRange(), Error);
+
+    if (ReadUint32(Data + 4) != 2)
+    {
+        Error = Path + ": only glTF 2.0 binaries are supported";
+        return false;
+    }
+    const size_t Length = std::min<size_t>(ReadUint32(Data + 8), Size);
+    BufferRange JsonChunk;
+    BufferRange BinaryChunk;
+    for (size_t Offset = 12; Offset + 8 <= Length;)
+    {
+        const size_t ChunkLength = ReadUint32(Data + Offset);
+        const uint32_t ChunkType = ReadUint32(Data + Offset + 4);
+        if (ChunkLength > Length - Offset - 8)
+        {
+            Error = Path + ": truncated chunk";
+            return false;
+        }
+        const BufferRange Chunk{ Data + Offset + 8, ChunkLength };
+        if (ChunkType == GlbChunkJson && !JsonChunk.Data)
+            JsonChunk = Chunk;
+        else if (ChunkType == GlbChunkBinary && !BinaryChunk.Data)
+            BinaryChunk = Chunk;
+        // Chunks are 4-byte aligned
+        Offset += 8 + ((ChunkLength + 3) & ~size_t(3));
+    }
+    if (!JsonChunk.Data)
+    {
+        Error = Path + ": no JSON chunk";
+        return false;
+    }
+    return ParseJson(JsonChunk.Data, JsonChunk.Size, Directory, BinaryChunk, Error);
+}
+
+bool GltfDocument::ParseJson(const uint8_t* Json, size_t Size, const std::string& Directory,
+    const BufferRange& GlbBinary, std::string& Error)
+{
+    const json Document = json::parse(Json, Json + Size, nullptr, false);
+    if (Document.is_discarded() || !Document.is_object())
+    {
+        Error = "invalid glTF JSON";
+        return false;
+    }
+
+    // Type mismatches in the document surface as exceptions from json
+    try
+    {
+        const json Empty = json::array();
+        const json& Buffers = Document.contains("buffers") ? Document["buffers"] : Empty;
+        for (size_t i = 0; i < Buffers.size(); ++i)
+        {
+            const json& Buffer = Buffers[i];
+            const size_t ByteLength = Buffer.at("byteLength").get<size_t>();
+            BufferRange Range;
+            if (!Buffer.contains("uri"))
+            {
+                // Only the first buffer of a .glb may live in the BIN chunk
+                if (i != 0 || !GlbBinary.Data)
+                {
+                    Error = "buffer " + std::to_string(i) + " has no uri";
+                    return false;
+                }
+                Range = GlbBinary;
+            }
+            else
+            {
+                const std::string Uri = Buffer["uri"].get<std::string>();
+                if (Uri.compare(0, 5, "data:") == 0)
+                {
+                    const size_t Comma = Uri.find(";base64,");
+                    m_DecodedBuffers.emplace_back();
+                    if (Comma == std::string::npos
+                        || !DecodeBase64(Uri.c_str() + Comma + 8, Uri.size() - Comma - 8, m_DecodedBuffers.back()))
+                    {
+                        Error = "buffer " + std::to_string(i) + " has an invalid data URI";
+                        return false;
+                    }
+                    Range = { m_DecodedBuffers.back().data(), m_DecodedBuffers.back().size() };
+                }
+                else
+                {
+                    m_BufferFiles.emplace_back();
+                    if (!m_BufferFiles.back().Open(Directory + DecodeUri(Uri), Error))
+                        return false;
+                    m_BufferFiles.back().PrefetchAll();
+                    Range = { m_BufferFiles.back().GetData(), m_BufferFiles.back().GetSize() };
+                }
+            }
+            if (Range.Size < ByteLength)
+            {
+                Error = "buffer " + std::to_string(i) + " is shorter than its byteLength";
+                return false;
+            }
+            Range.Size = ByteLength;
+            m_Buffers.push_back(Range);
+        }
+
+        struct View
+        {
+            BufferRange Range;
+            uint32_t Stride;
+        };
+        std::vector<View> Views;
+        const json& BufferViews = Document.contains("bufferViews") ? Document["bufferViews"] : Empty;
+        for (const json& BufferView : BufferViews)
+        {
+            const size_t Buffer = BufferView.at("buffer").get<size_t>();
+            const size_t Offset = BufferView.value("byteOffset", size_t(0));
+            const size_t Length = BufferView.at("byteLength").get<size_t>();
+            if (Buffer >= m_Buffers.size() || Offset > m_Buffers[Buffer].Size
+                || Length > m_Buffers[Buffer].Size - Offset)
+            {
+                Error = "buffer view out of range";
+                return false;
+            }
+            Views.push_back({ { m_Buffers[Buffer].Data + Offset, Length }, BufferView.value("byteStride", 0u) });
+        }
+
+        // Accessors without data (no buffer view, or sparse) stay with a null
+        // Data; primitives using them are skipped
+        const json& Accessors = Document.contains("accessors") ? Document["accessors"] : Empty;
+        for (const json& Source : Accessors)
+        {
+            Accessor Target;
+            Target.ComponentType = Source.at("componentType").get<uint32_t>();
+            Target.Components = ComponentCount(Source.at("type").get<std::string>());
+            Target.Count = Source.at("count").get<uint32_t>();
+            Target.Normalized = Source.value("normalized", false);
+            const uint32_t ElementSize = ComponentSize(Target.ComponentType) * Target.Components;
+            if (Source.contains("bufferView") && !Source.contains("sparse") && ElementSize)
+            {
+                const size_t ViewIndex = Source["bufferView"].get<size_t>();
+                const size_t Offset = Source.value("byteOffset", size_t(0));
+                if (ViewIndex >= Views.size())
+                {
+                    Error = "accessor buffer view out of range";
+                    return false;
+                }
+                const View& Range = Views[ViewIndex];
+                Target.Stride = Range.Stride ? Range.Stride : ElementSize;
+                const size_t Needed = Target.Count ? Offset + size_t(Target.Count - 1) * Target.Stride + ElementSize : 0;
+                if (Needed > Range.Range.Size)
+                {
+                    Error = "accessor out of range of its buffer view";
+                    return false;
+                }
+                Target.Data = Range.Range.Data + Offset;
+            }
+            m_Accessors.push_back(Target);
+        }
+
+        const auto Find = [&](const json& Attributes, const char* Name, uint32_t Components) -> int32_t
+        {
+            if (!Attributes.contains(Name))
+                return -1;
+            const size_t Index = Attributes[Name].get<size_t>();
+            if (Index >= m_Accessors.size() || !m_Accessors[Index].Data || m_Accessors[Index].Components != Components)
+                return -2;
+            return static_cast<int32_t>(Index);
+        };
+
+        const json& Meshes = Document.contains("meshes") ? Document["meshes"] : Empty;
+        m_MeshCount = static_cast<uint32_t>(Meshes.size());
+        for (uint32_t MeshIndex = 0; MeshIndex < m_MeshCount; ++MeshIndex)
+        {
+            const json& Mesh = Meshes[MeshIndex];
+            const std::string Name = Mesh.value("name", "mesh" + std::to_string(MeshIndex));
+            const json& Primitives = Mesh.at("primitives");
+            for (uint32_t PrimitiveIndex = 0; PrimitiveIndex < Primitives.size(); ++PrimitiveIndex)
+            {
+                const json& Source = Primitives[PrimitiveIndex];
+                const json& Attributes = Source.at("attributes");
+                Primitive Target;
+                Target.Name = Name;
+                Target.Mesh = MeshIndex;
+                Target.Index = PrimitiveIndex;
+                Target.Position = Find(Attributes, "POSITION", 3);
+                Target.Normal = Find(Attributes, "NORMAL", 3);
+                Target.Tangent = Find(Attributes, "TANGENT", 4);
+                Target.TexCoord0 = Find(Attributes, "TEXCOORD_0", 2);
+                Target.Indices = Find(Source, "indices", 1);
+
+                const uint32_t IndexType = Target.Indices >= 0 ? m_Accessors[Target.Indices].ComponentType : 0;
+                const bool IndicesValid = Target.Indices == -1 || IndexType == ComponentUnsignedByte
+                    || IndexType == ComponentUnsignedShort || IndexType == ComponentUnsignedInt;
+                if (Source.value("mode", ModeTriangles) != ModeTriangles || Target.Position < 0 || Target.Normal < -1
+                    || Target.Tangent < -1 || Target.TexCoord0 < -1 || Target.Indices < -1 || !IndicesValid)
+                {
+                    ++m_SkippedPrimitives;
+                    continue;
+                }
+                m_Primitives.push_back(std::move(Target));
+            }
+        }
+    }
+    catch (const json::exception& Exception)
+    {
+        Error = std::string("invalid glTF: ") + Exception.what();
+        return false;
+    }
+    return true;
+}
+
+size_t GltfDocument::GetBufferBytes() const
+{
+    size_t Bytes = 0;
+    for (const BufferRange& Buffer : m_Buffers)
+        Bytes += Buffer.Size;
+    return Bytes;
+}
+
+void GltfDocument::GetPrimitiveSize(uint32_t PrimitiveIndex, uint32_t& VertexCount, uint32_t& IndexCount) const
+{
+    assert(PrimitiveIndex < m_Primitives.size());
+    const Primitive& Source = m_Primitives[PrimitiveIndex];
+    VertexCount = m_Accessors[Source.Position].Count;
+    IndexCount = (Source.Indices >= 0 ? m_Accessors[Source.Indices].Count : VertexCount) / 3 * 3;
+}
+
+uint64_t GltfDocument::HashContents(uint64_t Seed) const
+{
+    // data: URIs are part of the JSON, so the file and its .bin files cover everything
+    ContentHasher Hasher(Seed);
+    Hasher.Add(m_File.GetData(), m_File.GetSize());
+    for (const MappedFile& Buffer : m_BufferFiles)
+        Hasher.Add(Buffer.GetData(), Buffer.GetSize());
+    return Hasher.Get();
+}
+
+bool GltfDocument::LoadPrimitive(uint32_t PrimitiveIndex, GltfMesh& Out, std::string& Error) const
+{
+    assert(PrimitiveIndex < m_Primitives.size());
+    const Primitive& Source = m_Primitives[PrimitiveIndex];
+    Out.Name = Source.Name;
+    Out.MeshIndex = Source.Mesh;
+    Out.PrimitiveIndex = Source.Index;
+    Out.Attributes = VertexAttributeBits::Position;
+
+    // Missing attributes are filled in below, everything else starts at zero
+    MeshData& Mesh = Out.Mesh;
+    const Accessor& Positions = m_Accessors[Source.Position];
+    const uint32_t VertexCount = Positions.Count;
+    Mesh.Vertices.assign(VertexCount, Vertex(0.f, 0.f, 0.f, 0.f, 0.f, 0.f, 0.f, 0.f, 0.f, 0.f, 0.f));
+    Vertex* Vertices = Mesh.Vertices.data();
+
+    const auto Read = [&](int32_t Index, uint32_t Bit, auto&& Store)
+    {
+        if (Index < 0)
+            return;
+        const Accessor& A = m_Accessors[Index];
+        // Attributes of one primitive must agree on the vertex count
+        ReadAccessor(A.Data, std::min(A.Count, VertexCount), A.Stride, A.ComponentType, A.Components, A.Normalized,
+            Store);
+        Out.Attributes |= Bit;
+    };
+    Read(Source.Position, VertexAttributeBits::Position,
+        [Vertices](uint32_t i, XMVECTOR V) { XMStoreFloat3(&Vertices[i].Position, V); });
+    const bool QuantizedNormals = Source.Normal >= 0 && m_Accessors[Source.Normal].ComponentType != ComponentFloat;
+    Read(Source.Normal, VertexAttributeBits::Normal, [Vertices, QuantizedNormals](uint32_t i, XMVECTOR V)
+        { XMStoreFloat3(&Vertices[i].Normal, QuantizedNormals ? XMVector3Normalize(V) : V); });
+    // The handedness in w has no place in Vertex and is dropped
+    Read(Source.Tangent, VertexAttributeBits::Tangent,
+        [Vertices](uint32_t i, XMVECTOR V) { XMStoreFloat3(&Vertices[i].Tangent, V); });
+    Read(Source.TexCoord0, VertexAttributeBits::TexCoord0,
+        [Vertices](uint32_t i, XMVECTOR V) { XMStoreFloat2(&Vertices[i].UV, V); });
+
+    if (Source.Indices >= 0)
+    {
+        const Accessor& Indices = m_Accessors[Source.Indices];
+        // Whole triangles only
+        Mesh.Indices32.resize(Indices.Count / 3 * 3);
+        const uint32_t Count = static_cast<uint32_t>(Mesh.Indices32.size());
+        bool Valid;
+        switch (Indices.ComponentType)
+        {
+        case ComponentUnsignedByte:
+            Valid = ReadIndices<uint8_t>(Indices.Data, Count, Indices.Stride, VertexCount, Mesh.Indices32.data());
+            break;
+        case ComponentUnsignedShort:
+            Valid = ReadIndices<uint16_t>(Indices.Data, Count, Indices.Stride, VertexCount, Mesh.Indices32.data());
+            break;
+        default:
+            Valid = ReadIndices<uint32_t>(Indices.Data, Count, Indices.Stride, VertexCount, Mesh.Indices32.data());
+            break;
+        }
+        if (!Valid)
+        {
+            Error = Source.Name + ": index out of range";
+            return false;
+        }
+    }
+    else
+    {
+        Mesh.Indices32.resize(VertexCount / 3 * 3);
+        for (uint32_t i = 0; i < Mesh.Indices32.size(); ++i)
+            Mesh.Indices32[i] = i;
+    }
+    Mesh.InvalidateIndices16();
+
+    if (!(Out.Attributes & VertexAttributeBits::Normal))
+        ComputeNormals(Mesh);
+    if (!(Out.Attributes & VertexAttributeBits::Tangent))
+        ComputeTangents(Mesh);
+    Mesh.UpdateBounds();
+    return true;
+}
+
+bool GltfDocument::LoadMeshes(std::vector<GltfMesh>& Meshes, std::string& Error, JobSystem* Jobs) const
+{
+    RACOON_PROFILE_SCOPE("GltfDocument::LoadMeshes");
+    const uint32_t Count = GetPrimitiveCount();
+    Meshes.clear();
+    Meshes.resize(Count);
+    std::vector<std::string> Errors(Count);
+    std::vector<uint8_t> Failed(Count, 0);
+    const auto LoadRange = [&](uint32_t First, uint32_t Last)
+    {
+        for (uint32_t i = First; i < Last; ++i)
+            Failed[i] = !LoadPrimitive(i, Meshes[i], Errors[i]);
+    };
+    // One primitive per range: sizes vary wildly, stealing evens them out
+    if (Jobs)
+        Jobs->ParallelFor(Count, 1, LoadRange);
+    else
+        LoadRange(0, Count);
+
+    for (uint32_t i = 0; i < Count; ++i)
+    {
+        if (Failed[i])
+        {
+            Error = Errors[i];
+            Meshes.clear();
+            return false;
+        }
+    }
+    return true;
+}
+
+void ComputeNormals(MeshData& Mesh)
+{
+    std::vector<XMFLOAT3> Sums(Mesh.Vertices.size(), XMFLOAT3(0.f, 0.f, 0.f));
+    for (size_t i = 0; i + 2 < Mesh.Indices32.size(); i += 3)
+    {
+        const uint32_t I0 = Mesh.Indices32[i];
+        const uint32_t I1 = Mesh.Indices32[i + 1];
+        const uint32_t I2 = Mesh.Indices32[i + 2];
+        const XMVECTOR P0 = XMLoadFloat3(&Mesh.Vertices[I0].Position);
+        // The cross product's length is twice the area, which is the weight
+        const XMVECTOR Face = XMVector3Cross(XMVectorSubtract(XMLoadFloat3(&Mesh.Vertices[I1].Position), P0),
+            XMVectorSubtract(XMLoadFloat3(&Mesh.Vertices[I2].Position), P0));
+        for (uint32_t Index : { I0, I1, I2 })
+            XMStoreFloat3(&Sums[Index], XMVectorAdd(XMLoadFloat3(&Sums[Index]), Face));
+    }
+
+    for (size_t i = 0; i < Mesh.Vertices.size(); ++i)
+    {
+        const XMVECTOR Sum = XMLoadFloat3(&Sums[i]);
+        const bool Degenerate = XMVectorGetX(XMVector3LengthSq(Sum)) < 1e-20f;
+        XMStoreFloat3(&Mesh.Vertices[i].Normal, Degenerate ? XMVectorSet(0.f, 1.f, 0.f, 0.f) : XMVector3Normalize(Sum));
+    }
+}
+
+void ComputeTangents(MeshData& Mesh)
+{
+    std::vector<XMFLOAT3> Sums(Mesh.Vertices.size(), XMFLOAT3(0.f, 0.f, 0.f));
+    for (size_t i = 0; i + 2 < Mesh.Indices32.size(); i += 3)
+    {
+        const uint32_t I0 = Mesh.Indices32[i];
+        const uint32_t I1 = Mesh.Indices32[i + 1];
+        const uint32_t I2 = Mesh.Indices32[i + 2];
+        const Vertex& V0 = Mesh.Vertices[I0];
+        const Vertex& V1 = Mesh.Vertices[I1];
+        const Vertex& V2 = Mesh.Vertices[I2];
+        const float DU1 = V1.UV.x - V0.UV.x;
+        const float DV1 = V1.UV.y - V0.UV.y;
+        const float DU2 = V2.UV.x - V0.UV.x;
+        const float DV2 = V2.UV.y - V0.UV.y;
+        const float Determinant = DU1 * DV2 - DU2 * DV1;
+        if (std::abs(Determinant) < 1e-12f)
+            continue;
+
+        // Solves E1 = DU1 T + DV1 B, E2 = DU2 T + DV2 B for T
+        const XMVECTOR P0 = XMLoadFloat3(&V0.Position);
+        const XMVECTOR E1 = XMVectorSubtract(XMLoadFloat3(&V1.Position), P0);
+        const XMVECTOR E2 = XMVectorSubtract(XMLoadFloat3(&V2.Position), P0);
+        const XMVECTOR Tangent = XMVectorScale(
+            XMVectorSubtract(XMVectorScale(E1, DV2), XMVectorScale(E2, DV1)), 1.f / Determinant);
+        for (uint32_t Index : { I0, I1, I2 })
+            XMStoreFloat3(&Sums[Index], XMVectorAdd(XMLoadFloat3(&Sums[Index]), Tangent));
+    }
+
+    for (size_t i = 0; i < Mesh.Vertices.size(); ++i)
+    {
+        // Gram-Schmidt against the normal
+        const XMVECTOR Normal = XMLoadFloat3(&Mesh.Vertices[i].Normal);
+        const XMVECTOR Sum = XMLoadFloat3(&Sums[i]);
+        const XMVECTOR Tangent = XMVectorSubtract(Sum, XMVectorMultiply(Normal, XMVector3Dot(Normal, Sum)));
+        const bool Degenerate = XMVectorGetX(XMVector3LengthSq(Tangent)) < 1e-20f;
+        XMStoreFloat3(&Mesh.Vertices[i].Tangent, Degenerate ? AnyPerpendicular(Normal) : XMVector3Normalize(Tangent));
+    }
+}
+
+} // namespace Racoon
@@ -0,0 +1,120 @@
+#pragma once
+
+#include "CoreStdafx.h"
+#include "MappedFile.h"
+#include "MeshGeometry.h"
+
+#include <string>
+
+namespace Racoon {
+
+class JobSystem;
+
+// Vertex attributes a glTF primitive can provide, as bits
+namespace VertexAttributeBits {
+constexpr uint32_t Position = 1 << 0;
+constexpr uint32_t Normal = 1 << 1;
+constexpr uint32_t Tangent = 1 << 2;
+constexpr uint32_t TexCoord0 = 1 << 3;
+constexpr uint32_t All = Position | Normal | Tangent | TexCoord0;
+} // namespace VertexAttributeBits
+
+// One triangle primitive of a glTF mesh. Every Vertex attribute is filled:
+// Attributes says which came from the file, the rest were derived. Normals
+// are area-weighted face normals, tangents follow the UV gradient (or any
+// perpendicular without UVs) and missing UVs are zero, so every mesh fits
+// the renderer's one vertex layout.
+struct GltfMesh
+{
+    std::string Name;
+    uint32_t MeshIndex{ 0 };
+    uint32_t PrimitiveIndex{ 0 };
+    uint32_t Attributes{ 0 };
+    MeshData Mesh;
+};
+
+// A glTF 2.0 asset, .glb or .gltf with external or data: URI buffers.
+//
+// Open maps the file and its buffers and parses the JSON into compact
+// accessor tables; the JSON document itself is not kept. LoadMeshes then
+// converts each accessor straight from the mapped memory into MeshData,
+// four components at a time, with no copy of the buffers in between. Only
+// data: URIs are decoded into memory of their own.
+//
+// Meshes are loaded in mesh space; node transforms are not applied. Point
+// and line primitives and sparse accessors are skipped.
+class GltfDocument
+{
+public:
+    bool Open(const std::string& Path, std::string& Error);
+
+    uint32_t GetMeshCount() const { return m_MeshCount; }
+    // Triangle primitives, the entries LoadMeshes produces
+    uint32_t GetPrimitiveCount() const { return static_cast<uint32_t>(m_Primitives.size()); }
+    // Primitives Open skipped: points, lines or sparse accessors
+    uint32_t GetSkippedPrimitiveCount() const { return m_SkippedPrimitives; }
+    // Vertices and whole-triangle indices LoadPrimitive will produce, known
+    // from the accessors without converting anything
+    void GetPrimitiveSize(uint32_t Primitive, uint32_t& VertexCount, uint32_t& IndexCount) const;
+    // Bytes of every mapped or decoded buffer
+    size_t GetBufferBytes() const;
+    // Hash of the file and every external buffer, a cache key for what
+    // LoadMeshes would produce
+    uint64_t HashContents(uint64_t Seed = 0) const;
+
+    // One GltfMesh per triangle primitive, in mesh then primitive order.
+    // With Jobs the primitives convert in parallel.
+    bool LoadMeshes(std::vector<GltfMesh>& Meshes, std::string& Error, JobSystem* Jobs = nullptr) const;
+    bool LoadPrimitive(uint32_t Primitive, GltfMesh& Out, std::string& Error) const;
+
+private:
+    // Validated against its buffer in Open, so loads need no bounds checks
+    struct Accessor
+    {
+        const uint8_t* Data{ nullptr };
+        uint32_t Count{ 0 };
+        uint32_t Stride{ 0 };
+        uint32_t ComponentType{ 0 };
+        uint32_t Components{ 0 };
+        bool Normalized{ false };
+    };
+
+    struct Primitive
+    {
+        std::string Name;
+        uint32_t Mesh{ 0 };
+        uint32_t Index{ 0 };
+        int32_t Position{ -1 };
+        int32_t Normal{ -1 };
+        int32_t Tangent{ -1 };
+        int32_t TexCoord0{ -1 };
+        int32_t Indices{ -1 };
+    };
+
+    struct BufferRange
+    {
+        const uint8_t* Data{ nullptr };
+        size_t Size{ 0 };
+    };
+
+    bool ParseJson(const uint8_t* Json, size_t Size, const std::string& Directory, const BufferRange& GlbBinary,
+        std::string& Error);
+
+    MappedFile m_File;
+    // External .bin files and decoded data: URIs
+    std::vector<MappedFile> m_BufferFiles;
+    std::vector<std::vector<uint8_t>> m_DecodedBuffers;
+    std::vector<BufferRange> m_Buffers;
+    std::vector<Accessor> m_Accessors;
+    std::vector<Primitive> m_Primitives;
+    uint32_t m_MeshCount{ 0 };
+    uint32_t m_SkippedPrimitives{ 0 };
+};
+
+// Area-weighted vertex normals from the triangles
+void ComputeNormals(MeshData& Mesh);
+// Tangents along the U direction of the UVs, orthogonal to the normals.
+// Where the UVs are degenerate any perpendicular of the normal is used.
+void ComputeTangents(MeshData& Mesh);
+
+} // namespace Racoon
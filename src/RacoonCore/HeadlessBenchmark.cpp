@@ -0,0 +1,555 @@
+#include "CoreStdafx.h"
+
+#include "HeadlessBenchmark.h"
+
+#include "AabbTree.h"
+#include "DrawBatcher.h"
+#include "DrawRecorder.h"
+#include "FrustumCuller.h"
+#include "JobSystem.h"
+#include "MeshRegistry.h"
+#include "PrimitivesGenerator.h"
+#include "Profiler.h"
+#include "RenderQueue.h"
+#include "TransformSystem.h"
+
+#include <cctype>
+#include <cstring>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <random>
+
+namespace Racoon {
+
+const char* const HeadlessUsage =
+    "--headless [options]\n"
+    "  --objects N         objects in the scene (10000)\n"
+    "  --meshes N          unique meshes shared by the objects (32)\n"
+    "  --mix cube=W,sphere=W,cylinder=W\n"
+    "                      relative weights of the mesh kinds (1 each)\n"
+    "  --motion F          share of objects moving every frame (0.1)\n"
+    "  --transparent F     share of objects in the transparent pass (0.1)\n"
+    "  --world F           side of the square the objects cover (1000)\n"
+    "  --seed N            scene seed (1)\n"
+    "  --frames N          measured frames (300)\n"
+    "  --warmup N          frames run before measuring (10)\n"
+    "  --threads N         job system threads, 0 for one per core (0)\n"
+    "  --out PATH          JSON output, stdout when omitted\n";
+
+namespace {
+
+// Scene stages in frame order. Each is a scope of the benchmark's own profiler.
+const char* const StageNames[] = { "Camera", "Transforms", "Visibility", "Sorting", "Constants" };
+
+constexpr float Pi = 3.14159265f;
+// Simulated time per frame, so every run animates the same way regardless of speed
+constexpr float SimulatedStep = 1.f / 60.f;
+
+bool ParseUnsigned(const std::string& Text, uint32_t& Value)
+{
+    if (Text.empty() || !std::isdigit(static_cast<unsigned char>(Text[0])))
+        return false;
+    char* End = nullptr;
+    const unsigned long Parsed = std::strtoul(Text.c_str(), &End, 10);
+    if (*End || Parsed > UINT32_MAX)
+        return false;
+    Value = static_cast<uint32_t>(Parsed);
+    return true;
+}
+
+bool ParseFloat(const std::string& Text, float& Value)
+{
+    if (Text.empty())
+        return false;
+    char* End = nullptr;
+    const float Parsed = std::strtof(Text.c_str(), &End);
+    if (*End || !std::isfinite(Parsed))
+        return false;
+    Value = Parsed;
+    return true;
+}
+
+bool ParseMix(const std::string& Text, PrimitiveMix& Mix)
+{
+    PrimitiveMix Parsed{ 0.f, 0.f, 0.f };
+    size_t Start = 0;
+    while (Start <= Text.size())
+    {
+        const size_t Comma = std::min(Text.find(',', Start), Text.size());
+        const std::string Entry = Text.substr(Start, Comma - Start);
+        const size_t Equals = Entry.find('=');
+        if (Equals == std::string::npos)
+            return false;
+        const std::string Kind = Entry.substr(0, Equals);
+        float Weight;
+        if (!ParseFloat(Entry.substr(Equals + 1), Weight) || Weight < 0.f)
+            return false;
+
+        if (Kind == "cube")
+            Parsed.Cubes = Weight;
+        else if (Kind == "sphere")
+            Parsed.Spheres = Weight;
+        else if (Kind == "cylinder")
+            Parsed.Cylinders = Weight;
+        else
+            return false;
+        Start = Comma + 1;
+    }
+    if (Parsed.Cubes + Parsed.Spheres + Parsed.Cylinders <= 0.f)
+        return false;
+    Mix = Parsed;
+    return true;
+}
+
+// std::uniform_real_distribution differs between standard libraries, this
+// keeps a seed's scene identical everywhere
+float Uniform(std::mt19937& Rng, float Min = 0.f, float Max = 1.f)
+{
+    return Min + (Max - Min) * static_cast<float>(Rng() >> 8) * (1.f / 16777216.f);
+}
+
+enum class PrimitiveKind
+{
+    Cube,
+    Sphere,
+    Cylinder
+};
+
+// Spreads the kinds over the meshes in proportion to the weights
+PrimitiveKind PickKind(const PrimitiveMix& Mix, uint32_t Mesh, uint32_t MeshCount)
+{
+    const float Total = Mix.Cubes + Mix.Spheres + Mix.Cylinders;
+    const float At = (Mesh + 0.5f) / MeshCount * Total;
+    if (At < Mix.Cubes)
+        return PrimitiveKind::Cube;
+    if (At < Mix.Cubes + Mix.Spheres)
+        return PrimitiveKind::Sphere;
+    return PrimitiveKind::Cylinder;
+}
+
+std::shared_ptr<MeshData> CreateMesh(PrimitivesGenerator& Generator, PrimitiveKind Kind, std::mt19937& Rng)
+{
+    switch (Kind)
+    {
+    case PrimitiveKind::Cube:
+    {
+        // The generator has a single cube; stretch copies so meshes differ
+        auto Mesh = std::make_shared<MeshData>(Generator.CreateCube());
+        const float Scale[3] = { Uniform(Rng, 0.5f, 2.f), Uniform(Rng, 0.5f, 2.f), Uniform(Rng, 0.5f, 2.f) };
+        for (Vertex& V : Mesh->Vertices)
+        {
+            V.Position.x *= Scale[0];
+            V.Position.y *= Scale[1];
+            V.Position.z *= Scale[2];
+        }
+        Mesh->UpdateBounds();
+        return Mesh;
+    }
+    case PrimitiveKind::Sphere:
+        return std::make_shared<MeshData>(
+            Generator.CreateGeosphere(Uniform(Rng, 0.5f, 2.f), static_cast<uint32_t>(Uniform(Rng, 0.f, 3.f))));
+    case PrimitiveKind::Cylinder:
+    default:
+        return std::make_shared<MeshData>(Generator.CreateCylinder(Uniform(Rng, 0.5f, 1.5f),
+            Uniform(Rng, 0.25f, 1.5f), Uniform(Rng, 1.f, 4.f), 6 + static_cast<uint32_t>(Uniform(Rng, 0.f, 19.f)),
+            1 + static_cast<uint32_t>(Uniform(Rng, 0.f, 4.f))));
+    }
+}
+
+// Counts what recording emits, in place of a D3D12 command list
+class CountingCommandList final : public DrawCommandList
+{
+public:
+    void Begin() override {}
+    void SetPipelineState(uint16_t, PrimitiveTopology) override {}
+    void SetBatchConstants(const BatchConstants&) override {}
+    void SetIndexBuffer(IndexFormat) override {}
+    void DrawIndexedInstanced(uint32_t, uint32_t, uint32_t, uint32_t) override { ++m_Draws; }
+
+    uint64_t m_Draws{ 0 };
+};
+
+struct MovingObject
+{
+    uint32_t Object;
+    XMFLOAT3 Anchor;
+    float Radius;
+    float Phase;
+    float Speed;
+};
+
+// Everything the frame loop works on, laid out like the renderer's members
+struct SyntheticScene
+{
+    TransformSystem Transforms;
+    MeshRegistry Meshes;
+    std::vector<std::shared_ptr<MeshData>> UniqueMeshes;
+    std::vector<std::shared_ptr<RenderItem>> Objects;
+    std::vector<uint32_t> Proxies;
+    std::vector<MovingObject> Moving;
+    AabbTree Tree;
+};
+
+void BuildScene(const SyntheticSceneDesc& Desc, JobSystem& Jobs, SyntheticScene& Scene)
+{
+    std::mt19937 Rng(Desc.Seed);
+
+    GeneratorOptions Options;
+    Options.Jobs = &Jobs;
+    PrimitivesGenerator Generator(Options);
+    const uint32_t MeshCount = std::max(1u, Desc.UniqueMeshes);
+    for (uint32_t i = 0; i < MeshCount; ++i)
+        Scene.UniqueMeshes.push_back(CreateMesh(Generator, PickKind(Desc.Mix, i, MeshCount), Rng));
+
+    const float Half = 0.5f * Desc.WorldSize;
+    const uint32_t MovingCount = static_cast<uint32_t>(
+        std::clamp(Desc.MotionFraction, 0.f, 1.f) * Desc.ObjectCount + 0.5f);
+    Scene.Objects.reserve(Desc.ObjectCount);
+    Scene.Proxies.reserve(Desc.ObjectCount);
+    Scene.Moving.reserve(MovingCount);
+    for (uint32_t i = 0; i < Desc.ObjectCount; ++i)
+    {
+        Trs Local;
+        Local.Translation = XMFLOAT3(Uniform(Rng, -Half, Half), Uniform(Rng, 0.f, 10.f), Uniform(Rng, -Half, Half));
+        const float Yaw = Uniform(Rng, 0.f, 2.f * Pi);
+        Local.Rotation = XMFLOAT4(0.f, std::sin(0.5f * Yaw), 0.f, std::cos(0.5f * Yaw));
+        const float Scale = Uniform(Rng, 0.5f, 2.f);
+        Local.Scale = XMFLOAT3(Scale, Scale, Scale);
+
+        const auto& Mesh = Scene.UniqueMeshes[static_cast<uint32_t>(Uniform(Rng) * MeshCount) % MeshCount];
+        auto Item = std::make_shared<RenderItem>(Mesh, Scene.Transforms, Scene.Transforms.Create(Local));
+        Item->Index = i;
+        Scene.Meshes.Register(*Item);
+        if (Uniform(Rng) < Desc.TransparentFraction)
+        {
+            Item->Pass = RenderPass::Transparent;
+            Item->PipelineState = 1;
+        }
+        // Objects are scattered at random, so the first ones are as good as any
+        if (i < MovingCount)
+        {
+            Scene.Moving.push_back({ i, Local.Translation, Uniform(Rng, 1.f, 10.f), Uniform(Rng, 0.f, 2.f * Pi),
+                Uniform(Rng, 0.5f, 2.f) });
+        }
+
+        Item->UpdateWorldBounds();
+        Scene.Proxies.push_back(Scene.Tree.CreateProxy(Aabb::FromBounds(Item->GetWorldBounds()), i));
+        Scene.Objects.push_back(std::move(Item));
+    }
+    Scene.Tree.Rebuild();
+}
+
+HeadlessStageResult ToStageResult(const ScopeStats& Stats, uint32_t ObjectCount)
+{
+    HeadlessStageResult Stage;
+    Stage.Name = Stats.Name ? Stats.Name : "";
+    Stage.MeanMs = Stats.MeanMs;
+    Stage.P50Ms = Stats.P50Ms;
+    Stage.P95Ms = Stats.P95Ms;
+    Stage.P99Ms = Stats.P99Ms;
+    Stage.MaxMs = Stats.MaxMs;
+    Stage.ObjectsPerMs = Stats.MeanMs > 0.0 ? ObjectCount / Stats.MeanMs : 0.0;
+    return Stage;
+}
+
+void WriteStage(std::ostream& Out, const HeadlessStageResult& Stage)
+{
+    Out << "{\"name\":\"" << Stage.Name << "\",\"mean_ms\":" << Stage.MeanMs << ",\"p50_ms\":" << Stage.P50Ms
+        << ",\"p95_ms\":" << Stage.P95Ms << ",\"p99_ms\":" << Stage.P99Ms << ",\"max_ms\":" << Stage.MaxMs
+        << ",\"objects_per_ms\":" << Stage.ObjectsPerMs << "}";
+}
+
+} // namespace
+
+bool ParseHeadlessOptions(const std::vector<std::string>& Args, HeadlessBenchmarkOptions& Options, std::string& Error)
+{
+    for (size_t i = 0; i < Args.size(); ++i)
+    {
+        const std::string& Flag = Args[i];
+        if (Flag == "--headless")
+            continue;
+        if (i + 1 >= Args.size())
+        {
+            Error = "missing value for " + Flag;
+            return false;
+        }
+        const std::string& Value = Args[++i];
+
+        SyntheticSceneDesc& Scene = Options.Scene;
+        bool Valid;
+        if (Flag == "--objects")
+            Valid = ParseUnsigned(Value, Scene.ObjectCount);
+        else if (Flag == "--meshes")
+            Valid = ParseUnsigned(Value, Scene.UniqueMeshes) && Scene.UniqueMeshes > 0;
+        else if (Flag == "--mix")
+            Valid = ParseMix(Value, Scene.Mix);
+        else if (Flag == "--motion")
+            Valid = ParseFloat(Value, Scene.MotionFraction) && Scene.MotionFraction >= 0.f
+                && Scene.MotionFraction <= 1.f;
+        else if (Flag == "--transparent")
+            Valid = ParseFloat(Value, Scene.TransparentFraction) && Scene.TransparentFraction >= 0.f
+                && Scene.TransparentFraction <= 1.f;
+        else if (Flag == "--world")
+            Valid = ParseFloat(Value, Scene.WorldSize) && Scene.WorldSize > 0.f;
+        else if (Flag == "--seed")
+            Valid = ParseUnsigned(Value, Scene.Seed);
+        else if (Flag == "--frames")
+            Valid = ParseUnsigned(Value, Options.Frames) && Options.Frames > 0;
+        else if (Flag == "--warmup")
+            Valid = ParseUnsigned(Value, Options.WarmupFrames);
+        else if (Flag == "--threads")
+            Valid = ParseUnsigned(Value, Options.Threads);
+        else if (Flag == "--out")
+            Valid = !(Options.OutputPath = Value).empty();
+        else
+        {
+            Error = "unknown option " + Flag;
+            return false;
+        }
+
+        if (!Valid)
+        {
+            Error = "invalid value '" + Value + "' for " + Flag;
+            return false;
+        }
+    }
+    return true;
+}
+
+std::vector<std::string> SplitCommandLine(const char* CommandLine)
+{
+    std::vector<std::string> Args;
+    if (!CommandLine)
+        return Args;
+
+    std::string Current;
+    bool InArgument = false;
+    bool Quoted = false;
+    for (const char* c = CommandLine; *c; ++c)
+    {
+        if (*c == '"')
+        {
+            Quoted = !Quoted;
+            InArgument = true;
+        }
+        else if (!Quoted && std::isspace(static_cast<unsigned char>(*c)))
+        {
+            if (InArgument)
+                Args.push_back(std::move(Current));
+            Current.clear();
+            InArgument = false;
+        }
+        else
+        {
+            Current += *c;
+            InArgument = true;
+        }
+    }
+    if (InArgument)
+        Args.push_back(std::move(Current));
+    return Args;
+}
+
+HeadlessBenchmarkResult RunHeadlessBenchmark(const HeadlessBenchmarkOptions& Options)
+{
+    HeadlessBenchmarkResult Result;
+    Result.Options = Options;
+    const SyntheticSceneDesc& Desc = Options.Scene;
+
+    JobSystem Jobs(Options.Threads);
+    Result.Threads = Jobs.GetThreadCount();
+
+    const auto SetupStart = std::chrono::steady_clock::now();
+    SyntheticScene Scene;
+    BuildScene(Desc, Jobs, Scene);
+    Result.SetupMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - SetupStart).count();
+
+    // The same per-frame state the renderer keeps
+    std::vector<uint32_t> Visible;
+    RenderQueue Queue;
+    std::vector<std::shared_ptr<RenderItem>> Opaque;
+    std::vector<std::shared_ptr<RenderItem>> Transparent;
+    DrawBatcher OpaqueBatcher;
+    DrawBatcher TransparentBatcher;
+    const ParallelDrawRecorder Recorder(&Jobs, 4);
+    std::vector<CountingCommandList> Lists(Recorder.GetMaxChunks());
+    std::vector<DrawCommandList*> ListPointers;
+    for (CountingCommandList& List : Lists)
+        ListPointers.push_back(&List);
+
+    // DrawObjects without the D3D12 side
+    const auto RecordPass = [&](const std::vector<std::shared_ptr<RenderItem>>& Items, BatchMerging Merging,
+        DrawBatcher& Batcher)
+    {
+        Batcher.Build(Items, Merging);
+        const std::vector<DrawBatch>& Batches = Batcher.GetBatches();
+        if (Batches.empty())
+            return uint64_t{ 0 };
+        for (CountingCommandList& List : Lists)
+            List.m_Draws = 0;
+        Recorder.Record(Batches, ListPointers.data());
+        uint64_t Draws = 0;
+        for (const CountingCommandList& List : Lists)
+            Draws += List.m_Draws;
+        return Draws;
+    };
+
+    // Its history holds exactly the measured frames, warm-up ones fall out
+    Profiler Prof(Options.Frames);
+    uint64_t MovedSum = 0;
+    uint64_t VisibleSum = 0;
+    uint64_t DrawSum = 0;
+    const float Half = 0.5f * Desc.WorldSize;
+    const math::Matrix4 Projection = math::Matrix4::perspective(Pi / 3.f, 16.f / 9.f, 0.1f, 2.f * Desc.WorldSize);
+
+    const uint32_t TotalFrames = Options.WarmupFrames + Options.Frames;
+    for (uint32_t FrameIndex = 0; FrameIndex < TotalFrames; ++FrameIndex)
+    {
+        const float Time = FrameIndex * SimulatedStep;
+        math::Matrix4 View;
+        Frustum ViewFrustum;
+        {
+            // Orbits the middle of the world once every 30 s, so visibility
+            // and depth order keep changing
+            ProfileScope Scope("Camera", Prof);
+            const float Angle = 2.f * Pi * Time / 30.f;
+            const math::Point3 Eye(0.6f * Half * std::cos(Angle), 0.15f * Desc.WorldSize, 0.6f * Half * std::sin(Angle));
+            View = math::Matrix4::lookAt(Eye, math::Point3(0.f, 0.f, 0.f), math::Vector3(0.f, 1.f, 0.f));
+            ViewFrustum = Frustum::FromViewProjection(Projection * View);
+        }
+        uint32_t Moved = 0;
+        {
+            ProfileScope Scope("Transforms", Prof);
+            for (const MovingObject& Object : Scene.Moving)
+            {
+                const float Angle = Object.Phase + Object.Speed * Time;
+                Scene.Transforms.SetLocalTranslation(Scene.Objects[Object.Object]->GetTransform(),
+                    XMFLOAT3(Object.Anchor.x + Object.Radius * std::cos(Angle),
+                        Object.Anchor.y + std::sin(2.f * Angle),
+                        Object.Anchor.z + Object.Radius * std::sin(Angle)));
+            }
+            Scene.Transforms.Update();
+            for (size_t i = 0; i < Scene.Objects.size(); ++i)
+            {
+                if (!Scene.Transforms.HasChanged(Scene.Objects[i]->GetTransform()))
+                    continue;
+                Scene.Objects[i]->UpdateWorldBounds();
+                Scene.Tree.MoveProxy(Scene.Proxies[i], Aabb::FromBounds(Scene.Objects[i]->GetWorldBounds()));
+                ++Moved;
+            }
+            Scene.Tree.Refit();
+            Scene.Tree.RebuildIfDegraded();
+        }
+        {
+            ProfileScope Scope("Visibility", Prof);
+            Visible.clear();
+            Scene.Tree.QueryFrustum(ViewFrustum, Visible);
+        }
+        {
+            ProfileScope Scope("Sorting", Prof);
+            Queue.Build(Scene.Objects, Visible, View);
+            Opaque.clear();
+            for (uint32_t Item : Queue.GetOpaque())
+                Opaque.push_back(Scene.Objects[Item]);
+            Transparent.clear();
+            for (uint32_t Item : Queue.GetTransparent())
+                Transparent.push_back(Scene.Objects[Item]);
+        }
+        uint64_t Draws = 0;
+        {
+            // Batching builds the per-instance transforms, recording the
+            // per-draw root constants; only the uploads are left out
+            ProfileScope Scope("Constants", Prof);
+            Draws += RecordPass(Opaque, BatchMerging::Any, OpaqueBatcher);
+            Draws += RecordPass(Transparent, BatchMerging::Adjacent, TransparentBatcher);
+        }
+        Prof.EndFrame();
+
+        if (FrameIndex >= Options.WarmupFrames)
+        {
+            MovedSum += Moved;
+            VisibleSum += Visible.size();
+            DrawSum += Draws;
+        }
+    }
+
+    std::vector<ScopeStats> Scopes;
+    Prof.GetScopeStats(Scopes);
+    for (const char* Name : StageNames)
+    {
+        const auto Found = std::find_if(Scopes.begin(), Scopes.end(),
+            [Name](const ScopeStats& Stats) { return std::strcmp(Stats.Name, Name) == 0; });
+        HeadlessStageResult Stage;
+        Stage.Name = Name;
+        if (Found != Scopes.end())
+            Stage = ToStageResult(*Found, Desc.ObjectCount);
+        Result.Stages.push_back(Stage);
+    }
+    ScopeStats FrameStats = Prof.GetFrameStats();
+    FrameStats.Name = "Frame";
+    Result.Frame = ToStageResult(FrameStats, Desc.ObjectCount);
+
+    Result.MovedObjects = static_cast<double>(MovedSum) / Options.Frames;
+    Result.VisibleObjects = static_cast<double>(VisibleSum) / Options.Frames;
+    Result.Draws = static_cast<double>(DrawSum) / Options.Frames;
+    return Result;
+}
+
+void WriteHeadlessJson(std::ostream& Out, const HeadlessBenchmarkResult& Result)
+{
+    const HeadlessBenchmarkOptions& Options = Result.Options;
+    const SyntheticSceneDesc& Scene = Options.Scene;
+    Out << "{\n";
+    Out << "  \"scene\": {\"objects\":" << Scene.ObjectCount << ",\"unique_meshes\":" << Scene.UniqueMeshes
+        << ",\"mix\":{\"cube\":" << Scene.Mix.Cubes << ",\"sphere\":" << Scene.Mix.Spheres
+        << ",\"cylinder\":" << Scene.Mix.Cylinders << "},\"motion_fraction\":" << Scene.MotionFraction
+        << ",\"transparent_fraction\":" << Scene.TransparentFraction << ",\"world_size\":" << Scene.WorldSize
+        << ",\"seed\":" << Scene.Seed << "},\n";
+    Out << "  \"frames\": " << Options.Frames << ",\n";
+    Out << "  \"warmup_frames\": " << Options.WarmupFrames << ",\n";
+    Out << "  \"threads\": " << Result.Threads << ",\n";
+    Out << "  \"setup_ms\": " << Result.SetupMs << ",\n";
+    Out << "  \"per_frame\": {\"moved_objects\":" << Result.MovedObjects << ",\"visible_objects\":"
+        << Result.VisibleObjects << ",\"draws\":" << Result.Draws << "},\n";
+    Out << "  \"frame\": ";
+    WriteStage(Out, Result.Frame);
+    Out << ",\n  \"stages\": [";
+    for (size_t i = 0; i < Result.Stages.size(); ++i)
+    {
+        Out << (i ? ",\n    " : "\n    ");
+        WriteStage(Out, Result.Stages[i]);
+    }
+    Out << "\n  ]\n}\n";
+}
+
+int RunHeadlessBenchmarkMain(const std::vector<std::string>& Args)
+{
+    HeadlessBenchmarkOptions Options;
+    std::string Error;
+    if (!ParseHeadlessOptions(Args, Options, Error))
+    {
+        std::cerr << Error << "\nusage: " << HeadlessUsage;
+        return 1;
+    }
+
+    const HeadlessBenchmarkResult Result = RunHeadlessBenchmark(Options);
+    if (Options.OutputPath.empty())
+    {
+        WriteHeadlessJson(std::cout, Result);
+        return 0;
+    }
+
+    std::ofstream File(Options.OutputPath);
+    WriteHeadlessJson(File, Result);
+    if (!File)
+    {
+        std::cerr << "could not write " << Options.OutputPath << "\n";
+        return 1;
+    }
+    std::cout << "wrote " << Options.OutputPath << ": " << Result.Frame.MeanMs << " ms per frame, "
+              << Result.Frame.ObjectsPerMs << " objects/ms\n";
+    return 0;
+}
+
+} // namespace Racoon
@@ -0,0 +1,91 @@
+#pragma once
+
+#include "CoreStdafx.h"
+
+#include <iosfwd>
+#include <string>
+
+namespace Racoon {
+
+// Relative weights of the primitive kinds among the unique meshes
+struct PrimitiveMix
+{
+    float Cubes{ 1.f };
+    float Spheres{ 1.f };
+    float Cylinders{ 1.f };
+};
+
+// A reproducible scene of primitives scattered over a square
+struct SyntheticSceneDesc
+{
+    uint32_t ObjectCount{ 10000 };
+    uint32_t UniqueMeshes{ 32 };
+    PrimitiveMix Mix;
+    // Share of objects that move every frame
+    float MotionFraction{ 0.1f };
+    float TransparentFraction{ 0.1f };
+    // Side of the square the objects are scattered over
+    float WorldSize{ 1000.f };
+    uint32_t Seed{ 1 };
+};
+
+struct HeadlessBenchmarkOptions
+{
+    SyntheticSceneDesc Scene;
+    uint32_t Frames{ 300 };
+    // Run before measuring, so buffers and trees have settled
+    uint32_t WarmupFrames{ 10 };
+    // Job system threads, 0 for one per core
+    uint32_t Threads{ 0 };
+    // JSON goes to stdout when empty
+    std::string OutputPath;
+};
+
+// Per-frame time of one stage of the CPU frame pipeline
+struct HeadlessStageResult
+{
+    std::string Name;
+    double MeanMs{ 0 };
+    double P50Ms{ 0 };
+    double P95Ms{ 0 };
+    double P99Ms{ 0 };
+    double MaxMs{ 0 };
+    // Scene objects over mean time
+    double ObjectsPerMs{ 0 };
+};
+
+struct HeadlessBenchmarkResult
+{
+    HeadlessBenchmarkOptions Options;
+    uint32_t Threads{ 0 };
+    double SetupMs{ 0 };
+    // Camera, transforms, visibility, sorting and constants, in frame order
+    std::vector<HeadlessStageResult> Stages;
+    HeadlessStageResult Frame;
+    // Per frame means
+    double MovedObjects{ 0 };
+    double VisibleObjects{ 0 };
+    double Draws{ 0 };
+};
+
+// Usage text for the options below
+extern const char* const HeadlessUsage;
+
+// Parses "--objects N --meshes N --mix cube=W,sphere=W,cylinder=W --motion F
+// --transparent F --world F --seed N --frames N --warmup N --threads N --out PATH".
+// Returns false with a message in Error for unknown or malformed arguments.
+bool ParseHeadlessOptions(const std::vector<std::string>& Args, HeadlessBenchmarkOptions& Options, std::string& Error);
+// Splits a Windows-style command line on whitespace, honouring double quotes
+std::vector<std::string> SplitCommandLine(const char* CommandLine);
+
+// Builds the synthetic scene and runs the engine's per-frame CPU work on it
+// without a window or GPU: camera update, transform update and bounds
+// refresh, frustum culling, render queue sorting, and batching plus
+// per-draw constant building.
+HeadlessBenchmarkResult RunHeadlessBenchmark(const HeadlessBenchmarkOptions& Options);
+void WriteHeadlessJson(std::ostream& Out, const HeadlessBenchmarkResult& Result);
+
+// Parse, run and write the JSON. Returns a process exit code.
+int RunHeadlessBenchmarkMain(const std::vector<std::string>& Args);
+
+} // namespace Racoon
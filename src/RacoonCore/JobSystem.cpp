@@ -0,0 +1,217 @@
+#include "CoreStdafx.h"
+
+#include "JobSystem.h"
+
+namespace Racoon {
+
+namespace {
+
+// The system the current thread works for and its worker index there
+thread_local const JobSystem* t_System = nullptr;
+thread_local uint32_t t_WorkerIndex = 0;
+
+// Rounds of failed job searches before a worker goes to sleep
+constexpr uint32_t SpinRounds = 64;
+
+} // namespace
+
+bool JobSystem::WorkDeque::Push(Job* NewJob)
+{
+    const int64_t Bottom = m_Bottom.load(std::memory_order_relaxed);
+    const int64_t Top = m_Top.load(std::memory_order_acquire);
+    if (Bottom - Top >= static_cast<int64_t>(MaxJobsPerThread))
+        return false;
+
+    // Release on the slot as well as the fence, so a thief's acquire load of
+    // the pointer also sees the job's contents (and tools that ignore fences agree)
+    m_Jobs[Bottom & (MaxJobsPerThread - 1)].store(NewJob, std::memory_order_release);
+    std::atomic_thread_fence(std::memory_order_release);
+    m_Bottom.store(Bottom + 1, std::memory_order_relaxed);
+    return true;
+}
+
+JobSystem::Job* JobSystem::WorkDeque::Pop()
+{
+    const int64_t Bottom = m_Bottom.load(std::memory_order_relaxed) - 1;
+    m_Bottom.store(Bottom, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t Top = m_Top.load(std::memory_order_relaxed);
+
+    if (Top > Bottom)
+    {
+        // Empty
+        m_Bottom.store(Bottom + 1, std::memory_order_relaxed);
+        return nullptr;
+    }
+
+    Job* Result = m_Jobs[Bottom & (MaxJobsPerThread - 1)].load(std::memory_order_relaxed);
+    if (Top == Bottom)
+    {
+        // Last job, race the thieves for it
+        if (!m_Top.compare_exchange_strong(Top, Top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+            Result = nullptr;
+        m_Bottom.store(Bottom + 1, std::memory_order_relaxed);
+    }
+    return Result;
+}
+
+JobSystem::Job* JobSystem::WorkDeque::Steal()
+{
+    int64_t Top = m_Top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    const int64_t Bottom = m_Bottom.load(std::memory_order_acquire);
+    if (Top >= Bottom)
+        return nullptr;
+
+    Job* Result = m_Jobs[Top & (MaxJobsPerThread - 1)].load(std::memory_order_acquire);
+    // Losing the race means another thief or the owner took it
+    if (!m_Top.compare_exchange_strong(Top, Top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+        return nullptr;
+    return Result;
+}
+
+JobSystem::JobSystem(uint32_t ThreadCount)
+    : m_ThreadCount(ThreadCount ? ThreadCount : std::max(1u, std::thread::hardware_concurrency()))
+    , m_Workers(new Worker[m_ThreadCount])
+    , m_PreviousSystem(t_System)
+    , m_PreviousIndex(t_WorkerIndex)
+{
+    t_System = this;
+    t_WorkerIndex = 0;
+
+    m_Threads.reserve(m_ThreadCount - 1);
+    for (uint32_t Index = 1; Index < m_ThreadCount; ++Index)
+        m_Threads.emplace_back(&JobSystem::WorkerMain, this, Index);
+}
+
+JobSystem::~JobSystem()
+{
+    {
+        std::lock_guard<std::mutex> Lock(m_SleepMutex);
+        m_Stopping.store(true);
+    }
+    m_WakeUp.notify_all();
+    for (std::thread& Thread : m_Threads)
+        Thread.join();
+
+    if (t_System == this)
+    {
+        t_System = m_PreviousSystem;
+        t_WorkerIndex = m_PreviousIndex;
+    }
+}
+
+uint32_t JobSystem::GetWorkerIndex() const
+{
+    return t_System == this ? t_WorkerIndex : NotAWorker;
+}
+
+JobSystem::Job* JobSystem::AllocateJob()
+{
+    const uint32_t Index = GetWorkerIndex();
+    if (Index == NotAWorker)
+        return nullptr;
+
+    Worker& Self = m_Workers[Index];
+    Job& Slot = Self.Pool[Self.NextJob & (MaxJobsPerThread - 1)];
+    if (Slot.InUse.load(std::memory_order_acquire))
+        return nullptr;
+    ++Self.NextJob;
+    Slot.InUse.store(true, std::memory_order_relaxed);
+    return &Slot;
+}
+
+void JobSystem::Submit(Job* NewJob)
+{
+    if (!m_Workers[GetWorkerIndex()].Queue.Push(NewJob))
+    {
+        Execute(*NewJob);
+        return;
+    }
+
+    // Pairs with the sleeper incrementing m_SleepingWorkers before it checks
+    // m_QueuedJobs: one of the two sees the other, so no wake-up is lost
+    m_QueuedJobs.fetch_add(1);
+    if (m_SleepingWorkers.load() > 0)
+    {
+        std::lock_guard<std::mutex> Lock(m_SleepMutex);
+        m_WakeUp.notify_one();
+    }
+}
+
+JobSystem::Job* JobSystem::FindJob(uint32_t Index)
+{
+    Job* Found = nullptr;
+    if (Index != NotAWorker)
+        Found = m_Workers[Index].Queue.Pop();
+
+    if (!Found)
+    {
+        // Start after our own deque so thieves spread over the victims
+        const uint32_t First = Index == NotAWorker ? 0 : Index + 1;
+        for (uint32_t i = 0; i < m_ThreadCount && !Found; ++i)
+        {
+            const uint32_t Victim = (First + i) % m_ThreadCount;
+            if (Victim != Index)
+                Found = m_Workers[Victim].Queue.Steal();
+        }
+        if (Found)
+            m_StolenJobs.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    if (Found)
+        m_QueuedJobs.fetch_sub(1);
+    return Found;
+}
+
+void JobSystem::Execute(Job& Current)
+{
+    JobCounter* Counter = Current.Counter;
+    Current.Invoke(Current);
+    // Free the slot before the counter: once it reaches zero the owner may
+    // destroy the system
+    Current.InUse.store(false, std::memory_order_release);
+    Counter->m_Pending.fetch_sub(1, std::memory_order_release);
+}
+
+void JobSystem::Wait(JobCounter& Counter)
+{
+    const uint32_t Index = GetWorkerIndex();
+    while (!Counter.IsDone())
+    {
+        if (Job* Next = FindJob(Index))
+            Execute(*Next);
+        else
+            std::this_thread::yield();
+    }
+}
+
+void JobSystem::WorkerMain(uint32_t Index)
+{
+    t_System = this;
+    t_WorkerIndex = Index;
+
+    uint32_t IdleRounds = 0;
+    while (!m_Stopping.load(std::memory_order_acquire))
+    {
+        if (Job* Next = FindJob(Index))
+        {
+            Execute(*Next);
+            IdleRounds = 0;
+            continue;
+        }
+        if (++IdleRounds < SpinRounds)
+        {
+            std::this_thread::yield();
+            continue;
+        }
+
+        IdleRounds = 0;
+        std::unique_lock<std::mutex> Lock(m_SleepMutex);
+        m_SleepingWorkers.fetch_add(1);
+        m_WakeUp.wait(Lock, [this]() { return m_Stopping.load() || m_QueuedJobs.load() > 0; });
+        m_SleepingWorkers.fetch_sub(1);
+    }
+}
+
+} // namespace Racoon
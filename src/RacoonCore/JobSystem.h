@@ -0,0 +1,189 @@
+#pragma once
+
+#include "CoreStdafx.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+
+namespace Racoon {
+
+// Number of unfinished jobs. Run adds one, the job subtracts one when it has
+// run, and JobSystem::Wait returns once it is back at zero. A job that needs
+// others done first waits on their counter; waiting runs other jobs, so it
+// never blocks a worker.
+class JobCounter
+{
+public:
+    bool IsDone() const { return m_Pending.load(std::memory_order_acquire) == 0; }
+
+private:
+    friend class JobSystem;
+    std::atomic<uint32_t> m_Pending{ 0 };
+};
+
+// Fixed pool of threads with one work-stealing deque each. The creating thread
+// is worker 0: it runs jobs whenever it waits. Workers pop their own newest
+// job and steal the oldest from others, so split ranges are stolen biggest
+// first. Jobs are stored inline without allocating; when a thread has too many
+// in flight, Run executes the new job on the spot instead.
+//
+// Run, Wait and ParallelFor may be called from any job and from the creating
+// thread. Other threads get the same results, but their jobs run inline.
+class JobSystem
+{
+public:
+    // Captures of a job must fit in this many bytes; capture pointers to larger data
+    static constexpr size_t MaxJobDataSize = 48;
+    // Jobs a thread can have queued at once, a power of two
+    static constexpr uint32_t MaxJobsPerThread = 4096;
+
+    // ThreadCount includes the creating thread, 0 uses std::thread::hardware_concurrency()
+    explicit JobSystem(uint32_t ThreadCount = 0);
+    ~JobSystem();
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    uint32_t GetThreadCount() const { return m_ThreadCount; }
+    // Jobs taken from another thread's deque since construction
+    uint64_t GetStolenJobCount() const { return m_StolenJobs.load(std::memory_order_relaxed); }
+
+    static constexpr uint32_t NotAWorker = ~0u;
+    // Index of the calling thread in this system, 0 for the creating thread,
+    // or NotAWorker. Handy for per-thread data such as FrameAllocator arenas.
+    uint32_t GetWorkerIndex() const;
+
+    template<typename Fn>
+    void Run(JobCounter& Counter, Fn&& Body);
+
+    // Runs queued jobs until Counter reaches zero
+    void Wait(JobCounter& Counter);
+
+    // Calls Body(First, Last) over [0, Count) in ranges of at most Grain
+    // elements and returns when all have run. Grain 0 aims for about eight
+    // ranges per thread. Ranges are split in halves, so an idle thread steals
+    // half of the remaining work at a time.
+    template<typename Fn>
+    void ParallelFor(uint32_t Count, uint32_t Grain, const Fn& Body);
+
+private:
+    struct Job
+    {
+        // Runs the callable in Data and destroys it
+        void (*Invoke)(Job& Self);
+        JobCounter* Counter;
+        // Set while queued or running, so the slot is not reused
+        std::atomic<bool> InUse{ false };
+        alignas(16) unsigned char Data[MaxJobDataSize];
+    };
+
+    // Chase-Lev deque over a fixed ring (Le et al., "Correct and Efficient
+    // Work-Stealing for Weak Memory Models"). The owner pushes and pops at the
+    // bottom, thieves take from the top.
+    class WorkDeque
+    {
+    public:
+        bool Push(Job* NewJob);
+        Job* Pop();
+        Job* Steal();
+
+    private:
+        alignas(64) std::atomic<int64_t> m_Top{ 0 };
+        alignas(64) std::atomic<int64_t> m_Bottom{ 0 };
+        std::atomic<Job*> m_Jobs[MaxJobsPerThread];
+    };
+
+    struct alignas(64) Worker
+    {
+        WorkDeque Queue;
+        // Jobs are handed out round robin; InUse guards against wrapping onto a live one
+        Job Pool[MaxJobsPerThread];
+        uint32_t NextJob{ 0 };
+    };
+
+    // A free job slot of the calling worker, or nullptr to run inline
+    Job* AllocateJob();
+    void Submit(Job* NewJob);
+    Job* FindJob(uint32_t Index);
+    void Execute(Job& Current);
+    void WorkerMain(uint32_t Index);
+
+    template<typename Fn>
+    void SplitRange(JobCounter& Counter, uint32_t First, uint32_t Last, uint32_t Grain, const Fn& Body);
+
+    uint32_t m_ThreadCount;
+    std::unique_ptr<Worker[]> m_Workers;
+    std::vector<std::thread> m_Threads;
+
+    // Sleeping workers wake when a job is queued
+    std::atomic<int64_t> m_QueuedJobs{ 0 };
+    std::atomic<uint32_t> m_SleepingWorkers{ 0 };
+    std::mutex m_SleepMutex;
+    std::condition_variable m_WakeUp;
+    std::atomic<bool> m_Stopping{ false };
+
+    std::atomic<uint64_t> m_StolenJobs{ 0 };
+
+    // The creating thread's previous registration, restored on destruction
+    const JobSystem* m_PreviousSystem;
+    uint32_t m_PreviousIndex;
+};
+
+template<typename Fn>
+void JobSystem::Run(JobCounter& Counter, Fn&& Body)
+{
+    using Callable = std::decay_t<Fn>;
+    static_assert(sizeof(Callable) <= MaxJobDataSize, "Job captures too large, capture a pointer instead");
+    static_assert(alignof(Callable) <= 16, "Job captures over-aligned");
+
+    Job* NewJob = AllocateJob();
+    if (!NewJob)
+    {
+        Body();
+        return;
+    }
+
+    Counter.m_Pending.fetch_add(1, std::memory_order_relaxed);
+    new (NewJob->Data) Callable(std::forward<Fn>(Body));
+    NewJob->Invoke = [](Job& Self) {
+        Callable& Stored = *std::launder(reinterpret_cast<Callable*>(Self.Data));
+        Stored();
+        Stored.~Callable();
+    };
+    NewJob->Counter = &Counter;
+    Submit(NewJob);
+}
+
+template<typename Fn>
+void JobSystem::ParallelFor(uint32_t Count, uint32_t Grain, const Fn& Body)
+{
+    if (Count == 0)
+        return;
+    if (Grain == 0)
+        Grain = std::max(1u, Count / (m_ThreadCount * 8));
+
+    JobCounter Counter;
+    SplitRange(Counter, 0, Count, Grain, Body);
+    Wait(Counter);
+}
+
+template<typename Fn>
+void JobSystem::SplitRange(JobCounter& Counter, uint32_t First, uint32_t Last, uint32_t Grain, const Fn& Body)
+{
+    // Queue the upper halves and keep the lowest range
+    while (Last - First > Grain)
+    {
+        const uint32_t Middle = First + (Last - First) / 2;
+        Run(Counter, [this, &Counter, Middle, Last, Grain, &Body]() {
+            SplitRange(Counter, Middle, Last, Grain, Body);
+        });
+        Last = Middle;
+    }
+    Body(First, Last);
+}
+
+} // namespace Racoon
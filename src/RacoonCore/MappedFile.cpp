@@ -0,0 +1,170 @@
+#include "CoreStdafx.h"
+
+#include "MappedFile.h"
+
+#include <utility>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace Racoon {
+
+MappedFile::~MappedFile()
+{
+    Close();
+}
+
+MappedFile::MappedFile(MappedFile&& Other) noexcept
+{
+    *this = std::move(Other);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& Other) noexcept
+{
+    if (this == &Other)
+        return *this;
+    Close();
+    m_Data = std::exchange(Other.m_Data, nullptr);
+    m_Size = std::exchange(Other.m_Size, 0);
+    m_Open = std::exchange(Other.m_Open, false);
+#ifdef _WIN32
+    m_File = std::exchange(Other.m_File, nullptr);
+    m_Mapping = std::exchange(Other.m_Mapping, nullptr);
+#endif
+    return *this;
+}
+
+#ifdef _WIN32
+
+bool MappedFile::Open(const std::string& Path, std::string& Error)
+{
+    Close();
+    HANDLE File = CreateFileA(Path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (File == INVALID_HANDLE_VALUE)
+    {
+        Error = "cannot open " + Path;
+        return false;
+    }
+
+    LARGE_INTEGER Size;
+    if (!GetFileSizeEx(File, &Size))
+    {
+        CloseHandle(File);
+        Error = "cannot get the size of " + Path;
+        return false;
+    }
+
+    m_File = File;
+    m_Size = static_cast<size_t>(Size.QuadPart);
+    m_Open = true;
+    // Empty files cannot be mapped
+    if (m_Size == 0)
+        return true;
+
+    m_Mapping = CreateFileMappingA(File, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (m_Mapping)
+        m_Data = static_cast<const uint8_t*>(MapViewOfFile(m_Mapping, FILE_MAP_READ, 0, 0, 0));
+    if (!m_Data)
+    {
+        Close();
+        Error = "cannot map " + Path;
+        return false;
+    }
+    return true;
+}
+
+void MappedFile::Close()
+{
+    if (m_Data)
+        UnmapViewOfFile(m_Data);
+    if (m_Mapping)
+        CloseHandle(m_Mapping);
+    if (m_File)
+        CloseHandle(m_File);
+    m_Data = nullptr;
+    m_Mapping = nullptr;
+    m_File = nullptr;
+    m_Size = 0;
+    m_Open = false;
+}
+
+void MappedFile::PrefetchAll() const
+{
+    if (!m_Data)
+        return;
+    WIN32_MEMORY_RANGE_ENTRY Range{ const_cast<uint8_t*>(m_Data), m_Size };
+    PrefetchVirtualMemory(GetCurrentProcess(), 1, &Range, 0);
+}
+
+#else
+
+bool MappedFile::Open(const std::string& Path, std::string& Error)
+{
+    Close();
+    const int File = ::open(Path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (File < 0)
+    {
+        Error = "cannot open " + Path + ": " + std::strerror(errno);
+        return false;
+    }
+
+    struct stat Info;
+    if (fstat(File, &Info) != 0)
+    {
+        Error = "cannot stat " + Path + ": " + std::strerror(errno);
+        ::close(File);
+        return false;
+    }
+
+    m_Size = static_cast<size_t>(Info.st_size);
+    m_Open = true;
+    if (m_Size > 0)
+    {
+        void* Data = mmap(nullptr, m_Size, PROT_READ, MAP_PRIVATE, File, 0);
+        if (Data == MAP_FAILED)
+        {
+            Error = "cannot map " + Path + ": " + std::strerror(errno);
+            ::close(File);
+            Close();
+            return false;
+        }
+        m_Data = static_cast<const uint8_t*>(Data);
+    }
+    // The mapping keeps the file alive
+    ::close(File);
+    return true;
+}
+
+void MappedFile::Close()
+{
+    if (m_Data)
+        munmap(const_cast<uint8_t*>(m_Data), m_Size);
+    m_Data = nullptr;
+    m_Size = 0;
+    m_Open = false;
+}
+
+void MappedFile::PrefetchAll() const
+{
+    if (m_Data)
+        madvise(const_cast<uint8_t*>(m_Data), m_Size, MADV_WILLNEED);
+}
+
+#endif
+
+} // namespace Racoon
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "CoreStdafx.h"
+
+#include <string>
+
+namespace Racoon {
+
+// Read-only memory mapping of a whole file. Pages are faulted in by the OS
+// as they are touched, so readers work on the file contents in place
+// without reading them into a buffer first. Move-only; unmaps on
+// destruction.
+class MappedFile
+{
+public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(MappedFile&& Other) noexcept;
+    MappedFile& operator=(MappedFile&& Other) noexcept;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // Maps Path, closing any previous mapping. An empty file opens with no data.
+    bool Open(const std::string& Path, std::string& Error);
+    void Close();
+
+    bool IsOpen() const { return m_Open; }
+    const uint8_t* GetData() const { return m_Data; }
+    size_t GetSize() const { return m_Size; }
+
+    // Hints that the whole file will be read front to back soon
+    void PrefetchAll() const;
+
+private:
+    const uint8_t* m_Data{ nullptr };
+    size_t m_Size{ 0 };
+    bool m_Open{ false };
+#ifdef _WIN32
+    void* m_File{ nullptr };
+    void* m_Mapping{ nullptr };
+#endif
+};
+
+} // namespace Racoon
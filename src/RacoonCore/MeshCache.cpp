@@ -0,0 +1,312 @@
+#include "CoreStdafx.h"
+
+#include "MeshCache.h"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+namespace Racoon {
+
+struct MeshCacheHeader
+{
+    char Magic[4];
+    uint32_t Version;
+    uint64_t ContentHash;
+    uint32_t Encoding;
+    uint32_t VertexStride;
+    uint32_t VertexCount;
+    uint32_t Index16Count;
+    uint32_t Index32Count;
+    uint32_t MeshCount;
+    uint64_t VertexOffset;
+    uint64_t Index16Offset;
+    uint64_t Index32Offset;
+    uint64_t MeshOffset;
+    uint64_t FileSize;
+};
+static_assert(sizeof(MeshCacheHeader) == 80, "the header layout is part of the file format");
+
+namespace {
+
+uint64_t AlignSection(uint64_t Offset)
+{
+    return (Offset + MeshCacheFormat::SectionAlignment - 1) & ~(MeshCacheFormat::SectionAlignment - 1);
+}
+
+bool SectionFits(uint64_t Offset, uint64_t Size, uint64_t FileSize)
+{
+    return Offset % MeshCacheFormat::SectionAlignment == 0 && Offset <= FileSize && Size <= FileSize - Offset;
+}
+
+// Writes Size bytes and zeros up to the next section boundary
+void WriteSection(std::ofstream& Out, const void* Data, uint64_t Size)
+{
+    static const char Zeros[MeshCacheFormat::SectionAlignment] = {};
+    if (Size > 0)
+        Out.write(static_cast<const char*>(Data), static_cast<std::streamsize>(Size));
+    Out.write(Zeros, static_cast<std::streamsize>(AlignSection(Size) - Size));
+}
+
+} // namespace
+
+bool WriteMeshCache(const std::string& Path, uint64_t ContentHash, const MeshRegistry& Registry,
+    const std::vector<std::shared_ptr<MeshData>>& Meshes, std::string& Error)
+{
+    return WriteMeshCache(Path, ContentHash, Registry, Meshes, {}, Error);
+}
+
+bool WriteMeshCache(const std::string& Path, uint64_t ContentHash, const MeshRegistry& Registry,
+    const std::vector<std::shared_ptr<MeshData>>& Meshes, const std::vector<std::vector<LodLevel>>& Lods,
+    std::string& Error)
+{
+    assert(Lods.empty() || Lods.size() == Meshes.size());
+    const auto& VertexData = Registry.GetVertexData();
+    const auto& Indices16 = Registry.GetIndices16();
+    const auto& Indices32 = Registry.GetIndices32();
+
+    size_t EntryCount = Meshes.size();
+    for (const auto& Levels : Lods)
+        EntryCount += Levels.size();
+
+    // Set field by field on zeroed memory, so padding bytes are zero and the
+    // same meshes always give the same file
+    std::vector<CookedMesh> Cooked(EntryCount);
+    std::memset(static_cast<void*>(Cooked.data()), 0, Cooked.size() * sizeof(CookedMesh));
+    size_t Next = 0;
+    auto Cook = [&](const MeshData& Mesh, uint32_t Level, float LodError) {
+        const MeshHandle Handle = Registry.Find(&Mesh);
+        if (!Handle.IsValid())
+            return false;
+        const MeshRange& Range = Registry.GetRange(Handle);
+        CookedMesh& Entry = Cooked[Next++];
+        Entry.LocalBounds.Center = Mesh.LocalBounds.Center;
+        Entry.LocalBounds.Extents = Mesh.LocalBounds.Extents;
+        Entry.LocalBounds.Radius = Mesh.LocalBounds.Radius;
+        Entry.Range.BaseVertex = Range.BaseVertex;
+        Entry.Range.VertexCount = Range.VertexCount;
+        Entry.Range.StartIndex = Range.StartIndex;
+        Entry.Range.IndexCount = Range.IndexCount;
+        Entry.Range.IndexWidth = Range.IndexWidth;
+        Entry.Range.Quantization.Offset = Range.Quantization.Offset;
+        Entry.Range.Quantization.Scale = Range.Quantization.Scale;
+        Entry.LodLevel = Level;
+        Entry.LodError = LodError;
+        return true;
+    };
+    for (size_t i = 0; i < Meshes.size(); ++i)
+    {
+        bool Registered = Cook(*Meshes[i], 0, 0.f);
+        const size_t LevelCount = Lods.empty() ? 0 : Lods[i].size();
+        for (size_t Level = 0; Registered && Level < LevelCount; ++Level)
+            Registered = Cook(*Lods[i][Level].Mesh, static_cast<uint32_t>(Level + 1), Lods[i][Level].Error);
+        if (!Registered)
+        {
+            Error = "mesh " + std::to_string(i) + " or one of its levels is not registered";
+            return false;
+        }
+        if (LevelCount + 1 > MeshLodChain::MaxLevels)
+        {
+            Error = "mesh " + std::to_string(i) + " has more than " + std::to_string(MeshLodChain::MaxLevels) +
+                " levels";
+            return false;
+        }
+    }
+
+    MeshCacheHeader Head;
+    std::memset(&Head, 0, sizeof(Head));
+    std::memcpy(Head.Magic, MeshCacheFormat::Magic, sizeof(Head.Magic));
+    Head.Version = MeshCacheFormat::Version;
+    Head.ContentHash = ContentHash;
+    Head.Encoding = static_cast<uint32_t>(Registry.GetEncoding());
+    Head.VertexStride = Registry.GetVertexStride();
+    Head.VertexCount = Registry.GetVertexCount();
+    Head.Index16Count = static_cast<uint32_t>(Indices16.size());
+    Head.Index32Count = static_cast<uint32_t>(Indices32.size());
+    Head.MeshCount = static_cast<uint32_t>(Cooked.size());
+    Head.VertexOffset = AlignSection(sizeof(Head));
+    Head.Index16Offset = Head.VertexOffset + AlignSection(VertexData.size());
+    Head.Index32Offset = Head.Index16Offset + AlignSection(Indices16.size() * sizeof(uint16_t));
+    Head.MeshOffset = Head.Index32Offset + AlignSection(Indices32.size() * sizeof(uint32_t));
+    Head.FileSize = Head.MeshOffset + AlignSection(Cooked.size() * sizeof(CookedMesh));
+
+    const std::string TempPath = Path + ".tmp";
+    {
+        std::ofstream Out(TempPath, std::ios::binary | std::ios::trunc);
+        if (!Out)
+        {
+            Error = "cannot create " + TempPath;
+            return false;
+        }
+        WriteSection(Out, &Head, sizeof(Head));
+        WriteSection(Out, VertexData.data(), VertexData.size());
+        WriteSection(Out, Indices16.data(), Indices16.size() * sizeof(uint16_t));
+        WriteSection(Out, Indices32.data(), Indices32.size() * sizeof(uint32_t));
+        WriteSection(Out, Cooked.data(), Cooked.size() * sizeof(CookedMesh));
+        Out.close();
+        if (!Out)
+        {
+            Error = "cannot write " + TempPath;
+            return false;
+        }
+    }
+
+    std::error_code Failure;
+    std::filesystem::rename(TempPath, Path, Failure);
+    if (Failure)
+    {
+        Error = "cannot replace " + Path + ": " + Failure.message();
+        std::filesystem::remove(TempPath, Failure);
+        return false;
+    }
+    return true;
+}
+
+bool MeshCacheFile::Open(const std::string& Path, std::string& Error)
+{
+    Close();
+    MappedFile File;
+    if (!File.Open(Path, Error))
+        return false;
+
+    const uint64_t FileSize = File.GetSize();
+    if (FileSize < sizeof(MeshCacheHeader))
+    {
+        Error = Path + " is too small for a mesh cache";
+        return false;
+    }
+    // The mapping is page aligned, so the header can be read in place
+    const MeshCacheHeader& Head = *reinterpret_cast<const MeshCacheHeader*>(File.GetData());
+    if (std::memcmp(Head.Magic, MeshCacheFormat::Magic, sizeof(Head.Magic)) != 0)
+    {
+        Error = Path + " is not a mesh cache";
+        return false;
+    }
+    if (Head.Version != MeshCacheFormat::Version)
+    {
+        Error = Path + " has version " + std::to_string(Head.Version) + ", expected " +
+            std::to_string(MeshCacheFormat::Version);
+        return false;
+    }
+    if (Head.Encoding > static_cast<uint32_t>(VertexEncoding::PackedQuantized) ||
+        Head.VertexStride != GetVertexLayout(static_cast<VertexEncoding>(Head.Encoding)).Stride)
+    {
+        Error = Path + " has an unknown vertex encoding";
+        return false;
+    }
+    if (Head.FileSize != FileSize ||
+        !SectionFits(Head.VertexOffset, uint64_t(Head.VertexCount) * Head.VertexStride, FileSize) ||
+        !SectionFits(Head.Index16Offset, uint64_t(Head.Index16Count) * sizeof(uint16_t), FileSize) ||
+        !SectionFits(Head.Index32Offset, uint64_t(Head.Index32Count) * sizeof(uint32_t), FileSize) ||
+        !SectionFits(Head.MeshOffset, uint64_t(Head.MeshCount) * sizeof(CookedMesh), FileSize))
+    {
+        Error = Path + " is truncated or its sections overlap the end";
+        return false;
+    }
+
+    // Per mesh, not per element: a few dozen checks keep every draw inside
+    // the arenas even if the file was damaged
+    const CookedMesh* Meshes = reinterpret_cast<const CookedMesh*>(File.GetData() + Head.MeshOffset);
+    for (uint32_t i = 0; i < Head.MeshCount; ++i)
+    {
+        const MeshRange& Range = Meshes[i].Range;
+        const uint64_t IndexArena = Range.IndexWidth == IndexFormat::Uint16 ? Head.Index16Count : Head.Index32Count;
+        if ((Range.IndexWidth != IndexFormat::Uint16 && Range.IndexWidth != IndexFormat::Uint32) ||
+            uint64_t(Range.BaseVertex) + Range.VertexCount > Head.VertexCount ||
+            uint64_t(Range.StartIndex) + Range.IndexCount > IndexArena)
+        {
+            Error = Path + ": mesh " + std::to_string(i) + " lies outside the arenas";
+            return false;
+        }
+        // Levels continue the entry before them, so chains can be rebuilt
+        // without looking ahead
+        const uint32_t Level = Meshes[i].LodLevel;
+        if (Level >= MeshLodChain::MaxLevels || (Level > 0 && (i == 0 || Meshes[i - 1].LodLevel != Level - 1)))
+        {
+            Error = Path + ": mesh " + std::to_string(i) + " has a stray LOD level";
+            return false;
+        }
+    }
+
+    m_File = std::move(File);
+    m_Header = &Head;
+    return true;
+}
+
+uint64_t MeshCacheFile::GetContentHash() const
+{
+    assert(IsOpen());
+    return m_Header->ContentHash;
+}
+
+VertexEncoding MeshCacheFile::GetEncoding() const
+{
+    assert(IsOpen());
+    return static_cast<VertexEncoding>(m_Header->Encoding);
+}
+
+uint32_t MeshCacheFile::GetVertexStride() const
+{
+    assert(IsOpen());
+    return m_Header->VertexStride;
+}
+
+uint32_t MeshCacheFile::GetVertexCount() const
+{
+    assert(IsOpen());
+    return m_Header->VertexCount;
+}
+
+const uint8_t* MeshCacheFile::GetVertexData() const
+{
+    assert(IsOpen());
+    return m_File.GetData() + m_Header->VertexOffset;
+}
+
+uint32_t MeshCacheFile::GetIndex16Count() const
+{
+    assert(IsOpen());
+    return m_Header->Index16Count;
+}
+
+const uint16_t* MeshCacheFile::GetIndices16() const
+{
+    assert(IsOpen());
+    return reinterpret_cast<const uint16_t*>(m_File.GetData() + m_Header->Index16Offset);
+}
+
+uint32_t MeshCacheFile::GetIndex32Count() const
+{
+    assert(IsOpen());
+    return m_Header->Index32Count;
+}
+
+const uint32_t* MeshCacheFile::GetIndices32() const
+{
+    assert(IsOpen());
+    return reinterpret_cast<const uint32_t*>(m_File.GetData() + m_Header->Index32Offset);
+}
+
+uint32_t MeshCacheFile::GetMeshCount() const
+{
+    assert(IsOpen());
+    return m_Header->MeshCount;
+}
+
+const CookedMesh& MeshCacheFile::GetMesh(uint32_t Index) const
+{
+    assert(IsOpen() && Index < m_Header->MeshCount);
+    return reinterpret_cast<const CookedMesh*>(m_File.GetData() + m_Header->MeshOffset)[Index];
+}
+
+void ApplyCookedMesh(const CookedMesh& Mesh, uint32_t MeshIndex, RenderItem& Item)
+{
+    Item.MeshIndex = MeshIndex;
+    Item.BaseVertexLocation = Mesh.Range.BaseVertex;
+    Item.StartIndexLocation = Mesh.Range.StartIndex;
+    Item.IndexCount = Mesh.Range.IndexCount;
+    Item.IndexWidth = Mesh.Range.IndexWidth;
+    Item.Quantization = Mesh.Range.Quantization;
+}
+
+} // namespace Racoon
@@ -0,0 +1,106 @@
+#pragma once
+
+#include "CoreStdafx.h"
+#include "MappedFile.h"
+#include "MeshLod.h"
+#include "MeshRegistry.h"
+#include "MeshSimplifier.h"
+
+#include <string>
+#include <utility>
+
+namespace Racoon {
+
+// One mesh of a .rmesh file: its object space bounds and where its vertices
+// and indices sit in the file's arenas. Stored as is and read in place.
+struct CookedMesh
+{
+    Bounds LocalBounds;
+    MeshRange Range;
+    // 0 for a source mesh; its coarser levels follow it, numbered from 1,
+    // with their errors as in LodLevel
+    uint32_t LodLevel;
+    float LodError;
+};
+static_assert(std::is_trivially_copyable_v<CookedMesh>, "CookedMesh is read straight from the mapping");
+
+// .rmesh: a MeshRegistry's arenas cooked to disk. Everything little endian.
+//
+//   Header          magic, version, content hash, counts, section offsets
+//   Vertices        VertexCount * VertexStride bytes, already in the GPU layout
+//   Indices16       16-bit index arena
+//   Indices32       32-bit index arena
+//   Meshes          MeshCount CookedMesh entries, each source mesh followed
+//                   by its LOD levels
+//
+// Each section starts on a 64-byte boundary of the file, so with the mapping
+// page aligned every section is cache line aligned in memory too. Loading is
+// one mmap and a header check; nothing is parsed per element.
+namespace MeshCacheFormat {
+constexpr char Magic[4] = { 'R', 'M', 'S', 'H' };
+// Bump whenever the layout of the file or of CookedMesh changes
+constexpr uint32_t Version = 2;
+constexpr uint64_t SectionAlignment = 64;
+} // namespace MeshCacheFormat
+
+// Writes every mesh in Meshes, which must be registered in Registry, with
+// ContentHash as the key. Mesh i of the file is Meshes[i]; the arenas are
+// written as they are, holes included. The file is written next to Path and
+// renamed over it, so readers never see a partial file.
+bool WriteMeshCache(const std::string& Path, uint64_t ContentHash, const MeshRegistry& Registry,
+    const std::vector<std::shared_ptr<MeshData>>& Meshes, std::string& Error);
+// As above with each mesh followed by its coarser levels, Lods[i] being the
+// levels of Meshes[i] after the source as BuildLodChain returns them. Lods is
+// empty or has one entry per mesh.
+bool WriteMeshCache(const std::string& Path, uint64_t ContentHash, const MeshRegistry& Registry,
+    const std::vector<std::shared_ptr<MeshData>>& Meshes, const std::vector<std::vector<LodLevel>>& Lods,
+    std::string& Error);
+
+struct MeshCacheHeader;
+
+// A mapped .rmesh file. Open checks the header and that every section and
+// mesh range lies inside the file; the data itself is trusted. Compare
+// GetContentHash with the key of the source before using it.
+class MeshCacheFile
+{
+public:
+    MeshCacheFile() = default;
+    MeshCacheFile(MeshCacheFile&& Other) noexcept
+        : m_File(std::move(Other.m_File)), m_Header(std::exchange(Other.m_Header, nullptr)) {}
+    MeshCacheFile& operator=(MeshCacheFile&& Other) noexcept
+    {
+        if (this != &Other)
+        {
+            m_File = std::move(Other.m_File);
+            m_Header = std::exchange(Other.m_Header, nullptr);
+        }
+        return *this;
+    }
+
+    bool Open(const std::string& Path, std::string& Error);
+    void Close() { m_File.Close(); m_Header = nullptr; }
+    bool IsOpen() const { return m_Header != nullptr; }
+
+    uint64_t GetContentHash() const;
+    VertexEncoding GetEncoding() const;
+    uint32_t GetVertexStride() const;
+    uint32_t GetVertexCount() const;
+    const uint8_t* GetVertexData() const;
+    uint32_t GetIndex16Count() const;
+    const uint16_t* GetIndices16() const;
+    uint32_t GetIndex32Count() const;
+    const uint32_t* GetIndices32() const;
+
+    uint32_t GetMeshCount() const;
+    const CookedMesh& GetMesh(uint32_t Index) const;
+
+private:
+    MappedFile m_File;
+    const MeshCacheHeader* m_Header{ nullptr };
+};
+
+// Points the item's draw arguments at a cooked mesh, like MeshRegistry::ApplyRange.
+// MeshIndex is the mesh's index in the file.
+void ApplyCookedMesh(const CookedMesh& Mesh, uint32_t MeshIndex, RenderItem& Item);
+
+} // namespace Racoon
@@ -0,0 +1,86 @@
+#include "MeshGeometry.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define RACOON_SSE2 1
+#endif
+
+namespace Racoon {
+
+Bounds ComputeBounds(const Vertex* Vertices, size_t Count)
+{
+    Bounds Result;
+    if (Count == 0)
+        return Result;
+
+    XMVECTOR Min = XMLoadFloat3(&Vertices[0].Position);
+    XMVECTOR Max = Min;
+    for (size_t i = 1; i < Count; ++i)
+    {
+        const XMVECTOR P = XMLoadFloat3(&Vertices[i].Position);
+        Min = XMVectorMin(Min, P);
+        Max = XMVectorMax(Max, P);
+    }
+    const XMVECTOR Center = XMVectorScale(XMVectorAdd(Min, Max), 0.5f);
+    XMStoreFloat3(&Result.Center, Center);
+    XMStoreFloat3(&Result.Extents, XMVectorScale(XMVectorSubtract(Max, Min), 0.5f));
+
+    // Second pass for the farthest vertex from the box center
+    XMVECTOR MaxDistanceSq = XMVectorZero();
+    for (size_t i = 0; i < Count; ++i)
+    {
+        const XMVECTOR Offset = XMVectorSubtract(XMLoadFloat3(&Vertices[i].Position), Center);
+        MaxDistanceSq = XMVectorMax(MaxDistanceSq, XMVector3LengthSq(Offset));
+    }
+    Result.Radius = std::sqrt(XMVectorGetX(MaxDistanceSq));
+    return Result;
+}
+
+bool MeshData::FitsIndices16() const
+{
+    // OR-ing everything together is branch-free and vectorizes; a bit at or
+    // above 16 survives if any index does not fit
+    uint32_t Combined = 0;
+    for (uint32_t Index : Indices32)
+        Combined |= Index;
+    return Combined <= 0xFFFFu;
+}
+
+const std::vector<uint16_t>& MeshData::GetIndices16()
+{
+    if (!m_Indices16Valid || m_Indices16.size() != Indices32.size())
+    {
+        assert(FitsIndices16() && "Mesh indices do not fit in 16 bits");
+        m_Indices16.resize(Indices32.size());
+        NarrowIndices16(Indices32.data(), Indices32.size(), m_Indices16.data());
+        m_Indices16Valid = true;
+    }
+    return m_Indices16;
+}
+
+void NarrowIndices16(const uint32_t* In, size_t Count, uint16_t* Out)
+{
+    size_t i = 0;
+#if RACOON_SSE2
+    // SSE2 only has a signed 32->16 saturating pack. Biasing by -32768 maps
+    // [0, 65535] onto the signed range exactly, and the bias is undone on the
+    // 16-bit result.
+    const __m128i Bias32 = _mm_set1_epi32(0x8000);
+    const __m128i Bias16 = _mm_set1_epi16(static_cast<short>(0x8000));
+    for (; i + 8 <= Count; i += 8)
+    {
+        __m128i Lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(In + i));
+        __m128i Hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(In + i + 4));
+        Lo = _mm_sub_epi32(Lo, Bias32);
+        Hi = _mm_sub_epi32(Hi, Bias32);
+        const __m128i Packed = _mm_xor_si128(_mm_packs_epi32(Lo, Hi), Bias16);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(Out + i), Packed);
+    }
+#endif
+    for (; i < Count; ++i)
+    {
+        Out[i] = static_cast<uint16_t>(In[i]);
+    }
+}
+
+}
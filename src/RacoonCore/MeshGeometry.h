@@ -0,0 +1,84 @@
+#pragma once
+
+#include "CoreStdafx.h"
+
+namespace Racoon {
+struct Vertex
+{
+    Vertex() {}
+
+    Vertex(
+        const XMFLOAT3& pos,
+        const XMFLOAT3& normal,
+        const XMFLOAT3& tangent,
+        const XMFLOAT2& uv
+    ) :
+        Position(pos),
+        Normal(normal),
+        Tangent(tangent),
+        UV(uv) {}
+
+    Vertex(
+        float px, float py, float pz,
+        float nx, float ny, float nz,
+        float tx, float ty, float tz,
+        float u, float v
+    ) :
+        Position(px, py, pz),
+        Normal(nx, ny, nz),
+        Tangent(tx, ty, tz),
+        UV(u, v) {}
+
+    XMFLOAT3 Position;
+    XMFLOAT3 Normal;
+    XMFLOAT3 Tangent;
+    XMFLOAT2 UV;
+};
+
+// Axis-aligned box as center and half extents, and a sphere around the same
+// center. The sphere is fit to the vertices, not to the box.
+struct Bounds
+{
+    XMFLOAT3 Center{ 0.f, 0.f, 0.f };
+    XMFLOAT3 Extents{ 0.f, 0.f, 0.f };
+    float Radius{ 0.f };
+};
+
+Bounds ComputeBounds(const Vertex* Vertices, size_t Count);
+
+enum class IndexFormat : uint8_t
+{
+    Uint16,
+    Uint32
+};
+
+struct MeshData
+{
+    std::vector<Vertex> Vertices;
+    std::vector<uint32_t> Indices32;
+    // Object space bounds of Vertices. Set by the generators; call
+    // UpdateBounds() after moving vertices.
+    Bounds LocalBounds;
+
+    void UpdateBounds() { LocalBounds = ComputeBounds(Vertices.data(), Vertices.size()); }
+
+    // True when every index fits in 16 bits. Indices are local to the mesh and
+    // the GPU adds BaseVertexLocation afterwards, so only the mesh's own vertex
+    // range matters, not where it ends up in the shared buffer.
+    bool FitsIndices16() const;
+    IndexFormat GetIndexFormat() const { return FitsIndices16() ? IndexFormat::Uint16 : IndexFormat::Uint32; }
+
+    // Indices32 narrowed to 16 bits. Converted once and cached; call
+    // InvalidateIndices16() after modifying Indices32 in place.
+    const std::vector<uint16_t>& GetIndices16();
+    void InvalidateIndices16() { m_Indices16Valid = false; }
+
+private:
+    std::vector<uint16_t> m_Indices16;
+    bool m_Indices16Valid{ false };
+};
+
+// Narrows Count indices that must all be < 65536
+void NarrowIndices16(const uint32_t* In, size_t Count, uint16_t* Out);
+
+}
\ No newline at end of file
@@ -0,0 +1,83 @@
+#include "CoreStdafx.h"
+
+#include "MeshLod.h"
+
+#include "Profiler.h"
+
+namespace Racoon {
+
+void ApplyLodLevel(const MeshLodChain& Chain, uint32_t Level, RenderItem& Item)
+{
+    assert(Level < Chain.LevelCount);
+    const LodDrawLevel& Draw = Chain.Levels[Level];
+    Item.MeshIndex = Draw.MeshIndex;
+    Item.BaseVertexLocation = Draw.Range.BaseVertex;
+    Item.StartIndexLocation = Draw.Range.StartIndex;
+    Item.IndexCount = Draw.Range.IndexCount;
+    Item.IndexWidth = Draw.Range.IndexWidth;
+    Item.Quantization = Draw.Range.Quantization;
+    Item.Lod = static_cast<uint8_t>(Level);
+}
+
+uint32_t SelectLod(const MeshLodChain& Chain, float ErrorScale, float Distance, const LodSelectionView& View,
+    uint32_t Current)
+{
+    float Errors[MeshLodChain::MaxLevels];
+    for (uint32_t Level = 0; Level < Chain.LevelCount; ++Level)
+        Errors[Level] = Chain.Levels[Level].Error;
+    return SelectLod(Errors, Chain.LevelCount, ErrorScale, Distance, View, Current);
+}
+
+uint32_t SelectLod(const float* Errors, uint32_t LevelCount, float ErrorScale, float Distance,
+    const LodSelectionView& View, uint32_t Current)
+{
+    assert(LevelCount > 0);
+    // Inside the bounds every error is too large to see through
+    if (Distance <= 0.f)
+        return 0;
+    const float PixelsPerError = ErrorScale * View.ProjectionScale / Distance;
+
+    // Errors grow along the chain, so the levels that fit are a prefix
+    uint32_t Fitting = 0;
+    uint32_t FittingWithMargin = 0;
+    const float Threshold = View.PixelThreshold;
+    const float CoarsenThreshold = View.PixelThreshold * (1.f - View.Hysteresis);
+    for (uint32_t Level = 1; Level < LevelCount; ++Level)
+    {
+        const float Pixels = Errors[Level] * PixelsPerError;
+        if (Pixels > Threshold)
+            break;
+        Fitting = Level;
+        if (Pixels <= CoarsenThreshold)
+            FittingWithMargin = Level;
+    }
+
+    Current = std::min(Current, LevelCount - 1);
+    if (Fitting < Current)
+        return Fitting;
+    return std::max(Current, FittingWithMargin);
+}
+
+void SelectLods(const std::vector<std::shared_ptr<RenderItem>>& Items, const std::vector<uint32_t>& Visible,
+    const std::vector<MeshLodChain>& Chains, const LodSelectionView& View)
+{
+    RACOON_PROFILE_SCOPE("SelectLods");
+    for (uint32_t Index : Visible)
+    {
+        RenderItem& Item = *Items[Index];
+        if (Item.LodChain == NoLodChain)
+            continue;
+        const MeshLodChain& Chain = Chains[Item.LodChain];
+        const Bounds& World = Item.GetWorldBounds();
+        const float Dx = World.Center.x - View.Eye.x;
+        const float Dy = World.Center.y - View.Eye.y;
+        const float Dz = World.Center.z - View.Eye.z;
+        const float Distance = std::sqrt(Dx * Dx + Dy * Dy + Dz * Dz) - World.Radius;
+        const float ErrorScale = Chain.LocalRadius > 0.f ? World.Radius / Chain.LocalRadius : 1.f;
+        const uint32_t Level = SelectLod(Chain, ErrorScale, Distance, View, Item.Lod);
+        if (Level != Item.Lod)
+            ApplyLodLevel(Chain, Level, Item);
+    }
+}
+
+} // namespace Racoon
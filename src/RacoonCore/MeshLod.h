@@ -0,0 +1,63 @@
+#pragma once
+
+#include "CoreStdafx.h"
+#include "MeshRegistry.h"
+#include "RenderItem.h"
+
+namespace Racoon {
+
+// One level of a mesh as registered for drawing
+struct LodDrawLevel
+{
+    MeshRange Range;
+    uint32_t MeshIndex{ 0 };
+    // Object space distance to the source surface, 0 for the source
+    float Error{ 0.f };
+};
+
+// The registered levels of one mesh, finest first, with errors that never
+// decrease. Items point at a chain with RenderItem::LodChain.
+struct MeshLodChain
+{
+    static constexpr uint32_t MaxLevels = 8;
+
+    LodDrawLevel Levels[MaxLevels];
+    uint32_t LevelCount{ 0 };
+    // Of the source mesh, shared by every level; relates the item's world
+    // bounds to the object space errors
+    float LocalRadius{ 0.f };
+};
+
+// Points the item's draw arguments at a level, like MeshRegistry::ApplyRange
+void ApplyLodLevel(const MeshLodChain& Chain, uint32_t Level, RenderItem& Item);
+
+struct LodSelectionView
+{
+    XMFLOAT3 Eye{ 0.f, 0.f, 0.f };
+    // Pixels per world unit at distance 1: half the viewport height times
+    // the projection's vertical scale
+    float ProjectionScale{ 1.f };
+    // Largest error, in pixels, a level may show on screen
+    float PixelThreshold{ 1.f };
+    // A coarser level is only taken once its error is this fraction below
+    // the threshold, so items near a switch distance do not flicker between
+    // levels as the camera wobbles
+    float Hysteresis{ 0.25f };
+};
+
+// The level to draw from Current. Errors are projected as if at Distance
+// from the eye, scaled by ErrorScale from object to world space. Finer
+// levels are taken as soon as the current one exceeds the threshold,
+// coarser ones only with the hysteresis margin.
+uint32_t SelectLod(const MeshLodChain& Chain, float ErrorScale, float Distance, const LodSelectionView& View,
+    uint32_t Current);
+// As above, for levels given by their errors alone
+uint32_t SelectLod(const float* Errors, uint32_t LevelCount, float ErrorScale, float Distance,
+    const LodSelectionView& View, uint32_t Current);
+
+// Selects and applies the level of every visible item with a chain. The
+// distance is from the eye to the item's bounding sphere.
+void SelectLods(const std::vector<std::shared_ptr<RenderItem>>& Items, const std::vector<uint32_t>& Visible,
+    const std::vector<MeshLodChain>& Chains, const LodSelectionView& View);
+
+} // namespace Racoon
@@ -0,0 +1,427 @@
+#include "MeshOptimizer.h"
+
+#include <cstring>
+
+namespace Racoon {
+
+VertexCacheStats AnalyzeVertexCache(const uint32_t* Indices, size_t IndexCount, size_t VertexCount,
+    uint32_t CacheSize)
+{
+    VertexCacheStats Stats;
+    if (IndexCount < 3)
+        return Stats;
+
+    // A vertex is in the FIFO cache when it entered less than CacheSize misses ago
+    std::vector<uint32_t> Timestamps(VertexCount, 0);
+    std::vector<uint8_t> Referenced(VertexCount, 0);
+    uint32_t Time = CacheSize + 1;
+    size_t ReferencedCount = 0;
+
+    for (size_t i = 0; i < IndexCount; ++i)
+    {
+        const uint32_t v = Indices[i];
+        assert(v < VertexCount);
+        if (Time - Timestamps[v] > CacheSize)
+        {
+            Timestamps[v] = Time++;
+            ++Stats.Transforms;
+        }
+        if (!Referenced[v])
+        {
+            Referenced[v] = 1;
+            ++ReferencedCount;
+        }
+    }
+
+    Stats.ACMR = static_cast<float>(Stats.Transforms) / (IndexCount / 3);
+    Stats.ATVR = static_cast<float>(Stats.Transforms) / ReferencedCount;
+    return Stats;
+}
+
+namespace {
+
+// Vertex -> triangle adjacency in CSR form
+struct TriangleAdjacency
+{
+    std::vector<uint32_t> Offsets;
+    std::vector<uint32_t> Triangles;
+
+    TriangleAdjacency(const uint32_t* Indices, size_t IndexCount, size_t VertexCount, std::vector<uint32_t>& Valence)
+    {
+        Valence.assign(VertexCount, 0);
+        for (size_t i = 0; i < IndexCount; ++i)
+            ++Valence[Indices[i]];
+
+        Offsets.resize(VertexCount + 1);
+        Offsets[0] = 0;
+        for (size_t v = 0; v < VertexCount; ++v)
+            Offsets[v + 1] = Offsets[v] + Valence[v];
+
+        Triangles.resize(IndexCount);
+        std::vector<uint32_t> Cursor(Offsets.begin(), Offsets.end() - 1);
+        for (size_t i = 0; i < IndexCount; ++i)
+            Triangles[Cursor[Indices[i]]++] = static_cast<uint32_t>(i / 3);
+    }
+};
+
+} // namespace
+
+void OptimizeVertexCache(uint32_t* Indices, size_t IndexCount, size_t VertexCount,
+    uint32_t CacheSize, std::vector<uint32_t>* ClusterStarts)
+{
+    const size_t TriangleCount = IndexCount / 3;
+    if (ClusterStarts)
+        ClusterStarts->clear();
+    if (TriangleCount == 0)
+        return;
+
+    // Live holds the number of not yet emitted triangles per vertex
+    std::vector<uint32_t> Live;
+    const TriangleAdjacency Adjacency(Indices, IndexCount, VertexCount, Live);
+
+    std::vector<uint32_t> CacheTime(VertexCount, 0);
+    std::vector<uint8_t> Emitted(TriangleCount, 0);
+    std::vector<uint32_t> DeadEnd;
+    DeadEnd.reserve(IndexCount);
+    std::vector<uint32_t> Candidates;
+    std::vector<uint32_t> Output;
+    Output.reserve(IndexCount);
+
+    uint32_t Time = CacheSize + 1;
+    size_t Cursor = 0;
+
+    // Next vertex with live triangles: the most recent dead-end entry first,
+    // then a linear scan over the input order
+    auto SkipDeadEnd = [&]() -> int64_t
+    {
+        while (!DeadEnd.empty())
+        {
+            const uint32_t v = DeadEnd.back();
+            DeadEnd.pop_back();
+            if (Live[v] > 0)
+                return v;
+        }
+        for (; Cursor < VertexCount; ++Cursor)
+        {
+            if (Live[Cursor] > 0)
+                return static_cast<int64_t>(Cursor);
+        }
+        return -1;
+    };
+
+    int64_t Fanning = SkipDeadEnd();
+    if (ClusterStarts)
+        ClusterStarts->push_back(0);
+
+    while (Fanning >= 0)
+    {
+        // Emit every remaining triangle around the fanning vertex
+        Candidates.clear();
+        for (uint32_t a = Adjacency.Offsets[Fanning]; a < Adjacency.Offsets[Fanning + 1]; ++a)
+        {
+            const uint32_t t = Adjacency.Triangles[a];
+            if (Emitted[t])
+                continue;
+            Emitted[t] = 1;
+
+            for (uint32_t k = 0; k < 3; ++k)
+            {
+                const uint32_t v = Indices[t * 3 + k];
+                Output.push_back(v);
+                DeadEnd.push_back(v);
+                Candidates.push_back(v);
+                --Live[v];
+                if (Time - CacheTime[v] > CacheSize)
+                    CacheTime[v] = Time++;
+            }
+        }
+
+        // Prefer the candidate that stays in cache longest while still having
+        // its remaining triangles fit before eviction
+        int64_t Best = -1;
+        int64_t BestPriority = -1;
+        for (uint32_t v : Candidates)
+        {
+            if (Live[v] == 0)
+                continue;
+            int64_t Priority = 0;
+            if (Time - CacheTime[v] + 2 * Live[v] <= CacheSize)
+                Priority = Time - CacheTime[v];
+            if (Priority > BestPriority)
+            {
+                Best = v;
+                BestPriority = Priority;
+            }
+        }
+
+        if (Best < 0)
+        {
+            Best = SkipDeadEnd();
+            if (ClusterStarts && Best >= 0)
+                ClusterStarts->push_back(static_cast<uint32_t>(Output.size() / 3));
+        }
+        Fanning = Best;
+    }
+
+    assert(Output.size() == TriangleCount * 3);
+    std::copy(Output.begin(), Output.end(), Indices);
+}
+
+void OptimizeOverdraw(uint32_t* Indices, size_t IndexCount, const Vertex* Vertices,
+    const std::vector<uint32_t>& ClusterStarts, uint32_t MinClusterTriangles)
+{
+    const uint32_t TriangleCount = static_cast<uint32_t>(IndexCount / 3);
+    if (TriangleCount == 0 || ClusterStarts.empty())
+        return;
+
+    // Dead ends can be only a few triangles apart; merge until clusters are
+    // large enough that sorting them is meaningful
+    std::vector<uint32_t> Starts;
+    for (uint32_t Start : ClusterStarts)
+    {
+        if (Starts.empty() || Start - Starts.back() >= MinClusterTriangles)
+            Starts.push_back(Start);
+    }
+
+    struct Cluster
+    {
+        uint32_t Start;
+        uint32_t End;
+        float Sort;
+    };
+    std::vector<Cluster> Clusters(Starts.size());
+
+    XMVECTOR MeshCentroid = XMVectorZero();
+    float MeshArea = 0.f;
+    std::vector<XMFLOAT3> Centroids(Starts.size());
+    std::vector<XMFLOAT3> Normals(Starts.size());
+
+    for (size_t c = 0; c < Starts.size(); ++c)
+    {
+        Cluster& C = Clusters[c];
+        C.Start = Starts[c];
+        C.End = c + 1 < Starts.size() ? Starts[c + 1] : TriangleCount;
+
+        // Area weighted centroid and normal
+        XMVECTOR Centroid = XMVectorZero();
+        XMVECTOR Normal = XMVectorZero();
+        float Area = 0.f;
+        for (uint32_t t = C.Start; t < C.End; ++t)
+        {
+            const XMVECTOR p0 = XMLoadFloat3(&Vertices[Indices[t * 3 + 0]].Position);
+            const XMVECTOR p1 = XMLoadFloat3(&Vertices[Indices[t * 3 + 1]].Position);
+            const XMVECTOR p2 = XMLoadFloat3(&Vertices[Indices[t * 3 + 2]].Position);
+            const XMVECTOR N = XMVector3Cross(XMVectorSubtract(p1, p0), XMVectorSubtract(p2, p0));
+            const float TriangleArea = XMVectorGetX(XMVector3Length(N));
+            Centroid = XMVectorAdd(Centroid, XMVectorScale(XMVectorAdd(XMVectorAdd(p0, p1), p2), TriangleArea / 3.f));
+            Normal = XMVectorAdd(Normal, N);
+            Area += TriangleArea;
+        }
+        MeshCentroid = XMVectorAdd(MeshCentroid, Centroid);
+        MeshArea += Area;
+        XMStoreFloat3(&Centroids[c], Area > 0.f ? XMVectorScale(Centroid, 1.f / Area) : Centroid);
+        XMStoreFloat3(&Normals[c], Normal);
+    }
+    MeshCentroid = MeshArea > 0.f ? XMVectorScale(MeshCentroid, 1.f / MeshArea) : MeshCentroid;
+
+    // Clusters that face away from the mesh center are the likeliest occluders
+    for (size_t c = 0; c < Clusters.size(); ++c)
+    {
+        const XMVECTOR Offset = XMVectorSubtract(XMLoadFloat3(&Centroids[c]), MeshCentroid);
+        Clusters[c].Sort = XMVectorGetX(XMVector3Dot(Offset, XMLoadFloat3(&Normals[c])));
+    }
+    std::stable_sort(Clusters.begin(), Clusters.end(),
+        [](const Cluster& a, const Cluster& b) { return a.Sort > b.Sort; });
+
+    std::vector<uint32_t> Output;
+    Output.reserve(IndexCount);
+    for (const Cluster& C : Clusters)
+        Output.insert(Output.end(), Indices + C.Start * 3, Indices + C.End * 3);
+    std::copy(Output.begin(), Output.end(), Indices);
+}
+
+size_t OptimizeVertexFetch(MeshData& Mesh)
+{
+    const uint32_t Unassigned = ~0u;
+    std::vector<uint32_t> Remap(Mesh.Vertices.size(), Unassigned);
+    std::vector<Vertex> Reordered;
+    Reordered.reserve(Mesh.Vertices.size());
+
+    for (uint32_t& Index : Mesh.Indices32)
+    {
+        uint32_t& NewIndex = Remap[Index];
+        if (NewIndex == Unassigned)
+        {
+            NewIndex = static_cast<uint32_t>(Reordered.size());
+            Reordered.push_back(Mesh.Vertices[Index]);
+        }
+        Index = NewIndex;
+    }
+
+    Mesh.Vertices.swap(Reordered);
+    Mesh.InvalidateIndices16();
+    return Mesh.Vertices.size();
+}
+
+namespace {
+
+constexpr uint32_t WeldKeySize = sizeof(Vertex) / sizeof(float);
+
+// Quantized attribute values of one vertex. Equal keys weld.
+struct WeldKey
+{
+    int32_t Values[WeldKeySize];
+};
+
+int32_t QuantizeAttribute(float Value, float InvEpsilon)
+{
+    if (InvEpsilon == 0.f)
+    {
+        // Exact comparison on the bit pattern, folding -0 into +0
+        if (Value == 0.f)
+            Value = 0.f;
+        int32_t Bits;
+        std::memcpy(&Bits, &Value, sizeof(Bits));
+        return Bits;
+    }
+    return static_cast<int32_t>(std::floor(Value * InvEpsilon + 0.5f));
+}
+
+uint64_t HashWeldKey(const WeldKey& Key)
+{
+    uint64_t Hash = 0xCBF29CE484222325ull;
+    for (int32_t Value : Key.Values)
+    {
+        Hash ^= static_cast<uint32_t>(Value);
+        Hash *= 0x100000001B3ull;
+        Hash ^= Hash >> 29;
+    }
+    return Hash;
+}
+
+} // namespace
+
+size_t WeldVertices(MeshData& Mesh, const WeldOptions& Options)
+{
+    const size_t VertexCount = Mesh.Vertices.size();
+    if (VertexCount == 0)
+        return 0;
+
+    // 0 keeps exact comparison, a negative inverse marks an ignored attribute
+    auto Inverse = [](float Epsilon) -> float
+    {
+        if (Epsilon <= 0.f)
+            return 0.f;
+        if (std::isinf(Epsilon))
+            return -1.f;
+        return 1.f / Epsilon;
+    };
+    float InvEpsilon[WeldKeySize];
+    const float PerAttribute[4] = {
+        Inverse(Options.PositionEpsilon), Inverse(Options.NormalEpsilon),
+        Inverse(Options.TangentEpsilon), Inverse(Options.UVEpsilon)
+    };
+    for (uint32_t i = 0; i < WeldKeySize; ++i)
+        InvEpsilon[i] = PerAttribute[std::min(i / 3, 3u)];
+
+    std::vector<WeldKey> Keys(VertexCount);
+    for (size_t v = 0; v < VertexCount; ++v)
+    {
+        const float* Attributes = &Mesh.Vertices[v].Position.x;
+        for (uint32_t i = 0; i < WeldKeySize; ++i)
+        {
+            Keys[v].Values[i] = InvEpsilon[i] < 0.f ? 0 : QuantizeAttribute(Attributes[i], InvEpsilon[i]);
+        }
+    }
+
+    // Slots hold vertex indices, load factor at most 0.5
+    size_t TableSize = 64;
+    while (TableSize < VertexCount * 2)
+        TableSize <<= 1;
+    const size_t Mask = TableSize - 1;
+    const uint32_t Empty = ~0u;
+    std::vector<uint32_t> Table(TableSize, Empty);
+
+    // Survivors keep their relative order, so Remap[v] <= v and the vertex
+    // array compacts in place
+    std::vector<uint32_t> Remap(VertexCount);
+    uint32_t Unique = 0;
+
+    for (size_t v = 0; v < VertexCount; ++v)
+    {
+        const WeldKey& Key = Keys[v];
+        size_t Slot = static_cast<size_t>(HashWeldKey(Key)) & Mask;
+        while (true)
+        {
+            const uint32_t Existing = Table[Slot];
+            if (Existing == Empty)
+            {
+                Table[Slot] = static_cast<uint32_t>(v);
+                Remap[v] = Unique;
+                Mesh.Vertices[Unique++] = Mesh.Vertices[v];
+                break;
+            }
+            if (std::memcmp(&Keys[Existing], &Key, sizeof(WeldKey)) == 0)
+            {
+                Remap[v] = Remap[Existing];
+                break;
+            }
+            Slot = (Slot + 1) & Mask;
+        }
+    }
+
+    std::vector<uint32_t>& Indices = Mesh.Indices32;
+    size_t Out = 0;
+    for (size_t t = 0; t + 2 < Indices.size(); t += 3)
+    {
+        const uint32_t a = Remap[Indices[t]];
+        const uint32_t b = Remap[Indices[t + 1]];
+        const uint32_t c = Remap[Indices[t + 2]];
+        if (Options.RemoveDegenerateTriangles && (a == b || b == c || a == c))
+            continue;
+        Indices[Out++] = a;
+        Indices[Out++] = b;
+        Indices[Out++] = c;
+    }
+    Indices.resize(Out);
+
+    const size_t Removed = VertexCount - Unique;
+    Mesh.Vertices.resize(Unique);
+    Mesh.Vertices.shrink_to_fit();
+    Mesh.InvalidateIndices16();
+    return Removed;
+}
+
+MeshOptimizationReport OptimizeMesh(MeshData& Mesh, const MeshOptimizationOptions& Options)
+{
+    MeshOptimizationReport Report;
+    Report.Before = AnalyzeVertexCache(Mesh.Indices32.data(), Mesh.Indices32.size(), Mesh.Vertices.size(),
+        Options.CacheSize);
+
+    if (Options.Weld)
+    {
+        Report.WeldedVertices = WeldVertices(Mesh, Options.WeldTolerances);
+    }
+
+    std::vector<uint32_t> ClusterStarts;
+    if (Options.VertexCache || Options.Overdraw)
+    {
+        OptimizeVertexCache(Mesh.Indices32.data(), Mesh.Indices32.size(), Mesh.Vertices.size(),
+            Options.CacheSize, Options.Overdraw ? &ClusterStarts : nullptr);
+    }
+    if (Options.Overdraw)
+    {
+        OptimizeOverdraw(Mesh.Indices32.data(), Mesh.Indices32.size(), Mesh.Vertices.data(), ClusterStarts);
+    }
+    if (Options.VertexFetch)
+    {
+        OptimizeVertexFetch(Mesh);
+    }
+    Mesh.InvalidateIndices16();
+
+    Report.After = AnalyzeVertexCache(Mesh.Indices32.data(), Mesh.Indices32.size(), Mesh.Vertices.size(),
+        Options.CacheSize);
+    return Report;
+}
+
+} // namespace Racoon
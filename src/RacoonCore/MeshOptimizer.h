@@ -0,0 +1,78 @@
+#pragma once
+
+#include "CoreStdafx.h"
+#include "MeshGeometry.h"
+
+namespace Racoon {
+
+// Post-transform cache efficiency of an index buffer, simulated with a FIFO
+// cache. ACMR is transformed vertices per triangle (0.5 is the ideal for large
+// regular meshes, 3 the worst case). ATVR is transformed vertices per
+// referenced vertex (1 is ideal).
+struct VertexCacheStats
+{
+    float ACMR{ 0.f };
+    float ATVR{ 0.f };
+    uint32_t Transforms{ 0 };
+};
+
+VertexCacheStats AnalyzeVertexCache(const uint32_t* Indices, size_t IndexCount, size_t VertexCount,
+    uint32_t CacheSize = 16);
+
+// Reorders triangles for the post-transform vertex cache using Tipsify
+// (Sander, Nehab, Barczak 2007). Runs in linear time. When ClusterStarts is
+// given, it receives the first triangle of every cluster, i.e. every place
+// where the walk hit a dead end and had to jump.
+void OptimizeVertexCache(uint32_t* Indices, size_t IndexCount, size_t VertexCount,
+    uint32_t CacheSize = 16, std::vector<uint32_t>* ClusterStarts = nullptr);
+
+// Reorders the clusters found by OptimizeVertexCache so that outward facing
+// ones come first, which lowers overdraw for a wide range of view directions.
+// Triangle order inside a cluster is kept, so the cache behaviour barely changes.
+void OptimizeOverdraw(uint32_t* Indices, size_t IndexCount, const Vertex* Vertices,
+    const std::vector<uint32_t>& ClusterStarts, uint32_t MinClusterTriangles = 64);
+
+// Rewrites Vertices in the order the index buffer first references them and
+// remaps the indices. Unreferenced vertices are dropped. Returns the new
+// vertex count.
+size_t OptimizeVertexFetch(MeshData& Mesh);
+
+struct WeldOptions
+{
+    // Attributes are snapped to a grid of this spacing before comparing.
+    // 0 requires bitwise equality (with -0 == +0), INFINITY ignores the attribute.
+    // Vertices on either side of a grid line are not merged even when close.
+    float PositionEpsilon{ 0.f };
+    float NormalEpsilon{ 0.f };
+    float TangentEpsilon{ 0.f };
+    float UVEpsilon{ 0.f };
+    // Drops triangles that collapsed to a line or point after welding
+    bool RemoveDegenerateTriangles{ true };
+};
+
+// Merges equal (or, with epsilons, nearly equal) vertices, keeping the first
+// occurrence of each, rewrites Indices32 and shrinks Vertices. Runs in linear
+// time using an open-addressing hash table. Returns the number of vertices removed.
+size_t WeldVertices(MeshData& Mesh, const WeldOptions& Options = WeldOptions());
+
+struct MeshOptimizationOptions
+{
+    bool Weld{ false };
+    WeldOptions WeldTolerances;
+    bool VertexCache{ true };
+    bool Overdraw{ false };
+    bool VertexFetch{ true };
+    uint32_t CacheSize{ 16 };
+};
+
+struct MeshOptimizationReport
+{
+    VertexCacheStats Before;
+    VertexCacheStats After;
+    size_t WeldedVertices{ 0 };
+};
+
+// Runs the enabled steps in order: weld, vertex cache, overdraw, vertex fetch
+MeshOptimizationReport OptimizeMesh(MeshData& Mesh, const MeshOptimizationOptions& Options = MeshOptimizationOptions());
+
+} // namespace Racoon
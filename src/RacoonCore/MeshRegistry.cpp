@@ -0,0 +1,182 @@
+#include "CoreStdafx.h"
+
+#include "MeshRegistry.h"
+
+namespace Racoon {
+
+MeshHandle MeshRegistry::Register(const std::shared_ptr<MeshData>& Mesh)
+{
+    assert(Mesh);
+
+    const MeshHandle Handle = Find(Mesh.get());
+    if (Handle.IsValid())
+    {
+        ++m_Entries[Handle.Index].References;
+        return Handle;
+    }
+    return Register(Mesh, PackVertices(*Mesh, m_Encoding));
+}
+
+MeshHandle MeshRegistry::Register(const std::shared_ptr<MeshData>& Mesh, const PackedVertexStream& Stream)
+{
+    assert(Mesh);
+    assert(Stream.Encoding == m_Encoding && Stream.VertexCount == Mesh->Vertices.size());
+
+    MeshHandle Handle = Find(Mesh.get());
+    if (Handle.IsValid())
+    {
+        ++m_Entries[Handle.Index].References;
+        return Handle;
+    }
+
+    if (!m_FreeEntries.empty())
+    {
+        Handle.Index = m_FreeEntries.back();
+        m_FreeEntries.pop_back();
+    }
+    else
+    {
+        Handle.Index = static_cast<uint32_t>(m_Entries.size());
+        m_Entries.emplace_back();
+    }
+
+    Entry& NewEntry = m_Entries[Handle.Index];
+    NewEntry.Mesh = Mesh;
+    NewEntry.References = 1;
+
+    MeshRange& Range = NewEntry.Range;
+    Range.BaseVertex = m_VertexCount;
+    Range.VertexCount = static_cast<uint32_t>(Stream.VertexCount);
+    Range.Quantization = Stream.Quantization;
+    m_VertexData.insert(m_VertexData.end(), Stream.Data.begin(), Stream.Data.end());
+    m_VertexCount += Range.VertexCount;
+
+    Range.IndexCount = static_cast<uint32_t>(Mesh->Indices32.size());
+    Range.IndexWidth = Mesh->GetIndexFormat();
+    if (Range.IndexWidth == IndexFormat::Uint16)
+    {
+        const auto& Indices16 = Mesh->GetIndices16();
+        Range.StartIndex = static_cast<uint32_t>(m_Indices16.size());
+        m_Indices16.insert(m_Indices16.end(), Indices16.begin(), Indices16.end());
+    }
+    else
+    {
+        Range.StartIndex = static_cast<uint32_t>(m_Indices32.size());
+        m_Indices32.insert(m_Indices32.end(), Mesh->Indices32.begin(), Mesh->Indices32.end());
+    }
+
+    m_Lookup.emplace(Mesh.get(), Handle.Index);
+    ++m_LiveMeshes;
+    ++m_Version;
+    return Handle;
+}
+
+MeshHandle MeshRegistry::Register(RenderItem& Item)
+{
+    const MeshHandle Handle = Register(Item.GetMesh());
+    ApplyRange(Handle, Item);
+    return Handle;
+}
+
+void MeshRegistry::Reserve(uint32_t Vertices, uint32_t Indices16, uint32_t Indices32)
+{
+    m_VertexData.reserve(m_VertexData.size() + size_t(Vertices) * GetVertexStride());
+    m_Indices16.reserve(m_Indices16.size() + Indices16);
+    m_Indices32.reserve(m_Indices32.size() + Indices32);
+}
+
+void MeshRegistry::Release(MeshHandle Handle)
+{
+    assert(Handle.IsValid() && Handle.Index < m_Entries.size());
+    Entry& Released = m_Entries[Handle.Index];
+    assert(Released.References > 0);
+
+    if (--Released.References > 0)
+        return;
+
+    m_WastedVertices += Released.Range.VertexCount;
+    m_WastedIndices += Released.Range.IndexCount;
+    m_Lookup.erase(Released.Mesh.get());
+    Released.Mesh.reset();
+    Released.Range = MeshRange();
+    m_FreeEntries.push_back(Handle.Index);
+    --m_LiveMeshes;
+}
+
+void MeshRegistry::Compact()
+{
+    if (m_WastedVertices == 0 && m_WastedIndices == 0)
+        return;
+
+    const uint32_t Stride = GetVertexStride();
+
+    std::vector<uint8_t> VertexData;
+    VertexData.reserve(static_cast<size_t>(m_VertexCount - m_WastedVertices) * Stride);
+    std::vector<uint16_t> Indices16;
+    Indices16.reserve(m_Indices16.size());
+    std::vector<uint32_t> Indices32;
+    Indices32.reserve(m_Indices32.size());
+
+    uint32_t VertexCount = 0;
+    for (Entry& Live : m_Entries)
+    {
+        if (Live.References == 0)
+            continue;
+
+        MeshRange& Range = Live.Range;
+        const auto VertexBegin = m_VertexData.begin() + static_cast<size_t>(Range.BaseVertex) * Stride;
+        VertexData.insert(VertexData.end(), VertexBegin, VertexBegin + static_cast<size_t>(Range.VertexCount) * Stride);
+        Range.BaseVertex = VertexCount;
+        VertexCount += Range.VertexCount;
+
+        if (Range.IndexWidth == IndexFormat::Uint16)
+        {
+            const auto IndexBegin = m_Indices16.begin() + Range.StartIndex;
+            Range.StartIndex = static_cast<uint32_t>(Indices16.size());
+            Indices16.insert(Indices16.end(), IndexBegin, IndexBegin + Range.IndexCount);
+        }
+        else
+        {
+            const auto IndexBegin = m_Indices32.begin() + Range.StartIndex;
+            Range.StartIndex = static_cast<uint32_t>(Indices32.size());
+            Indices32.insert(Indices32.end(), IndexBegin, IndexBegin + Range.IndexCount);
+        }
+    }
+
+    m_VertexData.swap(VertexData);
+    m_Indices16.swap(Indices16);
+    m_Indices32.swap(Indices32);
+    m_VertexCount = VertexCount;
+    m_WastedVertices = 0;
+    m_WastedIndices = 0;
+    ++m_Version;
+}
+
+MeshHandle MeshRegistry::Find(const MeshData* Mesh) const
+{
+    const auto It = m_Lookup.find(Mesh);
+    MeshHandle Handle;
+    if (It != m_Lookup.end())
+        Handle.Index = It->second;
+    return Handle;
+}
+
+const MeshRange& MeshRegistry::GetRange(MeshHandle Handle) const
+{
+    assert(Handle.IsValid() && Handle.Index < m_Entries.size());
+    assert(m_Entries[Handle.Index].References > 0);
+    return m_Entries[Handle.Index].Range;
+}
+
+void MeshRegistry::ApplyRange(MeshHandle Handle, RenderItem& Item) const
+{
+    const MeshRange& Range = GetRange(Handle);
+    Item.MeshIndex = Handle.Index;
+    Item.BaseVertexLocation = Range.BaseVertex;
+    Item.StartIndexLocation = Range.StartIndex;
+    Item.IndexCount = Range.IndexCount;
+    Item.IndexWidth = Range.IndexWidth;
+    Item.Quantization = Range.Quantization;
+}
+
+} // namespace Racoon
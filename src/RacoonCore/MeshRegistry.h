@@ -0,0 +1,109 @@
+#pragma once
+
+#include "CoreStdafx.h"
+#include "MeshGeometry.h"
+#include "RenderItem.h"
+#include "VertexPacking.h"
+
+#include <unordered_map>
+
+namespace Racoon {
+
+struct MeshHandle
+{
+    static constexpr uint32_t Invalid = ~0u;
+
+    uint32_t Index{ Invalid };
+
+    bool IsValid() const { return Index != Invalid; }
+    bool operator==(const MeshHandle& Other) const { return Index == Other.Index; }
+    bool operator!=(const MeshHandle& Other) const { return Index != Other.Index; }
+};
+
+// Where a registered mesh lives in the arena. BaseVertex is in vertices,
+// StartIndex in elements of the index arena selected by IndexWidth.
+struct MeshRange
+{
+    uint32_t BaseVertex{ 0 };
+    uint32_t VertexCount{ 0 };
+    uint32_t StartIndex{ 0 };
+    uint32_t IndexCount{ 0 };
+    IndexFormat IndexWidth{ IndexFormat::Uint32 };
+    VertexQuantization Quantization;
+};
+
+// Owns one growable vertex arena (already encoded for the GPU) and two index
+// arenas, 16 and 32 bit. Each distinct MeshData is stored once: registering
+// the same shared_ptr again returns the same handle and bumps its reference
+// count. Meshes are encoded when first registered, later edits to the
+// MeshData are not picked up.
+class MeshRegistry
+{
+public:
+    explicit MeshRegistry(VertexEncoding Encoding = VertexEncoding::Full) : m_Encoding(Encoding) {}
+
+    MeshHandle Register(const std::shared_ptr<MeshData>& Mesh);
+    // As above with the vertices already encoded by PackVertices in this
+    // registry's encoding, say on a loading thread, so only copies remain
+    MeshHandle Register(const std::shared_ptr<MeshData>& Mesh, const PackedVertexStream& Vertices);
+    // Registers the item's mesh and points its draw arguments at the range
+    MeshHandle Register(RenderItem& Item);
+
+    // Grows the arenas to hold this many more vertices and indices, so
+    // registering meshes one by one does not copy the arenas as they grow
+    void Reserve(uint32_t Vertices, uint32_t Indices16, uint32_t Indices32);
+
+    // Drops one reference. The range becomes a hole once no references are
+    // left and the handle may be handed out again by a later Register.
+    void Release(MeshHandle Handle);
+
+    // Moves every live range down over the holes. Handles stay valid but
+    // ranges change, so items must be refreshed with ApplyRange.
+    void Compact();
+
+    MeshHandle Find(const MeshData* Mesh) const;
+    const MeshRange& GetRange(MeshHandle Handle) const;
+    void ApplyRange(MeshHandle Handle, RenderItem& Item) const;
+
+    VertexEncoding GetEncoding() const { return m_Encoding; }
+    uint32_t GetVertexStride() const { return GetVertexLayout(m_Encoding).Stride; }
+
+    const std::vector<uint8_t>& GetVertexData() const { return m_VertexData; }
+    const std::vector<uint16_t>& GetIndices16() const { return m_Indices16; }
+    const std::vector<uint32_t>& GetIndices32() const { return m_Indices32; }
+    uint32_t GetVertexCount() const { return m_VertexCount; }
+
+    uint32_t GetMeshCount() const { return m_LiveMeshes; }
+    // Arena elements no live mesh points at, reclaimed by Compact
+    uint32_t GetWastedVertices() const { return m_WastedVertices; }
+    uint32_t GetWastedIndices() const { return m_WastedIndices; }
+
+    // Bumped whenever the arena contents change, so GPU copies know to re-upload
+    uint64_t GetVersion() const { return m_Version; }
+
+private:
+    struct Entry
+    {
+        std::shared_ptr<MeshData> Mesh;
+        MeshRange Range;
+        uint32_t References{ 0 };
+    };
+
+    VertexEncoding m_Encoding;
+
+    std::vector<Entry> m_Entries;
+    std::vector<uint32_t> m_FreeEntries;
+    std::unordered_map<const MeshData*, uint32_t> m_Lookup;
+
+    std::vector<uint8_t> m_VertexData;
+    std::vector<uint16_t> m_Indices16;
+    std::vector<uint32_t> m_Indices32;
+    uint32_t m_VertexCount{ 0 };
+
+    uint32_t m_LiveMeshes{ 0 };
+    uint32_t m_WastedVertices{ 0 };
+    uint32_t m_WastedIndices{ 0 };
+    uint64_t m_Version{ 0 };
+};
+
+} // namespace Racoon
@@ -0,0 +1,643 @@
+#include "CoreStdafx.h"
+
+#include "MeshSimplifier.h"
+
+#include "MeshOptimizer.h"
+#include "Profiler.h"
+
+#include <cfloat>
+#include <cstring>
+
+namespace Racoon {
+
+namespace {
+
+constexpr uint32_t NoVertex = ~0u;
+
+// What a vertex may collapse along. Seam vertices come in pairs at one
+// position; Locked covers seam ends, corners where borders or seams meet,
+// and anything non-manifold.
+enum class VertexKind : uint8_t
+{
+    Manifold,
+    Border,
+    Seam,
+    Locked
+};
+
+// Sum of squared distances to weighted planes, as the symmetric matrix A,
+// the vector b and the constant c of x^T A x + 2 b^T x + c. In doubles:
+// errors of fine collapses are far below float precision of c.
+struct Quadric
+{
+    double A00, A11, A22, A10, A20, A21;
+    double B0, B1, B2;
+    double C;
+    double Weight;
+};
+
+void AddPlane(Quadric& Q, const XMFLOAT3& Normal, float Offset, float PlaneWeight)
+{
+    const double Nx = Normal.x, Ny = Normal.y, Nz = Normal.z, D = Offset, Weight = PlaneWeight;
+    Q.A00 += Weight * Nx * Nx;
+    Q.A11 += Weight * Ny * Ny;
+    Q.A22 += Weight * Nz * Nz;
+    Q.A10 += Weight * Ny * Nx;
+    Q.A20 += Weight * Nz * Nx;
+    Q.A21 += Weight * Nz * Ny;
+    Q.B0 += Weight * Nx * D;
+    Q.B1 += Weight * Ny * D;
+    Q.B2 += Weight * Nz * D;
+    Q.C += Weight * D * D;
+    Q.Weight += Weight;
+}
+
+void AddQuadric(Quadric& Q, const Quadric& Other)
+{
+    Q.A00 += Other.A00;
+    Q.A11 += Other.A11;
+    Q.A22 += Other.A22;
+    Q.A10 += Other.A10;
+    Q.A20 += Other.A20;
+    Q.A21 += Other.A21;
+    Q.B0 += Other.B0;
+    Q.B1 += Other.B1;
+    Q.B2 += Other.B2;
+    Q.C += Other.C;
+    Q.Weight += Other.Weight;
+}
+
+// Weighted mean squared distance of P to the planes
+float QuadricError(const Quadric& Q, const XMFLOAT3& P)
+{
+    const double X = P.x, Y = P.y, Z = P.z;
+    const double Rx = Q.A00 * X + Q.A10 * Y + Q.A20 * Z + 2.0 * Q.B0;
+    const double Ry = Q.A10 * X + Q.A11 * Y + Q.A21 * Z + 2.0 * Q.B1;
+    const double Rz = Q.A20 * X + Q.A21 * Y + Q.A22 * Z + 2.0 * Q.B2;
+    const double Sum = X * Rx + Y * Ry + Z * Rz + Q.C;
+    return Q.Weight > 0.0 ? static_cast<float>(std::fabs(Sum) / Q.Weight) : 0.f;
+}
+
+XMFLOAT3 Subtract(const XMFLOAT3& A, const XMFLOAT3& B)
+{
+    return XMFLOAT3(A.x - B.x, A.y - B.y, A.z - B.z);
+}
+
+XMFLOAT3 Cross(const XMFLOAT3& A, const XMFLOAT3& B)
+{
+    return XMFLOAT3(A.y * B.z - A.z * B.y, A.z * B.x - A.x * B.z, A.x * B.y - A.y * B.x);
+}
+
+float Dot(const XMFLOAT3& A, const XMFLOAT3& B)
+{
+    return A.x * B.x + A.y * B.y + A.z * B.z;
+}
+
+// Half-edges by their first vertex in CSR form: the second vertex of each
+struct EdgeAdjacency
+{
+    std::vector<uint32_t> Offsets;
+    std::vector<uint32_t> Targets;
+
+    EdgeAdjacency(const std::vector<uint32_t>& Indices, size_t VertexCount)
+    {
+        Offsets.assign(VertexCount + 1, 0);
+        for (uint32_t Index : Indices)
+            ++Offsets[Index + 1];
+        for (size_t v = 0; v < VertexCount; ++v)
+            Offsets[v + 1] += Offsets[v];
+        Targets.resize(Indices.size());
+        std::vector<uint32_t> Cursor(Offsets.begin(), Offsets.end() - 1);
+        for (size_t t = 0; t < Indices.size(); t += 3)
+        {
+            for (uint32_t k = 0; k < 3; ++k)
+                Targets[Cursor[Indices[t + k]]++] = Indices[t + (k + 1) % 3];
+        }
+    }
+
+    bool HasEdge(uint32_t From, uint32_t To) const
+    {
+        for (uint32_t e = Offsets[From]; e < Offsets[From + 1]; ++e)
+        {
+            if (Targets[e] == To)
+                return true;
+        }
+        return false;
+    }
+};
+
+// Everything about the source mesh a simplification reads, computed once
+// and shared by every level of a chain
+struct SimplifyInput
+{
+    std::vector<uint32_t> Indices;
+    // In a unit cube, so the float quadrics keep their precision
+    std::vector<XMFLOAT3> Positions;
+    float Scale{ 1.f };
+    // First vertex at the same position, and the next one in a circular list
+    std::vector<uint32_t> Remap;
+    std::vector<uint32_t> Wedge;
+    std::vector<VertexKind> Kinds;
+    // The one open half-edge leaving and entering a Border or Seam vertex
+    std::vector<uint32_t> OpenNext;
+    std::vector<uint32_t> OpenPrev;
+    // Indexed by Remap, so the vertices of a seam share one
+    std::vector<Quadric> Quadrics;
+};
+
+void BuildPositionRemap(SimplifyInput& Input)
+{
+    const size_t VertexCount = Input.Positions.size();
+    Input.Remap.resize(VertexCount);
+    Input.Wedge.resize(VertexCount);
+
+    size_t TableSize = 64;
+    while (TableSize < VertexCount * 2)
+        TableSize <<= 1;
+    const size_t Mask = TableSize - 1;
+    std::vector<uint32_t> Table(TableSize, NoVertex);
+    auto Bits = [&Input](uint32_t v, uint32_t (&Out)[3]) {
+        // + 0.f turns -0 into +0, so both land in the same slot
+        const float Values[3] = { Input.Positions[v].x + 0.f, Input.Positions[v].y + 0.f,
+            Input.Positions[v].z + 0.f };
+        std::memcpy(Out, Values, sizeof(Out));
+    };
+
+    // Unused vertices would look like the other side of a seam
+    std::vector<uint8_t> Used(VertexCount, 0);
+    for (uint32_t Index : Input.Indices)
+        Used[Index] = 1;
+
+    for (uint32_t v = 0; v < VertexCount; ++v)
+    {
+        Input.Remap[v] = v;
+        Input.Wedge[v] = v;
+        if (!Used[v])
+            continue;
+        uint32_t Key[3];
+        Bits(v, Key);
+        size_t Slot = ((Key[0] * 73856093u) ^ (Key[1] * 19349663u) ^ (Key[2] * 83492791u)) & Mask;
+        for (;; Slot = (Slot + 1) & Mask)
+        {
+            const uint32_t Existing = Table[Slot];
+            if (Existing == NoVertex)
+            {
+                Table[Slot] = v;
+                break;
+            }
+            uint32_t ExistingKey[3];
+            Bits(Existing, ExistingKey);
+            if (std::memcmp(Key, ExistingKey, sizeof(Key)) == 0)
+            {
+                Input.Remap[v] = Existing;
+                Input.Wedge[v] = Input.Wedge[Existing];
+                Input.Wedge[Existing] = v;
+                break;
+            }
+        }
+    }
+}
+
+void ClassifyVertices(SimplifyInput& Input, const EdgeAdjacency& Edges, bool LockBorders)
+{
+    const size_t VertexCount = Input.Positions.size();
+    std::vector<uint8_t> OpenOut(VertexCount, 0), OpenIn(VertexCount, 0);
+    Input.OpenNext.assign(VertexCount, NoVertex);
+    Input.OpenPrev.assign(VertexCount, NoVertex);
+
+    // Open half-edges have no twin with exactly the same vertices. Seams
+    // show up as open on both sides, borders on one.
+    for (uint32_t v = 0; v < VertexCount; ++v)
+    {
+        for (uint32_t e = Edges.Offsets[v]; e < Edges.Offsets[v + 1]; ++e)
+        {
+            const uint32_t To = Edges.Targets[e];
+            if (Edges.HasEdge(To, v))
+                continue;
+            OpenOut[v] = static_cast<uint8_t>(std::min(OpenOut[v] + 1, 2));
+            OpenIn[To] = static_cast<uint8_t>(std::min(OpenIn[To] + 1, 2));
+            Input.OpenNext[v] = To;
+            Input.OpenPrev[To] = v;
+        }
+    }
+
+    Input.Kinds.resize(VertexCount);
+    for (uint32_t v = 0; v < VertexCount; ++v)
+    {
+        const bool Closed = OpenOut[v] == 0 && OpenIn[v] == 0;
+        const bool OneOpen = OpenOut[v] == 1 && OpenIn[v] == 1;
+        const uint32_t Other = Input.Wedge[v];
+        VertexKind Kind = VertexKind::Locked;
+        if (Other == v)
+        {
+            if (Closed)
+                Kind = VertexKind::Manifold;
+            else if (OneOpen && !LockBorders)
+                Kind = VertexKind::Border;
+        }
+        else if (Input.Wedge[Other] == v && OneOpen && OpenOut[Other] == 1 && OpenIn[Other] == 1)
+        {
+            // Two vertices at one position whose open edges run along the
+            // same line in opposite directions: both sides of one seam
+            const auto& Remap = Input.Remap;
+            if (Remap[Input.OpenNext[v]] == Remap[Input.OpenPrev[Other]] &&
+                Remap[Input.OpenPrev[v]] == Remap[Input.OpenNext[Other]])
+                Kind = VertexKind::Seam;
+        }
+        Input.Kinds[v] = Kind;
+    }
+}
+
+void BuildQuadrics(SimplifyInput& Input, const EdgeAdjacency& Edges)
+{
+    // Open edges also get a plane through the edge, perpendicular to the
+    // triangle, so borders and seams resist moving sideways
+    constexpr float EdgeWeight = 2.f;
+
+    Input.Quadrics.assign(Input.Positions.size(), Quadric{});
+    const auto& Indices = Input.Indices;
+    for (size_t t = 0; t < Indices.size(); t += 3)
+    {
+        const uint32_t Corners[3] = { Indices[t], Indices[t + 1], Indices[t + 2] };
+        const XMFLOAT3& P0 = Input.Positions[Corners[0]];
+        XMFLOAT3 Normal = Cross(Subtract(Input.Positions[Corners[1]], P0), Subtract(Input.Positions[Corners[2]], P0));
+        const float Length = std::sqrt(Dot(Normal, Normal));
+        if (Length == 0.f)
+            continue;
+        Normal = XMFLOAT3(Normal.x / Length, Normal.y / Length, Normal.z / Length);
+        const float Area = 0.5f * Length;
+        for (uint32_t Corner : Corners)
+            AddPlane(Input.Quadrics[Input.Remap[Corner]], Normal, -Dot(Normal, P0), Area);
+
+        for (uint32_t k = 0; k < 3; ++k)
+        {
+            const uint32_t From = Corners[k];
+            const uint32_t To = Corners[(k + 1) % 3];
+            if (Edges.HasEdge(To, From))
+                continue;
+            const XMFLOAT3 Edge = Subtract(Input.Positions[To], Input.Positions[From]);
+            XMFLOAT3 Side = Cross(Edge, Normal);
+            const float SideLength = std::sqrt(Dot(Side, Side));
+            if (SideLength == 0.f)
+                continue;
+            Side = XMFLOAT3(Side.x / SideLength, Side.y / SideLength, Side.z / SideLength);
+            const float D = -Dot(Side, Input.Positions[From]);
+            const float Weight = EdgeWeight * Dot(Edge, Edge);
+            AddPlane(Input.Quadrics[Input.Remap[From]], Side, D, Weight);
+            AddPlane(Input.Quadrics[Input.Remap[To]], Side, D, Weight);
+        }
+    }
+}
+
+SimplifyInput PrepareSimplify(const MeshData& Mesh, const SimplifyOptions& Options)
+{
+    RACOON_PROFILE_SCOPE("PrepareSimplify");
+    SimplifyInput Input;
+    const size_t VertexCount = Mesh.Vertices.size();
+
+    // Triangles that are already degenerate would only confuse the edge
+    // classification
+    Input.Indices.reserve(Mesh.Indices32.size());
+    for (size_t t = 0; t + 2 < Mesh.Indices32.size(); t += 3)
+    {
+        const uint32_t a = Mesh.Indices32[t], b = Mesh.Indices32[t + 1], c = Mesh.Indices32[t + 2];
+        if (a == b || b == c || a == c)
+            continue;
+        Input.Indices.insert(Input.Indices.end(), { a, b, c });
+    }
+
+    XMFLOAT3 Min(FLT_MAX, FLT_MAX, FLT_MAX), Max(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+    for (const Vertex& V : Mesh.Vertices)
+    {
+        Min = XMFLOAT3(std::min(Min.x, V.Position.x), std::min(Min.y, V.Position.y), std::min(Min.z, V.Position.z));
+        Max = XMFLOAT3(std::max(Max.x, V.Position.x), std::max(Max.y, V.Position.y), std::max(Max.z, V.Position.z));
+    }
+    const float Extent = std::max({ Max.x - Min.x, Max.y - Min.y, Max.z - Min.z });
+    Input.Scale = Extent > 0.f ? Extent : 1.f;
+    Input.Positions.resize(VertexCount);
+    for (size_t v = 0; v < VertexCount; ++v)
+    {
+        const XMFLOAT3& P = Mesh.Vertices[v].Position;
+        Input.Positions[v] = XMFLOAT3((P.x - Min.x) / Input.Scale, (P.y - Min.y) / Input.Scale,
+            (P.z - Min.z) / Input.Scale);
+    }
+
+    BuildPositionRemap(Input);
+    const EdgeAdjacency Edges(Input.Indices, VertexCount);
+    ClassifyVertices(Input, Edges, Options.LockBorders);
+    BuildQuadrics(Input, Edges);
+    return Input;
+}
+
+struct Collapse
+{
+    uint32_t From;
+    uint32_t To;
+    // Ranking cost, and the geometric part of it alone
+    float Cost;
+    float ErrorSq;
+};
+
+class Simplifier
+{
+public:
+    Simplifier(const MeshData& Mesh, const SimplifyInput& Input, const SimplifyOptions& Options)
+        : m_Mesh(Mesh), m_Input(Input), m_Options(Options), m_Indices(Input.Indices), m_Quadrics(Input.Quadrics)
+    {
+        m_Target.resize(Input.Positions.size());
+        for (uint32_t v = 0; v < m_Target.size(); ++v)
+            m_Target[v] = v;
+        m_Locked.resize(Input.Positions.size());
+    }
+
+    SimplifyResult Run(uint32_t TargetTriangles, MeshData& Out);
+
+private:
+    bool CanCollapse(uint32_t From, uint32_t To) const;
+    Collapse Rank(uint32_t From, uint32_t To) const;
+    // The vertex the seam partner of From collapses to along with From
+    uint32_t GetSeamTarget(uint32_t From, uint32_t To) const;
+    bool FlipsTriangle(uint32_t From, uint32_t To) const;
+    void BuildTriangleAdjacency();
+    void CollectCollapses();
+    uint32_t ApplyCollapses();
+
+    const MeshData& m_Mesh;
+    const SimplifyInput& m_Input;
+    const SimplifyOptions& m_Options;
+
+    std::vector<uint32_t> m_Indices;
+    std::vector<Quadric> m_Quadrics;
+    // Where each vertex went; itself until it collapses
+    std::vector<uint32_t> m_Target;
+    // Positions touched by a collapse in this pass
+    std::vector<uint8_t> m_Locked;
+    std::vector<Collapse> m_Collapses;
+    // Vertex to triangles, as of the start of the pass
+    std::vector<uint32_t> m_TriangleOffsets;
+    std::vector<uint32_t> m_Triangles;
+};
+
+bool Simplifier::CanCollapse(uint32_t From, uint32_t To) const
+{
+    switch (m_Input.Kinds[From])
+    {
+    case VertexKind::Manifold:
+        return true;
+    case VertexKind::Border:
+    case VertexKind::Seam:
+        return To == m_Input.OpenNext[From] || To == m_Input.OpenPrev[From];
+    default:
+        return false;
+    }
+}
+
+Collapse Simplifier::Rank(uint32_t From, uint32_t To) const
+{
+    const XMFLOAT3& P0 = m_Input.Positions[From];
+    const XMFLOAT3& P1 = m_Input.Positions[To];
+    Collapse Candidate{ From, To, 0.f, QuadricError(m_Quadrics[m_Input.Remap[From]], P1) };
+
+    // The fan of From takes on the attributes of To. Weighted by the edge
+    // length squared, like the area whose shading changes.
+    const Vertex& A = m_Mesh.Vertices[From];
+    const Vertex& B = m_Mesh.Vertices[To];
+    const XMFLOAT3 Normal = Subtract(A.Normal, B.Normal);
+    const float Du = A.UV.x - B.UV.x, Dv = A.UV.y - B.UV.y;
+    const XMFLOAT3 Edge = Subtract(P1, P0);
+    const float Attributes = m_Options.NormalWeight * Dot(Normal, Normal) + m_Options.UVWeight * (Du * Du + Dv * Dv);
+    Candidate.Cost = Candidate.ErrorSq + Attributes * Dot(Edge, Edge);
+    return Candidate;
+}
+
+uint32_t Simplifier::GetSeamTarget(uint32_t From, uint32_t To) const
+{
+    const uint32_t Partner = m_Input.Wedge[From];
+    return To == m_Input.OpenNext[From] ? m_Input.OpenPrev[Partner] : m_Input.OpenNext[Partner];
+}
+
+bool Simplifier::FlipsTriangle(uint32_t From, uint32_t To) const
+{
+    const XMFLOAT3& P0 = m_Input.Positions[From];
+    const XMFLOAT3& P1 = m_Input.Positions[To];
+    const uint32_t ToPosition = m_Input.Remap[To];
+    for (uint32_t i = m_TriangleOffsets[From]; i < m_TriangleOffsets[From + 1]; ++i)
+    {
+        const uint32_t* Corners = &m_Indices[m_Triangles[i] * 3];
+        const uint32_t k = Corners[0] == From ? 0 : Corners[1] == From ? 1 : 2;
+        // Earlier collapses of this pass have not been written to the indices yet
+        const uint32_t B = m_Target[Corners[(k + 1) % 3]];
+        const uint32_t C = m_Target[Corners[(k + 2) % 3]];
+        // Triangles on the collapsing edge disappear
+        if (m_Input.Remap[B] == ToPosition || m_Input.Remap[C] == ToPosition || m_Input.Remap[B] == m_Input.Remap[C])
+            continue;
+        const XMFLOAT3& PB = m_Input.Positions[B];
+        const XMFLOAT3& PC = m_Input.Positions[C];
+        const XMFLOAT3 Before = Cross(Subtract(PB, P0), Subtract(PC, P0));
+        const XMFLOAT3 After = Cross(Subtract(PB, P1), Subtract(PC, P1));
+        // Flipped, or turned nearly edge on
+        const float Agreement = Dot(Before, After);
+        if (Agreement <= 0.f || Agreement * Agreement < 1e-4f * Dot(Before, Before) * Dot(After, After))
+            return true;
+    }
+    return false;
+}
+
+void Simplifier::BuildTriangleAdjacency()
+{
+    const size_t VertexCount = m_Input.Positions.size();
+    m_TriangleOffsets.assign(VertexCount + 1, 0);
+    for (uint32_t Index : m_Indices)
+        ++m_TriangleOffsets[Index + 1];
+    for (size_t v = 0; v < VertexCount; ++v)
+        m_TriangleOffsets[v + 1] += m_TriangleOffsets[v];
+    m_Triangles.resize(m_Indices.size());
+    std::vector<uint32_t> Cursor(m_TriangleOffsets.begin(), m_TriangleOffsets.end() - 1);
+    for (size_t i = 0; i < m_Indices.size(); ++i)
+        m_Triangles[Cursor[m_Indices[i]]++] = static_cast<uint32_t>(i / 3);
+}
+
+void Simplifier::CollectCollapses()
+{
+    m_Collapses.clear();
+    for (size_t t = 0; t < m_Indices.size(); t += 3)
+    {
+        for (uint32_t k = 0; k < 3; ++k)
+        {
+            const uint32_t A = m_Indices[t + k];
+            const uint32_t B = m_Indices[t + (k + 1) % 3];
+            // Interior edges show up once from each side; open ones only once
+            if (A > B && m_Input.OpenNext[A] != B)
+                continue;
+            const bool Forward = CanCollapse(A, B);
+            const bool Backward = CanCollapse(B, A);
+            if (!Forward && !Backward)
+                continue;
+            if (Forward && Backward)
+            {
+                const Collapse AB = Rank(A, B);
+                const Collapse BA = Rank(B, A);
+                m_Collapses.push_back(AB.Cost <= BA.Cost ? AB : BA);
+            }
+            else
+            {
+                m_Collapses.push_back(Forward ? Rank(A, B) : Rank(B, A));
+            }
+        }
+    }
+}
+
+uint32_t Simplifier::ApplyCollapses()
+{
+    size_t Kept = 0;
+    for (size_t t = 0; t < m_Indices.size(); t += 3)
+    {
+        const uint32_t A = m_Target[m_Indices[t]];
+        const uint32_t B = m_Target[m_Indices[t + 1]];
+        const uint32_t C = m_Target[m_Indices[t + 2]];
+        const uint32_t PA = m_Input.Remap[A], PB = m_Input.Remap[B], PC = m_Input.Remap[C];
+        if (PA == PB || PB == PC || PA == PC)
+            continue;
+        m_Indices[Kept++] = A;
+        m_Indices[Kept++] = B;
+        m_Indices[Kept++] = C;
+    }
+    m_Indices.resize(Kept);
+    return static_cast<uint32_t>(Kept / 3);
+}
+
+SimplifyResult Simplifier::Run(uint32_t TargetTriangles, MeshData& Out)
+{
+    RACOON_PROFILE_SCOPE("SimplifyMesh");
+    const float MaxErrorSq = std::isinf(m_Options.MaxError) ? FLT_MAX :
+        (m_Options.MaxError / m_Input.Scale) * (m_Options.MaxError / m_Input.Scale);
+    float ErrorSq = 0.f;
+    uint32_t TriangleCount = static_cast<uint32_t>(m_Indices.size() / 3);
+
+    // Each pass ranks every edge, then collapses the cheapest ones that do
+    // not touch each other, so ranks stay valid without a priority queue
+    while (TriangleCount > TargetTriangles)
+    {
+        CollectCollapses();
+        if (m_Collapses.empty())
+            break;
+
+        // Most collapses remove two triangles, so Goal collapses go half the
+        // way to the target. Allowing a bit above the cost of the last of
+        // them keeps cheap collapses first without a pass per collapse.
+        // Candidates refused for good move the limit on, or a run of cheap
+        // refused ones would stall the passes at one collapse each.
+        const size_t Goal = std::max<size_t>((TriangleCount - TargetTriangles) / 4, 1);
+        std::sort(m_Collapses.begin(), m_Collapses.end(),
+            [](const Collapse& A, const Collapse& B) { return A.Cost < B.Cost; });
+        auto CostLimit = [this, Goal](size_t Refused) {
+            return m_Collapses[std::min(Goal + Refused, m_Collapses.size()) - 1].Cost * 1.5f;
+        };
+
+        BuildTriangleAdjacency();
+        std::fill(m_Locked.begin(), m_Locked.end(), 0);
+        uint32_t Removed = 0;
+        uint32_t Collapsed = 0;
+        size_t Refused = 0;
+        for (const Collapse& Candidate : m_Collapses)
+        {
+            if (TriangleCount - Removed <= TargetTriangles || (Collapsed > 0 && Candidate.Cost > CostLimit(Refused)))
+                break;
+            if (Candidate.ErrorSq > MaxErrorSq)
+            {
+                ++Refused;
+                continue;
+            }
+            const uint32_t FromPosition = m_Input.Remap[Candidate.From];
+            const uint32_t ToPosition = m_Input.Remap[Candidate.To];
+            if (m_Locked[FromPosition] || m_Locked[ToPosition])
+                continue;
+
+            const bool Seam = m_Input.Kinds[Candidate.From] == VertexKind::Seam;
+            const uint32_t Partner = Seam ? m_Input.Wedge[Candidate.From] : NoVertex;
+            const uint32_t PartnerTo = Seam ? GetSeamTarget(Candidate.From, Candidate.To) : NoVertex;
+            if (FlipsTriangle(Candidate.From, Candidate.To) || (Seam && FlipsTriangle(Partner, PartnerTo)))
+            {
+                ++Refused;
+                continue;
+            }
+
+            m_Target[Candidate.From] = Candidate.To;
+            if (Seam)
+                m_Target[Partner] = PartnerTo;
+            AddQuadric(m_Quadrics[ToPosition], m_Quadrics[FromPosition]);
+            m_Locked[FromPosition] = 1;
+            m_Locked[ToPosition] = 1;
+            Removed += m_Input.Kinds[Candidate.From] == VertexKind::Border ? 1 : 2;
+            ErrorSq = std::max(ErrorSq, Candidate.ErrorSq);
+            ++Collapsed;
+        }
+        if (Collapsed == 0)
+            break;
+        TriangleCount = ApplyCollapses();
+    }
+
+    Out.Vertices = m_Mesh.Vertices;
+    Out.Indices32 = std::move(m_Indices);
+    Out.InvalidateIndices16();
+    OptimizeMesh(Out);
+    Out.LocalBounds = m_Mesh.LocalBounds;
+
+    SimplifyResult Result;
+    Result.TriangleCount = TriangleCount;
+    Result.Error = std::sqrt(ErrorSq) * m_Input.Scale;
+    return Result;
+}
+
+} // namespace
+
+SimplifyResult SimplifyMesh(const MeshData& Mesh, uint32_t TargetTriangles, MeshData& Out,
+    const SimplifyOptions& Options)
+{
+    const SimplifyInput Input = PrepareSimplify(Mesh, Options);
+    return Simplifier(Mesh, Input, Options).Run(TargetTriangles, Out);
+}
+
+std::vector<LodLevel> BuildLodChain(const std::shared_ptr<MeshData>& Mesh, const LodChainOptions& Options,
+    JobSystem* Jobs)
+{
+    RACOON_PROFILE_SCOPE("BuildLodChain");
+    std::vector<LodLevel> Chain{ { Mesh, 0.f } };
+    const uint32_t SourceTriangles = static_cast<uint32_t>(Mesh->Indices32.size() / 3);
+    const uint32_t LevelCount = static_cast<uint32_t>(Options.TriangleRatios.size());
+    if (SourceTriangles == 0 || LevelCount == 0)
+        return Chain;
+
+    // Classification and quadrics of the source are the same for every level
+    const SimplifyInput Input = PrepareSimplify(*Mesh, Options.Simplify);
+    std::vector<LodLevel> Levels(LevelCount);
+    auto Simplify = [&](uint32_t First, uint32_t Last) {
+        for (uint32_t i = First; i < Last; ++i)
+        {
+            const uint32_t Target = static_cast<uint32_t>(SourceTriangles * Options.TriangleRatios[i]);
+            auto Level = std::make_shared<MeshData>();
+            const SimplifyResult Result = Simplifier(*Mesh, Input, Options.Simplify).Run(Target, *Level);
+            Levels[i] = { std::move(Level), Result.Error };
+        }
+    };
+    if (Jobs)
+        Jobs->ParallelFor(LevelCount, 1, Simplify);
+    else
+        Simplify(0, LevelCount);
+
+    uint32_t Previous = SourceTriangles;
+    float Error = 0.f;
+    for (LodLevel& Level : Levels)
+    {
+        const uint32_t Triangles = static_cast<uint32_t>(Level.Mesh->Indices32.size() / 3);
+        if (Triangles == 0 || Triangles > Options.MinReduction * Previous)
+            continue;
+        Error = std::max(Error, Level.Error);
+        Level.Error = Error;
+        Chain.push_back(std::move(Level));
+        Previous = Triangles;
+    }
+    return Chain;
+}
+
+} // namespace Racoon
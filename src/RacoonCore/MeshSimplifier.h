@@ -0,0 +1,69 @@
+#pragma once
+
+#include "CoreStdafx.h"
+#include "JobSystem.h"
+#include "MeshGeometry.h"
+
+namespace Racoon {
+
+struct SimplifyOptions
+{
+    // Stops before a collapse whose error, in object space units, exceeds
+    // this, even if the target was not reached
+    float MaxError{ INFINITY };
+    // Keeps open borders where they are. Off, border vertices may slide
+    // along the border but never off it.
+    bool LockBorders{ false };
+    // How much collapsing onto a vertex with other attributes costs, added
+    // to the geometric error when ranking collapses. Only affects the
+    // order; attributes are never interpolated either way.
+    float NormalWeight{ 0.5f };
+    float UVWeight{ 1.f };
+};
+
+struct SimplifyResult
+{
+    uint32_t TriangleCount{ 0 };
+    // Largest quadric error of a collapse, as a distance in object space
+    // units: how far the surface moved at most, by the quadric estimate
+    float Error{ 0.f };
+};
+
+// Quadric error edge collapse (Garland and Heckbert 1997). Each collapse
+// moves a vertex onto a neighbour, so every output vertex is an input
+// vertex with its normal, tangent and UV untouched. Vertices that share a
+// position but not their attributes form seams: they only collapse along
+// the seam, both sides together, so UV charts and hard edges stay closed.
+// Collapses that would flip a triangle are skipped.
+//
+// Out gets the input's vertices that are still used, with the triangles
+// ordered by OptimizeMesh, and the input's bounds.
+SimplifyResult SimplifyMesh(const MeshData& Mesh, uint32_t TargetTriangles, MeshData& Out,
+    const SimplifyOptions& Options = SimplifyOptions());
+
+struct LodChainOptions
+{
+    // Target triangle counts of the levels after the source, as fractions
+    // of its triangle count, largest first
+    std::vector<float> TriangleRatios{ 0.5f, 0.25f, 0.125f, 0.0625f };
+    SimplifyOptions Simplify;
+    // Levels that keep more than this fraction of the previous level's
+    // triangles are dropped as not worth a switch
+    float MinReduction{ 0.8f };
+};
+
+struct LodLevel
+{
+    std::shared_ptr<MeshData> Mesh;
+    // Object space distance to the source surface, see SimplifyResult
+    float Error{ 0.f };
+};
+
+// The source followed by its simplified levels, coarsest last. Every level
+// is simplified from the source, not from the level before, so errors do
+// not add up and the levels run in parallel on Jobs when given. Errors
+// never decrease along the chain.
+std::vector<LodLevel> BuildLodChain(const std::shared_ptr<MeshData>& Mesh,
+    const LodChainOptions& Options = LodChainOptions(), JobSystem* Jobs = nullptr);
+
+} // namespace Racoon
@@ -0,0 +1,609 @@
+#include "PrimitivesGenerator.h"
+
+namespace Racoon {
+
+MeshData PrimitivesGenerator::CreateCylinder(
+    float BottomRadius, float TopRadius, float Height,
+    uint32_t SliceCount, uint32_t StackCount)
+{
+    MeshData Mesh;
+
+    // Sides plus two caps of SliceCount + 1 rim vertices and a center each
+    const uint32_t RingVertexCount = SliceCount + 1;
+    Mesh.Vertices.reserve((StackCount + 1) * RingVertexCount + 2 * (RingVertexCount + 1));
+    Mesh.Indices32.reserve(StackCount * SliceCount * 6 + 2 * SliceCount * 3);
+
+    // The caps' rims share the side's angles in both modes
+    const SliceTable Slices = BuildSliceTable(SliceCount);
+    if (m_Options.Mode == GenerationMode::Bulk)
+        BuildCylinderSideBulk(BottomRadius, TopRadius, Height, SliceCount, StackCount, Slices, Mesh);
+    else
+        BuildCylinderSideScalar(BottomRadius, TopRadius, Height, SliceCount, StackCount, Mesh);
+
+    BuildCylinderCap(BottomRadius, -0.5f * Height, Height, SliceCount, Slices, false, Mesh);
+    BuildCylinderCap(TopRadius, 0.5f * Height, Height, SliceCount, Slices, true, Mesh);
+
+    Mesh.UpdateBounds();
+    return Mesh;
+}
+
+void PrimitivesGenerator::BuildCylinderSideScalar(float BottomRadius, float TopRadius, float Height,
+    uint32_t SliceCount, uint32_t StackCount, MeshData& Mesh)
+{
+    float StackHeight = Height / StackCount;
+    float RadiusStep = (TopRadius - BottomRadius) / StackCount;
+    uint32_t RingCount = StackCount + 1;
+
+    for (uint32_t i = 0; i < RingCount; ++i)
+    {
+        float y = -0.5f * Height + i * StackHeight;
+        float r = BottomRadius + i * RadiusStep;
+
+        float dTheta = 2.f * XM_PI / SliceCount;
+
+        for (uint32_t j = 0; j <= SliceCount; ++j)
+        {
+            Vertex V;
+
+            float c = cosf(j * dTheta);
+            float s = sinf(j * dTheta);
+
+            V.Position = XMFLOAT3(r * c, y, r * s);
+
+            V.UV.x = (float)j / SliceCount;
+            V.UV.y = 1.f - (float)i / StackCount;
+
+            V.Tangent = XMFLOAT3(-s, 0.f, c);
+
+            float dr = BottomRadius - TopRadius;
+            XMFLOAT3 Bitangent(dr * c, -Height, dr * s);
+
+            XMVECTOR T = XMLoadFloat3(&V.Tangent);
+            XMVECTOR B = XMLoadFloat3(&Bitangent);
+            XMVECTOR N = XMVector3Normalize(XMVector3Cross(T, B));
+            XMStoreFloat3(&V.Normal, N);
+
+            Mesh.Vertices.push_back(V);
+        }
+    }
+
+    const uint32_t RingVertexCount = SliceCount + 1;
+
+    for (uint32_t i = 0; i < StackCount; ++i)
+    {
+        for (uint32_t j = 0; j < SliceCount; ++j)
+        {
+            Mesh.Indices32.push_back((i + 1) * RingVertexCount + j + 1);
+            Mesh.Indices32.push_back((i + 1) * RingVertexCount + j);
+            Mesh.Indices32.push_back(i * RingVertexCount + j);
+
+            Mesh.Indices32.push_back(i * RingVertexCount + j + 1);
+            Mesh.Indices32.push_back((i + 1) * RingVertexCount + j + 1);
+            Mesh.Indices32.push_back(i * RingVertexCount + j);
+        }
+    }
+}
+
+uint32_t PrimitivesGenerator::ThreadCountFor(uint32_t VertexCount) const
+{
+    if (!m_Options.Jobs)
+        return 1;
+    uint32_t MaxThreads = m_Options.MaxThreads ? m_Options.MaxThreads : m_Options.Jobs->GetThreadCount();
+    MaxThreads = std::max(MaxThreads, 1u);
+    const uint32_t MinPerThread = std::max(m_Options.MinVerticesPerThread, 1u);
+    return std::max(1u, std::min(MaxThreads, VertexCount / MinPerThread));
+}
+
+PrimitivesGenerator::SliceTable PrimitivesGenerator::BuildSliceTable(uint32_t SliceCount)
+{
+    const uint32_t RingVertexCount = SliceCount + 1;
+    const uint32_t BatchCount = (RingVertexCount + 3) / 4;
+    const float dTheta = 2.f * XM_PI / SliceCount;
+
+    SliceTable Slices;
+    Slices.Cos.assign(BatchCount, XMFLOAT4A(0.f, 0.f, 0.f, 0.f));
+    Slices.Sin.assign(BatchCount, XMFLOAT4A(0.f, 0.f, 0.f, 0.f));
+    float* pCos = &Slices.Cos[0].x;
+    float* pSin = &Slices.Sin[0].x;
+    for (uint32_t j = 0; j < RingVertexCount; ++j)
+    {
+        // Same expressions as the scalar path so results stay identical
+        pCos[j] = cosf(j * dTheta);
+        pSin[j] = sinf(j * dTheta);
+    }
+    return Slices;
+}
+
+void PrimitivesGenerator::BuildCylinderSideBulk(float BottomRadius, float TopRadius, float Height,
+    uint32_t SliceCount, uint32_t StackCount, const SliceTable& Slices, MeshData& Mesh)
+{
+    const float StackHeight = Height / StackCount;
+    const float RadiusStep = (TopRadius - BottomRadius) / StackCount;
+    const float dr = BottomRadius - TopRadius;
+    const uint32_t RingCount = StackCount + 1;
+    const uint32_t RingVertexCount = SliceCount + 1;
+
+    // Everything else that depends only on the slice
+    const uint32_t BatchCount = (RingVertexCount + 3) / 4;
+    const std::vector<XMFLOAT4A>& Cos = Slices.Cos;
+    const std::vector<XMFLOAT4A>& Sin = Slices.Sin;
+    std::vector<XMFLOAT3> Normals(RingVertexCount);
+    std::vector<float> U(RingVertexCount);
+
+    const float* pCos = &Cos[0].x;
+    const float* pSin = &Sin[0].x;
+    for (uint32_t j = 0; j < RingVertexCount; ++j)
+    {
+        const float c = pCos[j];
+        const float s = pSin[j];
+        U[j] = (float)j / SliceCount;
+
+        const XMFLOAT3 Tangent(-s, 0.f, c);
+        const XMFLOAT3 Bitangent(dr * c, -Height, dr * s);
+        XMVECTOR T = XMLoadFloat3(&Tangent);
+        XMVECTOR B = XMLoadFloat3(&Bitangent);
+        XMStoreFloat3(&Normals[j], XMVector3Normalize(XMVector3Cross(T, B)));
+    }
+
+    const size_t BaseVertex = Mesh.Vertices.size();
+    const size_t BaseIndex = Mesh.Indices32.size();
+    Mesh.Vertices.resize(BaseVertex + size_t(RingCount) * RingVertexCount);
+    Mesh.Indices32.resize(BaseIndex + size_t(StackCount) * SliceCount * 6);
+
+    // Writes rings [First, Last) and the indices of the stacks above them.
+    // Ranges never overlap, so jobs need no synchronization.
+    auto BuildRings = [&](uint32_t First, uint32_t Last)
+    {
+        for (uint32_t i = First; i < Last; ++i)
+        {
+            const float y = -0.5f * Height + i * StackHeight;
+            const float r = BottomRadius + i * RadiusStep;
+            const float v = 1.f - (float)i / StackCount;
+            const XMVECTOR R = XMVectorReplicate(r);
+
+            Vertex* Ring = &Mesh.Vertices[BaseVertex + size_t(i) * RingVertexCount];
+            for (uint32_t b = 0; b < BatchCount; ++b)
+            {
+                XMFLOAT4A X, Z;
+                XMStoreFloat4A(&X, XMVectorMultiply(R, XMLoadFloat4A(&Cos[b])));
+                XMStoreFloat4A(&Z, XMVectorMultiply(R, XMLoadFloat4A(&Sin[b])));
+                const float* pX = &X.x;
+                const float* pZ = &Z.x;
+
+                const uint32_t BatchBegin = b * 4;
+                const uint32_t BatchEnd = std::min(BatchBegin + 4, RingVertexCount);
+                for (uint32_t j = BatchBegin; j < BatchEnd; ++j)
+                {
+                    Vertex& V = Ring[j];
+                    V.Position = XMFLOAT3(pX[j - BatchBegin], y, pZ[j - BatchBegin]);
+                    V.Normal = Normals[j];
+                    V.Tangent = XMFLOAT3(-pSin[j], 0.f, pCos[j]);
+                    V.UV = XMFLOAT2(U[j], v);
+                }
+            }
+
+            if (i == StackCount)
+                continue;
+
+            uint32_t* Out = &Mesh.Indices32[BaseIndex + size_t(i) * SliceCount * 6];
+            const uint32_t Bottom = static_cast<uint32_t>(BaseVertex) + i * RingVertexCount;
+            const uint32_t Top = Bottom + RingVertexCount;
+            for (uint32_t j = 0; j < SliceCount; ++j)
+            {
+                *Out++ = Top + j + 1;
+                *Out++ = Top + j;
+                *Out++ = Bottom + j;
+
+                *Out++ = Bottom + j + 1;
+                *Out++ = Top + j + 1;
+                *Out++ = Bottom + j;
+            }
+        }
+    };
+
+    const uint32_t ThreadCount = ThreadCountFor(RingCount * RingVertexCount);
+    if (ThreadCount <= 1)
+    {
+        BuildRings(0, RingCount);
+        return;
+    }
+
+    // The calling thread works on the ranges too while it waits
+    const uint32_t RingsPerThread = (RingCount + ThreadCount - 1) / ThreadCount;
+    m_Options.Jobs->ParallelFor(RingCount, RingsPerThread, BuildRings);
+}
+
+MeshData PrimitivesGenerator::CreateCube()
+{
+    MeshData Mesh;
+    Mesh.Vertices.resize(24);
+
+    Mesh.Vertices = {
+        // Front face
+        { XMFLOAT3(-1.0f, -1.0f, -1.0f), XMFLOAT3(0.f, 0.f, -1.f), XMFLOAT3(1.f, 0.f, 0.f), XMFLOAT2(0.33f, 0.5f) },
+        { XMFLOAT3(1.0f, -1.0f, -1.0f), XMFLOAT3(0.f, 0.f, -1.f), XMFLOAT3(1.f, 0.f, 0.f), XMFLOAT2(0.33f, 0.5f) },
+        { XMFLOAT3(1.0f,  1.0f, -1.0f), XMFLOAT3(0.f, 0.f, -1.f), XMFLOAT3(1.f, 0.f, 0.f), XMFLOAT2(0.33f, 0.5f) },
+        { XMFLOAT3(-1.0f,  1.0f, -1.0f), XMFLOAT3(0.f, 0.f, -1.f), XMFLOAT3(1.f, 0.f, 0.f), XMFLOAT2(0.33f, 0.5f) },
+        // Right face
+        { XMFLOAT3(1.0f, -1.0f, -1.0f), XMFLOAT3(1.f, 0.f, 0.f), XMFLOAT3(1.f, 0.f, 0.f), XMFLOAT2(0.33f, 0.5f) },
+        { XMFLOAT3(1.0f, -1.0f,  1.0f), XMFLOAT3(1.f, 0.f, 0.f), XMFLOAT3(1.f, 0.f, 0.f), XMFLOAT2(0.33f, 0.5f) },
+        { XMFLOAT3(1.0f,  1.0f,  1.0f), XMFLOAT3(1.f, 0.f, 0.f), XMFLOAT3(1.f, 0.f, 0.f), XMFLOAT2(0.33f, 0.5f) },
+        { XMFLOAT3(1.0f,  1.0f, -1.0f), XMFLOAT3(1.f, 0.f, 0.f), XMFLOAT3(1.f, 0.f, 0.f), XMFLOAT2(0.33f, 0.5f) },
+        // Back face
+        { XMFLOAT3(1.0f, -1.0f, 1.0f), XMFLOAT3(0.f, 0.f, 1.f), XMFLOAT3(1.f, 0.f, 0.f), XMFLOAT2(0.33f, 0.5f) },
+        { XMFLOAT3(-1.0f, -1.0f, 1.0f), XMFLOAT3(0.f, 0.f, 1.f), XMFLOAT3(1.f, 0.f, 0.f), XMFLOAT2(0.33f, 0.5f) },
+        { XMFLOAT3(-1.0f,  1.0f, 1.0f), XMFLOAT3(0.f, 0.f, 1.f), XMFLOAT3(1.f, 0.f, 0.f), XMFLOAT2(0.33f, 0.5f) },
+        { XMFLOAT3(1.0f,  1.0f, 1.0f), XMFLOAT3(0.f, 0.f, 1.f), XMFLOAT3(1.f, 0.f, 0.f), XMFLOAT2(0.33f, 0.5f) },
+        // Left face
+        { XMFLOAT3(-1.0f, -1.0f,  1.0f), XMFLOAT3(-1.f, 0.f, 0.f), XMFLOAT3(1.f, 0.f, 0.f), XMFLOAT2(0.33f, 0.5f) },
+        { XMFLOAT3(-1.0f, -1.0f, -1.0f), XMFLOAT3(-1.f, 0.f, 0.f), XMFLOAT3(1.f, 0.f, 0.f), XMFLOAT2(0.33f, 0.5f) },
+        { XMFLOAT3(-1.0f,  1.0f, -1.0f), XMFLOAT3(-1.f, 0.f, 0.f), XMFLOAT3(1.f, 0.f, 0.f), XMFLOAT2(0.33f, 0.5f) },
+        { XMFLOAT3(-1.0f,  1.0f,  1.0f), XMFLOAT3(-1.f, 0.f, 0.f), XMFLOAT3(1.f, 0.f, 0.f), XMFLOAT2(0.33f, 0.5f) },
+        // Top face
+        { XMFLOAT3(-1.0f,  1.0f, -1.0f), XMFLOAT3(0.f, 1.f, 0.f), XMFLOAT3(1.f, 0.f, 0.f), XMFLOAT2(0.33f, 0.5f) },
+        { XMFLOAT3( 1.0f,  1.0f, -1.0f), XMFLOAT3(0.f, 1.f, 0.f), XMFLOAT3(1.f, 0.f, 0.f), XMFLOAT2(0.33f, 0.5f) },
+        { XMFLOAT3( 1.0f,  1.0f,  1.0f), XMFLOAT3(0.f, 1.f, 0.f), XMFLOAT3(1.f, 0.f, 0.f), XMFLOAT2(0.33f, 0.5f) },
+        { XMFLOAT3(-1.0f,  1.0f,  1.0f), XMFLOAT3(0.f, 1.f, 0.f), XMFLOAT3(1.f, 0.f, 0.f), XMFLOAT2(0.33f, 0.5f) },
+        // Bottom face
+        { XMFLOAT3(-1.0f, -1.0f, -1.0f), XMFLOAT3(0.f, -1.f, 0.f), XMFLOAT3(1.f, 0.f, 0.f), XMFLOAT2(0.33f, 0.5f) },
+        { XMFLOAT3(-1.0f, -1.0f,  1.0f), XMFLOAT3(0.f, -1.f, 0.f), XMFLOAT3(1.f, 0.f, 0.f), XMFLOAT2(0.33f, 0.5f) },
+        { XMFLOAT3( 1.0f, -1.0f,  1.0f), XMFLOAT3(0.f, -1.f, 0.f), XMFLOAT3(1.f, 0.f, 0.f), XMFLOAT2(0.33f, 0.5f) },
+        { XMFLOAT3( 1.0f, -1.0f, -1.0f), XMFLOAT3(0.f, -1.f, 0.f), XMFLOAT3(1.f, 0.f, 0.f), XMFLOAT2(0.33f, 0.5f) }
+    };
+    Mesh.Indices32.resize(36);
+
+    for (uint32_t i = 0; i < 24; i += 4)
+    {
+        std::vector<uint32_t> indicesOfCurrFace = {
+            i, i + 1, i + 2, i, i + 2, i + 3
+        };
+        Mesh.Indices32.insert(Mesh.Indices32.end(), indicesOfCurrFace.begin(), indicesOfCurrFace.end());
+    }
+    
+    Mesh.UpdateBounds();
+    return Mesh;
+}
+
+void PrimitivesGenerator::BuildCylinderCap(float Radius, float y, float Height, uint32_t SliceCount,
+    const SliceTable& Slices, bool Top, MeshData& Mesh)
+{
+    const uint32_t RingVertexCount = SliceCount + 1;
+    const size_t BaseVertex = Mesh.Vertices.size();
+    const size_t BaseIndex = Mesh.Indices32.size();
+    // The rim, then the center vertex
+    Mesh.Vertices.resize(BaseVertex + RingVertexCount + 1);
+    Mesh.Indices32.resize(BaseIndex + size_t(SliceCount) * 3);
+
+    const XMVECTOR R = XMVectorReplicate(Radius);
+    const XMVECTOR Heights = XMVectorReplicate(Height);
+    const XMVECTOR Half = XMVectorReplicate(0.5f);
+    Vertex* Rim = &Mesh.Vertices[BaseVertex];
+    const uint32_t BatchCount = (RingVertexCount + 3) / 4;
+    for (uint32_t b = 0; b < BatchCount; ++b)
+    {
+        // Divided rather than scaled by the reciprocal, as the scalar caps did
+        const XMVECTOR X = XMVectorMultiply(R, XMLoadFloat4A(&Slices.Cos[b]));
+        const XMVECTOR Z = XMVectorMultiply(R, XMLoadFloat4A(&Slices.Sin[b]));
+        XMFLOAT4A Xs, Zs, Us, Vs;
+        XMStoreFloat4A(&Xs, X);
+        XMStoreFloat4A(&Zs, Z);
+        XMStoreFloat4A(&Us, XMVectorAdd(XMVectorDivide(X, Heights), Half));
+        XMStoreFloat4A(&Vs, XMVectorAdd(XMVectorDivide(Z, Heights), Half));
+
+        const uint32_t BatchBegin = b * 4;
+        const uint32_t BatchEnd = std::min(BatchBegin + 4, RingVertexCount);
+        for (uint32_t j = BatchBegin; j < BatchEnd; ++j)
+        {
+            const uint32_t Lane = j - BatchBegin;
+            Vertex& V = Rim[j];
+            V.Position = XMFLOAT3((&Xs.x)[Lane], y, (&Zs.x)[Lane]);
+            V.Normal = XMFLOAT3(0.f, 1.f, 0.f);
+            V.Tangent = XMFLOAT3(1.f, 0.f, 0.f);
+            V.UV = XMFLOAT2((&Us.x)[Lane], (&Vs.x)[Lane]);
+        }
+    }
+    Rim[RingVertexCount] = Vertex(0.f, y, 0.f, 0.f, 1.f, 0.f, 1.f, 0.f, 0.f, 0.5f, 0.5f);
+
+    // The bottom cap is seen from below, so it winds the other way
+    uint32_t* Out = &Mesh.Indices32[BaseIndex];
+    const uint32_t First = static_cast<uint32_t>(BaseVertex);
+    const uint32_t Center = First + RingVertexCount;
+    for (uint32_t j = 0; j < SliceCount; ++j)
+    {
+        if (Top)
+        {
+            *Out++ = First + j;
+            *Out++ = First + j + 1;
+            *Out++ = Center;
+        }
+        else
+        {
+            *Out++ = Center;
+            *Out++ = First + j + 1;
+            *Out++ = First + j;
+        }
+    }
+}
+
+uint32_t PrimitivesGenerator::GeosphereVertexCount(uint32_t NumSubdivisions)
+{
+    return 10u * (1u << (2u * NumSubdivisions)) + 2u;
+}
+
+uint32_t PrimitivesGenerator::GeosphereTriangleCount(uint32_t NumSubdivisions)
+{
+    return 20u * (1u << (2u * NumSubdivisions));
+}
+
+namespace {
+
+// Edges of a closed triangle mesh by id: the two vertices of every edge,
+// and the three edges of every triangle in the order (v0, v1), (v1, v2),
+// (v0, v2). Subdivision needs no lookups with them: the midpoint of edge e
+// is appended as vertex VertexCount + e, and the ids of the edges of the
+// child triangles follow from their parent's.
+struct MeshEdges
+{
+    std::vector<uint32_t> Ends;
+    std::vector<uint32_t> OfTriangle;
+};
+
+MeshEdges FindEdges(const uint32_t* Indices, uint32_t TriangleCount)
+{
+    MeshEdges Edges;
+    Edges.OfTriangle.resize(size_t(TriangleCount) * 3);
+    for (uint32_t t = 0; t < TriangleCount; ++t)
+    {
+        const uint32_t* Tri = &Indices[t * 3];
+        const uint32_t Sides[3][2] = { { Tri[0], Tri[1] }, { Tri[1], Tri[2] }, { Tri[0], Tri[2] } };
+        for (uint32_t k = 0; k < 3; ++k)
+        {
+            // Only used for the icosahedron, a linear search is fine
+            uint32_t Edge = 0;
+            const uint32_t EdgeCount = static_cast<uint32_t>(Edges.Ends.size() / 2);
+            while (Edge < EdgeCount && !(std::min(Sides[k][0], Sides[k][1]) == Edges.Ends[Edge * 2] &&
+                std::max(Sides[k][0], Sides[k][1]) == Edges.Ends[Edge * 2 + 1]))
+            {
+                ++Edge;
+            }
+            if (Edge == EdgeCount)
+            {
+                Edges.Ends.push_back(std::min(Sides[k][0], Sides[k][1]));
+                Edges.Ends.push_back(std::max(Sides[k][0], Sides[k][1]));
+            }
+            Edges.OfTriangle[t * 3 + k] = Edge;
+        }
+    }
+    return Edges;
+}
+
+// Splits every triangle (v0, v1, v2) into four using the edge midpoints
+// m0 = (v0, v1), m1 = (v1, v2), m2 = (v0, v2). Winding is preserved.
+// Works on bare positions; full vertices are only built once at the end.
+// The edges of the result are only built when another level follows.
+void Subdivide(std::vector<XMFLOAT3>& Positions, std::vector<uint32_t>& Indices,
+    std::vector<uint32_t>& Scratch, MeshEdges& Edges, MeshEdges& EdgeScratch, bool KeepEdges)
+{
+    const uint32_t VertexCount = static_cast<uint32_t>(Positions.size());
+    const uint32_t EdgeCount = static_cast<uint32_t>(Edges.Ends.size() / 2);
+    const uint32_t TriangleCount = static_cast<uint32_t>(Indices.size() / 3);
+
+    Positions.resize(size_t(VertexCount) + EdgeCount);
+    for (uint32_t e = 0; e < EdgeCount; ++e)
+    {
+        const XMFLOAT3 p0 = Positions[Edges.Ends[e * 2]];
+        const XMFLOAT3 p1 = Positions[Edges.Ends[e * 2 + 1]];
+        Positions[VertexCount + e] = XMFLOAT3(0.5f * (p0.x + p1.x), 0.5f * (p0.y + p1.y), 0.5f * (p0.z + p1.z));
+    }
+
+    Scratch.resize(size_t(TriangleCount) * 12);
+    uint32_t* Out = Scratch.data();
+    const uint32_t* In = Indices.data();
+    const uint32_t* InEdges = Edges.OfTriangle.data();
+    for (uint32_t t = 0; t < TriangleCount; ++t)
+    {
+        const uint32_t v0 = In[t * 3 + 0];
+        const uint32_t v1 = In[t * 3 + 1];
+        const uint32_t v2 = In[t * 3 + 2];
+
+        const uint32_t m0 = VertexCount + InEdges[t * 3 + 0];
+        const uint32_t m1 = VertexCount + InEdges[t * 3 + 1];
+        const uint32_t m2 = VertexCount + InEdges[t * 3 + 2];
+
+        const uint32_t Quad[12] = {
+            v0, m0, m2,
+            m0, m1, m2,
+            m2, m1, v2,
+            m0, v1, m1
+        };
+        std::copy_n(Quad, 12, Out + size_t(t) * 12);
+    }
+
+    if (KeepEdges)
+    {
+        // Edge e splits into 2e, which keeps its first vertex, and 2e + 1.
+        // The three edges inside triangle t come after all of them.
+        EdgeScratch.Ends.resize((size_t(EdgeCount) * 2 + size_t(TriangleCount) * 3) * 2);
+        EdgeScratch.OfTriangle.resize(size_t(TriangleCount) * 12);
+        uint32_t* Ends = EdgeScratch.Ends.data();
+        for (uint32_t e = 0; e < EdgeCount; ++e)
+        {
+            const uint32_t Mid = VertexCount + e;
+            Ends[e * 4 + 0] = Edges.Ends[e * 2];
+            Ends[e * 4 + 1] = Mid;
+            Ends[e * 4 + 2] = Mid;
+            Ends[e * 4 + 3] = Edges.Ends[e * 2 + 1];
+        }
+        uint32_t* OutEdges = EdgeScratch.OfTriangle.data();
+        for (uint32_t t = 0; t < TriangleCount; ++t)
+        {
+            const uint32_t v0 = In[t * 3 + 0];
+            const uint32_t v1 = In[t * 3 + 1];
+            const uint32_t v2 = In[t * 3 + 2];
+            const uint32_t e0 = InEdges[t * 3 + 0];
+            const uint32_t e1 = InEdges[t * 3 + 1];
+            const uint32_t e2 = InEdges[t * 3 + 2];
+            // The half of edge e that ends at v
+            auto Half = [&](uint32_t e, uint32_t v) { return Edges.Ends[e * 2] == v ? e * 2 : e * 2 + 1; };
+
+            // (m0, m2), (m0, m1) and (m1, m2)
+            const uint32_t Inner = EdgeCount * 2 + t * 3;
+            const uint32_t m0 = VertexCount + e0;
+            const uint32_t m1 = VertexCount + e1;
+            const uint32_t m2 = VertexCount + e2;
+            const uint32_t InnerEnds[6] = { m0, m2, m0, m1, m1, m2 };
+            std::copy_n(InnerEnds, 6, Ends + size_t(Inner) * 2);
+
+            // Same triangle order as Quad above
+            const uint32_t QuadEdges[12] = {
+                Half(e0, v0), Inner, Half(e2, v0),
+                Inner + 1, Inner + 2, Inner,
+                Inner + 2, Half(e1, v2), Half(e2, v2),
+                Half(e0, v1), Half(e1, v1), Inner + 1
+            };
+            std::copy_n(QuadEdges, 12, OutEdges + size_t(t) * 12);
+        }
+        std::swap(Edges, EdgeScratch);
+    }
+
+    Indices.swap(Scratch);
+}
+
+} // namespace
+
+MeshData PrimitivesGenerator::CreateGeosphere(float radius, uint32_t
+    numSubdivisions)
+{
+    MeshData meshData;
+    // Put a cap on the number of subdivisions.
+    numSubdivisions = std::min<uint32_t>(numSubdivisions, MaxGeosphereSubdivisions);
+    // Approximate a sphere by tessellating an icosahedron.
+    const float X = 0.525731f;
+    const float Z = 0.850651f;
+    XMFLOAT3 pos[12] =
+    {
+    XMFLOAT3(-X, 0.0f, Z), XMFLOAT3(X, 0.0f, Z),
+    XMFLOAT3(-X, 0.0f, -Z), XMFLOAT3(X, 0.0f, -Z),
+    XMFLOAT3(0.0f, Z, X), XMFLOAT3(0.0f, Z, -X),
+    XMFLOAT3(0.0f, -Z, X), XMFLOAT3(0.0f, -Z, -X),
+    XMFLOAT3(Z, X, 0.0f), XMFLOAT3(-Z, X, 0.0f),
+    XMFLOAT3(Z, -X, 0.0f), XMFLOAT3(-Z, -X, 0.0f)
+    };
+    uint32_t k[60] =
+    {
+    1,4,0, 4,9,0, 4,5,9, 8,5,4, 1,8,4,
+    1,10,8, 10,3,8, 8,3,5, 3,2,5, 3,7,2,
+    3,10,7, 10,6,7, 6,11,7, 6,0,11, 6,1,0,
+    10,1,6, 11,0,9, 2,11,9, 5,2,9, 11,2,7
+    };
+
+    // Size everything for the finest level up front so subdivision never reallocates
+    const uint32_t FinalVertexCount = GeosphereVertexCount(numSubdivisions);
+    const uint32_t FinalTriangleCount = GeosphereTriangleCount(numSubdivisions);
+    std::vector<XMFLOAT3> Positions;
+    Positions.reserve(FinalVertexCount);
+    Positions.assign(&pos[0], &pos[12]);
+    meshData.Indices32.reserve(FinalTriangleCount * 3);
+    meshData.Indices32.assign(&k[0], &k[60]);
+
+    if (numSubdivisions > 0)
+    {
+        std::vector<uint32_t> Scratch;
+        Scratch.reserve(FinalTriangleCount * 3);
+        MeshEdges Edges = FindEdges(meshData.Indices32.data(), 20);
+        // Sized for the edges of the last input level, F / 4 triangles with
+        // E = 3F / 2 edges of their own
+        MeshEdges EdgeScratch;
+        EdgeScratch.Ends.reserve(FinalTriangleCount * 3 / 4);
+        EdgeScratch.OfTriangle.reserve(FinalTriangleCount * 3 / 4);
+        Edges.Ends.reserve(FinalTriangleCount * 3 / 4);
+        Edges.OfTriangle.reserve(FinalTriangleCount * 3 / 4);
+        for (uint32_t i = 0; i < numSubdivisions; ++i)
+            Subdivide(Positions, meshData.Indices32, Scratch, Edges, EdgeScratch, i + 1 < numSubdivisions);
+    }
+    assert(Positions.size() == FinalVertexCount);
+    meshData.Vertices.resize(FinalVertexCount);
+
+    // Project vertices onto the sphere and derive their UVs and tangents,
+    // four at a time in SoA form. The last batch repeats its last vertex
+    // in the unused lanes and only writes the used ones.
+    const XMVECTOR Radius = XMVectorReplicate(radius);
+    const XMVECTOR Zero = XMVectorZero();
+    const XMVECTOR One = XMVectorSplatOne();
+    const XMVECTOR TwoPi = XMVectorReplicate(XM_2PI);
+    const XMVECTOR InvTwoPi = XMVectorReplicate(1.f / XM_2PI);
+    const XMVECTOR InvPi = XMVectorReplicate(1.f / XM_PI);
+    auto ProjectVertices = [&](uint32_t FirstBatch, uint32_t LastBatch)
+    {
+        for (uint32_t b = FirstBatch; b < LastBatch; ++b)
+        {
+            const uint32_t BatchBegin = b * 4;
+            const uint32_t BatchEnd = std::min(BatchBegin + 4, FinalVertexCount);
+            XMFLOAT4A Px, Py, Pz;
+            for (uint32_t Lane = 0; Lane < 4; ++Lane)
+            {
+                const XMFLOAT3& P = Positions[std::min(BatchBegin + Lane, BatchEnd - 1)];
+                (&Px.x)[Lane] = P.x;
+                (&Py.x)[Lane] = P.y;
+                (&Pz.x)[Lane] = P.z;
+            }
+
+            // Project onto the unit sphere
+            const XMVECTOR X = XMLoadFloat4A(&Px);
+            const XMVECTOR Y = XMLoadFloat4A(&Py);
+            const XMVECTOR Z = XMLoadFloat4A(&Pz);
+            const XMVECTOR Len = XMVectorSqrt(
+                XMVectorAdd(XMVectorAdd(XMVectorMultiply(X, X), XMVectorMultiply(Y, Y)), XMVectorMultiply(Z, Z)));
+            const XMVECTOR InvLen = XMVectorReciprocal(Len);
+            const XMVECTOR Nx = XMVectorMultiply(X, InvLen);
+            const XMVECTOR Ny = XMVectorMultiply(Y, InvLen);
+            const XMVECTOR Nz = XMVectorMultiply(Z, InvLen);
+
+            // Texture coordinates from spherical coordinates, theta put in [0, 2pi]
+            XMVECTOR Theta = XMVectorATan2(Nz, Nx);
+            Theta = XMVectorSelect(Theta, XMVectorAdd(Theta, TwoPi), XMVectorLess(Theta, Zero));
+            const XMVECTOR Phi = XMVectorACos(XMVectorClamp(Ny, XMVectorNegate(One), One));
+
+            // Partial derivative of P with respect to theta, normalized. That is
+            // (-sin(theta), 0, cos(theta)), which is just the normal's xz projection
+            // rotated by 90 degrees, so no trig is needed. Poles use theta = 0.
+            const XMVECTOR LenXZ = XMVectorSqrt(XMVectorAdd(XMVectorMultiply(Nx, Nx), XMVectorMultiply(Nz, Nz)));
+            const XMVECTOR OffPole = XMVectorGreater(LenXZ, Zero);
+            const XMVECTOR InvLenXZ = XMVectorReciprocal(LenXZ);
+            const XMVECTOR Tx = XMVectorSelect(Zero, XMVectorNegate(XMVectorMultiply(Nz, InvLenXZ)), OffPole);
+            const XMVECTOR Tz = XMVectorSelect(One, XMVectorMultiply(Nx, InvLenXZ), OffPole);
+
+            XMFLOAT4A Nxs, Nys, Nzs, Us, Vs, Txs, Tzs;
+            XMStoreFloat4A(&Px, XMVectorMultiply(Radius, Nx));
+            XMStoreFloat4A(&Py, XMVectorMultiply(Radius, Ny));
+            XMStoreFloat4A(&Pz, XMVectorMultiply(Radius, Nz));
+            XMStoreFloat4A(&Nxs, Nx);
+            XMStoreFloat4A(&Nys, Ny);
+            XMStoreFloat4A(&Nzs, Nz);
+            XMStoreFloat4A(&Us, XMVectorMultiply(Theta, InvTwoPi));
+            XMStoreFloat4A(&Vs, XMVectorMultiply(Phi, InvPi));
+            XMStoreFloat4A(&Txs, Tx);
+            XMStoreFloat4A(&Tzs, Tz);
+            for (uint32_t j = BatchBegin; j < BatchEnd; ++j)
+            {
+                const uint32_t Lane = j - BatchBegin;
+                Vertex& V = meshData.Vertices[j];
+                V.Position = XMFLOAT3((&Px.x)[Lane], (&Py.x)[Lane], (&Pz.x)[Lane]);
+                V.Normal = XMFLOAT3((&Nxs.x)[Lane], (&Nys.x)[Lane], (&Nzs.x)[Lane]);
+                V.Tangent = XMFLOAT3((&Txs.x)[Lane], 0.f, (&Tzs.x)[Lane]);
+                V.UV = XMFLOAT2((&Us.x)[Lane], (&Vs.x)[Lane]);
+            }
+        }
+    };
+
+    const uint32_t BatchCount = (FinalVertexCount + 3) / 4;
+    const uint32_t ThreadCount = ThreadCountFor(FinalVertexCount);
+    if (ThreadCount <= 1)
+        ProjectVertices(0, BatchCount);
+    else
+        m_Options.Jobs->ParallelFor(BatchCount, (BatchCount + ThreadCount - 1) / ThreadCount, ProjectVertices);
+
+    meshData.UpdateBounds();
+    return meshData;
+}
+}
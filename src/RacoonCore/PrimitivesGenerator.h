@@ -0,0 +1,79 @@
+#pragma once
+
+#include "CoreStdafx.h"
+#include "JobSystem.h"
+#include "MeshGeometry.h"
+
+namespace Racoon {
+
+enum class GenerationMode
+{
+    // One vertex at a time, trig and normal evaluated per vertex. Reference path.
+    Scalar,
+    // Per-slice values (sin/cos, normal, tangent, u) are computed once and shared
+    // by every ring. Rings are written in SIMD batches of 4 slices, and large
+    // meshes are split into stack ranges run as jobs. Output matches Scalar
+    // bit-for-bit as long as the compiler contracts float math the same way in
+    // both paths; with differing FMA contraction expect at most 1 ulp difference.
+    Bulk
+};
+
+struct GeneratorOptions
+{
+    GenerationMode Mode{ GenerationMode::Bulk };
+    // Runs the split ranges of large meshes; without one everything runs on
+    // the calling thread
+    JobSystem* Jobs{ nullptr };
+    // Cap on the ranges a mesh is split into, 0 uses Jobs->GetThreadCount()
+    uint32_t MaxThreads{ 0 };
+    // Meshes are only split when every range gets at least this many vertices
+    uint32_t MinVerticesPerThread{ 64 * 1024 };
+};
+
+class PrimitivesGenerator
+{
+public:
+    PrimitivesGenerator(const GeneratorOptions& Options = GeneratorOptions()) : m_Options(Options) {}
+
+    MeshData CreateCylinder(float BottomRadius, float TopRadius, float Height,
+        uint32_t SliceCount, uint32_t StackCount);
+
+    MeshData CreateCube();
+
+    // Icosahedron subdivided NumSubdivisions times and projected onto the sphere.
+    // Every level splits each triangle in four; shared edges get one midpoint.
+    MeshData CreateGeosphere(float Radius, uint32_t NumSubdivisions);
+
+    static constexpr uint32_t MaxGeosphereSubdivisions = 10;
+
+    // Closed-form sizes of a geosphere at the given level: V = 10 * 4^n + 2, F = 20 * 4^n
+    static uint32_t GeosphereVertexCount(uint32_t NumSubdivisions);
+    static uint32_t GeosphereTriangleCount(uint32_t NumSubdivisions);
+
+private:
+    // Cos and sin of every slice angle, SoA with four slices per element,
+    // padded so the last batch can be loaded whole
+    struct SliceTable
+    {
+        std::vector<XMFLOAT4A> Cos;
+        std::vector<XMFLOAT4A> Sin;
+    };
+    static SliceTable BuildSliceTable(uint32_t SliceCount);
+
+    void BuildCylinderSideScalar(
+        float BottomRadius, float TopRadius, float Height,
+        uint32_t SliceCount, uint32_t StackCount, MeshData& Mesh);
+    void BuildCylinderSideBulk(
+        float BottomRadius, float TopRadius, float Height,
+        uint32_t SliceCount, uint32_t StackCount, const SliceTable& Slices, MeshData& Mesh);
+    // Rim of Radius at height y around a center vertex
+    static void BuildCylinderCap(
+        float Radius, float y, float Height,
+        uint32_t SliceCount, const SliceTable& Slices, bool Top, MeshData& Mesh);
+
+    uint32_t ThreadCountFor(uint32_t VertexCount) const;
+
+    GeneratorOptions m_Options;
+};
+
+} // namespace Racoon
\ No newline at end of file
@@ -0,0 +1,332 @@
+#include "CoreStdafx.h"
+
+#include "Profiler.h"
+
+#include <ostream>
+
+namespace Racoon {
+
+namespace {
+
+// Tells profilers apart in the thread-local cache, even at a reused address
+std::atomic<uint64_t> g_NextProfilerId{ 1 };
+
+struct CachedBuffer
+{
+    uint64_t ProfilerId{ 0 };
+    void* Buffer{ nullptr };
+};
+thread_local CachedBuffer t_Cached;
+
+constexpr uint32_t NoTotal = ~0u;
+
+uint32_t NextPowerOfTwo(uint32_t Value)
+{
+    uint32_t Result = 1;
+    while (Result < Value)
+        Result <<= 1;
+    return Result;
+}
+
+// Nearest rank on sorted values
+double Percentile(const std::vector<double>& Sorted, double Fraction)
+{
+    const size_t Rank = static_cast<size_t>(std::ceil(Fraction * Sorted.size()));
+    return Sorted[std::min(Sorted.size() - 1, Rank ? Rank - 1 : 0)];
+}
+
+ScopeStats MakeStats(const char* Name, std::vector<double>& Milliseconds, uint64_t Calls)
+{
+    ScopeStats Stats;
+    Stats.Name = Name;
+    Stats.Frames = static_cast<uint32_t>(Milliseconds.size());
+    if (Milliseconds.empty())
+        return Stats;
+
+    std::sort(Milliseconds.begin(), Milliseconds.end());
+    double Sum = 0;
+    for (double Ms : Milliseconds)
+        Sum += Ms;
+    Stats.CallsPerFrame = static_cast<double>(Calls) / Milliseconds.size();
+    Stats.MeanMs = Sum / Milliseconds.size();
+    Stats.P50Ms = Percentile(Milliseconds, 0.50);
+    Stats.P95Ms = Percentile(Milliseconds, 0.95);
+    Stats.P99Ms = Percentile(Milliseconds, 0.99);
+    Stats.MaxMs = Milliseconds.back();
+    return Stats;
+}
+
+void WriteJsonString(std::ostream& Out, const char* Text)
+{
+    Out << '"';
+    for (const char* c = Text; *c; ++c)
+    {
+        if (*c == '"' || *c == '\\')
+            Out << '\\' << *c;
+        else if (static_cast<unsigned char>(*c) < 0x20)
+            Out << ' ';
+        else
+            Out << *c;
+    }
+    Out << '"';
+}
+
+// Trace-event timestamps are microseconds; keep the nanoseconds as decimals
+void WriteMicroseconds(std::ostream& Out, uint64_t Nanoseconds)
+{
+    const uint64_t Fraction = Nanoseconds % 1000;
+    Out << Nanoseconds / 1000 << '.' << Fraction / 100 << (Fraction / 10) % 10 << Fraction % 10;
+}
+
+void WriteCompleteEvent(std::ostream& Out, const char* Name, uint64_t Start, uint64_t End, uint32_t Track)
+{
+    Out << "{\"name\":";
+    WriteJsonString(Out, Name);
+    Out << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << Track << ",\"ts\":";
+    WriteMicroseconds(Out, Start);
+    Out << ",\"dur\":";
+    WriteMicroseconds(Out, End - Start);
+    Out << '}';
+}
+
+} // namespace
+
+Profiler::Profiler(uint32_t HistoryFrames, uint32_t EventsPerThread)
+    : m_Id(g_NextProfilerId.fetch_add(1))
+    , m_EventMask(NextPowerOfTwo(std::max(2u, EventsPerThread)) - 1)
+    , m_Epoch(std::chrono::steady_clock::now())
+    , m_Frames(std::max(1u, HistoryFrames))
+{
+}
+
+Profiler::~Profiler() = default;
+
+Profiler& Profiler::Get()
+{
+    static Profiler Instance;
+    return Instance;
+}
+
+uint64_t Profiler::Now() const
+{
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - m_Epoch).count());
+}
+
+Profiler::ThreadBuffer& Profiler::GetThreadBuffer()
+{
+    if (t_Cached.ProfilerId == m_Id)
+        return *static_cast<ThreadBuffer*>(t_Cached.Buffer);
+    return RegisterThread();
+}
+
+Profiler::ThreadBuffer& Profiler::RegisterThread()
+{
+    std::lock_guard<std::mutex> Lock(m_ThreadsMutex);
+
+    // The thread may have registered before and recorded into another profiler since
+    const std::thread::id Self = std::this_thread::get_id();
+    ThreadBuffer* Found = nullptr;
+    for (auto& Buffer : m_Threads)
+    {
+        if (Buffer->Owner == Self)
+            Found = Buffer.get();
+    }
+    if (!Found)
+    {
+        m_Threads.push_back(std::make_unique<ThreadBuffer>());
+        Found = m_Threads.back().get();
+        Found->Events.reset(new ProfileEvent[m_EventMask + 1]);
+        Found->Owner = Self;
+        Found->Index = static_cast<uint32_t>(m_Threads.size() - 1);
+    }
+
+    t_Cached.ProfilerId = m_Id;
+    t_Cached.Buffer = Found;
+    return *Found;
+}
+
+uint64_t Profiler::BeginScope()
+{
+    ++GetThreadBuffer().Depth;
+    return Now();
+}
+
+void Profiler::EndScope(const char* Name, uint64_t Start)
+{
+    const uint64_t End = Now();
+    ThreadBuffer& Buffer = GetThreadBuffer();
+    --Buffer.Depth;
+
+    const uint64_t Head = Buffer.Head.load(std::memory_order_relaxed);
+    if (Head - Buffer.Tail.load(std::memory_order_acquire) > m_EventMask)
+    {
+        Buffer.Dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    ProfileEvent& Event = Buffer.Events[Head & m_EventMask];
+    Event.Name = Name;
+    Event.Start = Start;
+    Event.End = End;
+    Event.Depth = Buffer.Depth;
+    Event.Thread = Buffer.Index;
+    // Publishes the event to EndFrame
+    Buffer.Head.store(Head + 1, std::memory_order_release);
+}
+
+uint32_t Profiler::GetScopeId(const char* Name)
+{
+    auto Found = m_ScopesByPointer.find(Name);
+    if (Found != m_ScopesByPointer.end())
+        return Found->second;
+
+    auto Inserted = m_ScopesByText.emplace(Name, static_cast<uint32_t>(m_ScopeNames.size()));
+    if (Inserted.second)
+    {
+        m_ScopeNames.push_back(Name);
+        m_TotalSlots.push_back(NoTotal);
+    }
+    m_ScopesByPointer.emplace(Name, Inserted.first->second);
+    return Inserted.first->second;
+}
+
+void Profiler::EndFrame()
+{
+    const uint64_t Now = this->Now();
+    Frame& Current = m_Frames[m_FrameCount % m_Frames.size()];
+    Current.Start = m_FrameStart;
+    Current.End = Now;
+    Current.Events.clear();
+    Current.Totals.clear();
+
+    {
+        std::lock_guard<std::mutex> Lock(m_ThreadsMutex);
+        for (auto& Buffer : m_Threads)
+        {
+            const uint64_t Tail = Buffer->Tail.load(std::memory_order_relaxed);
+            const uint64_t Head = Buffer->Head.load(std::memory_order_acquire);
+            for (uint64_t i = Tail; i < Head; ++i)
+                Current.Events.push_back(Buffer->Events[i & m_EventMask]);
+            // Hands the slots back to the owner
+            Buffer->Tail.store(Head, std::memory_order_release);
+        }
+    }
+
+    // Per-scope sums of the frame, through a slot table indexed by scope id.
+    // Runs of one scope are common, so skip the lookup for a repeated name.
+    const char* LastName = nullptr;
+    uint32_t Scope = 0;
+    for (const ProfileEvent& Event : Current.Events)
+    {
+        if (Event.Name != LastName)
+        {
+            Scope = GetScopeId(Event.Name);
+            LastName = Event.Name;
+        }
+        if (m_TotalSlots[Scope] == NoTotal)
+        {
+            m_TotalSlots[Scope] = static_cast<uint32_t>(Current.Totals.size());
+            Current.Totals.push_back({ Scope, 0, 0 });
+        }
+        ScopeTotal& Total = Current.Totals[m_TotalSlots[Scope]];
+        ++Total.Calls;
+        Total.Nanoseconds += Event.End - Event.Start;
+    }
+    for (const ScopeTotal& Total : Current.Totals)
+        m_TotalSlots[Total.Scope] = NoTotal;
+
+    ++m_FrameCount;
+    m_FrameStart = Now;
+}
+
+uint32_t Profiler::GetFrameCount() const
+{
+    return static_cast<uint32_t>(std::min<uint64_t>(m_FrameCount, m_Frames.size()));
+}
+
+const Profiler::Frame& Profiler::GetFrame(uint32_t FramesAgo) const
+{
+    assert(FramesAgo < GetFrameCount());
+    return m_Frames[(m_FrameCount - 1 - FramesAgo) % m_Frames.size()];
+}
+
+double Profiler::GetFrameMilliseconds(uint32_t FramesAgo) const
+{
+    if (FramesAgo >= GetFrameCount())
+        return 0;
+    const Frame& Past = GetFrame(FramesAgo);
+    return (Past.End - Past.Start) * 1e-6;
+}
+
+ScopeStats Profiler::GetFrameStats() const
+{
+    std::vector<double> Milliseconds;
+    for (uint32_t i = 0; i < GetFrameCount(); ++i)
+        Milliseconds.push_back(GetFrameMilliseconds(i));
+    return MakeStats("Frame", Milliseconds, Milliseconds.size());
+}
+
+void Profiler::GetScopeStats(std::vector<ScopeStats>& Stats) const
+{
+    std::vector<std::vector<double>> Milliseconds(m_ScopeNames.size());
+    std::vector<uint64_t> Calls(m_ScopeNames.size(), 0);
+    for (uint32_t i = 0; i < GetFrameCount(); ++i)
+    {
+        for (const ScopeTotal& Total : GetFrame(i).Totals)
+        {
+            Milliseconds[Total.Scope].push_back(Total.Nanoseconds * 1e-6);
+            Calls[Total.Scope] += Total.Calls;
+        }
+    }
+
+    Stats.clear();
+    for (uint32_t Scope = 0; Scope < m_ScopeNames.size(); ++Scope)
+    {
+        if (!Milliseconds[Scope].empty())
+            Stats.push_back(MakeStats(m_ScopeNames[Scope], Milliseconds[Scope], Calls[Scope]));
+    }
+}
+
+uint64_t Profiler::GetDroppedEventCount() const
+{
+    std::lock_guard<std::mutex> Lock(m_ThreadsMutex);
+    uint64_t Dropped = 0;
+    for (const auto& Buffer : m_Threads)
+        Dropped += Buffer->Dropped.load(std::memory_order_relaxed);
+    return Dropped;
+}
+
+void Profiler::WriteChromeTrace(std::ostream& Out, uint32_t LastFrames) const
+{
+    const uint32_t Frames = std::min(LastFrames, GetFrameCount());
+    uint32_t ThreadCount;
+    {
+        std::lock_guard<std::mutex> Lock(m_ThreadsMutex);
+        ThreadCount = static_cast<uint32_t>(m_Threads.size());
+    }
+
+    // Track 0 holds the frames, thread i is track i + 1
+    Out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n";
+    Out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"Frames\"}}";
+    for (uint32_t Thread = 0; Thread < ThreadCount; ++Thread)
+    {
+        Out << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << Thread + 1
+            << ",\"args\":{\"name\":\"Thread " << Thread << "\"}}";
+    }
+
+    // Oldest first
+    for (uint32_t i = Frames; i-- > 0;)
+    {
+        const Frame& Past = GetFrame(i);
+        Out << ",\n";
+        WriteCompleteEvent(Out, "Frame", Past.Start, Past.End, 0);
+        for (const ProfileEvent& Event : Past.Events)
+        {
+            Out << ",\n";
+            WriteCompleteEvent(Out, Event.Name, Event.Start, Event.End, Event.Thread + 1);
+        }
+    }
+    Out << "\n]}\n";
+}
+
+} // namespace Racoon
@@ -0,0 +1,191 @@
+#pragma once
+
+#include "CoreStdafx.h"
+
+#include <atomic>
+#include <chrono>
+#include <iosfwd>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+// Set by CMake (RACOON_ENABLE_PROFILER). At 0 the scope macro compiles to nothing.
+#ifndef RACOON_PROFILER
+#define RACOON_PROFILER 1
+#endif
+
+#define RACOON_PROFILE_CONCAT_INNER(a, b) a##b
+#define RACOON_PROFILE_CONCAT(a, b) RACOON_PROFILE_CONCAT_INNER(a, b)
+#if RACOON_PROFILER
+// Times the rest of the enclosing block. Name must be a string literal or
+// otherwise outlive the profiler.
+#define RACOON_PROFILE_SCOPE(Name) ::Racoon::ProfileScope RACOON_PROFILE_CONCAT(ProfileScope, __LINE__)(Name)
+#else
+#define RACOON_PROFILE_SCOPE(Name) ((void)0)
+#endif
+
+namespace Racoon {
+
+// One closed scope
+struct ProfileEvent
+{
+    const char* Name;
+    // Nanoseconds since the profiler was created
+    uint64_t Start;
+    uint64_t End;
+    // Scopes open on the same thread around this one
+    uint32_t Depth;
+    // Order in which threads first recorded, the creating thread usually 0
+    uint32_t Thread;
+};
+
+// Distribution of a scope's time per frame over the profiler's history. A
+// scope entered several times in a frame counts once, with the sum.
+struct ScopeStats
+{
+    const char* Name{ nullptr };
+    // Frames of the history the scope ran in
+    uint32_t Frames{ 0 };
+    double CallsPerFrame{ 0 };
+    double MeanMs{ 0 };
+    double P50Ms{ 0 };
+    double P95Ms{ 0 };
+    double P99Ms{ 0 };
+    double MaxMs{ 0 };
+};
+
+// Hierarchical CPU scope timer. Each thread records closed scopes into its
+// own single-producer ring, lock-free; EndFrame, called once per frame by
+// one thread, drains every ring into the frame history. Events land in the
+// frame during which they ended. A full ring drops new events and counts
+// them rather than block.
+//
+// The history keeps the last HistoryFrames frames with all their events,
+// for the per-scope percentiles and the Chrome trace. Percentiles are over
+// per-frame times, so a single spike frame shows in the max and p99
+// instead of vanishing into an average.
+class Profiler
+{
+public:
+    explicit Profiler(uint32_t HistoryFrames = 512, uint32_t EventsPerThread = 16 * 1024);
+    ~Profiler();
+
+    Profiler(const Profiler&) = delete;
+    Profiler& operator=(const Profiler&) = delete;
+
+    // The profiler RACOON_PROFILE_SCOPE records into
+    static Profiler& Get();
+
+    // While disabled scopes cost a flag check
+    bool IsEnabled() const { return m_Enabled.load(std::memory_order_relaxed); }
+    void SetEnabled(bool Enabled) { m_Enabled.store(Enabled, std::memory_order_relaxed); }
+
+    // Nanoseconds since construction
+    uint64_t Now() const;
+
+    // ProfileScope's halves. EndScope must pair with the thread's latest BeginScope.
+    uint64_t BeginScope();
+    void EndScope(const char* Name, uint64_t Start);
+
+    // Closes the current frame. Not thread safe against itself or the queries below.
+    void EndFrame();
+
+    // Frames in the history, at most HistoryFrames
+    uint32_t GetFrameCount() const;
+    // Length of a frame in the history, 0 the one EndFrame just closed
+    double GetFrameMilliseconds(uint32_t FramesAgo = 0) const;
+    // Frame lengths over the history
+    ScopeStats GetFrameStats() const;
+    // Every scope seen in the history, in first-seen order
+    void GetScopeStats(std::vector<ScopeStats>& Stats) const;
+    // Events lost to full rings since construction
+    uint64_t GetDroppedEventCount() const;
+
+    // Trace-event JSON of the last LastFrames frames, for chrome://tracing
+    // or Perfetto. One track per thread plus one with the frames.
+    void WriteChromeTrace(std::ostream& Out, uint32_t LastFrames) const;
+
+private:
+    struct ThreadBuffer
+    {
+        std::unique_ptr<ProfileEvent[]> Events;
+        // Written by the owning thread only
+        alignas(64) std::atomic<uint64_t> Head{ 0 };
+        uint32_t Depth{ 0 };
+        std::atomic<uint64_t> Dropped{ 0 };
+        // Written by EndFrame only
+        alignas(64) std::atomic<uint64_t> Tail{ 0 };
+        std::thread::id Owner;
+        uint32_t Index{ 0 };
+    };
+
+    struct ScopeTotal
+    {
+        uint32_t Scope;
+        uint32_t Calls;
+        uint64_t Nanoseconds;
+    };
+
+    struct Frame
+    {
+        uint64_t Start{ 0 };
+        uint64_t End{ 0 };
+        std::vector<ProfileEvent> Events;
+        std::vector<ScopeTotal> Totals;
+    };
+
+    ThreadBuffer& GetThreadBuffer();
+    ThreadBuffer& RegisterThread();
+    uint32_t GetScopeId(const char* Name);
+    const Frame& GetFrame(uint32_t FramesAgo) const;
+
+    const uint64_t m_Id;
+    const uint32_t m_EventMask;
+    const std::chrono::steady_clock::time_point m_Epoch;
+    std::atomic<bool> m_Enabled{ true };
+
+    // Registration takes the lock once per thread; EndFrame takes it to walk the list
+    mutable std::mutex m_ThreadsMutex;
+    std::vector<std::unique_ptr<ThreadBuffer>> m_Threads;
+
+    // Ring of the last frames, m_FrameCount of them ever closed
+    std::vector<Frame> m_Frames;
+    uint64_t m_FrameCount{ 0 };
+    uint64_t m_FrameStart{ 0 };
+
+    // Scopes are found by name pointer first; literals with equal text in
+    // different translation units still share an id through m_ScopesByText
+    std::unordered_map<const char*, uint32_t> m_ScopesByPointer;
+    std::unordered_map<std::string, uint32_t> m_ScopesByText;
+    std::vector<const char*> m_ScopeNames;
+    // Per scope id, index into the frame's Totals or ~0u
+    std::vector<uint32_t> m_TotalSlots;
+};
+
+// Records the time between construction and destruction. Use RACOON_PROFILE_SCOPE.
+class ProfileScope
+{
+public:
+    explicit ProfileScope(const char* Name, Profiler& Target = Profiler::Get())
+        : m_Target(Target.IsEnabled() ? &Target : nullptr)
+        , m_Name(Name)
+        , m_Start(m_Target ? m_Target->BeginScope() : 0)
+    {
+    }
+    ~ProfileScope()
+    {
+        if (m_Target)
+            m_Target->EndScope(m_Name, m_Start);
+    }
+
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+
+private:
+    Profiler* m_Target;
+    const char* m_Name;
+    uint64_t m_Start;
+};
+
+} // namespace Racoon
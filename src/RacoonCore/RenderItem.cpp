@@ -0,0 +1,73 @@
+#include "CoreStdafx.h"
+
+#include "RenderItem.h"
+
+namespace Racoon {
+
+RenderItem::RenderItem()
+{
+    m_MeshGeometry.reset();
+}
+
+RenderItem::RenderItem(std::shared_ptr<MeshData> Mesh, TransformSystem& Transforms, TransformHandle Transform) :
+    m_Transforms(&Transforms)
+  , m_Transform(Transform)
+  , m_MeshGeometry(Mesh)
+{
+    UpdateWorldBounds();
+}
+
+math::Matrix4 RenderItem::GetObjectToWorldMatrix() const
+{
+    return m_Transforms ? m_Transforms->GetWorldMatrix(m_Transform) : math::Matrix4::identity();
+}
+
+math::Vector3 RenderItem::GetWorldPosition() const
+{
+    if (!m_Transforms)
+        return math::Vector3(0.f, 0.f, 0.f);
+    const XMFLOAT3 Position = m_Transforms->GetWorldPosition(m_Transform);
+    return math::Vector3(Position.x, Position.y, Position.z);
+}
+
+void RenderItem::SetMesh(const std::shared_ptr<MeshData> Mesh)
+{
+    m_MeshGeometry = Mesh;
+    UpdateWorldBounds();
+}
+
+void RenderItem::UpdateWorldBounds()
+{
+    m_WorldBounds = m_MeshGeometry ? TransformBounds(m_MeshGeometry->LocalBounds, GetObjectToWorldMatrix()) : Bounds();
+}
+
+Bounds TransformBounds(const Bounds& Local, const math::Matrix4& ToWorld)
+{
+    const math::Vector4 Rows[4] = { ToWorld.getRow(0), ToWorld.getRow(1), ToWorld.getRow(2), ToWorld.getRow(3) };
+    const float LocalCenter[3] = { Local.Center.x, Local.Center.y, Local.Center.z };
+    const float LocalExtents[3] = { Local.Extents.x, Local.Extents.y, Local.Extents.z };
+
+    // Row vector convention: world = local * M. Each world extent sums the
+    // absolute contributions of the local axes.
+    float Center[3] = { Rows[3].getX(), Rows[3].getY(), Rows[3].getZ() };
+    float Extents[3] = { 0.f, 0.f, 0.f };
+    float MaxScaleSq = 0.f;
+    for (int r = 0; r < 3; ++r)
+    {
+        const float Row[3] = { Rows[r].getX(), Rows[r].getY(), Rows[r].getZ() };
+        for (int c = 0; c < 3; ++c)
+        {
+            Center[c] += LocalCenter[r] * Row[c];
+            Extents[c] += LocalExtents[r] * std::fabs(Row[c]);
+        }
+        MaxScaleSq = std::max(MaxScaleSq, Row[0] * Row[0] + Row[1] * Row[1] + Row[2] * Row[2]);
+    }
+
+    Bounds World;
+    World.Center = XMFLOAT3(Center[0], Center[1], Center[2]);
+    World.Extents = XMFLOAT3(Extents[0], Extents[1], Extents[2]);
+    World.Radius = Local.Radius * std::sqrt(MaxScaleSq);
+    return World;
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "CoreStdafx.h"
+#include "MeshGeometry.h"
+#include "TransformSystem.h"
+#include "VertexPacking.h"
+
+namespace Racoon {
+
+// Subset of D3D_PRIMITIVE_TOPOLOGY the engine uses, kept API-agnostic so the
+// core library does not depend on D3D12.
+enum class PrimitiveTopology : uint8_t
+{
+    TriangleList,
+    TriangleStrip,
+    LineList
+};
+
+// RenderItem::LodChain of items that always draw their mesh as registered
+constexpr uint32_t NoLodChain = ~0u;
+
+enum class RenderPass : uint8_t
+{
+    Opaque,
+    Transparent
+};
+
+class RenderItem
+{
+public:
+    RenderItem();
+    // The item is placed by Transform, which must outlive it
+    RenderItem(std::shared_ptr<MeshData> Mesh, TransformSystem& Transforms, TransformHandle Transform);
+    // Object-to-world matrix as of the last TransformSystem::Update, identity
+    // without a transform. Stored transposed for the shaders' row-vector mul,
+    // with the translation in the last row.
+    math::Matrix4 GetObjectToWorldMatrix() const;
+    inline std::shared_ptr<MeshData> GetMesh() const { return m_MeshGeometry; }
+    TransformHandle GetTransform() const { return m_Transform; }
+    math::Vector3 GetWorldPosition() const;
+
+    void SetMesh(const std::shared_ptr<MeshData> Mesh);
+
+    // The mesh's bounds in world space. Call UpdateWorldBounds after the
+    // transform changed (TransformSystem::HasChanged) or the mesh's
+    // LocalBounds were updated.
+    const Bounds& GetWorldBounds() const { return m_WorldBounds; }
+    void UpdateWorldBounds();
+
+    // Index in the scene of all objects
+    uint64_t Index { 0 };
+    uint64_t IndexCount{ 0 };
+    uint64_t StartIndexLocation{ 0 };
+    uint32_t BaseVertexLocation{ 0 };
+    // Selects the pooled index buffer StartIndexLocation points into
+    IndexFormat IndexWidth{ IndexFormat::Uint32 };
+    PrimitiveTopology PrimitiveType{ PrimitiveTopology::TriangleList };
+    // Index of the renderer's pipeline state the item draws with
+    uint16_t PipelineState{ 0 };
+    RenderPass Pass{ RenderPass::Opaque };
+    // Handle index of the mesh in the MeshRegistry, set when registered
+    uint32_t MeshIndex{ 0 };
+    // Dequantization of the uploaded positions, identity unless packed with
+    // VertexEncoding::PackedQuantized
+    VertexQuantization Quantization;
+    // Index of the renderer's MeshLodChain of the mesh, and the level the
+    // draw arguments point at, kept by SelectLods
+    uint32_t LodChain{ NoLodChain };
+    uint8_t Lod{ 0 };
+
+private:
+    TransformSystem* m_Transforms{ nullptr };
+    TransformHandle m_Transform;
+    std::shared_ptr<MeshData> m_MeshGeometry;
+    Bounds m_WorldBounds;
+};
+
+// Bounds after applying a matrix stored the way RenderItem stores it, with
+// the basis in rows 0-2 and the translation in row 3. The box stays axis
+// aligned and encloses the transformed box; the radius grows with the
+// largest axis scale.
+Bounds TransformBounds(const Bounds& Local, const math::Matrix4& ToWorld);
+}
\ No newline at end of file
@@ -0,0 +1,138 @@
+#include "CoreStdafx.h"
+
+#include "RenderQueue.h"
+
+#include <cstring>
+#include <numeric>
+
+namespace Racoon {
+
+namespace {
+
+constexpr uint32_t SortKeyStateBits = SortKeyPipelineBits + SortKeyMeshBits;
+constexpr uint64_t TransparentPassBit = 1ull << (SortKeyBits - 1);
+
+constexpr uint32_t RadixDigitBits = 11;
+constexpr uint32_t RadixDigitCount = 1u << RadixDigitBits;
+constexpr uint32_t RadixPassCount = (SortKeyBits + RadixDigitBits - 1) / RadixDigitBits;
+
+uint32_t DepthBits(float ViewDepth)
+{
+    // Behind the camera sorts as 0; also folds -0 and NaN into 0
+    if (!(ViewDepth > 0.f))
+        return 0;
+    uint32_t Bits;
+    std::memcpy(&Bits, &ViewDepth, sizeof(Bits));
+    return Bits >> (32 - SortKeyDepthBits);
+}
+
+uint64_t StateBits(uint32_t PipelineState, uint32_t Mesh)
+{
+    assert(PipelineState < (1u << SortKeyPipelineBits));
+    const uint64_t MeshBits = Mesh & ((1u << SortKeyMeshBits) - 1);
+    return (uint64_t(PipelineState) << SortKeyMeshBits) | MeshBits;
+}
+
+} // namespace
+
+uint64_t MakeOpaqueSortKey(uint32_t PipelineState, uint32_t Mesh, float ViewDepth)
+{
+    return (StateBits(PipelineState, Mesh) << SortKeyDepthBits) | DepthBits(ViewDepth);
+}
+
+uint64_t MakeTransparentSortKey(uint32_t PipelineState, uint32_t Mesh, float ViewDepth)
+{
+    const uint64_t FarToNear = ~DepthBits(ViewDepth) & ((1u << SortKeyDepthBits) - 1);
+    return TransparentPassBit | (FarToNear << SortKeyStateBits) | StateBits(PipelineState, Mesh);
+}
+
+void RadixSort(std::vector<SortEntry>& Entries, std::vector<SortEntry>& Scratch)
+{
+    const size_t Count = Entries.size();
+    if (Count < 2)
+        return;
+    Scratch.resize(Count);
+
+    // All histograms in one read of the keys, 32 KiB of stack
+    uint32_t Histograms[RadixPassCount][RadixDigitCount] = {};
+    for (const SortEntry Entry : Entries)
+    {
+        const uint64_t Key = GetSortKey(Entry);
+        for (uint32_t Pass = 0; Pass < RadixPassCount; ++Pass)
+            ++Histograms[Pass][(Key >> (Pass * RadixDigitBits)) & (RadixDigitCount - 1)];
+    }
+
+    SortEntry* Source = Entries.data();
+    SortEntry* Destination = Scratch.data();
+    for (uint32_t Pass = 0; Pass < RadixPassCount; ++Pass)
+    {
+        uint32_t* Histogram = Histograms[Pass];
+        const uint32_t Shift = SortEntryItemBits + Pass * RadixDigitBits;
+
+        // Every key has the same digit, the pass would copy the array as is
+        if (Histogram[(Source[0] >> Shift) & (RadixDigitCount - 1)] == Count)
+            continue;
+
+        uint32_t Offset = 0;
+        for (uint32_t Digit = 0; Digit < RadixDigitCount; ++Digit)
+        {
+            const uint32_t DigitCount = Histogram[Digit];
+            Histogram[Digit] = Offset;
+            Offset += DigitCount;
+        }
+
+        for (size_t i = 0; i < Count; ++i)
+        {
+            const SortEntry Entry = Source[i];
+            Destination[Histogram[(Entry >> Shift) & (RadixDigitCount - 1)]++] = Entry;
+        }
+        std::swap(Source, Destination);
+    }
+
+    if (Source != Entries.data())
+        Entries.swap(Scratch);
+}
+
+void RenderQueue::Build(const std::vector<std::shared_ptr<RenderItem>>& Items, const math::Matrix4& View)
+{
+    m_AllItems.resize(Items.size());
+    std::iota(m_AllItems.begin(), m_AllItems.end(), 0u);
+    Build(Items, m_AllItems, View);
+}
+
+void RenderQueue::Build(const std::vector<std::shared_ptr<RenderItem>>& Items, const std::vector<uint32_t>& Visible,
+    const math::Matrix4& View)
+{
+    // View space z of a world position is the dot with the third row, and
+    // visible objects have negative z
+    const math::Vector4 ViewZ = View.getRow(2);
+
+    m_Entries.resize(Visible.size());
+    for (size_t i = 0; i < Visible.size(); ++i)
+    {
+        const RenderItem& Item = *Items[Visible[i]];
+        const math::Vector3 Position = Item.GetWorldPosition();
+        const float Depth = -(ViewZ.getX() * Position.getX() + ViewZ.getY() * Position.getY() +
+            ViewZ.getZ() * Position.getZ() + ViewZ.getW());
+
+        const uint64_t Key = Item.Pass == RenderPass::Transparent ?
+            MakeTransparentSortKey(Item.PipelineState, Item.MeshIndex, Depth) :
+            MakeOpaqueSortKey(Item.PipelineState, Item.MeshIndex, Depth);
+        m_Entries[i] = MakeSortEntry(Key, Visible[i]);
+    }
+
+    RadixSort(m_Entries, m_Scratch);
+
+    // Opaque keys have the pass bit clear, so they come first
+    m_Opaque.clear();
+    m_Transparent.clear();
+    for (const SortEntry Entry : m_Entries)
+    {
+        if (GetSortKey(Entry) & TransparentPassBit)
+            m_Transparent.push_back(GetSortItem(Entry));
+        else
+            m_Opaque.push_back(GetSortItem(Entry));
+    }
+}
+
+} // namespace Racoon
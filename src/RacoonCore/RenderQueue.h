@@ -0,0 +1,63 @@
+#pragma once
+
+#include "CoreStdafx.h"
+#include "RenderItem.h"
+
+namespace Racoon {
+
+// Key layouts, most significant bits first:
+//   opaque:      pass:1 | pipeline:10 | mesh:16 | depth:16   state first, then front to back
+//   transparent: pass:1 | ~depth:16 | pipeline:10 | mesh:16  back to front, state breaks ties
+// Depth is the upper half of the non-negative view depth's bit pattern, which
+// orders like the float with about 1% relative precision. Mesh indices wrap,
+// which only costs some state grouping past 64k meshes.
+constexpr uint32_t SortKeyPipelineBits = 10;
+constexpr uint32_t SortKeyMeshBits = 16;
+constexpr uint32_t SortKeyDepthBits = 16;
+constexpr uint32_t SortKeyBits = 1 + SortKeyPipelineBits + SortKeyMeshBits + SortKeyDepthBits;
+
+uint64_t MakeOpaqueSortKey(uint32_t PipelineState, uint32_t Mesh, float ViewDepth);
+uint64_t MakeTransparentSortKey(uint32_t PipelineState, uint32_t Mesh, float ViewDepth);
+
+// Key and item index packed in one word, key in the high bits, so the sort
+// moves 8 bytes per item. Limits a queue to 2M items.
+using SortEntry = uint64_t;
+constexpr uint32_t SortEntryItemBits = 64 - SortKeyBits;
+
+inline SortEntry MakeSortEntry(uint64_t Key, uint32_t Item)
+{
+    assert(Item < (1u << SortEntryItemBits));
+    return (Key << SortEntryItemBits) | Item;
+}
+inline uint64_t GetSortKey(SortEntry Entry) { return Entry >> SortEntryItemBits; }
+inline uint32_t GetSortItem(SortEntry Entry) { return static_cast<uint32_t>(Entry & ((1u << SortEntryItemBits) - 1)); }
+
+// LSD radix sort on the key bits, 11 bits per pass. Equal keys keep their
+// order. Passes in which every key has the same digit are skipped. Scratch is
+// resized to Entries.size().
+void RadixSort(std::vector<SortEntry>& Entries, std::vector<SortEntry>& Scratch);
+
+// Orders the visible items of a frame by their sort key and splits them per pass
+class RenderQueue
+{
+public:
+    // View is the camera's view matrix (right-handed, looking down -Z) and
+    // depth is measured from the item's world position.
+    void Build(const std::vector<std::shared_ptr<RenderItem>>& Items, const math::Matrix4& View);
+    // Only queues Items[Visible[i]], for example the output of FrustumCuller::Cull
+    void Build(const std::vector<std::shared_ptr<RenderItem>>& Items, const std::vector<uint32_t>& Visible,
+        const math::Matrix4& View);
+
+    // Indices into the Items given to Build, in draw order
+    const std::vector<uint32_t>& GetOpaque() const { return m_Opaque; }
+    const std::vector<uint32_t>& GetTransparent() const { return m_Transparent; }
+
+private:
+    std::vector<uint32_t> m_AllItems;
+    std::vector<SortEntry> m_Entries;
+    std::vector<SortEntry> m_Scratch;
+    std::vector<uint32_t> m_Opaque;
+    std::vector<uint32_t> m_Transparent;
+};
+
+} // namespace Racoon
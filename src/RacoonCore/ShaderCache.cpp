@@ -0,0 +1,387 @@
+#include "CoreStdafx.h"
+
+#include "ShaderCache.h"
+
+#include "ContentHash.h"
+#include "MappedFile.h"
+#include "Profiler.h"
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <set>
+
+namespace Racoon {
+
+namespace {
+
+// Bump whenever the blob file layout or the key inputs change
+constexpr uint32_t ShaderBlobVersion = 1;
+constexpr char ShaderBlobMagic[4] = { 'R', 'S', 'H', 'B' };
+
+struct ShaderBlobHeader
+{
+    char Magic[4];
+    uint32_t Version;
+    uint64_t Key;
+    uint64_t Size;
+    // Of the bytecode, so a damaged file is recompiled instead of handed to the driver
+    uint64_t DataHash;
+};
+static_assert(sizeof(ShaderBlobHeader) == 32, "the header layout is part of the file format");
+
+std::string NormalizePath(const std::filesystem::path& Path)
+{
+    return Path.lexically_normal().generic_string();
+}
+
+// Names in the #include lines of Text, skipping comments. Strings that
+// happen to contain comment markers are not handled; shaders do not use them.
+std::vector<std::string> FindIncludes(const char* Text, size_t Size)
+{
+    std::vector<std::string> Names;
+    bool InComment = false;
+    size_t Pos = 0;
+    while (Pos < Size)
+    {
+        size_t End = Pos;
+        while (End < Size && Text[End] != '\n')
+            ++End;
+
+        size_t i = Pos;
+        auto SkipComments = [&]() {
+            for (; i < End; ++i)
+            {
+                if (InComment)
+                {
+                    if (Text[i] == '*' && i + 1 < End && Text[i + 1] == '/')
+                    {
+                        InComment = false;
+                        ++i;
+                    }
+                    continue;
+                }
+                if (Text[i] == '/' && i + 1 < End && (Text[i + 1] == '/' || Text[i + 1] == '*'))
+                {
+                    if (Text[i + 1] == '/')
+                    {
+                        i = End;
+                        return;
+                    }
+                    InComment = true;
+                    ++i;
+                    continue;
+                }
+                if (Text[i] != ' ' && Text[i] != '\t' && Text[i] != '\r')
+                    return;
+            }
+        };
+
+        SkipComments();
+        if (i < End && Text[i] == '#')
+        {
+            ++i;
+            while (i < End && (Text[i] == ' ' || Text[i] == '\t'))
+                ++i;
+            if (End - i > 7 && std::memcmp(Text + i, "include", 7) == 0)
+            {
+                i += 7;
+                while (i < End && (Text[i] == ' ' || Text[i] == '\t'))
+                    ++i;
+                if (i < End && (Text[i] == '"' || Text[i] == '<'))
+                {
+                    const char Close = Text[i] == '"' ? '"' : '>';
+                    const size_t First = ++i;
+                    while (i < End && Text[i] != Close)
+                        ++i;
+                    if (i < End)
+                        Names.emplace_back(Text + First, i - First);
+                }
+            }
+        }
+        // The rest of the line only matters for comments it opens or closes
+        for (; i < End; ++i)
+        {
+            if (!InComment && Text[i] == '/' && i + 1 < End && Text[i + 1] == '/')
+                break;
+            if (!InComment && Text[i] == '/' && i + 1 < End && Text[i + 1] == '*')
+            {
+                InComment = true;
+                ++i;
+            }
+            else if (InComment && Text[i] == '*' && i + 1 < End && Text[i + 1] == '/')
+            {
+                InComment = false;
+                ++i;
+            }
+        }
+        Pos = End + 1;
+    }
+    return Names;
+}
+
+} // namespace
+
+ShaderIncludeGraph::Node& ShaderIncludeGraph::GetNode(const std::string& File)
+{
+    // References into an unordered_map survive rehashing, so reading the
+    // includes below cannot invalidate Found
+    Node& Found = m_Files[File];
+    if (Found.Read)
+        return Found;
+    Found.Read = true;
+
+    MappedFile Source;
+    std::string Error;
+    Found.Exists = Source.Open((std::filesystem::path(m_SourceDir) / File).string(), Error);
+    if (!Found.Exists)
+        return Found;
+    const char* Text = reinterpret_cast<const char*>(Source.GetData());
+    Found.ContentHash = HashBytes(Text, Source.GetSize());
+
+    // Like the compiler: next to the including file first, then from the
+    // source directory. A missing include is kept under the first path.
+    const std::filesystem::path Directory = std::filesystem::path(File).parent_path();
+    for (const std::string& Name : FindIncludes(Text, Source.GetSize()))
+    {
+        const std::string Local = NormalizePath(Directory / Name);
+        const std::string Root = NormalizePath(Name);
+        const bool UseRoot = Local != Root && !GetNode(Local).Exists && GetNode(Root).Exists;
+        Found.Includes.push_back(UseRoot ? Root : Local);
+    }
+    return Found;
+}
+
+bool ShaderIncludeGraph::GetTransitiveHash(const std::string& File, uint64_t& Hash, std::string& Error)
+{
+    const std::string Start = NormalizePath(File);
+    if (!GetNode(Start).Exists)
+    {
+        Error = "cannot read " + NormalizePath(std::filesystem::path(m_SourceDir) / Start);
+        return false;
+    }
+
+    // Every reachable file, sorted, so include order and cycles guarded by
+    // #pragma once do not matter
+    std::set<std::string> Reached{ Start };
+    std::vector<std::string> Stack{ Start };
+    while (!Stack.empty())
+    {
+        const std::string Current = std::move(Stack.back());
+        Stack.pop_back();
+        for (const std::string& Include : GetNode(Current).Includes)
+        {
+            if (Reached.insert(Include).second)
+                Stack.push_back(Include);
+        }
+    }
+
+    ContentHasher Hasher;
+    for (const std::string& Reachable : Reached)
+    {
+        const Node& Source = GetNode(Reachable);
+        Hasher.Add(Reachable).AddValue(Source.Exists).AddValue(Source.ContentHash);
+    }
+    Hash = Hasher.Get();
+    return true;
+}
+
+std::vector<std::string> ShaderIncludeGraph::Invalidate(const std::string& File)
+{
+    const std::string Changed = NormalizePath(File);
+    std::vector<std::string> Affected{ Changed };
+    std::set<std::string> Seen{ Changed };
+    // The graph is a few dozen files, so walking it backwards by scanning
+    // every node is cheaper than keeping reverse edges up to date
+    for (size_t i = 0; i < Affected.size(); ++i)
+    {
+        for (const auto& Entry : m_Files)
+        {
+            const auto& Includes = Entry.second.Includes;
+            if (std::find(Includes.begin(), Includes.end(), Affected[i]) != Includes.end() &&
+                Seen.insert(Entry.first).second)
+                Affected.push_back(Entry.first);
+        }
+    }
+
+    auto Found = m_Files.find(Changed);
+    if (Found != m_Files.end())
+        Found->second = Node();
+    return Affected;
+}
+
+ShaderCache::ShaderCache(std::string SourceDir, std::string CacheDir, ShaderCompiler& Compiler, JobSystem* Jobs)
+    : m_CacheDir(std::move(CacheDir)), m_Compiler(Compiler), m_pJobs(Jobs), m_Includes(std::move(SourceDir)),
+      m_CompilerVersion(Compiler.GetVersion())
+{
+    // Without the directory every write fails and every Build compiles,
+    // which is slow but still correct
+    std::error_code Ignored;
+    std::filesystem::create_directories(m_CacheDir, Ignored);
+}
+
+bool ShaderCache::GetKey(const ShaderDesc& Desc, uint64_t& Key, std::string& Error)
+{
+    uint64_t SourceHash;
+    if (!m_Includes.GetTransitiveHash(Desc.File, SourceHash, Error))
+        return false;
+
+    ContentHasher Hasher;
+    Hasher.AddValue(ShaderBlobVersion).Add(m_CompilerVersion);
+    Hasher.Add(NormalizePath(Desc.File)).Add(Desc.EntryPoint).Add(Desc.Profile);
+    for (const auto& Define : Desc.Defines)
+        Hasher.Add(Define.first).Add(Define.second);
+    Key = Hasher.AddValue(SourceHash).Get();
+    return true;
+}
+
+bool ShaderCache::Build(const std::vector<ShaderDesc>& Shaders, std::vector<ShaderBlob>& Blobs, std::string& Error)
+{
+    RACOON_PROFILE_SCOPE("ShaderCache::Build");
+
+    struct Miss
+    {
+        uint64_t Key;
+        const ShaderDesc* Desc;
+        std::vector<uint8_t> Bytecode;
+        std::string Error;
+        bool Compiled{ false };
+    };
+
+    Blobs.assign(Shaders.size(), nullptr);
+    std::vector<uint64_t> Keys(Shaders.size());
+    std::vector<bool> HasKey(Shaders.size(), false);
+    std::vector<Miss> Misses;
+    std::string Failures;
+    for (size_t i = 0; i < Shaders.size(); ++i)
+    {
+        std::string KeyError;
+        if (!GetKey(Shaders[i], Keys[i], KeyError))
+        {
+            Failures += KeyError + "\n";
+            continue;
+        }
+        HasKey[i] = true;
+
+        auto Found = m_Blobs.find(Keys[i]);
+        if (Found != m_Blobs.end())
+        {
+            Blobs[i] = Found->second;
+            ++m_Stats.MemoryHits;
+        }
+        else if (ShaderBlob Stored = ReadBlob(Keys[i]))
+        {
+            m_Blobs.emplace(Keys[i], Stored);
+            Blobs[i] = std::move(Stored);
+            ++m_Stats.DiskHits;
+        }
+        else if (std::none_of(Misses.begin(), Misses.end(), [&](const Miss& M) { return M.Key == Keys[i]; }))
+        {
+            Miss Entry;
+            Entry.Key = Keys[i];
+            Entry.Desc = &Shaders[i];
+            Misses.push_back(std::move(Entry));
+        }
+    }
+
+    // One compile per job: each takes milliseconds, far above the cost of a job
+    auto CompileRange = [this, &Misses](uint32_t First, uint32_t Last) {
+        for (uint32_t i = First; i < Last; ++i)
+        {
+            RACOON_PROFILE_SCOPE("ShaderCache::Compile");
+            Miss& Current = Misses[i];
+            Current.Compiled = m_Compiler.Compile(m_Includes.GetSourceDir(), *Current.Desc, Current.Bytecode,
+                Current.Error);
+            if (Current.Compiled)
+                WriteBlob(Current.Key, Current.Bytecode);
+        }
+    };
+    const uint32_t MissCount = static_cast<uint32_t>(Misses.size());
+    if (m_pJobs && MissCount > 1)
+        m_pJobs->ParallelFor(MissCount, 1, CompileRange);
+    else
+        CompileRange(0, MissCount);
+
+    for (Miss& Compiled : Misses)
+    {
+        if (!Compiled.Compiled)
+        {
+            Failures += Compiled.Desc->File + " (" + Compiled.Desc->EntryPoint + "): " + Compiled.Error + "\n";
+            continue;
+        }
+        m_Blobs.emplace(Compiled.Key, std::make_shared<const std::vector<uint8_t>>(std::move(Compiled.Bytecode)));
+        ++m_Stats.Compiled;
+    }
+    for (size_t i = 0; i < Shaders.size(); ++i)
+    {
+        if (Blobs[i] || !HasKey[i])
+            continue;
+        auto Found = m_Blobs.find(Keys[i]);
+        if (Found != m_Blobs.end())
+            Blobs[i] = Found->second;
+    }
+
+    if (Failures.empty())
+        return true;
+    Error = std::move(Failures);
+    return false;
+}
+
+std::vector<std::string> ShaderCache::OnFileChanged(const std::string& File)
+{
+    return m_Includes.Invalidate(File);
+}
+
+std::string ShaderCache::GetBlobPath(uint64_t Key) const
+{
+    char Name[32];
+    std::snprintf(Name, sizeof(Name), "%016llx.cso", static_cast<unsigned long long>(Key));
+    return (std::filesystem::path(m_CacheDir) / Name).string();
+}
+
+ShaderBlob ShaderCache::ReadBlob(uint64_t Key) const
+{
+    MappedFile File;
+    std::string Error;
+    if (!File.Open(GetBlobPath(Key), Error) || File.GetSize() < sizeof(ShaderBlobHeader))
+        return nullptr;
+
+    ShaderBlobHeader Head;
+    std::memcpy(&Head, File.GetData(), sizeof(Head));
+    const uint8_t* Data = File.GetData() + sizeof(Head);
+    if (std::memcmp(Head.Magic, ShaderBlobMagic, sizeof(Head.Magic)) != 0 || Head.Version != ShaderBlobVersion ||
+        Head.Key != Key || Head.Size != File.GetSize() - sizeof(Head) || HashBytes(Data, Head.Size) != Head.DataHash)
+        return nullptr;
+    return std::make_shared<const std::vector<uint8_t>>(Data, Data + Head.Size);
+}
+
+void ShaderCache::WriteBlob(uint64_t Key, const std::vector<uint8_t>& Bytecode) const
+{
+    ShaderBlobHeader Head;
+    std::memset(&Head, 0, sizeof(Head));
+    std::memcpy(Head.Magic, ShaderBlobMagic, sizeof(Head.Magic));
+    Head.Version = ShaderBlobVersion;
+    Head.Key = Key;
+    Head.Size = Bytecode.size();
+    Head.DataHash = HashBytes(Bytecode.data(), Bytecode.size());
+
+    // Written next to the final name and renamed, so a reader never sees
+    // half a blob. A failed write only costs a compile next time.
+    const std::string Path = GetBlobPath(Key);
+    const std::string TempPath = Path + ".tmp";
+    {
+        std::ofstream Out(TempPath, std::ios::binary | std::ios::trunc);
+        Out.write(reinterpret_cast<const char*>(&Head), sizeof(Head));
+        Out.write(reinterpret_cast<const char*>(Bytecode.data()), static_cast<std::streamsize>(Bytecode.size()));
+        Out.close();
+        if (!Out)
+            return;
+    }
+    std::error_code Failure;
+    std::filesystem::rename(TempPath, Path, Failure);
+    if (Failure)
+        std::filesystem::remove(TempPath, Failure);
+}
+
+} // namespace Racoon
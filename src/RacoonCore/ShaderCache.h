@@ -0,0 +1,144 @@
+#pragma once
+
+#include "CoreStdafx.h"
+#include "JobSystem.h"
+
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Racoon {
+
+// Sorted by name, so the order defines were set in does not change the key
+using ShaderDefines = std::map<std::string, std::string>;
+
+// One entry point of a shader source file
+struct ShaderDesc
+{
+    // Relative to the source directory
+    std::string File;
+    std::string EntryPoint;
+    // Target profile, e.g. "vs_6_0"
+    std::string Profile;
+    ShaderDefines Defines;
+};
+
+// Compiled bytecode, shared between every request with the same key
+using ShaderBlob = std::shared_ptr<const std::vector<uint8_t>>;
+
+// Turns HLSL into bytecode. The engine wraps DXC; RacoonBench uses a stub,
+// so the cache can be exercised where there is no compiler. Compile is
+// called from several threads at once.
+class ShaderCompiler
+{
+public:
+    virtual ~ShaderCompiler() = default;
+
+    // Names the compiler and its version. Part of every key, so changing
+    // the compiler recompiles everything.
+    virtual std::string GetVersion() const = 0;
+
+    // False with Error, which should carry the compiler's diagnostics
+    virtual bool Compile(const std::string& SourceDir, const ShaderDesc& Desc, std::vector<uint8_t>& Bytecode,
+        std::string& Error) = 0;
+};
+
+// Which source files include which, found by scanning for #include lines.
+// Conditional includes count whatever the defines, so a file may be thought
+// to depend on more than it does, never less. Files are read once and kept
+// until invalidated.
+class ShaderIncludeGraph
+{
+public:
+    explicit ShaderIncludeGraph(std::string SourceDir) : m_SourceDir(std::move(SourceDir)) {}
+
+    // Hash of the contents of File and of every file it includes, directly
+    // or not. An include that cannot be found is hashed as missing, so
+    // creating it later changes the hash. False with Error when File itself
+    // cannot be read.
+    bool GetTransitiveHash(const std::string& File, uint64_t& Hash, std::string& Error);
+
+    // Forgets what was read of File, so the next query reads it again.
+    // Returns File and every known file that includes it, directly or not:
+    // the ones whose hashes may now differ.
+    std::vector<std::string> Invalidate(const std::string& File);
+
+    const std::string& GetSourceDir() const { return m_SourceDir; }
+
+private:
+    struct Node
+    {
+        bool Read{ false };
+        bool Exists{ false };
+        uint64_t ContentHash{ 0 };
+        // Relative to the source directory, like the keys of m_Files
+        std::vector<std::string> Includes;
+    };
+
+    Node& GetNode(const std::string& File);
+
+    std::string m_SourceDir;
+    std::unordered_map<std::string, Node> m_Files;
+};
+
+struct ShaderCacheStats
+{
+    // Found in memory, found on disk, compiled
+    uint32_t MemoryHits{ 0 };
+    uint32_t DiskHits{ 0 };
+    uint32_t Compiled{ 0 };
+};
+
+// Content-addressed shader bytecode. A shader's key hashes the compiler
+// version, the file, entry point, profile, defines and the contents of the
+// file and everything it includes; the bytecode is stored on disk under
+// that key. Editing a header therefore changes only the keys of shaders
+// that include it, and everything else keeps being read from disk.
+//
+// Not thread safe: Build runs on one thread and spreads the compiles of
+// its misses over the job system.
+class ShaderCache
+{
+public:
+    // Bytecode files live in CacheDir, which is created if needed. Without
+    // Jobs, misses compile one after another.
+    ShaderCache(std::string SourceDir, std::string CacheDir, ShaderCompiler& Compiler, JobSystem* Jobs = nullptr);
+
+    ShaderCache(const ShaderCache&) = delete;
+    ShaderCache& operator=(const ShaderCache&) = delete;
+
+    // Fills Blobs[i] with the bytecode of Shaders[i]. Every miss is compiled
+    // even when one fails; false with Error listing the failures, whose
+    // blobs are null.
+    bool Build(const std::vector<ShaderDesc>& Shaders, std::vector<ShaderBlob>& Blobs, std::string& Error);
+
+    // Call when File changed on disk. Returns the files whose shaders the
+    // next Build compiles again; shaders of other files stay cache hits.
+    std::vector<std::string> OnFileChanged(const std::string& File);
+
+    // Key of Desc as Build would compute it, false with Error when its
+    // source cannot be read
+    bool GetKey(const ShaderDesc& Desc, uint64_t& Key, std::string& Error);
+
+    const ShaderCacheStats& GetStats() const { return m_Stats; }
+    void ResetStats() { m_Stats = ShaderCacheStats(); }
+
+private:
+    std::string GetBlobPath(uint64_t Key) const;
+    ShaderBlob ReadBlob(uint64_t Key) const;
+    void WriteBlob(uint64_t Key, const std::vector<uint8_t>& Bytecode) const;
+
+    std::string m_CacheDir;
+    ShaderCompiler& m_Compiler;
+    JobSystem* m_pJobs;
+    ShaderIncludeGraph m_Includes;
+    std::string m_CompilerVersion;
+    // Everything built so far, by key. Bytecode is small; a session holds a
+    // few versions of each shader at most.
+    std::unordered_map<uint64_t, ShaderBlob> m_Blobs;
+    ShaderCacheStats m_Stats;
+};
+
+} // namespace Racoon
@@ -0,0 +1,447 @@
+#include "CoreStdafx.h"
+
+#include "Terrain.h"
+
+#include "Profiler.h"
+
+namespace Racoon {
+
+namespace {
+
+constexpr uint32_t NoSlot = ~0u;
+
+uint64_t ChunkKey(int32_t ChunkX, int32_t ChunkZ)
+{
+    return uint64_t(uint32_t(ChunkX)) << 32 | uint32_t(ChunkZ);
+}
+
+XMVECTOR LoadFloats4(const float* Source)
+{
+    return XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(Source));
+}
+
+// Neighbour offsets in TerrainSideBits order
+constexpr int32_t SideX[4] = { -1, 1, 0, 0 };
+constexpr int32_t SideZ[4] = { 0, 0, -1, 1 };
+
+} // namespace
+
+Terrain::Terrain(const TerrainHeightSource& Heights, const TerrainOptions& Options, JobSystem* Jobs)
+    : m_Heights(Heights)
+    , m_Options(Options)
+    , m_Jobs(Jobs)
+{
+    const uint32_t Quads = m_Options.ChunkQuads;
+    assert(Quads >= 4 && Quads <= 128 && (Quads & (Quads - 1)) == 0);
+    assert(m_Options.LodCount >= 1 && m_Options.LodCount <= MaxLods);
+    assert((Quads >> (m_Options.LodCount - 1)) >= 2);
+    assert(m_Options.Encoding != VertexEncoding::PackedQuantized);
+    assert(m_Options.SampleSpacing > 0.f);
+
+    m_ChunkSize = Quads * m_Options.SampleSpacing;
+    m_VerticesPerChunk = (Quads + 1) * (Quads + 1);
+    m_Stride = GetVertexLayout(m_Options.Encoding).Stride;
+
+    // An interval of twice the eviction radius overlaps at most this many
+    // chunks per axis, wherever the eye is
+    const float Reach = m_Options.LoadRadius + m_Options.EvictMargin;
+    const uint32_t ChunksPerAxis = static_cast<uint32_t>(2.f * Reach / m_ChunkSize) + 2;
+    const uint32_t SlotCount = ChunksPerAxis * ChunksPerAxis;
+    m_Chunks.resize(SlotCount);
+    m_VertexData.resize(size_t(SlotCount) * m_VerticesPerChunk * m_Stride);
+    m_FreeSlots.reserve(SlotCount);
+    for (uint32_t Slot = SlotCount; Slot-- > 0;)
+        m_FreeSlots.push_back(Slot);
+    m_SlotOfChunk.reserve(SlotCount);
+    m_Scratch.resize(m_Jobs ? m_Jobs->GetThreadCount() : 1);
+
+    BuildIndices();
+}
+
+void Terrain::BuildIndices()
+{
+    const uint32_t Quads = m_Options.ChunkQuads;
+    const uint32_t Side = Quads + 1;
+    auto Emit = [&](uint32_t Column, uint32_t Row) {
+        m_Indices.push_back(static_cast<uint16_t>(Row * Side + Column));
+    };
+
+    // Triangles wind counter-clockwise in (column, row) order, which is
+    // clockwise seen from above, like the generator's meshes
+    for (uint32_t Lod = 0; Lod < m_Options.LodCount; ++Lod)
+    {
+        const uint32_t Step = 1u << Lod;
+        for (uint32_t Mask = 0; Mask < 16; ++Mask)
+        {
+            TerrainIndexRange& Range = m_Ranges[Lod][Mask];
+            Range.StartIndex = static_cast<uint32_t>(m_Indices.size());
+
+            // Quads clear of every side
+            for (uint32_t Row = Step; Row + 2 * Step <= Quads; Row += Step)
+            {
+                for (uint32_t Column = Step; Column + 2 * Step <= Quads; Column += Step)
+                {
+                    Emit(Column, Row);
+                    Emit(Column + Step, Row);
+                    Emit(Column + Step, Row + Step);
+
+                    Emit(Column, Row);
+                    Emit(Column + Step, Row + Step);
+                    Emit(Column, Row + Step);
+                }
+            }
+
+            // A strip along each side, from the side's vertices to the ring
+            // of inner quads, zipped together by position. A stitched side
+            // uses every other vertex. Strips meet on the diagonals from the
+            // corners, so any combination of stitched sides closes.
+            for (uint32_t Edge = 0; Edge < 4; ++Edge)
+            {
+                const uint32_t OuterStep = (Mask >> Edge & 1) ? 2 * Step : Step;
+                // T runs along the side, D inwards. Each mapping keeps the
+                // winding of the south side's.
+                auto EmitSide = [&](uint32_t T, uint32_t D) {
+                    switch (Edge)
+                    {
+                    case 0: Emit(D, Quads - T); break;
+                    case 1: Emit(Quads - D, T); break;
+                    case 2: Emit(T, D); break;
+                    default: Emit(Quads - T, Quads - D); break;
+                    }
+                };
+
+                uint32_t Outer = 0;
+                uint32_t Inner = Step;
+                const uint32_t InnerEnd = Quads - Step;
+                while (Outer < Quads || Inner < InnerEnd)
+                {
+                    // Advance the line whose next vertex comes first
+                    if (Outer == Quads || (Inner < InnerEnd && Inner + Step < Outer + OuterStep))
+                    {
+                        EmitSide(Outer, 0);
+                        EmitSide(Inner + Step, Step);
+                        EmitSide(Inner, Step);
+                        Inner += Step;
+                    }
+                    else
+                    {
+                        EmitSide(Outer, 0);
+                        EmitSide(Outer + OuterStep, 0);
+                        EmitSide(Inner, Step);
+                        Outer += OuterStep;
+                    }
+                }
+            }
+            Range.IndexCount = static_cast<uint32_t>(m_Indices.size()) - Range.StartIndex;
+        }
+    }
+}
+
+const TerrainIndexRange& Terrain::GetIndexRange(uint32_t Lod, uint32_t StitchMask) const
+{
+    assert(Lod < m_Options.LodCount && StitchMask < 16);
+    return m_Ranges[Lod][StitchMask];
+}
+
+void Terrain::BuildChunk(int32_t ChunkX, int32_t ChunkZ, Vertex* Vertices, float* LodErrors) const
+{
+    std::vector<float> Heights;
+    BuildChunk(ChunkX, ChunkZ, Vertices, LodErrors, Heights);
+}
+
+void Terrain::BuildChunk(int32_t ChunkX, int32_t ChunkZ, Vertex* Vertices, float* LodErrors,
+    std::vector<float>& Heights) const
+{
+    const uint32_t Quads = m_Options.ChunkQuads;
+    const uint32_t Side = Quads + 1;
+    const float Spacing = m_Options.SampleSpacing;
+    const XMVECTOR SpacingV = XMVectorReplicate(Spacing);
+    const XMVECTOR Lanes = XMVectorSet(0.f, 1.f, 2.f, 3.f);
+
+    // Heights with a one sample apron for the central differences. Rows are
+    // padded so the normal pass can load four from any column. Sample
+    // coordinates are whole numbers, exact as floats below 2^24, so every
+    // chunk computes a shared sample from identical inputs.
+    const uint32_t ApronSide = Quads + 3;
+    const uint32_t Pitch = (Quads + 6 + 3) & ~3u;
+    const int64_t FirstX = int64_t(ChunkX) * Quads - 1;
+    const int64_t FirstZ = int64_t(ChunkZ) * Quads - 1;
+    Heights.resize(size_t(Pitch) * ApronSide);
+    for (uint32_t Row = 0; Row < ApronSide; ++Row)
+    {
+        const XMVECTOR Z = XMVectorReplicate(float(FirstZ + Row) * Spacing);
+        float* Out = &Heights[size_t(Row) * Pitch];
+        for (uint32_t Column = 0; Column < Pitch; Column += 4)
+        {
+            const XMVECTOR X =
+                XMVectorMultiply(XMVectorAdd(XMVectorReplicate(float(FirstX + Column)), Lanes), SpacingV);
+            XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(Out + Column), m_Heights.SampleHeights4(X, Z));
+        }
+    }
+
+    // Normal (hl - hr, 2s, hd - hu) and tangent (2s, hr - hl, 0), four
+    // vertices at a time
+    const float TwoSpacing = 2.f * Spacing;
+    const XMVECTOR TwoSpacingSq = XMVectorReplicate(TwoSpacing * TwoSpacing);
+    const XMVECTOR TwoSpacingV = XMVectorReplicate(TwoSpacing);
+    const float InvQuads = 1.f / Quads;
+    for (uint32_t Row = 0; Row < Side; ++Row)
+    {
+        const float* Below = &Heights[size_t(Row) * Pitch + 1];
+        const float* Center = Below + Pitch;
+        const float* Above = Center + Pitch;
+        const float Z = float(FirstZ + 1 + Row) * Spacing;
+        const float V = Row * InvQuads;
+        Vertex* RowVertices = Vertices + size_t(Row) * Side;
+
+        for (uint32_t Column = 0; Column < Side; Column += 4)
+        {
+            const XMVECTOR Height = LoadFloats4(Center + Column);
+            const XMVECTOR Slope = XMVectorSubtract(LoadFloats4(Center + Column + 1), LoadFloats4(Center + Column - 1));
+            const XMVECTOR Nx = XMVectorNegate(Slope);
+            const XMVECTOR Nz = XMVectorSubtract(LoadFloats4(Below + Column), LoadFloats4(Above + Column));
+            const XMVECTOR NormalScale = XMVectorReciprocalSqrt(
+                XMVectorAdd(XMVectorAdd(XMVectorMultiply(Nx, Nx), TwoSpacingSq), XMVectorMultiply(Nz, Nz)));
+            const XMVECTOR TangentScale =
+                XMVectorReciprocalSqrt(XMVectorAdd(TwoSpacingSq, XMVectorMultiply(Slope, Slope)));
+            const XMVECTOR X =
+                XMVectorMultiply(XMVectorAdd(XMVectorReplicate(float(FirstX + 1 + Column)), Lanes), SpacingV);
+
+            XMFLOAT4A Px, Py, NormalX, NormalY, NormalZ, TangentX, TangentY;
+            XMStoreFloat4A(&Px, X);
+            XMStoreFloat4A(&Py, Height);
+            XMStoreFloat4A(&NormalX, XMVectorMultiply(Nx, NormalScale));
+            XMStoreFloat4A(&NormalY, XMVectorMultiply(TwoSpacingV, NormalScale));
+            XMStoreFloat4A(&NormalZ, XMVectorMultiply(Nz, NormalScale));
+            XMStoreFloat4A(&TangentX, XMVectorMultiply(TwoSpacingV, TangentScale));
+            XMStoreFloat4A(&TangentY, XMVectorMultiply(Slope, TangentScale));
+
+            const uint32_t BatchEnd = std::min(Column + 4, Side);
+            for (uint32_t c = Column; c < BatchEnd; ++c)
+            {
+                const uint32_t Lane = c - Column;
+                Vertex& Out = RowVertices[c];
+                Out.Position = XMFLOAT3((&Px.x)[Lane], (&Py.x)[Lane], Z);
+                Out.Normal = XMFLOAT3((&NormalX.x)[Lane], (&NormalY.x)[Lane], (&NormalZ.x)[Lane]);
+                Out.Tangent = XMFLOAT3((&TangentX.x)[Lane], (&TangentY.x)[Lane], 0.f);
+                Out.UV = XMFLOAT2(c * InvQuads, V);
+            }
+        }
+    }
+
+    // How far each level's grid, filled in bilinearly, is off the full one.
+    // The levels triangulate their quads, so this estimates rather than
+    // bounds the error; it is only used to pick levels.
+    auto HeightAt = [&](uint32_t Column, uint32_t Row) { return Heights[size_t(Row + 1) * Pitch + Column + 1]; };
+    LodErrors[0] = 0.f;
+    for (uint32_t Lod = 1; Lod < m_Options.LodCount; ++Lod)
+    {
+        const uint32_t Step = 1u << Lod;
+        const float InvStep = 1.f / Step;
+        float Error = LodErrors[Lod - 1];
+        for (uint32_t Row = 0; Row < Side; ++Row)
+        {
+            const uint32_t Row0 = Row - Row % Step;
+            const uint32_t Row1 = std::min(Row0 + Step, Quads);
+            const float Fv = (Row - Row0) * InvStep;
+            for (uint32_t Column = 0; Column < Side; ++Column)
+            {
+                const uint32_t Column0 = Column - Column % Step;
+                const uint32_t Column1 = std::min(Column0 + Step, Quads);
+                const float Fu = (Column - Column0) * InvStep;
+                const float Bottom = HeightAt(Column0, Row0) + (HeightAt(Column1, Row0) - HeightAt(Column0, Row0)) * Fu;
+                const float Top = HeightAt(Column0, Row1) + (HeightAt(Column1, Row1) - HeightAt(Column0, Row1)) * Fu;
+                const float Filtered = Bottom + (Top - Bottom) * Fv;
+                Error = std::max(Error, std::fabs(HeightAt(Column, Row) - Filtered));
+            }
+        }
+        LodErrors[Lod] = Error;
+    }
+}
+
+void Terrain::BuildIntoSlot(uint32_t Slot, BuildScratch& Scratch)
+{
+    Chunk& Target = m_Chunks[Slot];
+    uint8_t* Out = &m_VertexData[size_t(Slot) * m_VerticesPerChunk * m_Stride];
+    if (m_Options.Encoding == VertexEncoding::Full)
+    {
+        Vertex* Vertices = reinterpret_cast<Vertex*>(Out);
+        BuildChunk(Target.X, Target.Z, Vertices, Target.Errors, Scratch.Heights);
+        Target.WorldBounds = ComputeBounds(Vertices, m_VerticesPerChunk);
+        return;
+    }
+
+    Scratch.Vertices.resize(m_VerticesPerChunk);
+    BuildChunk(Target.X, Target.Z, Scratch.Vertices.data(), Target.Errors, Scratch.Heights);
+    Target.WorldBounds = ComputeBounds(Scratch.Vertices.data(), m_VerticesPerChunk);
+    PackVertices(Scratch.Vertices.data(), m_VerticesPerChunk, m_Options.Encoding, Out);
+}
+
+float Terrain::GetChunkDistance(int32_t ChunkX, int32_t ChunkZ, float EyeX, float EyeZ) const
+{
+    const float MinX = ChunkX * m_ChunkSize;
+    const float MinZ = ChunkZ * m_ChunkSize;
+    const float Dx = std::max(std::max(MinX - EyeX, EyeX - (MinX + m_ChunkSize)), 0.f);
+    const float Dz = std::max(std::max(MinZ - EyeZ, EyeZ - (MinZ + m_ChunkSize)), 0.f);
+    return std::sqrt(Dx * Dx + Dz * Dz);
+}
+
+uint32_t Terrain::FindSlot(int32_t ChunkX, int32_t ChunkZ) const
+{
+    const auto Found = m_SlotOfChunk.find(ChunkKey(ChunkX, ChunkZ));
+    return Found == m_SlotOfChunk.end() ? NoSlot : Found->second;
+}
+
+void Terrain::TakeWrittenSlots(std::vector<uint32_t>& Slots)
+{
+    Slots.clear();
+    Slots.swap(m_WrittenSlots);
+}
+
+void Terrain::Update(const LodSelectionView& View)
+{
+    RACOON_PROFILE_SCOPE("Terrain::Update");
+    // Builds index their scratch by worker
+    assert(!m_Jobs || m_Jobs->GetWorkerIndex() != JobSystem::NotAWorker);
+    m_Stats = TerrainUpdateStats();
+    const float EyeX = View.Eye.x;
+    const float EyeZ = View.Eye.z;
+    const float LoadRadius = m_Options.LoadRadius;
+
+    // Evict first, so this update's builds can take the slots
+    const float EvictRadius = LoadRadius + m_Options.EvictMargin;
+    for (uint32_t Slot = 0; Slot < m_Chunks.size(); ++Slot)
+    {
+        Chunk& Resident = m_Chunks[Slot];
+        if (!Resident.Resident || GetChunkDistance(Resident.X, Resident.Z, EyeX, EyeZ) <= EvictRadius)
+            continue;
+        m_SlotOfChunk.erase(ChunkKey(Resident.X, Resident.Z));
+        Resident.Resident = false;
+        m_FreeSlots.push_back(Slot);
+        ++m_Stats.Evicted;
+    }
+
+    m_Missing.clear();
+    const int32_t MinX = static_cast<int32_t>(std::floor((EyeX - LoadRadius) / m_ChunkSize));
+    const int32_t MaxX = static_cast<int32_t>(std::floor((EyeX + LoadRadius) / m_ChunkSize));
+    const int32_t MinZ = static_cast<int32_t>(std::floor((EyeZ - LoadRadius) / m_ChunkSize));
+    const int32_t MaxZ = static_cast<int32_t>(std::floor((EyeZ + LoadRadius) / m_ChunkSize));
+    for (int32_t ChunkZ = MinZ; ChunkZ <= MaxZ; ++ChunkZ)
+    {
+        for (int32_t ChunkX = MinX; ChunkX <= MaxX; ++ChunkX)
+        {
+            const float Distance = GetChunkDistance(ChunkX, ChunkZ, EyeX, EyeZ);
+            if (Distance <= LoadRadius && FindSlot(ChunkX, ChunkZ) == NoSlot)
+                m_Missing.emplace_back(Distance, ChunkKey(ChunkX, ChunkZ));
+        }
+    }
+
+    const size_t BuildCount =
+        std::min({ m_Missing.size(), size_t(m_Options.MaxBuildsPerUpdate), m_FreeSlots.size() });
+    std::partial_sort(m_Missing.begin(), m_Missing.begin() + BuildCount, m_Missing.end());
+    m_Building.clear();
+    for (size_t i = 0; i < BuildCount; ++i)
+    {
+        const uint32_t Slot = m_FreeSlots.back();
+        m_FreeSlots.pop_back();
+        Chunk& Target = m_Chunks[Slot];
+        Target.X = static_cast<int32_t>(m_Missing[i].second >> 32);
+        Target.Z = static_cast<int32_t>(static_cast<uint32_t>(m_Missing[i].second));
+        // Lets SelectLod pick the fitting level without the coarsening margin
+        Target.Lod = static_cast<uint8_t>(m_Options.LodCount - 1);
+        m_Building.push_back(Slot);
+    }
+
+    // Slots never overlap, so the builds need no synchronization
+    auto BuildRange = [this](uint32_t First, uint32_t Last) {
+        BuildScratch& Scratch = m_Scratch[m_Jobs ? m_Jobs->GetWorkerIndex() : 0];
+        for (uint32_t i = First; i < Last; ++i)
+            BuildIntoSlot(m_Building[i], Scratch);
+    };
+    if (m_Jobs && BuildCount > 1)
+        m_Jobs->ParallelFor(static_cast<uint32_t>(BuildCount), 1, BuildRange);
+    else
+        BuildRange(0, static_cast<uint32_t>(BuildCount));
+
+    for (uint32_t Slot : m_Building)
+    {
+        Chunk& Built = m_Chunks[Slot];
+        Built.Resident = true;
+        m_SlotOfChunk.emplace(ChunkKey(Built.X, Built.Z), Slot);
+        m_WrittenSlots.push_back(Slot);
+    }
+    m_Stats.Built = static_cast<uint32_t>(BuildCount);
+    m_Stats.Pending = static_cast<uint32_t>(m_Missing.size() - BuildCount);
+
+    SelectLods(View);
+}
+
+void Terrain::SelectLods(const LodSelectionView& View)
+{
+    m_Resident.clear();
+    for (uint32_t Slot = 0; Slot < m_Chunks.size(); ++Slot)
+    {
+        Chunk& Resident = m_Chunks[Slot];
+        if (!Resident.Resident)
+            continue;
+        m_Resident.push_back(Slot);
+        for (uint32_t Edge = 0; Edge < 4; ++Edge)
+            Resident.Neighbours[Edge] = FindSlot(Resident.X + SideX[Edge], Resident.Z + SideZ[Edge]);
+
+        // Positions are in world space, so errors need no scaling
+        const Bounds& World = Resident.WorldBounds;
+        const float Dx = World.Center.x - View.Eye.x;
+        const float Dy = World.Center.y - View.Eye.y;
+        const float Dz = World.Center.z - View.Eye.z;
+        const float Distance = std::sqrt(Dx * Dx + Dy * Dy + Dz * Dz) - World.Radius;
+        Resident.Lod = static_cast<uint8_t>(
+            SelectLod(Resident.Errors, m_Options.LodCount, 1.f, Distance, View, Resident.Lod));
+    }
+
+    // A stitched side bridges one level, so neighbours may differ by one at
+    // most. Only ever refining the coarser side settles within LodCount
+    // passes.
+    bool Changed = true;
+    while (Changed)
+    {
+        Changed = false;
+        for (uint32_t Slot : m_Resident)
+        {
+            Chunk& Resident = m_Chunks[Slot];
+            for (uint32_t Neighbour : Resident.Neighbours)
+            {
+                if (Neighbour != NoSlot && Resident.Lod > m_Chunks[Neighbour].Lod + 1)
+                {
+                    Resident.Lod = static_cast<uint8_t>(m_Chunks[Neighbour].Lod + 1);
+                    Changed = true;
+                }
+            }
+        }
+    }
+
+    m_Draws.clear();
+    for (uint32_t Slot : m_Resident)
+    {
+        const Chunk& Resident = m_Chunks[Slot];
+        uint32_t StitchMask = 0;
+        for (uint32_t Edge = 0; Edge < 4; ++Edge)
+        {
+            const uint32_t Neighbour = Resident.Neighbours[Edge];
+            if (Neighbour != NoSlot && m_Chunks[Neighbour].Lod == Resident.Lod + 1)
+                StitchMask |= 1u << Edge;
+        }
+
+        TerrainDraw Draw;
+        Draw.ChunkX = Resident.X;
+        Draw.ChunkZ = Resident.Z;
+        Draw.BaseVertex = Slot * m_VerticesPerChunk;
+        Draw.StartIndex = m_Ranges[Resident.Lod][StitchMask].StartIndex;
+        Draw.IndexCount = m_Ranges[Resident.Lod][StitchMask].IndexCount;
+        Draw.Lod = Resident.Lod;
+        Draw.StitchMask = static_cast<uint8_t>(StitchMask);
+        Draw.WorldBounds = Resident.WorldBounds;
+        m_Draws.push_back(Draw);
+    }
+}
+
+} // namespace Racoon
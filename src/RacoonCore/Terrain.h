@@ -0,0 +1,184 @@
+#pragma once
+
+#include "CoreStdafx.h"
+#include "JobSystem.h"
+#include "MeshGeometry.h"
+#include "MeshLod.h"
+#include "TerrainHeights.h"
+#include "VertexPacking.h"
+
+#include <unordered_map>
+
+namespace Racoon {
+
+// Sides of a chunk, as bits of TerrainDraw::StitchMask
+namespace TerrainSideBits {
+constexpr uint32_t West = 1 << 0;  // -X
+constexpr uint32_t East = 1 << 1;  // +X
+constexpr uint32_t South = 1 << 2; // -Z
+constexpr uint32_t North = 1 << 3; // +Z
+constexpr uint32_t All = West | East | South | North;
+} // namespace TerrainSideBits
+
+struct TerrainOptions
+{
+    // Quads along a chunk side at the finest level. A power of two from 4
+    // to 128, so every level halves evenly and a chunk's vertices fit
+    // 16-bit indices.
+    uint32_t ChunkQuads{ 64 };
+    // World units between height samples
+    float SampleSpacing{ 2.f };
+    // Levels per chunk, each with half the quads per side of the one
+    // before. At most log2(ChunkQuads), so the coarsest keeps two quads.
+    uint32_t LodCount{ 5 };
+    // Chunks whose XZ square comes within this distance of the eye are built
+    float LoadRadius{ 1024.f };
+    // Chunks are evicted this much farther out than they are built, so a
+    // camera moving along the edge of the radius does not rebuild them
+    float EvictMargin{ 128.f };
+    // Builds per Update at most. A camera that jumps fills in its
+    // surroundings over a few frames, nearest chunks first.
+    uint32_t MaxBuildsPerUpdate{ 16 };
+    // Full or Packed. PackedQuantized quantizes each chunk to its own
+    // bounds, which would pull the shared border vertices of two chunks
+    // apart.
+    VertexEncoding Encoding{ VertexEncoding::Packed };
+};
+
+// Where one level's stitching variant lives in GetIndices()
+struct TerrainIndexRange
+{
+    uint32_t StartIndex{ 0 };
+    uint32_t IndexCount{ 0 };
+};
+
+// One resident chunk as the renderer draws it: 16-bit indices from
+// GetIndices() at StartIndex, vertices from GetVertexData() at BaseVertex.
+// Positions are in world space, so there is no transform.
+struct TerrainDraw
+{
+    int32_t ChunkX{ 0 };
+    int32_t ChunkZ{ 0 };
+    uint32_t BaseVertex{ 0 };
+    uint32_t StartIndex{ 0 };
+    uint32_t IndexCount{ 0 };
+    uint8_t Lod{ 0 };
+    // TerrainSideBits of the sides that meet a neighbour one level coarser
+    uint8_t StitchMask{ 0 };
+    Bounds WorldBounds;
+};
+
+struct TerrainUpdateStats
+{
+    uint32_t Built{ 0 };
+    uint32_t Evicted{ 0 };
+    // Chunks within the load radius still waiting for a build
+    uint32_t Pending{ 0 };
+};
+
+// Heightfield terrain in square chunks streamed around the camera, drawn
+// with geomipmapping. Every chunk keeps its full resolution vertex grid;
+// level L draws every 2^L-th vertex of it. Each level has one index buffer
+// shared by all chunks, holding 16 variants: one per combination of sides
+// that meet a coarser neighbour. Those sides skip every other vertex so
+// they match the neighbour's, and neighbouring chunks are kept within one
+// level of each other, so seams never crack.
+//
+// Chunks live in a fixed pool of slots sized by the load radius, so memory
+// stays the same however far the camera travels. Heights are sampled at
+// whole multiples of the sample spacing in world space, with positions
+// computed the same way, so the shared border vertices of two chunks are
+// bit identical, normals included.
+class Terrain
+{
+public:
+    static constexpr uint32_t MaxLods = MeshLodChain::MaxLevels;
+
+    // Heights must outlive the terrain. Chunks are built on Jobs when given.
+    explicit Terrain(const TerrainHeightSource& Heights, const TerrainOptions& Options = TerrainOptions(),
+        JobSystem* Jobs = nullptr);
+
+    // Evicts chunks beyond the load radius and margin, builds the missing
+    // ones nearest to the eye first, then selects the level of every
+    // resident chunk by its projected error like SelectLod and stitches
+    // neighbours. Call from the thread that created the job system.
+    void Update(const LodSelectionView& View);
+
+    const std::vector<TerrainDraw>& GetDraws() const { return m_Draws; }
+    const TerrainUpdateStats& GetLastUpdateStats() const { return m_Stats; }
+    uint32_t GetResidentChunkCount() const { return static_cast<uint32_t>(m_SlotOfChunk.size()); }
+
+    // GetSlotCount() chunks of GetVerticesPerChunk() vertices in the
+    // options' encoding, row by row along +X
+    const std::vector<uint8_t>& GetVertexData() const { return m_VertexData; }
+    VertexEncoding GetEncoding() const { return m_Options.Encoding; }
+    uint32_t GetVertexStride() const { return m_Stride; }
+    uint32_t GetSlotCount() const { return static_cast<uint32_t>(m_Chunks.size()); }
+    uint32_t GetVerticesPerChunk() const { return m_VerticesPerChunk; }
+    // Moves the slots written since the last call to Slots, for uploading
+    // only what changed
+    void TakeWrittenSlots(std::vector<uint32_t>& Slots);
+
+    // Every level's variants, 16 per level, level by level
+    const std::vector<uint16_t>& GetIndices() const { return m_Indices; }
+    const TerrainIndexRange& GetIndexRange(uint32_t Lod, uint32_t StitchMask) const;
+
+    // Vertices of one chunk, (ChunkQuads + 1)^2 of them row by row, and the
+    // largest height error of each level against the full grid, in world
+    // units. Safe to call from several threads.
+    void BuildChunk(int32_t ChunkX, int32_t ChunkZ, Vertex* Vertices, float* LodErrors) const;
+
+private:
+    struct Chunk
+    {
+        int32_t X{ 0 };
+        int32_t Z{ 0 };
+        bool Resident{ false };
+        uint8_t Lod{ 0 };
+        float Errors[MaxLods]{};
+        Bounds WorldBounds;
+        // Slots of the resident neighbours, TerrainSideBits order, refreshed by SelectLods
+        uint32_t Neighbours[4]{};
+    };
+
+    // Per thread, so chunk builds do not allocate once warm
+    struct BuildScratch
+    {
+        std::vector<float> Heights;
+        std::vector<Vertex> Vertices;
+    };
+
+    void BuildIndices();
+    void BuildChunk(int32_t ChunkX, int32_t ChunkZ, Vertex* Vertices, float* LodErrors,
+        std::vector<float>& Heights) const;
+    void BuildIntoSlot(uint32_t Slot, BuildScratch& Scratch);
+    void SelectLods(const LodSelectionView& View);
+    // XZ distance from the eye to the chunk's square, 0 inside
+    float GetChunkDistance(int32_t ChunkX, int32_t ChunkZ, float EyeX, float EyeZ) const;
+    uint32_t FindSlot(int32_t ChunkX, int32_t ChunkZ) const;
+
+    const TerrainHeightSource& m_Heights;
+    TerrainOptions m_Options;
+    JobSystem* m_Jobs;
+    float m_ChunkSize;
+    uint32_t m_VerticesPerChunk;
+    uint32_t m_Stride;
+
+    std::vector<uint16_t> m_Indices;
+    TerrainIndexRange m_Ranges[MaxLods][16];
+
+    std::vector<Chunk> m_Chunks;
+    std::vector<uint8_t> m_VertexData;
+    std::unordered_map<uint64_t, uint32_t> m_SlotOfChunk;
+    std::vector<uint32_t> m_FreeSlots;
+    std::vector<uint32_t> m_WrittenSlots;
+    // Reused by every update, so a steady camera does not allocate
+    std::vector<std::pair<float, uint64_t>> m_Missing;
+    std::vector<uint32_t> m_Building;
+    std::vector<BuildScratch> m_Scratch;
+    std::vector<uint32_t> m_Resident;
+    std::vector<TerrainDraw> m_Draws;
+    TerrainUpdateStats m_Stats;
+};
+
+} // namespace Racoon
@@ -0,0 +1,237 @@
+#include "CoreStdafx.h"
+
+#include "TerrainHeights.h"
+
+#include "MappedFile.h"
+
+#include <cstring>
+
+namespace Racoon {
+
+namespace {
+
+float Fract(float V)
+{
+    return V - std::floor(V);
+}
+
+XMVECTOR Fract4(XMVECTOR V)
+{
+    return XMVectorSubtract(V, XMVectorFloor(V));
+}
+
+// Hash of integral lattice coordinates to [0, 1)
+float HashLattice(float X, float Z)
+{
+    const float Px = Fract(X * 0.1031f);
+    const float Pz = Fract(Z * 0.1031f);
+    const float D = Px * (Pz + 33.33f) + Pz * (Px + 33.33f) + Px * (Px + 33.33f);
+    return Fract((Px + D + (Pz + D)) * (Px + D));
+}
+
+XMVECTOR HashLattice4(XMVECTOR X, XMVECTOR Z)
+{
+    const XMVECTOR Scale = XMVectorReplicate(0.1031f);
+    const XMVECTOR Bias = XMVectorReplicate(33.33f);
+    const XMVECTOR Px = Fract4(XMVectorMultiply(X, Scale));
+    const XMVECTOR Pz = Fract4(XMVectorMultiply(Z, Scale));
+    XMVECTOR D = XMVectorMultiply(Px, XMVectorAdd(Pz, Bias));
+    D = XMVectorAdd(D, XMVectorMultiply(Pz, XMVectorAdd(Px, Bias)));
+    D = XMVectorAdd(D, XMVectorMultiply(Px, XMVectorAdd(Px, Bias)));
+    const XMVECTOR Dx = XMVectorAdd(Px, D);
+    return Fract4(XMVectorMultiply(XMVectorAdd(Dx, XMVectorAdd(Pz, D)), Dx));
+}
+
+float Smooth(float F)
+{
+    return F * F * (3.f - 2.f * F);
+}
+
+XMVECTOR Smooth4(XMVECTOR F)
+{
+    const XMVECTOR Three = XMVectorReplicate(3.f);
+    const XMVECTOR Two = XMVectorReplicate(2.f);
+    return XMVectorMultiply(XMVectorMultiply(F, F), XMVectorSubtract(Three, XMVectorMultiply(Two, F)));
+}
+
+float Lerp(float A, float B, float T)
+{
+    return A + (B - A) * T;
+}
+
+XMVECTOR Lerp4(XMVECTOR A, XMVECTOR B, XMVECTOR T)
+{
+    return XMVectorAdd(A, XMVectorMultiply(XMVectorSubtract(B, A), T));
+}
+
+// Value noise in [0, 1) at lattice coordinates
+float ValueNoise(float X, float Z)
+{
+    const float Xi = std::floor(X);
+    const float Zi = std::floor(Z);
+    const float U = Smooth(X - Xi);
+    const float W = Smooth(Z - Zi);
+    const float Bottom = Lerp(HashLattice(Xi, Zi), HashLattice(Xi + 1.f, Zi), U);
+    const float Top = Lerp(HashLattice(Xi, Zi + 1.f), HashLattice(Xi + 1.f, Zi + 1.f), U);
+    return Lerp(Bottom, Top, W);
+}
+
+XMVECTOR ValueNoise4(XMVECTOR X, XMVECTOR Z)
+{
+    const XMVECTOR One = XMVectorSplatOne();
+    const XMVECTOR Xi = XMVectorFloor(X);
+    const XMVECTOR Zi = XMVectorFloor(Z);
+    const XMVECTOR Xj = XMVectorAdd(Xi, One);
+    const XMVECTOR Zj = XMVectorAdd(Zi, One);
+    const XMVECTOR U = Smooth4(XMVectorSubtract(X, Xi));
+    const XMVECTOR W = Smooth4(XMVectorSubtract(Z, Zi));
+    const XMVECTOR Bottom = Lerp4(HashLattice4(Xi, Zi), HashLattice4(Xj, Zi), U);
+    const XMVECTOR Top = Lerp4(HashLattice4(Xi, Zj), HashLattice4(Xj, Zj), U);
+    return Lerp4(Bottom, Top, W);
+}
+
+} // namespace
+
+HeightfieldSource::HeightfieldSource(float Spacing, XMFLOAT2 Origin)
+    : m_InvSpacing(1.f / Spacing)
+    , m_Origin(Origin)
+{
+    assert(Spacing > 0.f);
+}
+
+void HeightfieldSource::SetHeights(std::vector<float> Heights, uint32_t Width, uint32_t Depth)
+{
+    assert(Width >= 2 && Depth >= 2);
+    assert(Heights.size() == size_t(Width) * Depth);
+    m_Heights = std::move(Heights);
+    m_Width = Width;
+    m_Depth = Depth;
+}
+
+bool HeightfieldSource::LoadR16(const std::string& Path, uint32_t Width, uint32_t Depth, float HeightScale,
+    std::string& Error)
+{
+    if (Width < 2 || Depth < 2)
+    {
+        Error = Path + ": a heightfield needs at least 2 x 2 samples";
+        return false;
+    }
+    MappedFile File;
+    if (!File.Open(Path, Error))
+        return false;
+    const size_t Count = size_t(Width) * Depth;
+    if (File.GetSize() != Count * sizeof(uint16_t))
+    {
+        Error = Path + ": " + std::to_string(File.GetSize()) + " bytes, expected " +
+            std::to_string(Count * sizeof(uint16_t)) + " for " + std::to_string(Width) + " x " +
+            std::to_string(Depth) + " samples";
+        return false;
+    }
+
+    std::vector<float> Heights(Count);
+    const uint8_t* Data = File.GetData();
+    const float Scale = HeightScale / 65535.f;
+    for (size_t i = 0; i < Count; ++i)
+        Heights[i] = float(Data[2 * i] | Data[2 * i + 1] << 8) * Scale;
+    SetHeights(std::move(Heights), Width, Depth);
+    return true;
+}
+
+XMVECTOR HeightfieldSource::SampleHeights4(XMVECTOR X, XMVECTOR Z) const
+{
+    assert(!m_Heights.empty());
+    const XMVECTOR InvSpacing = XMVectorReplicate(m_InvSpacing);
+    const XMVECTOR MaxU = XMVectorReplicate(float(m_Width - 1));
+    const XMVECTOR MaxV = XMVectorReplicate(float(m_Depth - 1));
+    const XMVECTOR U = XMVectorClamp(XMVectorMultiply(XMVectorSubtract(X, XMVectorReplicate(m_Origin.x)), InvSpacing),
+        XMVectorZero(), MaxU);
+    const XMVECTOR V = XMVectorClamp(XMVectorMultiply(XMVectorSubtract(Z, XMVectorReplicate(m_Origin.y)), InvSpacing),
+        XMVectorZero(), MaxV);
+    // The last cell also covers the far edge
+    const XMVECTOR Ui = XMVectorMin(XMVectorFloor(U), XMVectorReplicate(float(m_Width - 2)));
+    const XMVECTOR Vi = XMVectorMin(XMVectorFloor(V), XMVectorReplicate(float(m_Depth - 2)));
+
+    // No gathers in SSE: fetch the corners per lane, filter four at a time
+    XMFLOAT4A Column, Row, H00, H10, H01, H11;
+    XMStoreFloat4A(&Column, Ui);
+    XMStoreFloat4A(&Row, Vi);
+    const float* pColumn = &Column.x;
+    const float* pRow = &Row.x;
+    for (uint32_t Lane = 0; Lane < 4; ++Lane)
+    {
+        const float* Corner = &m_Heights[size_t(pRow[Lane]) * m_Width + size_t(pColumn[Lane])];
+        (&H00.x)[Lane] = Corner[0];
+        (&H10.x)[Lane] = Corner[1];
+        (&H01.x)[Lane] = Corner[m_Width];
+        (&H11.x)[Lane] = Corner[m_Width + 1];
+    }
+
+    const XMVECTOR Fu = XMVectorSubtract(U, Ui);
+    const XMVECTOR Fv = XMVectorSubtract(V, Vi);
+    const XMVECTOR Bottom = Lerp4(XMLoadFloat4A(&H00), XMLoadFloat4A(&H10), Fu);
+    const XMVECTOR Top = Lerp4(XMLoadFloat4A(&H01), XMLoadFloat4A(&H11), Fu);
+    return Lerp4(Bottom, Top, Fv);
+}
+
+float HeightfieldSource::SampleHeight(float X, float Z) const
+{
+    assert(!m_Heights.empty());
+    const float U = std::min(std::max((X - m_Origin.x) * m_InvSpacing, 0.f), float(m_Width - 1));
+    const float V = std::min(std::max((Z - m_Origin.y) * m_InvSpacing, 0.f), float(m_Depth - 1));
+    const float Ui = std::min(std::floor(U), float(m_Width - 2));
+    const float Vi = std::min(std::floor(V), float(m_Depth - 2));
+
+    const float* Corner = &m_Heights[size_t(Vi) * m_Width + size_t(Ui)];
+    const float Bottom = Lerp(Corner[0], Corner[1], U - Ui);
+    const float Top = Lerp(Corner[m_Width], Corner[m_Width + 1], U - Ui);
+    return Lerp(Bottom, Top, V - Vi);
+}
+
+NoiseHeightSource::NoiseHeightSource(const NoiseOptions& Options)
+{
+    assert(Options.Octaves > 0);
+    float Frequency = Options.Frequency;
+    float Weight = 1.f;
+    float WeightSum = 0.f;
+    for (uint32_t i = 0; i < Options.Octaves; ++i)
+    {
+        // Whole numbers, so lattice points stay integral
+        const float OffsetX = float((Options.Seed * 7919u + i * 131u) % 4096u);
+        const float OffsetZ = float((Options.Seed * 104729u + i * 337u) % 4096u);
+        m_Octaves.push_back({ Frequency, Weight, OffsetX, OffsetZ });
+        WeightSum += Weight;
+        Frequency *= Options.Lacunarity;
+        Weight *= Options.Gain;
+    }
+    // Each octave spans [-Amplitude, Amplitude] before weighting
+    for (Octave& O : m_Octaves)
+        O.Amplitude *= 2.f * Options.Amplitude / WeightSum;
+}
+
+XMVECTOR NoiseHeightSource::SampleHeights4(XMVECTOR X, XMVECTOR Z) const
+{
+    const XMVECTOR Half = XMVectorReplicate(0.5f);
+    XMVECTOR Height = XMVectorZero();
+    for (const Octave& O : m_Octaves)
+    {
+        const XMVECTOR Frequency = XMVectorReplicate(O.Frequency);
+        const XMVECTOR Lx = XMVectorAdd(XMVectorMultiply(X, Frequency), XMVectorReplicate(O.OffsetX));
+        const XMVECTOR Lz = XMVectorAdd(XMVectorMultiply(Z, Frequency), XMVectorReplicate(O.OffsetZ));
+        const XMVECTOR Noise = XMVectorSubtract(ValueNoise4(Lx, Lz), Half);
+        Height = XMVectorAdd(Height, XMVectorMultiply(Noise, XMVectorReplicate(O.Amplitude)));
+    }
+    return Height;
+}
+
+float NoiseHeightSource::SampleHeight(float X, float Z) const
+{
+    float Height = 0.f;
+    for (const Octave& O : m_Octaves)
+    {
+        const float Noise = ValueNoise(X * O.Frequency + O.OffsetX, Z * O.Frequency + O.OffsetZ) - 0.5f;
+        Height = Height + Noise * O.Amplitude;
+    }
+    return Height;
+}
+
+} // namespace Racoon
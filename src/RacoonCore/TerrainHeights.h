@@ -0,0 +1,90 @@
+#pragma once
+
+#include "CoreStdafx.h"
+
+#include <string>
+
+namespace Racoon {
+
+// Ground height at world XZ. Terrain chunks are built from several jobs at
+// once, so sampling must not modify the source.
+class TerrainHeightSource
+{
+public:
+    virtual ~TerrainHeightSource() = default;
+
+    // Heights at four points, X and Z in SoA form
+    virtual XMVECTOR SampleHeights4(XMVECTOR X, XMVECTOR Z) const = 0;
+    // One point, with the same operations as a lane of SampleHeights4 so
+    // both return identical heights
+    virtual float SampleHeight(float X, float Z) const = 0;
+};
+
+// Heights on a regular grid, bilinearly filtered. Points outside the grid
+// take the height of the nearest edge.
+class HeightfieldSource : public TerrainHeightSource
+{
+public:
+    // Spacing is the distance between samples in world units, Origin the
+    // world XZ of the first sample
+    explicit HeightfieldSource(float Spacing = 1.f, XMFLOAT2 Origin = XMFLOAT2(0.f, 0.f));
+
+    // Width samples per row along X, Depth rows along Z, both at least 2
+    void SetHeights(std::vector<float> Heights, uint32_t Width, uint32_t Depth);
+    // Reads a raw file of little-endian unorm16 heights, the .r16 format
+    // most terrain tools export, scaled to [0, HeightScale]
+    bool LoadR16(const std::string& Path, uint32_t Width, uint32_t Depth, float HeightScale, std::string& Error);
+
+    uint32_t GetWidth() const { return m_Width; }
+    uint32_t GetDepth() const { return m_Depth; }
+
+    XMVECTOR SampleHeights4(XMVECTOR X, XMVECTOR Z) const override;
+    float SampleHeight(float X, float Z) const override;
+
+private:
+    std::vector<float> m_Heights;
+    uint32_t m_Width{ 0 };
+    uint32_t m_Depth{ 0 };
+    float m_InvSpacing;
+    XMFLOAT2 m_Origin;
+};
+
+struct NoiseOptions
+{
+    uint32_t Seed{ 1 };
+    uint32_t Octaves{ 6 };
+    // Lattice cells per world unit of the first octave
+    float Frequency{ 1.f / 256.f };
+    // Heights stay within [-Amplitude, Amplitude]
+    float Amplitude{ 64.f };
+    // Frequency and amplitude factors from one octave to the next
+    float Lacunarity{ 2.f };
+    float Gain{ 0.5f };
+};
+
+// Fractal value noise: octaves of smoothly interpolated random lattice
+// values, added up. Unbounded, so the world is as large as floats allow.
+// The lattice hash uses float arithmetic only (Hoskins' hash without sine),
+// which vectorizes without integer multiplies and is exact while lattice
+// coordinates stay below 2^24.
+class NoiseHeightSource : public TerrainHeightSource
+{
+public:
+    explicit NoiseHeightSource(const NoiseOptions& Options = NoiseOptions());
+
+    XMVECTOR SampleHeights4(XMVECTOR X, XMVECTOR Z) const override;
+    float SampleHeight(float X, float Z) const override;
+
+private:
+    struct Octave
+    {
+        float Frequency;
+        float Amplitude;
+        // Lattice offsets, so octaves do not line up at the origin
+        float OffsetX;
+        float OffsetZ;
+    };
+    std::vector<Octave> m_Octaves;
+};
+
+} // namespace Racoon
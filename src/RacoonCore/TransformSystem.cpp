@@ -0,0 +1,279 @@
+#include "CoreStdafx.h"
+
+#include "TransformSystem.h"
+
+namespace Racoon {
+
+namespace {
+
+XMMATRIX LocalMatrix(const Trs& Local)
+{
+    return XMMatrixAffineTransformation(XMLoadFloat3(&Local.Scale), XMVectorZero(),
+        XMLoadFloat4(&Local.Rotation), XMLoadFloat3(&Local.Translation));
+}
+
+template<typename T>
+void Gather(std::vector<T>& Array, const std::vector<uint32_t>& Order)
+{
+    std::vector<T> Result(Order.size());
+    for (size_t i = 0; i < Order.size(); ++i)
+        Result[i] = Array[Order[i]];
+    Array.swap(Result);
+}
+
+} // namespace
+
+Trs Trs::FromTranslation(const XMFLOAT3& Translation)
+{
+    Trs Result;
+    Result.Translation = Translation;
+    return Result;
+}
+
+TransformHandle TransformSystem::Create(const Trs& Local, TransformHandle Parent)
+{
+    TransformHandle Handle;
+    if (!m_FreeHandles.empty())
+    {
+        Handle.Index = m_FreeHandles.back();
+        m_FreeHandles.pop_back();
+    }
+    else
+    {
+        Handle.Index = static_cast<uint32_t>(m_HandleToDense.size());
+        m_HandleToDense.push_back(Invalid);
+    }
+
+    const uint32_t ParentIndex = Parent.IsValid() ? Dense(Parent) : Invalid;
+    const uint32_t Index = GetCount();
+    m_HandleToDense[Handle.Index] = Index;
+
+    // Appending keeps parents first, the parent already has a smaller index
+    const XMMATRIX LocalToParent = LocalMatrix(Local);
+    XMMATRIX World = LocalToParent;
+    if (ParentIndex != Invalid)
+        World = XMMatrixMultiply(World, XMLoadFloat4x4A(&m_World[ParentIndex]));
+
+    m_Local.push_back(Local);
+    m_LocalMatrix.emplace_back();
+    XMStoreFloat4x4A(&m_LocalMatrix.back(), LocalToParent);
+    m_World.emplace_back();
+    XMStoreFloat4x4A(&m_World.back(), World);
+    m_Parent.push_back(ParentIndex);
+    m_LocalDirty.push_back(0);
+    // Reported as changed by the next Update, like any other new world matrix
+    m_ChangedIn.push_back(m_UpdateCount + 1);
+    m_DenseToHandle.push_back(Handle.Index);
+    return Handle;
+}
+
+void TransformSystem::Destroy(TransformHandle Transform)
+{
+    if (m_NeedsSort)
+        SortHierarchy();
+
+    // Descendants come after their parents, so one forward pass finds them all
+    const uint32_t First = Dense(Transform);
+    std::vector<uint8_t> Removed(GetCount(), 0);
+    Removed[First] = 1;
+    std::vector<uint32_t> Kept;
+    Kept.reserve(GetCount());
+    for (uint32_t i = 0; i < First; ++i)
+        Kept.push_back(i);
+    for (uint32_t i = First + 1; i < GetCount(); ++i)
+    {
+        if (m_Parent[i] != Invalid && Removed[m_Parent[i]])
+            Removed[i] = 1;
+        else
+            Kept.push_back(i);
+    }
+
+    for (uint32_t i = First; i < GetCount(); ++i)
+    {
+        if (Removed[i])
+        {
+            m_HandleToDense[m_DenseToHandle[i]] = Invalid;
+            m_FreeHandles.push_back(m_DenseToHandle[i]);
+        }
+    }
+    Permute(Kept);
+}
+
+void TransformSystem::SetParent(TransformHandle Transform, TransformHandle Parent)
+{
+    const uint32_t Index = Dense(Transform);
+    const uint32_t ParentIndex = Parent.IsValid() ? Dense(Parent) : Invalid;
+#ifndef NDEBUG
+    for (uint32_t Ancestor = ParentIndex; Ancestor != Invalid; Ancestor = m_Parent[Ancestor])
+        assert(Ancestor != Index && "SetParent would create a cycle");
+#endif
+
+    m_Parent[Index] = ParentIndex;
+    if (ParentIndex != Invalid && ParentIndex > Index)
+        m_NeedsSort = true;
+    MarkDirty(Index);
+}
+
+TransformHandle TransformSystem::GetParent(TransformHandle Transform) const
+{
+    const uint32_t ParentIndex = m_Parent[Dense(Transform)];
+    TransformHandle Parent;
+    if (ParentIndex != Invalid)
+        Parent.Index = m_DenseToHandle[ParentIndex];
+    return Parent;
+}
+
+void TransformSystem::SetLocal(TransformHandle Transform, const Trs& Local)
+{
+    const uint32_t Index = Dense(Transform);
+    m_Local[Index] = Local;
+    MarkDirty(Index);
+}
+
+void TransformSystem::SetLocalTranslation(TransformHandle Transform, const XMFLOAT3& Translation)
+{
+    const uint32_t Index = Dense(Transform);
+    m_Local[Index].Translation = Translation;
+    MarkDirty(Index);
+}
+
+void TransformSystem::SetLocalRotation(TransformHandle Transform, const XMFLOAT4& Rotation)
+{
+    const uint32_t Index = Dense(Transform);
+    m_Local[Index].Rotation = Rotation;
+    MarkDirty(Index);
+}
+
+void TransformSystem::MarkDirty(uint32_t Index)
+{
+    m_LocalDirty[Index] = 1;
+    m_FirstDirty = std::min(m_FirstDirty, Index);
+}
+
+void TransformSystem::Update()
+{
+    if (m_NeedsSort)
+        SortHierarchy();
+
+    ++m_UpdateCount;
+    m_Recomputed = 0;
+    const uint32_t Count = GetCount();
+    if (m_FirstDirty >= Count)
+        return;
+
+    // Local matrices do not depend on each other, so rebuild them in one
+    // tight loop before the dependent pass
+    for (uint32_t i = m_FirstDirty; i < Count; ++i)
+    {
+        if (m_LocalDirty[i])
+            XMStoreFloat4x4A(&m_LocalMatrix[i], LocalMatrix(m_Local[i]));
+    }
+
+    // Parents come first, so a parent changed in this pass is already final
+    // when its children read it
+    for (uint32_t i = m_FirstDirty; i < Count; ++i)
+    {
+        const uint32_t Parent = m_Parent[i];
+        const bool ParentChanged = Parent != Invalid && m_ChangedIn[Parent] == m_UpdateCount;
+        if (!m_LocalDirty[i] && !ParentChanged)
+            continue;
+
+        XMMATRIX World = XMLoadFloat4x4A(&m_LocalMatrix[i]);
+        if (Parent != Invalid)
+            World = XMMatrixMultiply(World, XMLoadFloat4x4A(&m_World[Parent]));
+        XMStoreFloat4x4A(&m_World[i], World);
+
+        m_LocalDirty[i] = 0;
+        m_ChangedIn[i] = m_UpdateCount;
+        ++m_Recomputed;
+    }
+    m_FirstDirty = Invalid;
+}
+
+math::Matrix4 TransformSystem::GetWorldMatrix(TransformHandle Transform) const
+{
+    // math::Matrix4 takes columns; row i of the result is row i of World
+    const XMFLOAT4X4A& World = m_World[Dense(Transform)];
+    return math::Matrix4(
+        math::Vector4(World.m[0][0], World.m[1][0], World.m[2][0], World.m[3][0]),
+        math::Vector4(World.m[0][1], World.m[1][1], World.m[2][1], World.m[3][1]),
+        math::Vector4(World.m[0][2], World.m[1][2], World.m[2][2], World.m[3][2]),
+        math::Vector4(World.m[0][3], World.m[1][3], World.m[2][3], World.m[3][3]));
+}
+
+XMFLOAT3 TransformSystem::GetWorldPosition(TransformHandle Transform) const
+{
+    const XMFLOAT4X4A& World = m_World[Dense(Transform)];
+    return XMFLOAT3(World.m[3][0], World.m[3][1], World.m[3][2]);
+}
+
+void TransformSystem::SortHierarchy()
+{
+    // Children of every transform, grouped by parent with a counting pass
+    const uint32_t Count = GetCount();
+    std::vector<uint32_t> ChildStart(Count + 1, 0);
+    for (uint32_t i = 0; i < Count; ++i)
+    {
+        if (m_Parent[i] != Invalid)
+            ++ChildStart[m_Parent[i] + 1];
+    }
+    for (uint32_t i = 0; i < Count; ++i)
+        ChildStart[i + 1] += ChildStart[i];
+    std::vector<uint32_t> Children(ChildStart[Count]);
+    std::vector<uint32_t> Cursor(ChildStart.begin(), ChildStart.end() - 1);
+    for (uint32_t i = 0; i < Count; ++i)
+    {
+        if (m_Parent[i] != Invalid)
+            Children[Cursor[m_Parent[i]]++] = i;
+    }
+
+    // Depth first from every root, which also keeps each subtree contiguous
+    std::vector<uint32_t> Order;
+    Order.reserve(Count);
+    std::vector<uint32_t> Stack;
+    for (uint32_t Root = 0; Root < Count; ++Root)
+    {
+        if (m_Parent[Root] != Invalid)
+            continue;
+        Stack.push_back(Root);
+        while (!Stack.empty())
+        {
+            const uint32_t Current = Stack.back();
+            Stack.pop_back();
+            Order.push_back(Current);
+            for (uint32_t c = ChildStart[Current + 1]; c > ChildStart[Current]; --c)
+                Stack.push_back(Children[c - 1]);
+        }
+    }
+    assert(Order.size() == Count && "Transform hierarchy has a cycle");
+
+    Permute(Order);
+    m_NeedsSort = false;
+}
+
+void TransformSystem::Permute(const std::vector<uint32_t>& Order)
+{
+    std::vector<uint32_t> NewIndex(GetCount(), Invalid);
+    for (uint32_t i = 0; i < Order.size(); ++i)
+        NewIndex[Order[i]] = i;
+
+    Gather(m_Local, Order);
+    Gather(m_LocalMatrix, Order);
+    Gather(m_World, Order);
+    Gather(m_Parent, Order);
+    Gather(m_LocalDirty, Order);
+    Gather(m_ChangedIn, Order);
+    Gather(m_DenseToHandle, Order);
+
+    m_FirstDirty = Invalid;
+    for (uint32_t i = 0; i < Order.size(); ++i)
+    {
+        if (m_Parent[i] != Invalid)
+            m_Parent[i] = NewIndex[m_Parent[i]];
+        m_HandleToDense[m_DenseToHandle[i]] = i;
+        if (m_LocalDirty[i] && m_FirstDirty == Invalid)
+            m_FirstDirty = i;
+    }
+}
+
+} // namespace Racoon
@@ -0,0 +1,102 @@
+#pragma once
+
+#include "CoreStdafx.h"
+
+namespace Racoon {
+
+// Transform relative to the parent: scale, then rotate, then translate
+struct Trs
+{
+    XMFLOAT3 Translation{ 0.f, 0.f, 0.f };
+    // Unit quaternion
+    XMFLOAT4 Rotation{ 0.f, 0.f, 0.f, 1.f };
+    XMFLOAT3 Scale{ 1.f, 1.f, 1.f };
+
+    static Trs FromTranslation(const XMFLOAT3& Translation);
+};
+
+// Stays valid until the transform is destroyed; ids are reused afterwards
+struct TransformHandle
+{
+    static constexpr uint32_t InvalidIndex = ~0u;
+    uint32_t Index{ InvalidIndex };
+
+    bool IsValid() const { return Index != InvalidIndex; }
+};
+
+// Local and world transforms of a scene in contiguous arrays, ordered so every
+// parent comes before its children. Setters only mark a transform dirty;
+// Update rebuilds the dirty local matrices in one pass, then walks the arrays
+// once multiplying each dirty transform, and every transform under it, by
+// its parent's fresh world matrix. Clean subtrees cost a flag check.
+//
+// World matrices use the row-vector convention RenderItem and the shaders
+// expect: the basis in rows 0-2 and the translation in row 3.
+class TransformSystem
+{
+public:
+    // The world matrix is computed right away from the parent's current one
+    TransformHandle Create(const Trs& Local = Trs(), TransformHandle Parent = TransformHandle());
+    // Destroys the transform and every descendant. Linear in the number of transforms.
+    void Destroy(TransformHandle Transform);
+
+    // Keeps the local transform, so the world transform moves with the new
+    // parent. An invalid Parent makes Transform a root.
+    void SetParent(TransformHandle Transform, TransformHandle Parent);
+    TransformHandle GetParent(TransformHandle Transform) const;
+
+    const Trs& GetLocal(TransformHandle Transform) const { return m_Local[Dense(Transform)]; }
+    void SetLocal(TransformHandle Transform, const Trs& Local);
+    void SetLocalTranslation(TransformHandle Transform, const XMFLOAT3& Translation);
+    void SetLocalRotation(TransformHandle Transform, const XMFLOAT4& Rotation);
+
+    // Brings every world matrix up to date
+    void Update();
+
+    // As of the last Update
+    const XMFLOAT4X4A& GetWorld(TransformHandle Transform) const { return m_World[Dense(Transform)]; }
+    math::Matrix4 GetWorldMatrix(TransformHandle Transform) const;
+    XMFLOAT3 GetWorldPosition(TransformHandle Transform) const;
+    // Whether the last Update changed the world matrix
+    bool HasChanged(TransformHandle Transform) const { return m_ChangedIn[Dense(Transform)] == m_UpdateCount; }
+
+    uint32_t GetCount() const { return static_cast<uint32_t>(m_World.size()); }
+    // World matrices the last Update recomputed
+    uint32_t GetRecomputedCount() const { return m_Recomputed; }
+
+private:
+    // Marks roots in m_Parent and destroyed handles in m_HandleToDense
+    static constexpr uint32_t Invalid = ~0u;
+
+    uint32_t Dense(TransformHandle Transform) const
+    {
+        assert(Transform.Index < m_HandleToDense.size() && m_HandleToDense[Transform.Index] != Invalid);
+        return m_HandleToDense[Transform.Index];
+    }
+    void MarkDirty(uint32_t Index);
+    // Restores parent-before-child order after SetParent broke it
+    void SortHierarchy();
+    // Moves the arrays so that element i comes from Order[i]
+    void Permute(const std::vector<uint32_t>& Order);
+
+    // Dense arrays, all indexed alike. Parents hold dense indices too.
+    std::vector<Trs> m_Local;
+    std::vector<XMFLOAT4X4A> m_LocalMatrix;
+    std::vector<XMFLOAT4X4A> m_World;
+    std::vector<uint32_t> m_Parent;
+    std::vector<uint8_t> m_LocalDirty;
+    // m_UpdateCount of the Update that last changed the world matrix
+    std::vector<uint32_t> m_ChangedIn;
+    std::vector<uint32_t> m_DenseToHandle;
+
+    std::vector<uint32_t> m_HandleToDense;
+    std::vector<uint32_t> m_FreeHandles;
+
+    // Nothing before this index is dirty
+    uint32_t m_FirstDirty{ Invalid };
+    bool m_NeedsSort{ false };
+    uint32_t m_UpdateCount{ 1 };
+    uint32_t m_Recomputed{ 0 };
+};
+
+} // namespace Racoon
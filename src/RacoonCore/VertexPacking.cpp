@@ -0,0 +1,341 @@
+#include "VertexPacking.h"
+
+#include <DirectXPackedVector.h>
+
+#include <cfloat>
+#include <cstddef>
+#include <cstring>
+
+namespace Racoon {
+
+VertexLayout GetVertexLayout(VertexEncoding Encoding)
+{
+    VertexLayout Layout;
+    switch (Encoding)
+    {
+    case VertexEncoding::Full:
+        Layout.Attributes = {
+            { "POSITION", VertexFormat::Float3, offsetof(Vertex, Position) },
+            { "NORMAL", VertexFormat::Float3, offsetof(Vertex, Normal) },
+            { "TANGENT", VertexFormat::Float3, offsetof(Vertex, Tangent) },
+            { "UV", VertexFormat::Float2, offsetof(Vertex, UV) }
+        };
+        Layout.Stride = sizeof(Vertex);
+        break;
+    case VertexEncoding::Packed:
+        Layout.Attributes = {
+            { "POSITION", VertexFormat::Float3, offsetof(PackedVertex, Position) },
+            { "TANGENTFRAME", VertexFormat::Snorm16x4, offsetof(PackedVertex, TangentFrame) },
+            { "UV", VertexFormat::Half2, offsetof(PackedVertex, UV) }
+        };
+        Layout.Stride = sizeof(PackedVertex);
+        break;
+    case VertexEncoding::PackedQuantized:
+        Layout.Attributes = {
+            { "POSITION", VertexFormat::Unorm16x4, offsetof(PackedQuantizedVertex, Position) },
+            { "TANGENTFRAME", VertexFormat::Snorm16x4, offsetof(PackedQuantizedVertex, TangentFrame) },
+            { "UV", VertexFormat::Half2, offsetof(PackedQuantizedVertex, UV) }
+        };
+        Layout.Stride = sizeof(PackedQuantizedVertex);
+        break;
+    }
+    return Layout;
+}
+
+namespace {
+
+constexpr float Snorm16Max = 32767.f;
+constexpr float Unorm16Max = 65535.f;
+
+// Octahedral mapping of four unit vectors given in SoA form. Results are in [-1, 1].
+void OctEncode4(XMVECTOR x, XMVECTOR y, XMVECTOR z, XMVECTOR& u, XMVECTOR& v)
+{
+    const XMVECTOR Zero = XMVectorZero();
+    const XMVECTOR One = XMVectorSplatOne();
+
+    XMVECTOR L1 = XMVectorAdd(XMVectorAdd(XMVectorAbs(x), XMVectorAbs(y)), XMVectorAbs(z));
+    L1 = XMVectorMax(L1, XMVectorReplicate(1e-20f));
+    const XMVECTOR InvL1 = XMVectorReciprocal(L1);
+    const XMVECTOR px = XMVectorMultiply(x, InvL1);
+    const XMVECTOR py = XMVectorMultiply(y, InvL1);
+
+    // The lower hemisphere is folded over the diagonals
+    const XMVECTOR SignX = XMVectorSelect(One, XMVectorNegate(One), XMVectorLess(px, Zero));
+    const XMVECTOR SignY = XMVectorSelect(One, XMVectorNegate(One), XMVectorLess(py, Zero));
+    const XMVECTOR FoldedX = XMVectorMultiply(XMVectorSubtract(One, XMVectorAbs(py)), SignX);
+    const XMVECTOR FoldedY = XMVectorMultiply(XMVectorSubtract(One, XMVectorAbs(px)), SignY);
+
+    const XMVECTOR Lower = XMVectorLess(z, Zero);
+    u = XMVectorSelect(px, FoldedX, Lower);
+    v = XMVectorSelect(py, FoldedY, Lower);
+}
+
+void OctDecode4(XMVECTOR u, XMVECTOR v, XMVECTOR& x, XMVECTOR& y, XMVECTOR& z)
+{
+    const XMVECTOR Zero = XMVectorZero();
+
+    z = XMVectorSubtract(XMVectorSubtract(XMVectorSplatOne(), XMVectorAbs(u)), XMVectorAbs(v));
+    const XMVECTOR t = XMVectorMax(XMVectorNegate(z), Zero);
+    x = XMVectorAdd(u, XMVectorSelect(XMVectorNegate(t), t, XMVectorLess(u, Zero)));
+    y = XMVectorAdd(v, XMVectorSelect(XMVectorNegate(t), t, XMVectorLess(v, Zero)));
+
+    const XMVECTOR LengthSq = XMVectorAdd(XMVectorAdd(XMVectorMultiply(x, x), XMVectorMultiply(y, y)), XMVectorMultiply(z, z));
+    const XMVECTOR InvLength = XMVectorReciprocalSqrt(LengthSq);
+    x = XMVectorMultiply(x, InvLength);
+    y = XMVectorMultiply(y, InvLength);
+    z = XMVectorMultiply(z, InvLength);
+}
+
+// The tangent's v coordinate is remapped to [1/32767, 1] and multiplied by the
+// handedness, so the sign survives quantization at the cost of one bit.
+XMVECTOR FoldTangentSign(XMVECTOR v, XMVECTOR Sign)
+{
+    const XMVECTOR Half = XMVectorReplicate(0.5f);
+    XMVECTOR Folded = XMVectorMultiplyAdd(v, Half, Half);
+    Folded = XMVectorMax(Folded, XMVectorReplicate(1.f / Snorm16Max));
+    return XMVectorMultiply(Folded, Sign);
+}
+
+XMVECTOR UnfoldTangentSign(XMVECTOR w, XMVECTOR& Sign)
+{
+    const XMVECTOR One = XMVectorSplatOne();
+    Sign = XMVectorSelect(One, XMVectorNegate(One), XMVectorLess(w, XMVectorZero()));
+    return XMVectorSubtract(XMVectorScale(XMVectorAbs(w), 2.f), One);
+}
+
+// Rounds four floats in [-1, 1] to snorm16 and writes them Stride bytes apart
+void StoreSnorm16x4(XMVECTOR Value, int16_t* Out, size_t Stride, size_t Count)
+{
+    Value = XMVectorRound(XMVectorScale(XMVectorClamp(Value, XMVectorNegate(XMVectorSplatOne()), XMVectorSplatOne()), Snorm16Max));
+    alignas(16) uint32_t Lanes[4];
+    XMStoreInt4(Lanes, XMConvertVectorFloatToInt(Value, 0));
+    for (size_t i = 0; i < Count; ++i)
+        *reinterpret_cast<int16_t*>(reinterpret_cast<uint8_t*>(Out) + i * Stride) = static_cast<int16_t>(Lanes[i]);
+}
+
+XMVECTOR LoadSnorm16x4(const int16_t* In, size_t Stride, size_t Count)
+{
+    float Lanes[4] = { 0.f, 0.f, 0.f, 0.f };
+    for (size_t i = 0; i < Count; ++i)
+        Lanes[i] = *reinterpret_cast<const int16_t*>(reinterpret_cast<const uint8_t*>(In) + i * Stride);
+    const XMVECTOR Value = XMVectorScale(XMVectorSet(Lanes[0], Lanes[1], Lanes[2], Lanes[3]), 1.f / Snorm16Max);
+    // -32768 decodes slightly below -1
+    return XMVectorMax(Value, XMVectorNegate(XMVectorSplatOne()));
+}
+
+template<typename TPacked>
+void EncodeTangentFrames(const Vertex* In, size_t Count, TPacked* Out)
+{
+    const XMVECTOR Handedness = XMVectorSplatOne();
+
+    for (size_t Base = 0; Base < Count; Base += 4)
+    {
+        const size_t BatchCount = std::min<size_t>(4, Count - Base);
+        // Pad the tail batch by repeating its last vertex
+        const Vertex* V[4];
+        for (size_t i = 0; i < 4; ++i)
+            V[i] = &In[Base + std::min(i, BatchCount - 1)];
+
+        XMVECTOR nu, nv, tu, tv;
+        OctEncode4(
+            XMVectorSet(V[0]->Normal.x, V[1]->Normal.x, V[2]->Normal.x, V[3]->Normal.x),
+            XMVectorSet(V[0]->Normal.y, V[1]->Normal.y, V[2]->Normal.y, V[3]->Normal.y),
+            XMVectorSet(V[0]->Normal.z, V[1]->Normal.z, V[2]->Normal.z, V[3]->Normal.z),
+            nu, nv);
+        OctEncode4(
+            XMVectorSet(V[0]->Tangent.x, V[1]->Tangent.x, V[2]->Tangent.x, V[3]->Tangent.x),
+            XMVectorSet(V[0]->Tangent.y, V[1]->Tangent.y, V[2]->Tangent.y, V[3]->Tangent.y),
+            XMVectorSet(V[0]->Tangent.z, V[1]->Tangent.z, V[2]->Tangent.z, V[3]->Tangent.z),
+            tu, tv);
+        tv = FoldTangentSign(tv, Handedness);
+
+        TPacked* Batch = Out + Base;
+        StoreSnorm16x4(nu, &Batch->TangentFrame[0], sizeof(TPacked), BatchCount);
+        StoreSnorm16x4(nv, &Batch->TangentFrame[1], sizeof(TPacked), BatchCount);
+        StoreSnorm16x4(tu, &Batch->TangentFrame[2], sizeof(TPacked), BatchCount);
+        StoreSnorm16x4(tv, &Batch->TangentFrame[3], sizeof(TPacked), BatchCount);
+    }
+}
+
+template<typename TPacked>
+void DecodeTangentFrames(const TPacked* In, size_t Count, Vertex* Out)
+{
+    for (size_t Base = 0; Base < Count; Base += 4)
+    {
+        const size_t BatchCount = std::min<size_t>(4, Count - Base);
+        const TPacked* Batch = In + Base;
+
+        XMVECTOR nx, ny, nz, tx, ty, tz, Sign;
+        OctDecode4(
+            LoadSnorm16x4(&Batch->TangentFrame[0], sizeof(TPacked), BatchCount),
+            LoadSnorm16x4(&Batch->TangentFrame[1], sizeof(TPacked), BatchCount),
+            nx, ny, nz);
+        const XMVECTOR tv = UnfoldTangentSign(LoadSnorm16x4(&Batch->TangentFrame[3], sizeof(TPacked), BatchCount), Sign);
+        OctDecode4(
+            LoadSnorm16x4(&Batch->TangentFrame[2], sizeof(TPacked), BatchCount),
+            tv, tx, ty, tz);
+
+        alignas(16) XMFLOAT4A Lanes[6];
+        XMStoreFloat4A(&Lanes[0], nx);
+        XMStoreFloat4A(&Lanes[1], ny);
+        XMStoreFloat4A(&Lanes[2], nz);
+        XMStoreFloat4A(&Lanes[3], tx);
+        XMStoreFloat4A(&Lanes[4], ty);
+        XMStoreFloat4A(&Lanes[5], tz);
+        for (size_t i = 0; i < BatchCount; ++i)
+        {
+            Vertex& V = Out[Base + i];
+            V.Normal = XMFLOAT3((&Lanes[0].x)[i], (&Lanes[1].x)[i], (&Lanes[2].x)[i]);
+            V.Tangent = XMFLOAT3((&Lanes[3].x)[i], (&Lanes[4].x)[i], (&Lanes[5].x)[i]);
+        }
+    }
+}
+
+template<typename TPacked>
+void EncodeUVs(const Vertex* In, size_t Count, TPacked* Out)
+{
+    using namespace DirectX::PackedVector;
+    XMConvertFloatToHalfStream(&Out->UV[0], sizeof(TPacked), &In->UV.x, sizeof(Vertex), Count);
+    XMConvertFloatToHalfStream(&Out->UV[1], sizeof(TPacked), &In->UV.y, sizeof(Vertex), Count);
+}
+
+template<typename TPacked>
+void DecodeUVs(const TPacked* In, size_t Count, Vertex* Out)
+{
+    using namespace DirectX::PackedVector;
+    XMConvertHalfToFloatStream(&Out->UV.x, sizeof(Vertex), &In->UV[0], sizeof(TPacked), Count);
+    XMConvertHalfToFloatStream(&Out->UV.y, sizeof(Vertex), &In->UV[1], sizeof(TPacked), Count);
+}
+
+VertexQuantization ComputeQuantization(const Vertex* Vertices, size_t Count)
+{
+    XMVECTOR Min = XMVectorReplicate(FLT_MAX);
+    XMVECTOR Max = XMVectorReplicate(-FLT_MAX);
+    for (size_t i = 0; i < Count; ++i)
+    {
+        const XMVECTOR P = XMLoadFloat3(&Vertices[i].Position);
+        Min = XMVectorMin(Min, P);
+        Max = XMVectorMax(Max, P);
+    }
+    if (Count == 0)
+        Min = Max = XMVectorZero();
+
+    VertexQuantization Quantization;
+    XMStoreFloat3(&Quantization.Offset, Min);
+    XMStoreFloat3(&Quantization.Scale, XMVectorSubtract(Max, Min));
+    return Quantization;
+}
+
+void EncodeQuantizedPositions(const Vertex* In, size_t Count, const VertexQuantization& Quantization,
+    PackedQuantizedVertex* Out)
+{
+    const XMVECTOR Offset = XMLoadFloat3(&Quantization.Offset);
+    const XMVECTOR Extent = XMLoadFloat3(&Quantization.Scale);
+    // Flat axes get a zero scale so they quantize to 0 instead of dividing by zero
+    const XMVECTOR InvExtent = XMVectorSelect(
+        XMVectorDivide(XMVectorReplicate(Unorm16Max), Extent), XMVectorZero(),
+        XMVectorLess(Extent, XMVectorReplicate(1e-30f)));
+
+    for (size_t i = 0; i < Count; ++i)
+    {
+        XMVECTOR q = XMVectorMultiply(XMVectorSubtract(XMLoadFloat3(&In[i].Position), Offset), InvExtent);
+        q = XMVectorRound(XMVectorClamp(q, XMVectorZero(), XMVectorReplicate(Unorm16Max)));
+        alignas(16) uint32_t Lanes[4];
+        XMStoreInt4(Lanes, XMConvertVectorFloatToInt(q, 0));
+        Out[i].Position[0] = static_cast<uint16_t>(Lanes[0]);
+        Out[i].Position[1] = static_cast<uint16_t>(Lanes[1]);
+        Out[i].Position[2] = static_cast<uint16_t>(Lanes[2]);
+        Out[i].Position[3] = 0;
+    }
+}
+
+void DecodeQuantizedPositions(const PackedQuantizedVertex* In, size_t Count, const VertexQuantization& Quantization,
+    Vertex* Out)
+{
+    const XMVECTOR Offset = XMLoadFloat3(&Quantization.Offset);
+    const XMVECTOR Scale = XMVectorScale(XMLoadFloat3(&Quantization.Scale), 1.f / Unorm16Max);
+    for (size_t i = 0; i < Count; ++i)
+    {
+        const XMVECTOR q = XMVectorSet(In[i].Position[0], In[i].Position[1], In[i].Position[2], 0.f);
+        XMStoreFloat3(&Out[i].Position, XMVectorMultiplyAdd(q, Scale, Offset));
+    }
+}
+
+} // namespace
+
+PackedVertexStream PackVertices(const Vertex* Vertices, size_t Count, VertexEncoding Encoding)
+{
+    PackedVertexStream Stream;
+    Stream.Encoding = Encoding;
+    Stream.Stride = GetVertexLayout(Encoding).Stride;
+    Stream.VertexCount = static_cast<uint32_t>(Count);
+    Stream.Data.resize(Count * Stream.Stride);
+    Stream.Quantization = PackVertices(Vertices, Count, Encoding, Stream.Data.data());
+    return Stream;
+}
+
+VertexQuantization PackVertices(const Vertex* Vertices, size_t Count, VertexEncoding Encoding, uint8_t* Out)
+{
+    VertexQuantization Quantization;
+    if (Count == 0)
+        return Quantization;
+
+    switch (Encoding)
+    {
+    case VertexEncoding::Full:
+        std::memcpy(Out, Vertices, Count * sizeof(Vertex));
+        break;
+    case VertexEncoding::Packed:
+    {
+        PackedVertex* Packed = reinterpret_cast<PackedVertex*>(Out);
+        for (size_t i = 0; i < Count; ++i)
+            Packed[i].Position = Vertices[i].Position;
+        EncodeTangentFrames(Vertices, Count, Packed);
+        EncodeUVs(Vertices, Count, Packed);
+        break;
+    }
+    case VertexEncoding::PackedQuantized:
+    {
+        PackedQuantizedVertex* Packed = reinterpret_cast<PackedQuantizedVertex*>(Out);
+        Quantization = ComputeQuantization(Vertices, Count);
+        EncodeQuantizedPositions(Vertices, Count, Quantization, Packed);
+        EncodeTangentFrames(Vertices, Count, Packed);
+        EncodeUVs(Vertices, Count, Packed);
+        break;
+    }
+    }
+    return Quantization;
+}
+
+void UnpackVertices(const PackedVertexStream& Stream, Vertex* Out)
+{
+    const size_t Count = Stream.VertexCount;
+    if (Count == 0)
+        return;
+
+    switch (Stream.Encoding)
+    {
+    case VertexEncoding::Full:
+        std::memcpy(Out, Stream.Data.data(), Count * sizeof(Vertex));
+        break;
+    case VertexEncoding::Packed:
+    {
+        const PackedVertex* In = reinterpret_cast<const PackedVertex*>(Stream.Data.data());
+        for (size_t i = 0; i < Count; ++i)
+            Out[i].Position = In[i].Position;
+        DecodeTangentFrames(In, Count, Out);
+        DecodeUVs(In, Count, Out);
+        break;
+    }
+    case VertexEncoding::PackedQuantized:
+    {
+        const PackedQuantizedVertex* In = reinterpret_cast<const PackedQuantizedVertex*>(Stream.Data.data());
+        DecodeQuantizedPositions(In, Count, Stream.Quantization, Out);
+        DecodeTangentFrames(In, Count, Out);
+        DecodeUVs(In, Count, Out);
+        break;
+    }
+    }
+}
+
+} // namespace Racoon
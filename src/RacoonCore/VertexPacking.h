@@ -0,0 +1,94 @@
+#pragma once
+
+#include "CoreStdafx.h"
+#include "MeshGeometry.h"
+
+namespace Racoon {
+
+// How vertices are laid out in GPU memory. Full is Racoon::Vertex as is; the
+// packed encodings trade a little precision for bandwidth and pool memory.
+enum class VertexEncoding : uint8_t
+{
+    // float3 position, normal, tangent and float2 UV: 44 bytes
+    Full,
+    // float3 position, octahedral snorm16 normal and tangent, half UV: 24 bytes
+    Packed,
+    // As Packed, with unorm16 positions quantized to the mesh bounds: 20 bytes
+    PackedQuantized
+};
+
+// API-agnostic attribute formats. The renderer maps them to DXGI formats.
+enum class VertexFormat : uint8_t
+{
+    Float2,
+    Float3,
+    Half2,
+    Snorm16x4,
+    Unorm16x4
+};
+
+struct VertexAttribute
+{
+    const char* Semantic;
+    VertexFormat Format;
+    uint32_t Offset;
+};
+
+struct VertexLayout
+{
+    std::vector<VertexAttribute> Attributes;
+    uint32_t Stride{ 0 };
+};
+
+VertexLayout GetVertexLayout(VertexEncoding Encoding);
+
+// TangentFrame holds the octahedral normal in xy and the octahedral tangent
+// in zw. The tangent handedness is folded into the sign of w, see PackVertices.
+struct PackedVertex
+{
+    XMFLOAT3 Position;
+    int16_t TangentFrame[4];
+    uint16_t UV[2];
+};
+static_assert(sizeof(PackedVertex) == 24, "PackedVertex must stay tightly packed");
+
+struct PackedQuantizedVertex
+{
+    uint16_t Position[4];
+    int16_t TangentFrame[4];
+    uint16_t UV[2];
+};
+static_assert(sizeof(PackedQuantizedVertex) == 20, "PackedQuantizedVertex must stay tightly packed");
+
+// Maps unorm positions back to object space: p = Offset + Scale * q, q in [0, 1].
+// Identity for encodings with float positions.
+struct VertexQuantization
+{
+    XMFLOAT3 Offset{ 0.f, 0.f, 0.f };
+    XMFLOAT3 Scale{ 1.f, 1.f, 1.f };
+};
+
+struct PackedVertexStream
+{
+    VertexEncoding Encoding{ VertexEncoding::Full };
+    uint32_t Stride{ 0 };
+    uint32_t VertexCount{ 0 };
+    VertexQuantization Quantization;
+    std::vector<uint8_t> Data;
+};
+
+// Encodes Count vertices, four at a time in SoA form. Vertex carries no
+// bitangent handedness, so the tangent sign is always stored as +1.
+PackedVertexStream PackVertices(const Vertex* Vertices, size_t Count, VertexEncoding Encoding);
+inline PackedVertexStream PackVertices(const MeshData& Mesh, VertexEncoding Encoding)
+{
+    return PackVertices(Mesh.Vertices.data(), Mesh.Vertices.size(), Encoding);
+}
+// As above into Out, Count times the encoding's stride bytes, for callers
+// that keep their own vertex memory. Returns the stream's quantization.
+VertexQuantization PackVertices(const Vertex* Vertices, size_t Count, VertexEncoding Encoding, uint8_t* Out);
+
+// Decodes Stream.VertexCount vertices into Out
+void UnpackVertices(const PackedVertexStream& Stream, Vertex* Out);
+
+} // namespace Racoon